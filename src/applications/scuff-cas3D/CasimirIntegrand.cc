@@ -225,6 +225,171 @@ void ExportHDF5Data(SC3Data *SC3D, double Xi, double *kBloch, char *Tag)
 
 }
  
+/***************************************************************/
+/* returns true if all quantities at transformation #nt are    */
+/* already converged, in which case GetCasimirIntegrand skips  */
+/* the transformation and returns zeros for its quantities.    */
+/***************************************************************/
+static bool TransformConverged(SC3Data *SC3D, int nt)
+{
+  bool PBC = (SC3D->G->LDim > 0);
+  for(int nq=0; nq<SC3D->NumQuantities; nq++)
+   { int ntnq = nt*SC3D->NumQuantities + nq;
+     if ( !SC3D->XiConverged[ntnq] && !(PBC && SC3D->BZConverged[ntnq]) )
+      return false;
+   };
+  return true;
+}
+
+/***************************************************************/
+/* helper routine for LegacyRead that, given a line of text    */
+/* from a .byXi or .byXikBloch file, does the following:       */
+/*  1. checks that the first token on the line matches Tag     */
+/*     and that the next NumKeys tokens match the              */
+/*     corresponding entries of Keys                           */
+/*  2. if (1) failed, returns false                            */
+/*  3. otherwise, fills in Values with the remaining numbers   */
+/*     on the line (up to 4) and returns the number of those   */
+/*     numbers that were successfully read as *NumValues       */
+/***************************************************************/
+static bool LineMatches(char *Line, const char *Tag, double *Keys, int NumKeys,
+                        double *Values, int *NumValues)
+{
+  char MyTag[1000];
+  double Numbers[7];
+  int nRead=sscanf(Line,"%s %le %le %le %le %le %le %le",
+                         MyTag, Numbers+0, Numbers+1,
+                         Numbers+2, Numbers+3, Numbers+4,
+                         Numbers+5, Numbers+6);
+
+  if ( nRead < (NumKeys+2) )
+   return false;
+
+  if ( strcasecmp(Tag, MyTag) )
+   return false;
+
+  for(int nk=0; nk<NumKeys; nk++)
+   if ( fabs(Numbers[nk]-Keys[nk]) > 1.0e-6*fabs(Keys[nk]) )
+    return false;
+
+  *NumValues = nRead - 1 - NumKeys;
+  for(int nv=0; nv < (*NumValues); nv++)
+   Values[nv] = Numbers[NumKeys + nv];
+
+  return true;
+}
+
+/***************************************************************/
+/* runs from before the introduction of checkpoint files       */
+/* resumed from the .byXi (or, for periodic geometries, the    */
+/* .byXikBloch) file. if --UseExistingData is given and there  */
+/* is no checkpoint file yet, LegacyFileName points to that    */
+/* file, and the integrand at (Xi, kBloch) is looked up there  */
+/* (matching Xi and kBloch to 1 part in 10^6, the precision of */
+/* the text file) and copied into the checkpoint file, so each */
+/* point is imported once and later runs use the checkpoint.   */
+/* returns true if data for all transforms were found.         */
+/***************************************************************/
+static bool LegacyRead(SC3Data *SC3D, double Xi, double *kBloch, double *EFT)
+{
+  if (SC3D->LegacyFileName==0)
+   return false;
+
+  FILE *f=fopen(SC3D->LegacyFileName,"r");
+  if (f==0)
+   return false;
+
+  int LDim = SC3D->G->LDim;
+  int NumKeys = 1 + LDim;
+  double Keys[3];
+  Keys[0]=Xi;
+  if(NumKeys>=2) Keys[1]=kBloch[0];
+  if(NumKeys>=3) Keys[2]=kBloch[1];
+
+  /*----------------------------------------------------------*/
+  /* skip down to the line for the first transform at this   */
+  /* point; the lines for the remaining transforms follow it  */
+  /*----------------------------------------------------------*/
+  double Values[7];
+  int NumValues;
+  int LineNum=0;
+  char Line[1000];
+  int NQ = SC3D->NumQuantities;
+  bool FoundFirst=false;
+  while( !FoundFirst && fgets(Line,1000,f) )
+   { LineNum++;
+     if ( !LineMatches(Line,SC3D->GTCList[0]->Tag,Keys,NumKeys,Values,&NumValues) )
+      continue;
+     if ( NumValues != NQ )
+      { Log(" found matching (Tag,freqs) on line %i of %s"
+            " but number of quantities is wrong (%i, %i)",
+            LineNum,SC3D->LegacyFileName,NumValues,NQ);
+        continue;
+      };
+     FoundFirst=true;
+   };
+  if (!FoundFirst)
+   { fclose(f);
+     return false;
+   };
+  memcpy(EFT,Values,NQ*sizeof(double));
+
+  for(int nt=1; nt<SC3D->NumTransformations; nt++)
+   { LineNum++;
+     if (    !fgets(Line,1000,f)
+          || !LineMatches(Line,SC3D->GTCList[nt]->Tag,Keys,NumKeys,Values,&NumValues)
+          || (NumValues!=NQ)
+        )
+      { Log("data at Xi=%g on line %i of %s are incomplete (ignoring)",
+             Xi,LineNum,SC3D->LegacyFileName);
+        fclose(f);
+        return false;
+      };
+     memcpy(EFT + nt*NQ,Values,NQ*sizeof(double));
+   };
+  fclose(f);
+
+  /*----------------------------------------------------------*/
+  /* import into the checkpoint file. transforms that were    */
+  /* already converged when the old run wrote this point have */
+  /* zeros in the file, which must not become checkpoint data */
+  /*----------------------------------------------------------*/
+  for(int nt=0; nt<SC3D->NumTransformations; nt++)
+   if ( !TransformConverged(SC3D, nt) )
+    WriteCheckpoint(SC3D->Checkpoint, SC3D->GTCList[nt]->Tag,
+                    cdouble(0.0,Xi), kBloch, EFT + nt*NQ);
+   else
+    memset(EFT + nt*NQ, 0, NQ*sizeof(double));
+
+  Log("Imported Casimir integrand at Xi=%g from line %i of %s",
+       Xi,LineNum,SC3D->LegacyFileName);
+  return true;
+}
+
+/***************************************************************/
+/* attempt to bypass an entire GetCasimirIntegrand calculation */
+/* by reading the integrand at all (non-converged) transforms  */
+/* from the checkpoint file, or from the output of an older    */
+/* run (see LegacyRead). returns true if successful.           */
+/***************************************************************/
+static bool CheckpointRead(SC3Data *SC3D, cdouble Omega, double *kBloch,
+                           double *EFT)
+{
+  if (SC3D->Checkpoint==0)
+   return false;
+
+  int NQ=SC3D->NumQuantities;
+  for(int nt=0; nt<SC3D->NumTransformations; nt++)
+   { if ( TransformConverged(SC3D, nt) )
+      memset(EFT + nt*NQ, 0, NQ*sizeof(double));
+     else if ( !ReadCheckpoint(SC3D->Checkpoint, SC3D->GTCList[nt]->Tag,
+                               Omega, kBloch, EFT + nt*NQ) )
+      return LegacyRead(SC3D, imag(Omega), kBloch, EFT);
+   };
+
+  Log("Read Casimir integrand at Xi=%g from checkpoint file",imag(Omega));
+  return true;
+}
 
 /***************************************************************/
 /* evaluate the casimir energy, force, and/or torque integrand */
@@ -262,10 +427,10 @@ void GetCasimirIntegrand(void *pSC3D, cdouble Omega,
   double Xi = imag(Omega);
 
   /***************************************************************/
-  /* attempt to bypass the calculation by reading data from a    */
-  /* cache file                                                  */
+  /* attempt to bypass the calculation by reading data from the  */
+  /* checkpoint file                                             */
   /***************************************************************/
-  if ( CacheRead(SC3D, Xi, kBloch, EFT) )
+  if ( CheckpointRead(SC3D, Omega, kBloch, EFT) )
    return;
 
   RWGGeometry *G = SC3D->G;
@@ -370,7 +535,7 @@ void GetCasimirIntegrand(void *pSC3D, cdouble Omega,
   /* for each line in the TransFile, apply the specified         */
   /* transformation, then calculate all quantities requested.    */
   /***************************************************************/
-  FILE *ByXiKFile = (G->LDim==0) ? 0 : fopen(SC3D->ByXiKFileName,"a");
+  FILE *ByXiKFile = (G->LDim==0) ? 0 : OpenOutputFile("%s",SC3D->ByXiKFileName);
   int NT=SC3D->NumTransformations;
   for(int ntnq=0, nt=0; nt<NT; nt++)
    { 
@@ -385,23 +550,7 @@ void GetCasimirIntegrand(void *pSC3D, cdouble Omega,
      /******************************************************************/
      /* skip if all quantities are already converged at this transform */
      /******************************************************************/
-     bool AllConverged=true;
-     for(int nq=0; AllConverged && nq<SC3D->NumQuantities; nq++)
-      { 
-        bool ThisConverged;
-
-        if (SC3D->XiConverged[ntnq+nq]) 
-         ThisConverged=true;
-        else if (PBC && SC3D->BZConverged[ntnq+nq])
-         ThisConverged=true;
-        else
-         ThisConverged=false;
-
-        if (ThisConverged==false) 
-         AllConverged=false;
-
-      };
-     if (AllConverged)
+     if ( TransformConverged(SC3D, nt) )
       { Log("All quantities already converged at Tag %s",Tag);
 
         for(int nq=0; nq<SC3D->NumQuantities; nq++)
@@ -483,6 +632,9 @@ void GetCasimirIntegrand(void *pSC3D, cdouble Omega,
         fflush(ByXiKFile);
       };
 
+     WriteCheckpoint(SC3D->Checkpoint, Tag, Omega, kBloch,
+                     EFT + ntnq - SC3D->NumQuantities);
+
      if (SC3D->WriteHDF5Files)
       ExportHDF5Data(SC3D, Xi, kBloch, (NT==1 ? 0 : Tag) );
 
@@ -494,7 +646,7 @@ void GetCasimirIntegrand(void *pSC3D, cdouble Omega,
    }; // for(ntnq=nt=0; nt<SC3D->NumTransformations; nt++)
 
   if (ByXiKFile)
-   fclose(ByXiKFile);
+   CloseOutputFile(ByXiKFile);
 
   /***************************************************************/
   /***************************************************************/
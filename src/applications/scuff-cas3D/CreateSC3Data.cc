@@ -212,7 +212,7 @@ void WriteFilePreamble(SC3Data *SC3D, int PreambleType)
      default: ErrExit("%s:%i: internal error",__FILE__,__LINE__);
    };
 
-  FILE *f=fopen(FileName,"a");
+  FILE *f=OpenOutputFile("%s",FileName);
   if (f==0) 
    ErrExit("could not open file %s",FileName);
 
@@ -297,7 +297,7 @@ void WriteFilePreamble(SC3Data *SC3D, int PreambleType)
      if (ErrorString) fprintf(f,"#%i: z-torque %s \n",nc++,ErrorString);
    };
 
-  fclose(f);
+  CloseOutputFile(f);
 
   SC3D->UTIntegralBuffer[0]=SC3D->UTIntegralBuffer[1]=0;
 
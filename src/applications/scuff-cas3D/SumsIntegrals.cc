@@ -34,140 +34,6 @@
 #define XIMIN  0.001
 #define XIMAX 10.000
 
-/***************************************************************/
-/* helper routine for CacheRead that, given a line of text     */
-/* from a cache file, does the following:                      */
-/*  1. checks that the first token on the line matches Tag     */
-/*     and that the next NumbersToMatch tokens match the       */
-/*     corresponding entries of Numbers                        */ 
-/*  2. if (1) failed, returns false                            */
-/*  3. otherwise, fills in Values with the remaining numbers   */
-/*     on the line (up to 4) and returns the number of those   */
-/*     numbers that were successfully read as *NumValues       */
-/***************************************************************/
-bool LineMatches(char *Line, char *Tag, double *Keys, int NumKeys,
-                 double *Values, int *NumValues)
-{
-  char MyTag[1000];
-  double Numbers[7];
-  int nRead=sscanf(Line,"%s %le %le %le %le %le %le %le",
-                         MyTag, Numbers+0, Numbers+1,
-                         Numbers+2, Numbers+3, Numbers+4,
-                         Numbers+5, Numbers+6);
-  
-  if ( nRead < (NumKeys+2) )
-   return false;
-
-  if ( strcasecmp(Tag, MyTag) ) 
-   return false;
-
-  for(int nk=0; nk<NumKeys; nk++)
-   if ( fabs(Numbers[nk]-Keys[nk]) > 1.0e-6*fabs(Keys[nk]) )
-    return false;
-
-  *NumValues = nRead - 1 - NumKeys;
-  for(int nv=0; nv < (*NumValues); nv++)
-   Values[nv] = Numbers[NumKeys + nv];
-
-  return true;
-
-}
-
-/***************************************************************/
-/* CacheRead: attempt to bypass an entire GetXiIntegrand       */
-/* calculation by reading results from the .byXi or .byXikbloch*/
-/* file. Returns true if successful (which means the values of */
-/* the energy/force/torque integrand for ALL transformations   */
-/* at this value of Xi were successfully read from the file)   */
-/* or false on failure.                                        */
-/***************************************************************/
-bool CacheRead(SC3Data *SC3D, double Xi, double *kBloch, double *EFT)
-{ 
-  if (SC3D->UseExistingData==false)
-   return false;
-   
-  int LDim = SC3D->G->LBasis ? SC3D->G->LBasis->NC : 0;
-
-  if (    (kBloch==0 && LDim>0)
-       || (kBloch!=0 && LDim==0)
-     ) ErrExit("%s:%i: internal error",__FILE__,__LINE__);
-
-  /*----------------------------------------------------------*/
-  /*----------------------------------------------------------*/
-  /*----------------------------------------------------------*/
-  int NumKeys = 1 + LDim;
-  double Keys[3];
-  Keys[0]=Xi;
-  if(NumKeys>=2) Keys[1]=kBloch[0];
-  if(NumKeys>=3) Keys[2]=kBloch[1];
-
-  /*----------------------------------------------------------*/
-  /* 0. try to open the cache file. --------------------------*/
-  /*----------------------------------------------------------*/
-  FILE *f;
-  if (kBloch)
-   f=fopen(SC3D->ByXiKFileName,"r");
-  else
-   f=fopen(SC3D->ByXiFileName,"r");
-  if (f==0) return false;
-
-  /*----------------------------------------------------------*/
-  /* 1. skip down through the cache file until we find a line */
-  /*    whose...                                              */
-  /*----------------------------------------------------------*/
-  double Values[7];
-  int NumValues;
-  int LineNum=0;
-  char Line[1000];
-  char *Tag = SC3D->GTCList[0]->Tag;
-  bool FoundFirst=false;
-  int NQ = SC3D->NumQuantities;
-  while( !FoundFirst && fgets(Line,1000,f) )
-   { LineNum++;
-     if ( !LineMatches(Line,Tag,Keys,NumKeys,Values,&NumValues) )
-      continue;
-     if ( NumValues != NQ )
-      { Log(" found matching (Tag,freqs) on line %i of cache file"
-            " but number of quantities is wrong (%i, %i)",
-            LineNum,NumValues,NQ);
-        continue;
-      };
-     FoundFirst=true;
-   };
-  if (!FoundFirst)
-   { fclose(f);
-     return false;
-   };
-
-  Log("...found matching dataset on line %i...",LineNum);
-  memcpy(EFT,Values,NQ*sizeof(double));
-   
-  /*----------------------------------------------------------*/
-  /* 3. ok, since that worked, now keep going ----------------*/
-  /*----------------------------------------------------------*/
-  for(int nt=1; nt<SC3D->NumTransformations; nt++)
-   { 
-     LineNum++;
-     Tag = SC3D->GTCList[nt]->Tag;
-
-     if (    !fgets(Line,1000,f)  
-          || !LineMatches(Line,Tag,Keys,NumKeys,Values,&NumValues) 
-          || (NumValues!=NQ)
-        )
-      { Log(" ...but data for some transforms were missing (line %i) (aborting)",LineNum);
-        fclose(f);
-        return false;
-      };
-
-     memcpy(EFT + nt*NQ,Values,NQ*sizeof(double));
-   };
-   
-  fclose(f);
-  Log(" ...and successfully read data for all quantities at all transforms");
-  return true;
-
-}
-
 /***************************************************************/
 /* wrapper around GetCasimirIntegrand with correct prototype   */
 /* prototype for passage to adapt_integrate() to use in        */
@@ -467,7 +333,7 @@ void GetXiIntegrand(SC3Data *SC3D, double Xi, double *EFT)
   /***************************************************************/
   /* write data to .byXi file                                    */
   /***************************************************************/
-  FILE *f=fopen(SC3D->ByXiFileName,"a");
+  FILE *f=OpenOutputFile("%s",SC3D->ByXiFileName);
   double *Error = Periodic ? SC3D->BZIArgs->BZIError : 0;
   for(int ntnq=0, nt=0; nt<SC3D->NumTransformations; nt++)
    { fprintf(f,"%s %.6e ",SC3D->GTCList[nt]->Tag,Xi);
@@ -478,31 +344,74 @@ void GetXiIntegrand(SC3Data *SC3D, double Xi, double *EFT)
       };
      fprintf(f,"\n");
    };
-  fclose(f);
+  CloseOutputFile(f);
 
 }
 
 /***************************************************************/
-/* wrapper with correct prototype for pcubature (over an       */
-/* infinite interval)                                          */
+/* evaluate GetXiIntegrand at each of NumXi frequencies, with  */
+/* EFT[nXi*NTNQ + ntnq] the ntnqth quantity at Xi[nXi].        */
+/*                                                             */
+/* when running on several MPI ranks, the frequencies are      */
+/* shared out dynamically among the ranks; for periodic        */
+/* geometries with fewer frequencies than ranks we instead do  */
+/* the frequencies one at a time and let the BZ integration    */
+/* distribute its kBloch points.                               */
 /***************************************************************/
-int GetXiIntegrand2(unsigned ndim, const double *x, void *params, 
-                    unsigned fdim, double *fval)
+typedef struct XiTaskData
+ { SC3Data *SC3D;
+   double *Xi;
+ } XiTaskData;
+
+static void XiTask(void *UserData, int nXi, double *EFT)
+{
+  XiTaskData *Data = (XiTaskData *)UserData;
+  GetXiIntegrand(Data->SC3D, Data->Xi[nXi], EFT);
+}
+
+void GetXiIntegrands(SC3Data *SC3D, int NumXi, double *Xi, double *EFT)
+{
+  int NTNQ = SC3D->NTNQ;
+  bool Periodic = (SC3D->G->LDim > 0);
+  if (Periodic && NumXi<GetMPISize())
+   { for(int nXi=0; nXi<NumXi; nXi++)
+      GetXiIntegrand(SC3D, Xi[nXi], EFT + nXi*NTNQ);
+     return;
+   };
+
+  XiTaskData Data;
+  Data.SC3D = SC3D;
+  Data.Xi   = Xi;
+  DistributeTasks(XiTask, (void *)&Data, NumXi, NTNQ, EFT);
+}
+
+/***************************************************************/
+/* wrapper with correct prototype for pcubature_v (over an     */
+/* infinite interval); all points of each refinement level are */
+/* evaluated in one batch                                      */
+/***************************************************************/
+int GetXiIntegrand2(unsigned ndim, size_t npt, const double *x,
+                    void *params, unsigned fdim, double *fval)
 {
   (void) ndim; // unused
   (void) fdim; // unused
 
   SC3Data *SC3D = (SC3Data *)params;
 
-  double Xi = SC3D->XiMin + x[0]/(1.0-x[0]); 
-  double Jacobian = 1.0/( (1.0-x[0])*(1.0-x[0]) );
-  double *EFT = fval;
+  double *Xi = new double[npt];
+  for(size_t np=0; np<npt; np++)
+   Xi[np] = SC3D->XiMin + x[np]/(1.0-x[np]); 
 
-  GetXiIntegrand(SC3D, Xi, EFT);
+  GetXiIntegrands(SC3D, npt, Xi, fval);
 
-  for(int ntnq=0; ntnq<SC3D->NTNQ; ntnq++)
-   EFT[ntnq]*=Jacobian;
+  for(size_t np=0; np<npt; np++)
+   { double Jacobian = 1.0/( (1.0-x[np])*(1.0-x[np]) );
+     double *EFT = fval + np*SC3D->NTNQ;
+     for(int ntnq=0; ntnq<SC3D->NTNQ; ntnq++)
+      EFT[ntnq]*=Jacobian;
+   };
 
+  delete[] Xi;
   return 0;
 
 }
@@ -532,36 +441,40 @@ int GetXiIntegrand3(unsigned ndim, const double *x, void *params,
 void GetXiIntegral_TrapSimp(SC3Data *SC3D, int NumIntervals, double *I, double *E)
 { 
   int fdim = SC3D->NTNQ;
-  double *fLeft  = new double[fdim];
-  double *fMid   = new double[fdim];
-  double *fRight = new double[fdim];
-  double Xi;
 
   /*--------------------------------------------------------------*/
-  /*- evaluate integrand at leftmost frequency point and estimate */
-  /*- the integral from 0 to XIMIN by assuming that the integrand */
-  /*- is constant in that range                                   */
+  /*- the integrand is needed at the leftmost frequency point and */
+  /*- at the midpoint and right end of each interval; evaluate    */
+  /*- them all in one batch                                       */
+  /*--------------------------------------------------------------*/
+  int NumXi = 2*NumIntervals + 1;
+  double *Xi = new double[NumXi];
+  double *f  = new double[NumXi*fdim];
+  double Delta = (XIMAX - XIMIN ) / NumIntervals;
+  Xi[0]=SC3D->XiMin;
+  for(int nXi=1; nXi<NumXi; nXi++)
+   Xi[nXi] = Xi[nXi-1] + 0.5*Delta;
+  GetXiIntegrands(SC3D, NumXi, Xi, f);
+
+  /*--------------------------------------------------------------*/
+  /*- estimate the integral from 0 to XIMIN by assuming that the  */
+  /*- integrand is constant in that range                         */
   /*--------------------------------------------------------------*/
-  Xi=SC3D->XiMin;
-  GetXiIntegrand(SC3D, Xi, fLeft);
   for(int nf=0; nf<fdim; nf++)
-   I[nf] = fLeft[nf] * (SC3D->XiMin);
+   I[nf] = f[nf] * (SC3D->XiMin);
   memset(E,0,SC3D->NTNQ*sizeof(double));
+
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
-  double Delta = (XIMAX - XIMIN ) / NumIntervals;
   double *ISimp  = new double[fdim];
   double *ITrap  = new double[fdim];
   for(int nIntervals=0; nIntervals<NumIntervals; nIntervals++)
    { 
-     // evaluate integrand at midpoint of interval 
-     Xi += 0.5*Delta;
-     GetXiIntegrand(SC3D, Xi, fMid);
-
-     // evaluate integrand at right end of interval 
-     Xi += 0.5*Delta;
-     GetXiIntegrand(SC3D, Xi, fRight);
+     // integrand at left end, midpoint, and right end of interval 
+     double *fLeft  = f + (2*nIntervals + 0)*fdim;
+     double *fMid   = f + (2*nIntervals + 1)*fdim;
+     double *fRight = f + (2*nIntervals + 2)*fdim;
 
      // compute the simpson's rule and trapezoidal rule
      // estimates of the integral over this interval  
@@ -573,13 +486,9 @@ void GetXiIntegral_TrapSimp(SC3Data *SC3D, int NumIntervals, double *I, double *
         E[nf] += fabs(ISimp[nf] - ITrap[nf]);
       };
 
-     // prepare for next iteration
-     memcpy(fLeft, fRight, fdim*sizeof(double));
-
    };
-  delete[] fLeft;
-  delete[] fMid;
-  delete[] fRight;
+  delete[] Xi;
+  delete[] f;
   delete[] ISimp;
   delete[] ITrap;
 
@@ -594,9 +503,9 @@ void GetXiIntegral_Adaptive(SC3Data *SC3D, double *EFT, double *Error)
   double Lower[1] = {0.0}; 
   double Upper[1] = {1.0};
 
-  pcubature(SC3D->NTNQ, GetXiIntegrand2, (void *)SC3D, 1, Lower, Upper,
-            SC3D->MaxXiPoints, SC3D->AbsTol, SC3D->RelTol,
-            ERROR_INDIVIDUAL, EFT, Error);
+  pcubature_v(SC3D->NTNQ, GetXiIntegrand2, (void *)SC3D, 1, Lower, Upper,
+              SC3D->MaxXiPoints, SC3D->AbsTol, SC3D->RelTol,
+              ERROR_INDIVIDUAL, EFT, Error);
    
 }
 
@@ -647,10 +556,12 @@ void GetXiIntegral_Cliff(SC3Data *SC3D, double *I, double *E)
   char ICFLogFile[100];
   snprintf(ICFLogFile, 100, "%s.XiIntegralLog",SC3D->FileBase);
   double XiMin = SC3D->XiMin;
+  // the cliff integrator proceeds one frequency at a time, so
+  // under MPI every rank runs it (only the root keeps a log)
   IntegrateCliffFunction(GetXiIntegrand3, (void *)SC3D, SC3D->NTNQ,
                          XiMin, 0.0, XiCliff, 
                          SC3D->AbsTol, SC3D->RelTol, I, E,
-                         ICFLogFile);
+                         GetMPIRank()==0 ? ICFLogFile : 0);
 }
 
 /***************************************************************/
@@ -667,9 +578,13 @@ void GetXiIntegral_Cliff(SC3Data *SC3D, double *I, double *E)
 void GetMatsubaraSum(SC3Data *SC3D, double Temperature, double *EFT, double *Error)
 { 
   int n, ntnq, NTNQ=SC3D->NTNQ;
-  double Xi, Weight;
+  double Weight;
 
-  double *dEFT = new double [NTNQ]; 
+  // under MPI we evaluate one matsubara frequency per rank at a
+  // time; terms beyond the point of convergence are discarded
+  int BatchSize = GetMPISize();
+  double *XiBatch = new double[BatchSize];
+  double *dEFTBatch = new double[BatchSize*NTNQ];
   double *LastEFT = new double[NTNQ]; 
   double RelDelta;
   int AllConverged=0;
@@ -683,82 +598,106 @@ void GetMatsubaraSum(SC3Data *SC3D, double Temperature, double *EFT, double *Err
 
   Log("Beginning Matsubara sum at T=%g kelvin...",Temperature);
 
-  for(n=0; n<SC3D->MaxXiPoints; n++)
+  for(n=0; n<SC3D->MaxXiPoints && AllConverged==0; )
    { 
      /***************************************************************/
-     /* compute the next matsubara frequency ************************/
+     /* compute the next batch of matsubara frequencies *************/
      /***************************************************************/
-     if (n==0)
-      { Weight=0.5;
+     int NumXi = SC3D->MaxXiPoints - n;
+     if (NumXi>BatchSize) NumXi=BatchSize;
+     for(int nXi=0; nXi<NumXi; nXi++)
+      { 
         // NOTE: we assume that the integrand is constant for Xi < XIMIN
-        Xi=XIMIN;
-      }
-     else
-      { Weight=1.0;
-        Xi=2.0*M_PI*kT*((double)n);
+        XiBatch[nXi] = (n+nXi==0) ? XIMIN : 2.0*M_PI*kT*((double)(n+nXi));
       };
 
      /***************************************************************/
-     /* evaluate the frequency integrand at this matsubara frequency*/
+     /* evaluate the frequency integrand at these frequencies       */
      /***************************************************************/
-     GetXiIntegrand(SC3D, Xi, dEFT);
+     GetXiIntegrands(SC3D, NumXi, XiBatch, dEFTBatch);
 
-     /***************************************************************/
-     /* accumulate contributions to the sum.                        */
-     /*                                                             */
-     /* how it works: the matsubara sum is                          */
-     /*  2\pi kT *  \sum_n^\prime F(\xi_n)                          */
-     /* where \xi_n is the nth matsubara frequency and F(\xi) is    */
-     /* the casimir integrand (and the primed sum means that the    */
-     /* n==0 term is weighted with a factor of 1/2).                */
-     /*                                                             */
-     /* however, my GetXiIntegrand() routine returns the quantity   */
-     /* FI = F(\xi_n) / (2\pi). (this is so that the integral of FI */
-     /* over all \xi returns the correct casimir quantity with no   */
-     /* additional multiplicative prefactors.)                      */
-     /*                                                             */
-     /* thus the matsubara sum is                                   */
-     /*  2\pi kT *  \sum_n^\prime FI(\xi_n)                       */
-     /*                                                             */
-     /* where FI is what is returned by GetXiIntegrand.             */
-     /***************************************************************/
-     memcpy(LastEFT,EFT,NTNQ*sizeof(double));
-     for(ntnq=0; ntnq<NTNQ; ntnq++)
-      EFT[ntnq] += Weight * 2.0*M_PI* kT * dEFT[ntnq];
-
-     /*********************************************************************/
-     /* convergence analysis.                                             */
-     /* how it works: if the relative change in output quantity #ntnq is  */
-     /* less than EPSREL, we increment ConvergedIters[ntnq]; otherwise we */
-     /* set ConvergedIters[ntnq] to 0.                                    */
-     /* when ConvergedIters[ntnq] hits 2, we mark quantity #ntnq as       */
-     /* having converged.                                                 */
-     /* when all quantities have converged, we are done.                  */
-     /*********************************************************************/
-     for(AllConverged=1, ntnq=0; ntnq<NTNQ; ntnq++)
+     int nXi;
+     for(nXi=0; nXi<NumXi; nXi++)
       { 
-        if ( SC3D->XiConverged[ntnq] )
-         continue;
-
-        Error[ntnq] = fabs(EFT[ntnq] - LastEFT[ntnq]);
-        RelDelta = Error[ntnq] / fabs(EFT[ntnq]);
-        if ( RelDelta < 1.0e-6 )
-         ConvergedIters[ntnq]++;
-        else
-         ConvergedIters[ntnq]=0;
-
-        if ( ConvergedIters[ntnq]>=2 )
-         SC3D->XiConverged[ntnq]=true;
-        else  
-         AllConverged=0;
-      }; 
-
-     if (AllConverged==1)
-      break;
+        Weight = (n+nXi==0) ? 0.5 : 1.0;
+        double *dEFT = dEFTBatch + nXi*NTNQ;
+
+        /***************************************************************/
+        /* a frequency evaluated one at a time contributes nothing to  */
+        /* transformations at which all quantities have converged;     */
+        /* within a batch, later terms may have been computed before   */
+        /* that happened, so we zero them here.                        */
+        /***************************************************************/
+        int NQ=SC3D->NumQuantities;
+        for(int nt=0; nt<SC3D->NumTransformations; nt++)
+         { bool AllConvergedAtTransform=true;
+           for(int nq=0; nq<NQ; nq++)
+            if (!SC3D->XiConverged[nt*NQ+nq]) 
+             AllConvergedAtTransform=false;
+           if (AllConvergedAtTransform)
+            memset(dEFT + nt*NQ, 0, NQ*sizeof(double));
+         };
+
+        /***************************************************************/
+        /* accumulate contributions to the sum.                        */
+        /*                                                             */
+        /* how it works: the matsubara sum is                          */
+        /*  2\pi kT *  \sum_n^\prime F(\xi_n)                          */
+        /* where \xi_n is the nth matsubara frequency and F(\xi) is    */
+        /* the casimir integrand (and the primed sum means that the    */
+        /* n==0 term is weighted with a factor of 1/2).                */
+        /*                                                             */
+        /* however, my GetXiIntegrand() routine returns the quantity   */
+        /* FI = F(\xi_n) / (2\pi). (this is so that the integral of FI */
+        /* over all \xi returns the correct casimir quantity with no   */
+        /* additional multiplicative prefactors.)                      */
+        /*                                                             */
+        /* thus the matsubara sum is                                   */
+        /*  2\pi kT *  \sum_n^\prime FI(\xi_n)                       */
+        /*                                                             */
+        /* where FI is what is returned by GetXiIntegrand.             */
+        /***************************************************************/
+        memcpy(LastEFT,EFT,NTNQ*sizeof(double));
+        for(ntnq=0; ntnq<NTNQ; ntnq++)
+         EFT[ntnq] += Weight * 2.0*M_PI* kT * dEFT[ntnq];
+
+        /*********************************************************************/
+        /* convergence analysis.                                             */
+        /* how it works: if the relative change in output quantity #ntnq is  */
+        /* less than EPSREL, we increment ConvergedIters[ntnq]; otherwise we */
+        /* set ConvergedIters[ntnq] to 0.                                    */
+        /* when ConvergedIters[ntnq] hits 2, we mark quantity #ntnq as       */
+        /* having converged.                                                 */
+        /* when all quantities have converged, we are done.                  */
+        /*********************************************************************/
+        for(AllConverged=1, ntnq=0; ntnq<NTNQ; ntnq++)
+         { 
+           if ( SC3D->XiConverged[ntnq] )
+            continue;
+
+           Error[ntnq] = fabs(EFT[ntnq] - LastEFT[ntnq]);
+           RelDelta = Error[ntnq] / fabs(EFT[ntnq]);
+           if ( RelDelta < 1.0e-6 )
+            ConvergedIters[ntnq]++;
+           else
+            ConvergedIters[ntnq]=0;
+
+           if ( ConvergedIters[ntnq]>=2 )
+            SC3D->XiConverged[ntnq]=true;
+           else  
+            AllConverged=0;
+         }; 
+
+        if (AllConverged==1)
+         break;
+
+      }; // for(nXi=0; nXi<NumXi; nXi++)
+     n+=nXi;
 
    }; /* for (n=0 ... */
 
-  delete[] dEFT;   
+  delete[] XiBatch;
+  delete[] dEFTBatch;
   delete[] LastEFT;
   delete[] ConvergedIters;
   
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "scuff-cas3D.h"
 
@@ -39,11 +40,33 @@
 
 #define MAXSTR   1000
 
+/***************************************************************/
+/* task function for distributing the rows of an --XikBlochFile*/
+/* over MPI ranks                                              */
+/***************************************************************/
+typedef struct XiKTaskData
+ { SC3Data *SC3D;
+   HMatrix *XiKPoints;
+ } XiKTaskData;
+
+static void XiKTask(void *UserData, int nr, double *EFT)
+{
+  XiKTaskData *Data  = (XiKTaskData *)UserData;
+  HMatrix *XiKPoints = Data->XiKPoints;
+  double Xi, kBloch[2]={0.0, 0.0};
+  Xi        = XiKPoints->GetEntryD(nr, 0);
+  kBloch[0] = XiKPoints->GetEntryD(nr, 1);
+  if (Data->SC3D->G->LDim>=2)
+   kBloch[1] = XiKPoints->GetEntryD(nr, 2);
+  GetCasimirIntegrand(Data->SC3D, cdouble(0.0,Xi), kBloch, EFT);
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
 int main(int argc, char *argv[])
 {
+  InitMPI(&argc, &argv);
   InstallHRSignalHandler();
   InitializeLog(argv[0]);
 
@@ -101,6 +124,7 @@ int main(int argc, char *argv[])
   bool UseExistingData = false;
   bool NewEnergyMethod = false;
   bool WriteHDF5Files  = false;
+  double FarFieldThreshold = 0.0;
 
 //
   /* name               type    #args  max_instances  storage           count         description*/
@@ -132,11 +156,13 @@ int main(int argc, char *argv[])
      {"ReadCache",      PA_STRING,  1, MAXCACHE,(void *)ReadCache,      &nReadCache,   "read cache"},
      {"WriteCache",     PA_STRING,  1, 1,       (void *)&WriteCache,    0,             "write cache"},
 //
-     {"UseExistingData", PA_BOOL,   0, 1,       (void *)&UseExistingData, 0,           "reuse data from existing .byXi files"},
+     {"UseExistingData", PA_BOOL,   0, 1,       (void *)&UseExistingData, 0,           "resume from the checkpoint (or, failing that, .byXi) file of an earlier run"},
 //
      {"NewEnergyMethod", PA_BOOL,   0, 1,       (void *)&NewEnergyMethod, 0,           "use alternative method for energy calculation"},
 //
      {"WriteHDF5Files", PA_BOOL,    1, 1,       (void *)&WriteHDF5Files,0,             "write BEM matrices to .hdf5 files"},
+//
+     {"FarFieldThreshold", PA_DOUBLE, 1, 1,     (void *)&FarFieldThreshold, 0,         "use multipole moments for well-separated basis functions"},
      {0,0,0,0,0,0,0}
    };
   ProcessOptions(argc, argv, OSArray);
@@ -148,6 +174,8 @@ int main(int argc, char *argv[])
    OSUsage(argv[0], OSArray, "--geometry option is mandatory");
   if (!FileBase)
    FileBase=vstrdup(GetFileBase(GeoFile));
+  if (FarFieldThreshold>0.0)
+   RWGGeometry::EdgeMomentThreshold=FarFieldThreshold;
 
   /***************************************************************/
   /* try to create the geometry  *********************************/
@@ -274,6 +302,28 @@ int main(int argc, char *argv[])
   SC3D->MaxXiPoints        = MaxXiPoints;
   SC3D->XiMin              = XiMin;
 
+  /*******************************************************************/
+  /* open the checkpoint file, to which the integrand is written at  */
+  /* every (Xi, kBloch) point as soon as it is computed; with        */
+  /* --UseExistingData, points already in the file are not redone;   */
+  /* if there is no checkpoint file yet, data at points computed by  */
+  /* runs of older versions are imported from the .byXi or           */
+  /* .byXikBloch file as they are encountered (see LegacyRead)       */
+  /*******************************************************************/
+  char *CheckpointFileName = vstrdup("%s.checkpoint",SC3D->FileBase);
+  char *CheckpointContext  = vstrdup("scuff-cas3D %s %i %i",GetFileBase(G->GeoFileName),
+                                     WhichQuantities, NewEnergyMethod ? 1 : 0);
+  SC3D->LegacyFileName=0;
+  if ( UseExistingData && access(CheckpointFileName, F_OK)!=0 )
+   { SC3D->LegacyFileName = (G->LDim==0) ? SC3D->ByXiFileName : SC3D->ByXiKFileName;
+     Log("no checkpoint file %s; importing existing data from %s",
+          CheckpointFileName, SC3D->LegacyFileName);
+   };
+  SC3D->Checkpoint = OpenCheckpointFile(CheckpointFileName, CheckpointContext,
+                                        NumQuantities, UseExistingData);
+  free(CheckpointFileName);
+  free(CheckpointContext);
+
   if (G->LDim>=1)
    { UpdateBZIArgs(BZIArgs, G->RLBasis, G->RLVolume);
      BZIArgs->BZIFunc  = GetCasimirIntegrand;
@@ -290,20 +340,22 @@ int main(int argc, char *argv[])
   double *Error=0; 
   if ( XiKPoints )
    { 
-     for(int nr=0; nr<XiKPoints->NR; nr++)
-      { 
-        double Xi, kBloch[2]={0.0, 0.0};
-        Xi        = XiKPoints->GetEntryD(nr, 0);
-        kBloch[0] = XiKPoints->GetEntryD(nr, 1);
-        if (G->LDim>=2)
-         kBloch[1] = XiKPoints->GetEntryD(nr, 2);
-        GetCasimirIntegrand(SC3D, cdouble(0.0,Xi), kBloch, EFT);
-      };
+     XiKTaskData Data;
+     Data.SC3D      = SC3D;
+     Data.XiKPoints = XiKPoints;
+     double *AllEFT = new double[XiKPoints->NR * SC3D->NTNQ];
+     DistributeTasks(XiKTask, (void *)&Data, XiKPoints->NR, SC3D->NTNQ, AllEFT);
+     delete[] AllEFT;
    }
   else if ( XiPoints )
    { 
+     double *Xi     = new double[XiPoints->NR];
+     double *AllEFT = new double[XiPoints->NR * SC3D->NTNQ];
      for (int nr=0; nr<XiPoints->NR; nr++)
-      GetXiIntegrand(SC3D, XiPoints->GetEntryD(nr,0), EFT);
+      Xi[nr] = XiPoints->GetEntryD(nr,0);
+     GetXiIntegrands(SC3D, XiPoints->NR, Xi, AllEFT);
+     delete[] Xi;
+     delete[] AllEFT;
    }
   else if ( Temperature > 0.0)
    { 
@@ -327,7 +379,7 @@ int main(int argc, char *argv[])
   if (Error)
    { 
      WriteFilePreamble(SC3D, PREAMBLE_OUT);
-     FILE *OutFile=fopen(SC3D->OutFileName,"a");
+     FILE *OutFile=OpenOutputFile("%s",SC3D->OutFileName);
      int ntnq=0;
      for(int nt=0; nt<SC3D->NumTransformations; nt++)
       { fprintf(OutFile,"%s ",SC3D->GTCList[nt]->Tag);
@@ -335,11 +387,13 @@ int main(int argc, char *argv[])
          fprintf(OutFile,"%e %e ",EFT[ntnq],Error[ntnq]);
         fprintf(OutFile,"\n");
       };
-     fclose(OutFile); 
+     CloseOutputFile(OutFile); 
      delete[] Error;
    };
 
   delete[] EFT;
+  CloseCheckpointFile(SC3D->Checkpoint);
+  FinalizeMPI();
 
   /***************************************************************/
   /***************************************************************/
@@ -112,6 +112,8 @@ typedef struct SC3Data
 
    // various other miscellaneous items
    bool UseExistingData;
+   CheckpointFile *Checkpoint;
+   char *LegacyFileName;
    bool WriteHDF5Files;
    char *WriteCache;
 
@@ -146,10 +148,10 @@ void WriteFilePreamble(SC3Data *SC3D, int PreambleType);
 /***************************************************************/
 void GetCasimirIntegrand(void *SC3D, cdouble Omega, double *kBloch, double *EFT);
 void GetXiIntegrand(SC3Data *SC3D, double Xi, double *EFT);
+void GetXiIntegrands(SC3Data *SC3D, int NumXi, double *Xi, double *EFT);
 void GetXiIntegral_Adaptive(SC3Data *SC3D, double *EFT, double *Error);
 void GetXiIntegral_TrapSimp(SC3Data *SC3D, int NumIntervals, double *I, double *E);
 void GetXiIntegral_Cliff(SC3Data *SC3D, double *EFT, double *Error);
 void GetMatsubaraSum(SC3Data *SC3D, double Temperature, double *EFT, double *Error);
-bool CacheRead(SC3Data *SC3D, double Xi, double *kBloch, double *EFT);
 
 #endif // #define SCUFFCAS3D_H
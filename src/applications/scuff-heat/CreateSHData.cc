@@ -64,6 +64,9 @@ SHData *CreateSHData(char *GeoFile, char *TransFile, int PlotFlux,
    SHD->nThread=GetNumThreads();
 
   SHD->WriteCache=0;
+  SHD->Checkpoint=0;
+  SHD->ByOmegaStream=0;
+  SHD->BMI=0;
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
@@ -139,3 +142,52 @@ SHData *CreateSHData(char *GeoFile, char *TransFile, int PlotFlux,
   return SHD;
 
 }
+
+/***************************************************************/
+/* create an additional workspace for evaluating a frequency   */
+/* concurrently with those handled by SHD: the clone has its   */
+/* own geometry and matrix storage, but shares the read-only   */
+/* data (transformation list, checkpoint file, file names).    */
+/* the matrix interpolator (if any) is not cloned.             */
+/***************************************************************/
+SHData *CloneSHData(SHData *SHD)
+{
+  SHData *Clone=(SHData *)mallocEC(sizeof(*Clone));
+  memcpy(Clone, SHD, sizeof(*Clone));
+  Clone->WriteCache=0;
+  Clone->ByOmegaStream=0;
+  Clone->BMI=0;
+
+  RWGGeometry *G=Clone->G=new RWGGeometry(SHD->G->GeoFileName);
+  G->SetLogLevel(SCUFF_VERBOSELOGGING);
+
+  int ns, nsp, nb, NS=G->NumSurfaces, NBF, NBFp;
+  Clone->TSelf= (HMatrix **)mallocEC(NS*sizeof(HMatrix *));
+  Clone->TMedium= (HMatrix **)mallocEC(NS*sizeof(HMatrix *));
+  for(ns=0; ns<NS; ns++)
+   { NBF=G->Surfaces[ns]->NumBFs;
+     Clone->TSelf[ns] = new HMatrix(NBF, NBF, LHM_COMPLEX);
+     Clone->TMedium[ns] = new HMatrix(NBF, NBF, LHM_COMPLEX);
+   };
+
+  Clone->UMedium = (HMatrix **)mallocEC( ( NS*(NS-1)/2)*sizeof(HMatrix *));
+  for(nb=0, ns=0; ns<NS; ns++)
+   for(nsp=ns+1; nsp<NS; nsp++, nb++)
+    { NBF=G->Surfaces[ns]->NumBFs;
+      NBFp=G->Surfaces[nsp]->NumBFs;
+      Clone->UMedium[nb] = new HMatrix(NBF, NBFp, LHM_COMPLEX);
+    };
+
+  int N=G->TotalBFs, N1=SHD->N1, N2=SHD->SymG2->NR;
+  Clone->SymG1      = new HMatrix(N1, N1, LHM_COMPLEX );
+  Clone->SymG2      = new HMatrix(N2, N2, LHM_COMPLEX );
+  Clone->W          = new HMatrix(N,  N,  LHM_COMPLEX );
+  Clone->W21        = new HMatrix(N2, N1, LHM_COMPLEX );
+  Clone->W21SymG1   = new HMatrix(N2, N1, LHM_COMPLEX );
+  Clone->W21DSymG2  = new HMatrix(N1, N2, LHM_COMPLEX );
+  Clone->Scratch    = new HMatrix(N,  N1, LHM_COMPLEX );
+
+  Clone->DV         = new HVector(N2, LHM_REAL);
+
+  return Clone;
+}
@@ -155,11 +155,36 @@ void InsertSymmetrizedBlock(HMatrix *A, HMatrix *B, int RowOffset, int ColOffset
 
 } 
 
+/***************************************************************/
+/* attempt to bypass an entire GetFrequencyIntegrand           */
+/* calculation by reading the integrand at all transformations */
+/* from the checkpoint file. returns true if successful.       */
+/***************************************************************/
+static bool CheckpointRead(SHData *SHD, cdouble Omega, double *FI)
+{
+  if ( SHD->Checkpoint==0 || SHD->PlotFlux )
+   return false;
+
+  for(int nt=0; nt<SHD->NumTransformations; nt++)
+   if ( !ReadCheckpoint(SHD->Checkpoint, SHD->GTCList[nt]->Tag, Omega, 0, FI+nt) )
+    return false;
+
+  Log("Read heat radiation/transfer at omega=%s from checkpoint file",z2s(Omega));
+  FILE *f=SHD->ByOmegaStream ? SHD->ByOmegaStream : fopen(SHD->ByOmegaFile, "a");
+  for(int nt=0; nt<SHD->NumTransformations; nt++)
+   fprintf(f,"%s %s %e\n",SHD->GTCList[nt]->Tag,z2s(Omega),FI[nt]);
+  if (f!=SHD->ByOmegaStream)
+   fclose(f);
+  return true;
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
 void GetFrequencyIntegrand(SHData *SHD, cdouble Omega, double *FI)
 {
+  if ( CheckpointRead(SHD, Omega, FI) )
+   return;
 
   /***************************************************************/
   /* extract fields from SHData structure ************************/
@@ -190,14 +215,16 @@ void GetFrequencyIntegrand(SHData *SHD, cdouble Omega, double *FI)
    { 
      Log(" Assembling self contributions to T(%i)...",ns);
      G->RegionMPs[0]->Zero();
-     G->AssembleBEMMatrixBlock(ns, ns, Omega, 0, TSelf[ns]);
+     if ( !SHD->BMI || !SHD->BMI->AssembleBlock(ns, ns, Omega, TSelf[ns]) )
+      G->AssembleBEMMatrixBlock(ns, ns, Omega, 0, TSelf[ns]);
      FillInLowerTriangle(TSelf[ns]);
      FlipSignOfMagneticColumns(TSelf[ns]);
      G->RegionMPs[0]->UnZero();
 
      Log(" Assembling medium contributions to T(%i)...",ns);
      G->RegionMPs[ns+1]->Zero();
-     G->AssembleBEMMatrixBlock(ns, ns, Omega, 0, TMedium[ns]);
+     if ( !SHD->BMI || !SHD->BMI->AssembleBlock(ns, ns, Omega, TMedium[ns]) )
+      G->AssembleBEMMatrixBlock(ns, ns, Omega, 0, TMedium[ns]);
      FillInLowerTriangle(TMedium[ns]);
      FlipSignOfMagneticColumns(TMedium[ns]);
      G->RegionMPs[ns+1]->UnZero();
@@ -368,9 +395,12 @@ void GetFrequencyIntegrand(SHData *SHD, cdouble Omega, double *FI)
         /***************************************************************/
         /* write the result to the frequency-resolved output file ******/
         /***************************************************************/
-        FILE *f=fopen(SHD->ByOmegaFile, "a");
+        FILE *f=SHD->ByOmegaStream ? SHD->ByOmegaStream : fopen(SHD->ByOmegaFile, "a");
         fprintf(f,"%s %s %e\n",Tag,z2s(Omega),FI[nt]);
-        fclose(f);
+        if (f!=SHD->ByOmegaStream)
+         fclose(f);
+
+        WriteCheckpoint(SHD->Checkpoint, Tag, Omega, 0, FI+nt);
       };
 
      /*--------------------------------------------------------------*/
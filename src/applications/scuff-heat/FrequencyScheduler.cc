@@ -0,0 +1,241 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * FrequencyScheduler.cc -- evaluate the scuff-heat spectral density
+ *                       -- at several frequencies concurrently
+ *
+ * As in scuff-neq, we keep several independent SHData workspaces
+ * ('slots') and hand each one a subset of the available threads,
+ * so that the serial LU-factorization and matrix-multiplication
+ * phases of one frequency overlap with the work on others. Output
+ * for each frequency is collected in a temporary stream and written
+ * to the .byOmega file in the order in which the frequencies were
+ * requested.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef USE_OPENMP
+#  include <omp.h>
+#endif
+
+#include "scuff-heat.h"
+
+/***************************************************************/
+/* estimate the number of bytes of matrix storage needed for   */
+/* one SHData workspace                                        */
+/***************************************************************/
+static double GetSlotMemory(SHData *SHD)
+{
+  RWGGeometry *G = SHD->G;
+  double N       = (double)G->TotalBFs;
+  double N1      = (double)SHD->N1;
+  double N2      = (double)SHD->SymG2->NR;
+  double Entries = N*N + N*N1 + N1*N1 + N2*N2 + 3.0*N1*N2; // W, Scratch, SymG1, SymG2, W21...
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   { double NBF = (double)G->Surfaces[ns]->NumBFs;
+     Entries += 2.0*NBF*NBF; // TSelf, TMedium
+     for(int nsp=ns+1; nsp<G->NumSurfaces; nsp++)
+      Entries += NBF*G->Surfaces[nsp]->NumBFs; // UMedium
+   };
+  return Entries*sizeof(cdouble);
+}
+
+/***************************************************************/
+/* decide how many frequencies to keep in flight and create    */
+/* the workspaces for them. SHD itself is used as the first    */
+/* slot. MemoryBudget is in GB; zero means no limit.           */
+/***************************************************************/
+FrequencyScheduler *CreateFrequencyScheduler(SHData *SHD, int MaxConcurrent,
+                                             double MemoryBudget)
+{
+  int NumThreads = GetNumThreads();
+  int NumSlots   = MaxConcurrent;
+  if (NumSlots>NumThreads) NumSlots=NumThreads;
+
+  if (MemoryBudget>0.0)
+   { double SlotMemory = GetSlotMemory(SHD);
+     int MaxSlots = (int)floor( MemoryBudget*1.0e9 / SlotMemory );
+     if (NumSlots>MaxSlots)
+      { Log("Memory budget %g GB allows %i concurrent frequencies (%g GB each)",
+             MemoryBudget, MaxSlots, SlotMemory/1.0e9);
+        NumSlots=MaxSlots;
+      };
+   };
+
+  if (NumSlots>1 && SHD->BMI)
+   { Warn("--InterpolateMatrix is incompatible with concurrent frequencies (disabling concurrency)");
+     NumSlots=1;
+   };
+
+#ifndef USE_OPENMP
+  if (NumSlots>1)
+   { Warn("concurrent frequencies require OpenMP support (disabling concurrency)");
+     NumSlots=1;
+   };
+#endif
+
+  if (NumSlots<1) NumSlots=1;
+
+  FrequencyScheduler *FS=(FrequencyScheduler *)mallocEC(sizeof(*FS));
+  FS->NumSlots       = NumSlots;
+  FS->ThreadsPerSlot = (NumThreads/NumSlots > 0) ? NumThreads/NumSlots : 1;
+  FS->Slots          = (SHData **)mallocEC(NumSlots*sizeof(SHData *));
+  FS->Slots[0]       = SHD;
+  for(int ns=1; ns<NumSlots; ns++)
+   FS->Slots[ns] = CloneSHData(SHD);
+
+  if (NumSlots>1)
+   Log("Evaluating up to %i frequencies concurrently (%i threads each)",
+        NumSlots, FS->ThreadsPerSlot);
+
+  return FS;
+}
+
+/***************************************************************/
+/* read back everything written to a temporary stream, close   */
+/* it, and append it to the named file                         */
+/***************************************************************/
+typedef struct StreamContents
+ { char *Buffer;
+   size_t Size;
+ } StreamContents;
+
+static void DrainStream(FILE *f, StreamContents *SC)
+{
+  SC->Buffer=0;
+  SC->Size=0;
+  if (!f) return;
+  fflush(f);
+  long Size=ftell(f);
+  if (Size>0)
+   { SC->Size=(size_t)Size;
+     SC->Buffer=(char *)mallocEC(SC->Size);
+     rewind(f);
+     if ( fread(SC->Buffer, 1, SC->Size, f) != SC->Size )
+      ErrExit("%s:%i: error reading temporary output stream",__FILE__,__LINE__);
+   };
+  fclose(f);
+}
+
+static void AppendToFile(const char *FileName, StreamContents *SC)
+{
+  if (SC->Size==0) return;
+  FILE *f=fopen(FileName,"a");
+  if (!f)
+   ErrExit("could not open file %s",FileName);
+  fwrite(SC->Buffer, 1, SC->Size, f);
+  fclose(f);
+  free(SC->Buffer);
+  SC->Buffer=0;
+  SC->Size=0;
+}
+
+/***************************************************************/
+/* evaluate GetFrequencyIntegrand at each of NumFreqs          */
+/* frequencies; on return, FI[nf*NT + nt] is the integrand at  */
+/* frequency #nf and transformation #nt.                       */
+/* this is the entry point for any frequency-integration       */
+/* driver: it may hand over a whole batch of abscissae at once.*/
+/***************************************************************/
+void GetFrequencyIntegrandBatch(FrequencyScheduler *FS, int NumFreqs,
+                                cdouble *OmegaList, double *FI)
+{
+  SHData *SHD  = FS->Slots[0];
+  int NumSlots = FS->NumSlots;
+  int NT       = SHD->NumTransformations;
+
+  /*--------------------------------------------------------------*/
+  /*- if we are supposed to write the cache after the first       */
+  /*- frequency, do that frequency by itself before anything else */
+  /*- runs concurrently                                           */
+  /*--------------------------------------------------------------*/
+  int FirstFreq=0;
+  if ( NumSlots==1 || SHD->WriteCache )
+   { int LastFreq = (NumSlots==1) ? NumFreqs : (NumFreqs>0 ? 1 : 0);
+     for(int nf=0; nf<LastFreq; nf++)
+      GetFrequencyIntegrand(SHD, OmegaList[nf], FI + nf*NT);
+     FirstFreq=LastFreq;
+   };
+  if (FirstFreq==NumFreqs)
+   return;
+
+  /*--------------------------------------------------------------*/
+  /*- frequency-resolved output goes to the .byOmega file unless  */
+  /*- we are plotting fluxes                                      */
+  /*--------------------------------------------------------------*/
+  bool ByOmega = (SHD->ByOmegaFile!=0);
+  StreamContents *Output
+   = (StreamContents *)mallocEC(NumFreqs*sizeof(StreamContents));
+  bool *Done = (bool *)mallocEC(NumFreqs*sizeof(bool));
+  memset(Done, 0, NumFreqs*sizeof(bool));
+  int NextToWrite=FirstFreq;
+
+  /*--------------------------------------------------------------*/
+  /*- run the remaining frequencies on all slots; each slot       */
+  /*- thread uses a team of ThreadsPerSlot threads inside libscuff*/
+  /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+  int MaxActiveLevelsSave = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+#pragma omp parallel num_threads(NumSlots)
+#endif
+   {
+#ifdef USE_OPENMP
+     SHData *Slot = FS->Slots[omp_get_thread_num()];
+     omp_set_num_threads(FS->ThreadsPerSlot);
+#pragma omp for schedule(dynamic,1)
+#else
+     SHData *Slot = SHD;
+#endif
+     for(int nf=FirstFreq; nf<NumFreqs; nf++)
+      {
+        if (ByOmega)
+         Slot->ByOmegaStream=tmpfile();
+
+        GetFrequencyIntegrand(Slot, OmegaList[nf], FI + nf*NT);
+
+        DrainStream(Slot->ByOmegaStream, Output + nf);
+        Slot->ByOmegaStream=0;
+
+        // write out all frequencies, in order, for which results
+        // are now available
+#ifdef USE_OPENMP
+#pragma omp critical(SHOutput)
+#endif
+         { Done[nf]=true;
+           for(; NextToWrite<NumFreqs && Done[NextToWrite]; NextToWrite++)
+            if (ByOmega)
+             AppendToFile(SHD->ByOmegaFile, Output + NextToWrite);
+         };
+      };
+   };
+#ifdef USE_OPENMP
+  omp_set_max_active_levels(MaxActiveLevelsSave);
+#endif
+
+  free(Done);
+  free(Output);
+}
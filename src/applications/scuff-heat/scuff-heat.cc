@@ -146,6 +146,33 @@
  * 
  *     --nThread xx   (use xx computational threads)
  *
+ *     --ConcurrentFrequencies N
+ *
+ *         Evaluate up to N frequencies at the same time, each
+ *         in its own workspace on a subset of the threads.
+ *         The default is 1 (one frequency at a time).
+ *
+ *     --MemoryBudget xx
+ *
+ *         Limit the number of concurrent frequencies so that
+ *         their matrix storage does not exceed xx GB.
+ *
+ *     --InterpolateMatrix
+ *
+ *         When computing the spectral density at a list of
+ *         frequencies, assemble the self-interaction (T) blocks
+ *         of the BEM matrix by interpolation in frequency
+ *         instead of from scratch at each frequency. This is
+ *         incompatible with --ConcurrentFrequencies.
+ *
+ *     --UseExistingData
+ *
+ *         The spectral density at each frequency is written to
+ *         Geometry.checkpoint as soon as it is computed. With
+ *         this option, frequencies already present in that
+ *         file (from an earlier, interrupted run) are read
+ *         from it instead of being recomputed.
+ *
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -185,8 +212,12 @@ int main(int argc, char *argv[])
   char *Cache=0;
   char *ReadCache[MAXCACHE];         int nReadCache;
   char *WriteCache=0;
+  bool UseExistingData=false;
   double SWPPITol=0.0;
   int nThread=0;
+  int ConcurrentFrequencies=1;
+  double MemoryBudget=0.0;
+  bool InterpolateMatrix=false;
   /* name               type    #args  max_instances  storage           count         description*/
   OptStruct OSArray[]=
    { {"Geometry",       PA_STRING,  1, 1,       (void *)&GeoFile,    0,             "geometry file"},
@@ -202,7 +233,11 @@ int main(int argc, char *argv[])
      {"Cache",          PA_STRING,  1, 1,       (void *)&Cache,      0,             "read/write cache"},
      {"ReadCache",      PA_STRING,  1, MAXCACHE,(void *)ReadCache,   &nReadCache,   "read cache"},
      {"WriteCache",     PA_STRING,  1, 1,       (void *)&WriteCache, 0,             "write cache"},
+     {"UseExistingData", PA_BOOL,   0, 1,       (void *)&UseExistingData, 0,       "resume from the checkpoint file of an earlier run"},
      {"nThread",        PA_INT,     1, 1,       (void *)&nThread,    0,             "number of CPU threads to use"},
+     {"ConcurrentFrequencies", PA_INT, 1, 1,    (void *)&ConcurrentFrequencies, 0,  "max number of frequencies to evaluate at once"},
+     {"MemoryBudget",   PA_DOUBLE,  1, 1,       (void *)&MemoryBudget, 0,           "memory budget (GB) for concurrent frequencies"},
+     {"InterpolateMatrix", PA_BOOL, 0, 1,       (void *)&InterpolateMatrix, 0,      "interpolate BEM matrix blocks in frequency"},
      {0,0,0,0,0,0,0}
    };
   ProcessOptions(argc, argv, OSArray);
@@ -296,20 +331,42 @@ int main(int argc, char *argv[])
   if (Cache) WriteCache=Cache;
   SHD->WriteCache = WriteCache;
 
+  if (InterpolateMatrix && NumFreqs>0)
+   SHD->BMI = CreateBEMMatrixInterpolator(SHD->G, OmegaList);
+
+  /*******************************************************************/
+  /* open the checkpoint file, to which the spectral density is      */
+  /* written at every frequency as soon as it is computed; with      */
+  /* --UseExistingData, frequencies already in the file are not      */
+  /* redone                                                          */
+  /*******************************************************************/
+  char *CheckpointFileName = vstrdup("%s.checkpoint",GetFileBase(GeoFile));
+  char *CheckpointContext  = vstrdup("scuff-heat %s",GetFileBase(GeoFile));
+  SHD->Checkpoint = OpenCheckpointFile(CheckpointFileName, CheckpointContext,
+                                       1, UseExistingData);
+  free(CheckpointFileName);
+  free(CheckpointContext);
+
   /*******************************************************************/
   /* now switch off based on the requested frequency behavior to     */
   /* perform the actual calculations                                 */
   /*******************************************************************/
-  double *I = new double[SHD->NumTransformations];
   if (NumFreqs>0)
-   { for (nFreq=0; nFreq<NumFreqs; nFreq++)
-      GetFrequencyIntegrand(SHD, OmegaList->GetEntry(nFreq), I);
+   { FrequencyScheduler *FS
+      = CreateFrequencyScheduler(SHD, ConcurrentFrequencies, MemoryBudget);
+     cdouble *Omegas = new cdouble[NumFreqs];
+     for (nFreq=0; nFreq<NumFreqs; nFreq++)
+      Omegas[nFreq] = OmegaList->GetEntry(nFreq);
+     double *I = new double[NumFreqs*SHD->NumTransformations];
+     GetFrequencyIntegrandBatch(FS, NumFreqs, Omegas, I);
+     delete[] I;
+     delete[] Omegas;
    }
   else
    { // frequency integration not yet implemented 
      ErrExit("frequency integration is not yet implemented");
    };
-  delete[] I;
+  CloseCheckpointFile(SHD->Checkpoint);
 
   /***************************************************************/
   /***************************************************************/
@@ -52,17 +52,45 @@ typedef struct SHData
    HVector *DV;
    int PlotFlux;
 
+   // frequency interpolator for TSelf, TMedium (may be NULL)
+   BEMMatrixInterpolator *BMI;
+
    GTComplex **GTCList;
    int NumTransformations;
 
    char *WriteCache;
+   CheckpointFile *Checkpoint;
    int nThread;
 
+   // if non-NULL, frequency-resolved output is written here
+   // instead of to ByOmegaFile
+   FILE *ByOmegaStream;
+
  } SHData;
 
 SHData *CreateSHData(char *GeoFile, char *TransFile, int PlotFlux,
                      char *ByOmegaFile, int nThread);
+SHData *CloneSHData(SHData *SHD);
 
 void GetFrequencyIntegrand(SHData *SHD, cdouble Omega, double *FI);
 
+/***************************************************************/
+/* a FrequencyScheduler evaluates batches of frequencies       */
+/* concurrently. each of its Slots is an independent SHData    */
+/* workspace (with its own geometry and BEM matrix storage)    */
+/* handled by ThreadsPerSlot threads.                          */
+/***************************************************************/
+typedef struct FrequencyScheduler
+ { 
+   SHData **Slots;
+   int NumSlots;
+   int ThreadsPerSlot;
+
+ } FrequencyScheduler;
+
+FrequencyScheduler *CreateFrequencyScheduler(SHData *SHD, int MaxConcurrent,
+                                             double MemoryBudget);
+void GetFrequencyIntegrandBatch(FrequencyScheduler *FS, int NumFreqs,
+                                cdouble *OmegaList, double *FI);
+
 #endif
@@ -35,7 +35,7 @@
 void WriteFilePreamble(char *FileName, int FileType, int LDim,  
                        bool TwoPointDGF)
 {
-  FILE *f=fopen(FileName,"a");
+  FILE *f=OpenOutputFile("%s",FileName);
 
   fprintf(f,"# scuff-ldos run on %s ",GetHostName());
   fprintf(f,"%s\n",GetTimeString());
@@ -85,7 +85,7 @@ void WriteFilePreamble(char *FileName, int FileType, int LDim,
   fprintf(f,"# %2i, %2i: re, im GM_{zy} \n",nc,nc+1); nc+=2;
   fprintf(f,"# %2i, %2i: re, im GM_{zz} \n",nc,nc+1); nc+=2;
 
-  fclose(f);
+  CloseOutputFile(f);
 }
 
 /***************************************************************/
@@ -33,11 +33,12 @@
 using namespace scuff;
 
 /***************************************************************/
+/* get the name of the output file of the given type for the   */
+/* given list of evaluation points, writing its preamble if    */
+/* that has not been done yet                                  */
 /***************************************************************/
-/***************************************************************/
-void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
-               int FileType, int WhichMatrix,
-               double *Result, double *Error)
+static void GetDataFileName(SLDData *Data, int FileType, int WhichMatrix,
+                            char FileName[MAXSTR])
 {
   int LDim         = Data->G->LDim;
   HMatrix *XMatrix = Data->XMatrices[WhichMatrix];
@@ -52,7 +53,6 @@ void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
   else
    Extension = TwoPointDGF ? "2PDGF" : "LDOS";
 
-  char FileName[MAXSTR];
   if (Data->NumXGMatrices==1)
    snprintf(FileName,MAXSTR,"%s.%s",FileBase,Extension);
   else
@@ -62,13 +62,42 @@ void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
    { Data->WrotePreamble[FileType][WhichMatrix] = true;
      WriteFilePreamble(FileName, FileType, LDim, TwoPointDGF);
    };
+}
+
+/***************************************************************/
+/* write the preambles of all output files of the given type   */
+/* now, instead of on first use; when the frequencies are      */
+/* distributed over MPI ranks this ensures that each preamble  */
+/* is written exactly once (by the root rank).                 */
+/***************************************************************/
+void WritePreambles(SLDData *Data, int FileType)
+{
+  char FileName[MAXSTR];
+  for(int nm=0; nm<Data->NumXGMatrices; nm++)
+   GetDataFileName(Data, FileType, nm, FileName);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
+               int FileType, int WhichMatrix,
+               double *Result, double *Error)
+{
+  int LDim         = Data->G->LDim;
+  HMatrix *XMatrix = Data->XMatrices[WhichMatrix];
+
+  bool TwoPointDGF = (XMatrix->NC==6);
+
+  char FileName[MAXSTR];
+  GetDataFileName(Data, FileType, WhichMatrix, FileName);
 
   int NFun = (Data->LDOSOnly ? 2 : 38);
   int Offset=0;
   for(int nm=0; nm<WhichMatrix; nm++)
    Offset += NFun * (Data->XMatrices[nm]->NR);
   
-  FILE *f=fopen(FileName,"a");
+  FILE *f=OpenOutputFile("%s",FileName);
   for(int nx=0; nx<XMatrix->NR; nx++)
    { 
      double X[6];
@@ -91,7 +120,7 @@ void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
 
      fprintf(f,"\n");
    };
-  fclose(f);
+  CloseOutputFile(f);
 }
 
 /***************************************************************/
@@ -36,11 +36,41 @@
 
 using namespace scuff;
 
+/***************************************************************/
+/* task function for distributing (Omega, kBloch) points over  */
+/* MPI ranks; row #n of OkBPoints is (Omega, kx, ky), or       */
+/* OmegaPoints[n] for non-periodic geometries                  */
+/***************************************************************/
+typedef struct LDOSTaskData
+ { SLDData *Data;
+   HVector *OmegaPoints;
+   HMatrix *OkBPoints;
+   double *Result;
+ } LDOSTaskData;
+
+static void LDOSTask(void *UserData, int n, double *Unused)
+{
+  (void) Unused;
+  LDOSTaskData *TD = (LDOSTaskData *)UserData;
+  if (TD->OkBPoints==0)
+   { GetLDOS( (void *)TD->Data, TD->OmegaPoints->GetEntry(n), 0, TD->Result);
+     return;
+   };
+
+  int LDim = TD->Data->G->LDim;
+  cdouble Omega=TD->OkBPoints->GetEntry(n,0);
+  double kBloch[3]={0.0, 0.0, 0.0};
+  for(int d=0; d<LDim; d++)
+   kBloch[d]=TD->OkBPoints->GetEntryD(n,1+d);
+  GetLDOS( (void *)TD->Data, Omega, kBloch, TD->Result);
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
 int main(int argc, char *argv[]) 
 { 
+  InitMPI(&argc, &argv);
   InstallHRSignalHandler();
   InitializeLog(argv[0]);
 
@@ -201,10 +231,15 @@ int main(int argc, char *argv[])
   /*- non-PBC geometry: just do non-periodic DGF calculations at  */
   /*-                   each requested Omega value                */
   /*--------------------------------------------------------------*/
+  LDOSTaskData TD;
+  TD.Data        = Data;
+  TD.OmegaPoints = OmegaPoints;
+  TD.OkBPoints   = 0;
+  TD.Result      = Result;
   if (LDim==0)
    {  
-     for(int no=0; no<OmegaPoints->N; no++)
-      GetLDOS( (void *)Data, OmegaPoints->GetEntry(no), 0, Result);
+     WritePreambles(Data, FILETYPE_LDOS);
+     DistributeTasks(LDOSTask, (void *)&TD, OmegaPoints->N);
    }
   /*--------------------------------------------------------------*/
   /*- PBC structure with specified kBloch points: do a periodic   */
@@ -212,16 +247,9 @@ int main(int argc, char *argv[])
   /*--------------------------------------------------------------*/
   else if (OkBPoints)
    {  
-     for(int nokb=0; nokb<OkBPoints->NR; nokb++)
-      { 
-        Omega=OkBPoints->GetEntry(nokb,0);
-
-        double kBloch[3]={0.0, 0.0, 0.0};
-        for(int d=0; d<LDim; d++)
-         kBloch[d]=OkBPoints->GetEntryD(nokb,1+d);
-
-        GetLDOS( (void *)Data, Omega, kBloch, Result);
-      };
+     WritePreambles(Data, FILETYPE_BYK);
+     TD.OkBPoints = OkBPoints;
+     DistributeTasks(LDOSTask, (void *)&TD, OkBPoints->NR);
    }
   /*--------------------------------------------------------------*/
   /*- PBC structure without specified kBloch points: perform a    */
@@ -239,8 +267,11 @@ int main(int argc, char *argv[])
      UpdateBZIArgs(BZIArgs, Data->G->RLBasis, Data->G->RLVolume);
 
      /***************************************************************/
+     /* the kBloch points of each BZ integral are shared out over   */
+     /* MPI ranks (if any) by GetBZIntegral                         */
      /***************************************************************/
-     /***************************************************************/
+     WritePreambles(Data, FILETYPE_BYK);
+     WritePreambles(Data, FILETYPE_LDOS);
      for(int no=0; no<OmegaPoints->N; no++)
       { Omega=OmegaPoints->GetEntry(no);
         Log("Evaluating Brillouin-zone integral at omega=%s",z2s(Omega));
@@ -249,4 +280,5 @@ int main(int argc, char *argv[])
       };
    };
 
+  FinalizeMPI();
 }
@@ -80,6 +80,7 @@ void WriteFilePreamble(char *FileName, int FileType, int LDim, bool TwoPointDGF)
 SLDData *CreateSLDData(char *GeoFile, char **EPFiles, int nEPFiles);
 
 // GetLDOS.cc
+void WritePreambles(SLDData *Data, int FileType);
 void WriteData(SLDData *Data, cdouble Omega, double *kBloch,
                int FileType, int WhichMatrix, 
                double *Result, double *Error);
@@ -44,7 +44,7 @@ const char *QuantityNames[NUMPFT]=
 /***************************************************************/
 void WriteSIFluxFilePreamble(SNEQData *SNEQD, char *FileName)
 {
-  FILE *f=fopen(FileName,"a");
+  FILE *f=OpenOutputFile("%s",FileName);
   fprintf(f,"\n");
   fprintf(f,"# scuff-neq run on ");
   fprintf(f,"%s (%s)\n",GetHostName(),GetTimeString());
@@ -62,7 +62,7 @@ void WriteSIFluxFilePreamble(SNEQData *SNEQD, char *FileName)
    fprintf(f,"# %i %s flux spectral density\n",
   nq++,QuantityNames[nPFT]);
 
-  fclose(f);
+  CloseOutputFile(f);
 }
 
 /***************************************************************/
@@ -75,6 +75,11 @@ SNEQData *CreateSNEQData(char *GeoFile, char *TransFile,
 
   SNEQData *SNEQD=(SNEQData *)mallocEC(sizeof(*SNEQD));
   SNEQD->WriteCache=0;
+  SNEQD->KS=0;
+  SNEQD->BMI=0;
+  SNEQD->SRFluxStream=0;
+  for(int npm=0; npm<MAXPFTMETHODS; npm++)
+   SNEQD->SIFluxStreams[npm]=0;
 
   /*--------------------------------------------------------------*/
   /*-- try to create the RWGGeometry -----------------------------*/
@@ -105,6 +110,7 @@ SNEQData *CreateSNEQData(char *GeoFile, char *TransFile,
   /*--------------------------------------------------------------*/
   SNEQD->PFTMatrix = new HMatrix(G->NumSurfaces, NUMPFT);
   InitPFTOptions( &(SNEQD->PFTOpts) );
+  SNEQD->PFTOpts.WS = new Workspace();
   SNEQD->NumPFTMethods = NumPFTMethods;
   SNEQD->DSIOmegaPoints=0;
   for(int npm=0; npm<NumPFTMethods; npm++)
@@ -186,7 +192,7 @@ SNEQData *CreateSNEQData(char *GeoFile, char *TransFile,
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   if (SNEQD->NumSRQs>0)
-   { FILE *f=vfopen("%s.SRFlux","a",SNEQD->FileBase);
+   { FILE *f=OpenOutputFile("%s.SRFlux",SNEQD->FileBase);
      fprintf(f,"\n");
      fprintf(f,"# scuff-neq run on %s (%s)\n",GetHostName(),GetTimeString());
      fprintf(f,"# data file columns: \n");
@@ -205,10 +211,67 @@ SNEQData *CreateSNEQData(char *GeoFile, char *TransFile,
      fprintf(f,"# %2i %2i %2i Txx,   Txy,   Txz \n",nq,nq+1,nq+2); nq+=3;
      fprintf(f,"# %2i %2i %2i Tyx,   Tyy,   Tyz \n",nq,nq+1,nq+2); nq+=3;
      fprintf(f,"# %2i %2i %2i Tzx,   Tzy,   Tzz \n",nq,nq+1,nq+2); nq+=3;
-     fclose(f);
+     CloseOutputFile(f);
    };
 
   Log("After CreateSNEQData: mem=%3.1f GB",GetMemoryUsage()/1.0e9);
   return SNEQD;
 
 }
+
+/***************************************************************/
+/* create a second SNEQData structure for the same calculation */
+/* as SNEQD, with its own copy of the geometry and its own     */
+/* storage for the BEM matrix and its subblocks, so that the   */
+/* two may be used to handle different frequencies at the same */
+/* time. read-only data (transformations, evaluation points,   */
+/* output file names) are shared with SNEQD. the iterative     */
+/* solver and matrix interpolator (if any) are not cloned.     */
+/***************************************************************/
+SNEQData *CloneSNEQData(SNEQData *SNEQD)
+{
+  SNEQData *Clone=(SNEQData *)mallocEC(sizeof(*Clone));
+  memcpy(Clone, SNEQD, sizeof(*Clone));
+  Clone->WriteCache=0;
+  Clone->KS=0;
+  Clone->BMI=0;
+  Clone->SRFluxStream=0;
+  for(int npm=0; npm<MAXPFTMETHODS; npm++)
+   Clone->SIFluxStreams[npm]=0;
+  Clone->PFTOpts.WS = new Workspace();
+
+  RWGGeometry *G=Clone->G=new RWGGeometry(SNEQD->G->GeoFileName);
+  int NS = G->NumSurfaces;
+
+  Clone->PFTMatrix = new HMatrix(NS, NUMPFT);
+  if (SNEQD->SRFMatrix)
+   Clone->SRFMatrix = new HMatrix(SNEQD->NX, NUMSRFLUX);
+
+  Clone->TExt = (HMatrix **)mallocEC(NS*sizeof(HMatrix *));
+  Clone->TInt = (HMatrix **)mallocEC(NS*sizeof(HMatrix *));
+  Clone->U = (HMatrix **)mallocEC( ((NS*(NS-1))/2)*sizeof(HMatrix *));
+  for(int nb=0, ns=0; ns<NS; ns++)
+   { 
+     int NBF=G->Surfaces[ns]->NumBFs;
+
+     if (G->Mate[ns]==-1)
+      { Clone->TExt[ns]  = new HMatrix(NBF, NBF, LHM_COMPLEX);
+        Clone->TInt[ns]  = new HMatrix(NBF, NBF, LHM_COMPLEX);
+      }
+     else
+      { Clone->TExt[ns] = Clone->TExt[ G->Mate[ns] ];
+        Clone->TInt[ns] = Clone->TInt[ G->Mate[ns] ];
+      };
+
+     for(int nsp=ns+1; nsp<NS; nsp++, nb++)
+      { int NBFp=G->Surfaces[nsp]->NumBFs;
+        Clone->U[nb] = new HMatrix(NBF, NBFp, LHM_COMPLEX);
+      };
+   };
+
+  Clone->M        = new HMatrix(G->TotalBFs, G->TotalBFs, LHM_COMPLEX );
+  Clone->DRMatrix = new HMatrix(G->TotalBFs, G->TotalBFs, LHM_COMPLEX );
+
+  Log("After CloneSNEQData: mem=%3.1f GB",GetMemoryUsage()/1.0e9);
+  return Clone;
+}
@@ -0,0 +1,296 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * FrequencyScheduler.cc -- evaluate scuff-neq quantities at several
+ *                       -- frequencies concurrently
+ *
+ * The BEM-matrix assembly in libscuff is multithreaded, but the LU
+ * factorization, dressed-Rytov and PFT phases of each frequency
+ * leave most cores idle. Here we instead keep several independent
+ * SNEQData workspaces ('slots') and hand each one a subset of the
+ * available threads, so that several frequencies are in flight at
+ * once. Output for each frequency is collected in temporary streams
+ * and written to the .SIFlux / .SRFlux files in the order in which
+ * the frequencies were requested.
+ *
+ * When running on several MPI ranks, the frequencies are instead
+ * shared out among the ranks (see DistributeTasks in libhrutil).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef USE_OPENMP
+#  include <omp.h>
+#endif
+
+#include "scuff-neq.h"
+
+/***************************************************************/
+/* estimate the number of bytes of matrix storage needed for   */
+/* one SNEQData workspace                                      */
+/***************************************************************/
+static double GetSlotMemory(SNEQData *SNEQD)
+{
+  RWGGeometry *G = SNEQD->G;
+  double NBF     = (double)G->TotalBFs;
+  double Entries = 2.0*NBF*NBF; // M, DRMatrix
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   { double NBFs = (double)G->Surfaces[ns]->NumBFs;
+     if (G->Mate[ns]==-1)
+      Entries += 2.0*NBFs*NBFs; // TInt, TExt
+     for(int nsp=ns+1; nsp<G->NumSurfaces; nsp++)
+      Entries += NBFs*G->Surfaces[nsp]->NumBFs; // U
+   };
+  return Entries*sizeof(cdouble);
+}
+
+/***************************************************************/
+/* decide how many frequencies to keep in flight and create    */
+/* the workspaces for them. SNEQD itself is used as the first  */
+/* slot. MemoryBudget is in GB; zero means no limit.           */
+/***************************************************************/
+FrequencyScheduler *CreateFrequencyScheduler(SNEQData *SNEQD, int Solver,
+                                             int MaxConcurrent,
+                                             double MemoryBudget)
+{
+  int NumThreads = GetNumThreads();
+  int NumSlots   = MaxConcurrent;
+  if (NumSlots>NumThreads) NumSlots=NumThreads;
+
+  if (MemoryBudget>0.0)
+   { double SlotMemory = GetSlotMemory(SNEQD);
+     int MaxSlots = (int)floor( MemoryBudget*1.0e9 / SlotMemory );
+     if (NumSlots>MaxSlots)
+      { Log("Memory budget %g GB allows %i concurrent frequencies (%g GB each)",
+             MemoryBudget, MaxSlots, SlotMemory/1.0e9);
+        NumSlots=MaxSlots;
+      };
+   };
+
+  if (NumSlots>1 && SNEQD->BMI)
+   { Warn("--InterpolateMatrix is incompatible with concurrent frequencies (disabling concurrency)");
+     NumSlots=1;
+   };
+
+  if (NumSlots>1 && GetMPISize()>1)
+   { Log("running on %i MPI ranks: evaluating one frequency at a time per rank",GetMPISize());
+     NumSlots=1;
+   };
+
+#ifndef USE_OPENMP
+  if (NumSlots>1)
+   { Warn("concurrent frequencies require OpenMP support (disabling concurrency)");
+     NumSlots=1;
+   };
+#endif
+
+  if (NumSlots<1) NumSlots=1;
+
+  FrequencyScheduler *FS=(FrequencyScheduler *)mallocEC(sizeof(*FS));
+  FS->NumSlots       = NumSlots;
+  FS->ThreadsPerSlot = (NumThreads/NumSlots > 0) ? NumThreads/NumSlots : 1;
+  FS->Slots          = (SNEQData **)mallocEC(NumSlots*sizeof(SNEQData *));
+  FS->Slots[0]       = SNEQD;
+  for(int ns=1; ns<NumSlots; ns++)
+   { FS->Slots[ns] = CloneSNEQData(SNEQD);
+     if (SNEQD->KS)
+      FS->Slots[ns]->KS = new KrylovSolver(FS->Slots[ns]->G, Solver);
+   };
+
+  if (NumSlots>1)
+   Log("Evaluating up to %i frequencies concurrently (%i threads each)",
+        NumSlots, FS->ThreadsPerSlot);
+
+  return FS;
+}
+
+/***************************************************************/
+/* read back everything written to a temporary stream and      */
+/* close it                                                    */
+/***************************************************************/
+typedef struct StreamContents
+ { char *Buffer;
+   size_t Size;
+ } StreamContents;
+
+static void DrainStream(FILE *f, StreamContents *SC)
+{
+  SC->Buffer=0;
+  SC->Size=0;
+  if (!f) return;
+  fflush(f);
+  long Size=ftell(f);
+  if (Size>0)
+   { SC->Size=(size_t)Size;
+     SC->Buffer=(char *)mallocEC(SC->Size);
+     rewind(f);
+     if ( fread(SC->Buffer, 1, SC->Size, f) != SC->Size )
+      ErrExit("%s:%i: error reading temporary output stream",__FILE__,__LINE__);
+   };
+  fclose(f);
+}
+
+static void AppendToFile(const char *FileName, StreamContents *SC)
+{
+  if (SC->Size==0) return;
+  FILE *f=fopen(FileName,"a");
+  if (!f)
+   ErrExit("could not open file %s",FileName);
+  fwrite(SC->Buffer, 1, SC->Size, f);
+  fclose(f);
+  free(SC->Buffer);
+  SC->Buffer=0;
+  SC->Size=0;
+}
+
+/***************************************************************/
+/* task function for sharing frequencies out over MPI ranks    */
+/***************************************************************/
+typedef struct FluxTaskData
+ { SNEQData *SNEQD;
+   cdouble *OmegaPoints;
+   double *kBlochPoints;
+ } FluxTaskData;
+
+static void FluxTask(void *UserData, int np, double *Unused)
+{
+  (void) Unused;
+  FluxTaskData *Data = (FluxTaskData *)UserData;
+  WriteFlux(Data->SNEQD, Data->OmegaPoints[np],
+            Data->kBlochPoints ? Data->kBlochPoints + 2*np : 0);
+}
+
+/***************************************************************/
+/* evaluate WriteFlux at each of NumPoints frequencies, with   */
+/* optional Bloch vectors (kBlochPoints[2*np+0,1]).            */
+/* this is the entry point for any frequency-integration       */
+/* driver: it may hand over a whole batch of abscissae at once.*/
+/***************************************************************/
+void WriteFluxBatch(FrequencyScheduler *FS, int NumPoints,
+                    cdouble *OmegaPoints, double *kBlochPoints)
+{
+  SNEQData *SNEQD = FS->Slots[0];
+  int NumSlots    = FS->NumSlots;
+
+  /*--------------------------------------------------------------*/
+  /*- if we are supposed to write the cache after the first       */
+  /*- frequency, do that frequency by itself before anything else */
+  /*- runs concurrently                                           */
+  /*--------------------------------------------------------------*/
+  bool Distributed = (GetMPISize()>1);
+  int FirstPoint=0;
+  if ( (NumSlots==1 && !Distributed) || SNEQD->WriteCache )
+   { int LastPoint = (NumSlots==1 && !Distributed) ? NumPoints : (NumPoints>0 ? 1 : 0);
+     for(int np=0; np<LastPoint; np++)
+      WriteFlux(SNEQD, OmegaPoints[np], kBlochPoints ? kBlochPoints + 2*np : 0);
+     FirstPoint=LastPoint;
+   };
+  if (FirstPoint==NumPoints)
+   return;
+
+  /*--------------------------------------------------------------*/
+  /*- on several MPI ranks, each rank takes one frequency at a    */
+  /*- time from the shared pool; DistributeTasks forwards output  */
+  /*- to the root rank, which writes it in frequency order        */
+  /*--------------------------------------------------------------*/
+  if (Distributed)
+   { FluxTaskData Data;
+     Data.SNEQD        = SNEQD;
+     Data.OmegaPoints  = OmegaPoints + FirstPoint;
+     Data.kBlochPoints = kBlochPoints ? kBlochPoints + 2*FirstPoint : 0;
+     DistributeTasks(FluxTask, (void *)&Data, NumPoints - FirstPoint);
+     return;
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- buffers for output from each point: one per SIFlux file     */
+  /*- plus one for the SRFlux file                                */
+  /*--------------------------------------------------------------*/
+  int NumPFTMethods = SNEQD->NumPFTMethods;
+  int NumFiles      = NumPFTMethods + 1;
+  char *SRFluxFileName = vstrdup("%s.SRFlux",SNEQD->FileBase);
+  StreamContents *Output
+   = (StreamContents *)mallocEC(NumPoints*NumFiles*sizeof(StreamContents));
+  bool *Done = (bool *)mallocEC(NumPoints*sizeof(bool));
+  memset(Done, 0, NumPoints*sizeof(bool));
+  int NextToWrite=FirstPoint;
+
+  /*--------------------------------------------------------------*/
+  /*- run the remaining points on all slots; each slot thread     */
+  /*- uses a team of ThreadsPerSlot threads inside libscuff       */
+  /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+  int MaxActiveLevelsSave = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+#pragma omp parallel num_threads(NumSlots)
+#endif
+   {
+#ifdef USE_OPENMP
+     SNEQData *Slot = FS->Slots[omp_get_thread_num()];
+     omp_set_num_threads(FS->ThreadsPerSlot);
+#pragma omp for schedule(dynamic,1)
+#else
+     SNEQData *Slot = SNEQD;
+#endif
+     for(int np=FirstPoint; np<NumPoints; np++)
+      {
+        for(int npm=0; npm<NumPFTMethods; npm++)
+         Slot->SIFluxStreams[npm]=tmpfile();
+        if (Slot->NumSRQs>0)
+         Slot->SRFluxStream=tmpfile();
+
+        WriteFlux(Slot, OmegaPoints[np], kBlochPoints ? kBlochPoints + 2*np : 0);
+
+        StreamContents *PointOutput = Output + np*NumFiles;
+        for(int npm=0; npm<NumPFTMethods; npm++)
+         { DrainStream(Slot->SIFluxStreams[npm], PointOutput + npm);
+           Slot->SIFluxStreams[npm]=0;
+         };
+        DrainStream(Slot->SRFluxStream, PointOutput + NumPFTMethods);
+        Slot->SRFluxStream=0;
+
+        // write out all points, in order, for which results are
+        // now available
+#ifdef USE_OPENMP
+#pragma omp critical(SNEQOutput)
+#endif
+         { Done[np]=true;
+           for(; NextToWrite<NumPoints && Done[NextToWrite]; NextToWrite++)
+            { StreamContents *SC = Output + NextToWrite*NumFiles;
+              for(int npm=0; npm<NumPFTMethods; npm++)
+               AppendToFile(SNEQD->SIFluxFileNames[npm], SC + npm);
+              AppendToFile(SRFluxFileName, SC + NumPFTMethods);
+            };
+         };
+      };
+   };
+#ifdef USE_OPENMP
+  omp_set_max_active_levels(MaxActiveLevelsSave);
+#endif
+
+  free(Done);
+  free(Output);
+  free(SRFluxFileName);
+}
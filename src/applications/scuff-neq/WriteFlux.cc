@@ -45,29 +45,14 @@ void UndoSCUFFMatrixTransformation(HMatrix *M)
 }
 
 /***************************************************************/
-/* Compute the dressed Rytov matrix for sources contained in   */
-/* SourceSurface. The matrix is stored in the DRMatrix         */
-/* field of the SNEQD structure.                               */
+/* stamp Sym(T_s) = (T_s + T_s^\dagger) / 2 (times the Rytov    */
+/* prefactor) into the block of S starting at (Offset,Offset), */
+/* undoing the SCUFF matrix transformation along the way.      */
 /***************************************************************/
 #define RYTOVPF (-4.0/M_PI)
-void ComputeDRMatrix(SNEQData *SNEQD, int SourceSurface)
+static void StampSymT(HMatrix *TInt, HMatrix *S, int Offset)
 {
-  Log("...computing DR matrix");
-
-  RWGGeometry *G  = SNEQD->G;
-  HMatrix *M      = SNEQD->M;
-  HMatrix *DR     = SNEQD->DRMatrix;
-
-  int NBFS        = G->Surfaces[SourceSurface]->NumBFs;
-  int OffsetS     = G->BFIndexOffset[SourceSurface];
-  HMatrix *TInt   = SNEQD->TInt[SourceSurface];
-
-  /***************************************************************/
-  /* stamp Sym(T_s) = (T_s + T_s^\dagger) / 2                    */
-  /* into the sth diagonal block of DRMatrix,                    */
-  /* undoing the SCUFF matrix transformation along the way.      */
-  /***************************************************************/
-  DR->Zero();
+  int NBFS = TInt->NR;
   for(int a=0; a<(NBFS/2); a++)
    for(int b=a; b<(NBFS/2); b++)
     {
@@ -86,26 +71,93 @@ void ComputeDRMatrix(SNEQData *SNEQD, int SourceSurface)
       cdouble SymTME = 0.5*RYTOVPF*( TMEab + conj(TEMba) );
       cdouble SymTMM = 0.5*RYTOVPF*( TMMab + conj(TMMba) );
 
-      DR->SetEntry(OffsetS + 2*a+0, OffsetS + 2*b+0, SymTEE );
-      DR->SetEntry(OffsetS + 2*b+0, OffsetS + 2*a+0, conj(SymTEE) );
+      S->SetEntry(Offset + 2*a+0, Offset + 2*b+0, SymTEE );
+      S->SetEntry(Offset + 2*b+0, Offset + 2*a+0, conj(SymTEE) );
 
-      DR->SetEntry(OffsetS + 2*a+0, OffsetS + 2*b+1, SymTEM );
-      DR->SetEntry(OffsetS + 2*b+1, OffsetS + 2*a+0, conj(SymTEM) );
+      S->SetEntry(Offset + 2*a+0, Offset + 2*b+1, SymTEM );
+      S->SetEntry(Offset + 2*b+1, Offset + 2*a+0, conj(SymTEM) );
 
-      DR->SetEntry(OffsetS + 2*a+1, OffsetS + 2*b+0, SymTME );
-      DR->SetEntry(OffsetS + 2*b+0, OffsetS + 2*a+1, conj(SymTME) );
+      S->SetEntry(Offset + 2*a+1, Offset + 2*b+0, SymTME );
+      S->SetEntry(Offset + 2*b+0, Offset + 2*a+1, conj(SymTME) );
 
-      DR->SetEntry(OffsetS + 2*a+1, OffsetS + 2*b+1, SymTMM );
-      DR->SetEntry(OffsetS + 2*b+1, OffsetS + 2*a+1, conj(SymTMM) );
+      S->SetEntry(Offset + 2*a+1, Offset + 2*b+1, SymTMM );
+      S->SetEntry(Offset + 2*b+1, Offset + 2*a+1, conj(SymTMM) );
     };
+}
+
+/***************************************************************/
+/* Compute the dressed Rytov matrix for sources contained in   */
+/* SourceSurface. The matrix is stored in the DRMatrix         */
+/* field of the SNEQD structure.                               */
+/*                                                             */
+/* DR = W * D * W', where W = M^{-1} and D is nonzero only in  */
+/* the diagonal block for SourceSurface, where it equals       */
+/* Sym(T_s). Writing E_s for the NBF x NBFS matrix that        */
+/* injects into that block, we have DR = Y * Sym(T_s) * Y'     */
+/* with Y = W*E_s; thus we only need to solve for the NBFS     */
+/* columns of Y, and can then assemble DR with two             */
+/* matrix-matrix products involving thin matrices.             */
+/***************************************************************/
+void ComputeDRMatrix(SNEQData *SNEQD, int SourceSurface)
+{
+  Log("...computing DR matrix");
+
+  RWGGeometry *G  = SNEQD->G;
+  HMatrix *M      = SNEQD->M;
+  HMatrix *DR     = SNEQD->DRMatrix;
+
+  int NBF         = G->TotalBFs;
+  int NBFS        = G->Surfaces[SourceSurface]->NumBFs;
+  int OffsetS     = G->BFIndexOffset[SourceSurface];
+  HMatrix *TInt   = SNEQD->TInt[SourceSurface];
 
   /***************************************************************/
-  /* set DR = W * DR * W' ****************************************/
-  /* by computing DR = M \ (M \ DR)'       ***********************/
+  /* if the source surface is the only surface there is nothing  */
+  /* to be gained from the thin formulation; in this case we     */
+  /* just set DR = M \ (M \ D)' in place to avoid allocating     */
+  /* extra NBF x NBF storage.                                    */
   /***************************************************************/
-  M->LUSolve(DR);
-  DR->Adjoint();
-  M->LUSolve(DR);
+  if (NBFS==NBF)
+   { DR->Zero();
+     StampSymT(TInt, DR, OffsetS);
+     if (SNEQD->KS)
+      { SNEQD->KS->Solve(DR);
+        DR->Adjoint();
+        SNEQD->KS->Solve(DR);
+      }
+     else
+      { M->LUSolve(DR);
+        DR->Adjoint();
+        M->LUSolve(DR);
+      };
+     Log("...done with DR matrix");
+     return;
+   };
+
+  /***************************************************************/
+  /* Y = M \ E_s                                                 */
+  /***************************************************************/
+  HMatrix *Y = new HMatrix(NBF, NBFS, LHM_COMPLEX);
+  for(int n=0; n<NBFS; n++)
+   Y->SetEntry(OffsetS + n, n, 1.0);
+  if (SNEQD->KS)
+   SNEQD->KS->Solve(Y);
+  else
+   M->LUSolve(Y);
+
+  /***************************************************************/
+  /* DR = (Y * Sym(T_s)) * Y'                                    */
+  /***************************************************************/
+  HMatrix *SymT = new HMatrix(NBFS, NBFS, LHM_COMPLEX);
+  StampSymT(TInt, SymT, 0);
+
+  HMatrix *YSymT = new HMatrix(NBF, NBFS, LHM_COMPLEX);
+  Y->Multiply(SymT, YSymT);
+  YSymT->Multiply(Y, DR, "--transB C");
+
+  delete YSymT;
+  delete SymT;
+  delete Y;
 
   Log("...done with DR matrix");
 }
@@ -194,6 +246,80 @@ int GetSIFlux(SNEQData *SNEQD, int SourceSurface, cdouble Omega,
 
 } 
 
+/***************************************************************/
+/* the checkpoint record for each transformation contains, for */
+/* each (source surface, PFT method), a flag that is 1 if the  */
+/* calculation was done, followed by the NS x NUMPFT entries   */
+/* of the PFT matrix.                                          */
+/***************************************************************/
+int GetCheckpointSize(SNEQData *SNEQD)
+{ int NS=SNEQD->G->NumSurfaces;
+  return NS*SNEQD->NumPFTMethods*(1 + NS*NUMPFT);
+}
+
+static double *GetCheckpointSlot(SNEQData *SNEQD, double *Record,
+                                 int nss, int npm)
+{ int NS=SNEQD->G->NumSurfaces;
+  return Record + (nss*SNEQD->NumPFTMethods + npm)*(1 + NS*NUMPFT);
+}
+
+/***************************************************************/
+/* write the fluxes from source surface nss to all surfaces,   */
+/* computed by PFT method #npm, to the .SIFlux file; PFT is    */
+/* the NS x NUMPFT PFT matrix stored by rows.                  */
+/***************************************************************/
+static void WriteSIFlux(SNEQData *SNEQD, int npm, char *Tag, cdouble Omega,
+                        double *kBloch, int nss, double *PFT)
+{
+  int NS=SNEQD->G->NumSurfaces;
+  FILE *f=SNEQD->SIFluxStreams[npm];
+  if (!f) f=OpenOutputFile("%s",SNEQD->SIFluxFileNames[npm]);
+  for(int nsd=0; nsd<NS; nsd++)
+   { fprintf(f,"%s %e ",Tag,real(Omega));
+     if (kBloch) fprintVec(f,kBloch,SNEQD->G->LDim);
+     fprintf(f,"%i%i ",nss+1,nsd+1);
+     for(int nq=0; nq<NUMPFT; nq++)
+      fprintf(f,"%+.8e ",PFT[nsd*NUMPFT + nq]);
+     fprintf(f,"\n");
+   };
+  if (!SNEQD->SIFluxStreams[npm]) CloseOutputFile(f);
+}
+
+/***************************************************************/
+/* attempt to bypass an entire WriteFlux calculation by reading*/
+/* the fluxes at all transformations from the checkpoint file. */
+/* spatially-resolved fluxes and flux plots are not stored in  */
+/* the checkpoint file, so in that case we always recompute.   */
+/***************************************************************/
+static bool CheckpointRead(SNEQData *SNEQD, cdouble Omega, double *kBloch)
+{
+  if ( !SNEQD->Checkpoint || SNEQD->SRXMatrix || SNEQD->PlotFlux )
+   return false;
+
+  int NT   = SNEQD->NumTransformations;
+  int Size = GetCheckpointSize(SNEQD);
+  double *Records = new double[NT*Size];
+  for(int nt=0; nt<NT; nt++)
+   if ( !ReadCheckpoint(SNEQD->Checkpoint, SNEQD->GTCList[nt]->Tag,
+                        Omega, kBloch, Records + nt*Size) )
+    { delete[] Records;
+      return false;
+    };
+
+  Log("Read neq quantities at omega=%s from checkpoint file",z2s(Omega));
+  int NS=SNEQD->G->NumSurfaces;
+  for(int nt=0; nt<NT; nt++)
+   for(int nss=0; nss<NS; nss++)
+    for(int npm=0; npm<SNEQD->NumPFTMethods; npm++)
+     { double *Slot=GetCheckpointSlot(SNEQD, Records + nt*Size, nss, npm);
+       if (Slot[0]==1.0)
+        WriteSIFlux(SNEQD, npm, SNEQD->GTCList[nt]->Tag, Omega, kBloch, nss, Slot+1);
+     };
+
+  delete[] Records;
+  return true;
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
@@ -210,6 +336,9 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
   int NS              = SNEQD->G->NumSurfaces;
   char *FileBase      = SNEQD->FileBase;
 
+  if ( CheckpointRead(SNEQD, Omega, kBloch) )
+   return;
+
   Log("Computing neq quantities at omega=%s...",z2s(Omega));
 
   /***************************************************************/
@@ -238,12 +367,14 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
 
      if ( !(G->Surfaces[ns]->IsPEC) )
       { G->RegionMPs[ G->Surfaces[ns]->RegionIndices[1] ]->UnZero();
-        G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TInt[ns]);
+        if ( !SNEQD->BMI || !SNEQD->BMI->AssembleBlock(ns, ns, Omega, TInt[ns]) )
+         G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TInt[ns]);
         G->RegionMPs[ G->Surfaces[ns]->RegionIndices[1] ]->Zero();
       };
 
      G->RegionMPs[ G->Surfaces[ns]->RegionIndices[0] ]->UnZero();
-     G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TExt[ns]);
+     if ( !SNEQD->BMI || !SNEQD->BMI->AssembleBlock(ns, ns, Omega, TExt[ns]) )
+      G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TExt[ns]);
      G->RegionMPs[ G->Surfaces[ns]->RegionIndices[0] ]->Zero();
    };
   for(int nr=0; nr<G->NumRegions; nr++)
@@ -253,6 +384,7 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
   /* now loop over transformations.                              */
   /* note: 'gtc' stands for 'geometrical transformation complex' */
   /***************************************************************/
+  double *Record = new double[GetCheckpointSize(SNEQD)];
   for(int nt=0; nt<SNEQD->NumTransformations; nt++)
    { 
      /*--------------------------------------------------------------*/
@@ -292,8 +424,14 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
          };
       };
      UndoSCUFFMatrixTransformation(M);
-     Log("LU factorizing...");
-     M->LUFactorize();
+     if (SNEQD->KS)
+      { Log("Factorizing preconditioner blocks...");
+        SNEQD->KS->SetMatrix(M);
+      }
+     else
+      { Log("LU factorizing...");
+        M->LUFactorize();
+      };
 
      /*--------------------------------------------------------------*/
      /*- compute the requested quantities for all objects           -*/
@@ -303,6 +441,7 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
      int NumPFTMethods  = SNEQD->NumPFTMethods;
      int *PFTMethods    = SNEQD->PFTMethods;
      HMatrix *PFTMatrix = SNEQD->PFTMatrix;
+     memset(Record, 0, GetCheckpointSize(SNEQD)*sizeof(double));
      for(int nss=0; nss<NS; nss++)
       {
         // PEC bodies do not act as thermal sources
@@ -322,16 +461,12 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
            if (Status==0)
             continue;
 
-           FILE *f=vfopen(SNEQD->SIFluxFileNames[npm],"a");
+           double *Slot=GetCheckpointSlot(SNEQD, Record, nss, npm);
+           Slot[0]=1.0;
            for(int nsd=0; nsd<NS; nsd++)
-            { fprintf(f,"%s %e ",Tag,real(Omega));
-              if (kBloch) fprintVec(f,kBloch,G->LDim);
-              fprintf(f,"%i%i ",nss+1,nsd+1);
-              for(int nq=0; nq<NUMPFT; nq++)
-               fprintf(f,"%+.8e ",PFTMatrix->GetEntryD(nsd,nq));
-              fprintf(f,"\n");
-            };
-           fclose(f);
+            for(int nq=0; nq<NUMPFT; nq++)
+             Slot[1 + nsd*NUMPFT + nq]=PFTMatrix->GetEntryD(nsd,nq);
+           WriteSIFlux(SNEQD, npm, Tag, Omega, kBloch, nss, Slot+1);
 
          };
 
@@ -342,9 +477,11 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
             HMatrix *SRXMatrix = SNEQD->SRXMatrix;
             HMatrix *SRFMatrix = SNEQD->SRFMatrix;
             HMatrix *DRMatrix  = SNEQD->DRMatrix;
-            GetSRFluxTrace(G, SRXMatrix, Omega, DRMatrix, SRFMatrix);
+            GetSRFluxTrace(G, SRXMatrix, Omega, DRMatrix, SRFMatrix,
+                           SNEQD->PFTOpts.WS);
 
-            FILE *f=vfopen("%s.SRFlux","a",FileBase);
+            FILE *f=SNEQD->SRFluxStream;
+            if (!f) f=OpenOutputFile("%s.SRFlux",FileBase);
             for(int nx=0; nx<SRXMatrix->NR; nx++)
              {
                double X[3], SRFlux[NUMSRFLUX];
@@ -359,11 +496,13 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
                 fprintf(f,"%e ",SRFMatrix->GetEntryD(nx,nfc));
                fprintf(f,"\n");
              };
-            fclose(f);
+            if (!SNEQD->SRFluxStream) CloseOutputFile(f);
           };
 
       };
 
+     WriteCheckpoint(SNEQD->Checkpoint, Tag, Omega, kBloch, Record);
+
      /*--------------------------------------------------------------*/
      /* untransform the geometry                                     */
      /*--------------------------------------------------------------*/
@@ -371,6 +510,7 @@ void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch)
      Log(" ...done!");
 
   }; // for (nt=0; nt<SNEQD->NumTransformations... )
+  delete[] Record;
 
   /*--------------------------------------------------------------*/
   /*- at the end of the first successful frequency calculation,  -*/
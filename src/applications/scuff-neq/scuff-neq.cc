@@ -50,6 +50,7 @@
 /***************************************************************/
 int main(int argc, char *argv[])
 {
+  InitMPI(&argc, &argv);
   InstallHRSignalHandler();
   InitializeLog(argv[0]);
 
@@ -94,6 +95,12 @@ int main(int argc, char *argv[])
   char *Cache=0;
   char *ReadCache[MAXCACHE];         int nReadCache;
   char *WriteCache=0;
+  bool UseExistingData=false;
+  char *SolverName=0;
+  bool InterpolateMatrix=false;
+  double FarFieldThreshold=0.0;
+  int ConcurrentFrequencies=1;
+  double MemoryBudget=0.0;
 
   /* name               type    #args  max_instances  storage           count         description*/
   OptStruct OSArray[]=
@@ -123,6 +130,13 @@ int main(int argc, char *argv[])
      {"Cache",          PA_STRING,  1, 1,       (void *)&Cache,      0,             "read/write cache"},
      {"ReadCache",      PA_STRING,  1, MAXCACHE,(void *)ReadCache,   &nReadCache,   "read cache"},
      {"WriteCache",     PA_STRING,  1, 1,       (void *)&WriteCache, 0,             "write cache"},
+     {"UseExistingData", PA_BOOL,   0, 1,       (void *)&UseExistingData, 0,       "resume from the checkpoint file of an earlier run"},
+/**/     
+     {"Solver",         PA_STRING,  1, 1,       (void *)&SolverName, 0,             "LU | GMRES | BiCGStab"},
+     {"InterpolateMatrix", PA_BOOL, 0, 1,       (void *)&InterpolateMatrix, 0,      "interpolate BEM matrix blocks in frequency"},
+     {"FarFieldThreshold", PA_DOUBLE, 1, 1,     (void *)&FarFieldThreshold, 0,      "use multipole moments for well-separated basis functions"},
+     {"ConcurrentFrequencies", PA_INT, 1, 1,    (void *)&ConcurrentFrequencies, 0,  "max number of frequencies to evaluate at once"},
+     {"MemoryBudget",   PA_DOUBLE,  1, 1,       (void *)&MemoryBudget, 0,           "memory budget (GB) for concurrent frequencies"},
 /**/     
      {0,0,0,0,0,0,0}
    };
@@ -135,6 +149,12 @@ int main(int argc, char *argv[])
    OSUsage(argv[0], OSArray, "--geometry option is mandatory");
   if (!FileBase)
    FileBase=vstrdup(GetFileBase(GeoFile));
+  if (FarFieldThreshold>0.0)
+   RWGGeometry::EdgeMomentThreshold=FarFieldThreshold;
+
+  int Solver = SolverName ? ParseSolverName(SolverName) : SCUFF_SOLVER_LU;
+  if (Solver==-1)
+   OSUsage(argv[0], OSArray, "unknown --Solver (valid choices: LU, GMRES, BiCGStab)");
 
   if ( Cache!=0 && WriteCache!=0 )
    ErrExit("--cache and --writecache options are mutually exclusive");
@@ -213,6 +233,10 @@ int main(int argc, char *argv[])
   SNEQD->PFTOpts.DSIRadius       = DSIRadius;
   SNEQD->PFTOpts.DSIFarField     = DSIFarField;
   SNEQD->DSIOmegaPoints          = DSIOmegaFile ? new HVector(DSIOmegaFile) : 0;
+  if (Solver!=SCUFF_SOLVER_LU)
+   SNEQD->KS = new KrylovSolver(G, Solver);
+  if (InterpolateMatrix && !OmegaKBPoints)
+   SNEQD->BMI = CreateBEMMatrixInterpolator(G, OmegaPoints);
 
   if (OmegaKBPoints && !G->LBasis)
    ErrExit("--OmegaKBPoints may only be used with extended geometries");
@@ -231,24 +255,56 @@ int main(int argc, char *argv[])
   if (Cache) WriteCache=Cache;
   SNEQD->WriteCache = WriteCache;
 
+  /*******************************************************************/
+  /* open the checkpoint file, to which the spatially-integrated     */
+  /* fluxes are written at every frequency as soon as they are       */
+  /* computed; with --UseExistingData, frequencies already in the    */
+  /* file are not redone                                             */
+  /*******************************************************************/
+  if ( UseExistingData && (EPFile || PlotFlux) )
+   { Warn("spatially-resolved fluxes cannot be read from checkpoint files");
+     Warn("(ignoring --UseExistingData)");
+     UseExistingData=false;
+   };
+  char CheckpointContext[1000];
+  snprintf(CheckpointContext,1000,"scuff-neq %s %i",GetFileBase(GeoFile),OmitSelfTerms ? 1 : 0);
+  for(int npm=0; npm<NumPFTMethods; npm++)
+   snprintf(CheckpointContext + strlen(CheckpointContext),
+            1000 - strlen(CheckpointContext), " %i", PFTMethods[npm]);
+  char *CheckpointFileName = vstrdup("%s.checkpoint",FileBase);
+  SNEQD->Checkpoint = OpenCheckpointFile(CheckpointFileName, CheckpointContext,
+                                         GetCheckpointSize(SNEQD), UseExistingData);
+  free(CheckpointFileName);
+
   /*******************************************************************/
   /* now switch off based on the requested frequency behavior to     */
   /* perform the actual calculations.                                */
   /*******************************************************************/
+  FrequencyScheduler *FS
+   = CreateFrequencyScheduler(SNEQD, Solver, ConcurrentFrequencies, MemoryBudget);
   if (OmegaKBPoints)
-   { for (int nok=0; nok<OmegaKBPoints->NR; nok++)
-      {  
-        cdouble Omega; 
-        double kBloch[2];
-        Omega     = OmegaKBPoints->GetEntryD(nok, 0);
-        kBloch[0] = OmegaKBPoints->GetEntryD(nok, 1);
-        kBloch[1] = OmegaKBPoints->GetEntryD(nok, 2);
-        WriteFlux(SNEQD, Omega, kBloch);
+   { int NOK = OmegaKBPoints->NR;
+     cdouble *OmegaList = new cdouble[NOK];
+     double *kBlochList = new double[2*NOK];
+     for (int nok=0; nok<NOK; nok++)
+      { OmegaList[nok]      = OmegaKBPoints->GetEntryD(nok, 0);
+        kBlochList[2*nok+0] = OmegaKBPoints->GetEntryD(nok, 1);
+        kBlochList[2*nok+1] = OmegaKBPoints->GetEntryD(nok, 2);
       };
+     WriteFluxBatch(FS, NOK, OmegaList, kBlochList);
+     delete[] OmegaList;
+     delete[] kBlochList;
    }
   else
-   for (int nFreq=0; nFreq<NumFreqs; nFreq++)
-    WriteFlux(SNEQD, OmegaPoints->GetEntry(nFreq));
+   { cdouble *OmegaList = new cdouble[NumFreqs];
+     for (int nFreq=0; nFreq<NumFreqs; nFreq++)
+      OmegaList[nFreq] = OmegaPoints->GetEntry(nFreq);
+     WriteFluxBatch(FS, NumFreqs, OmegaList);
+     delete[] OmegaList;
+   };
+
+  CloseCheckpointFile(SNEQD->Checkpoint);
+  FinalizeMPI();
 
   /***************************************************************/
   /***************************************************************/
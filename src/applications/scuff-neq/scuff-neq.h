@@ -108,6 +108,8 @@ typedef struct SNEQData
    HMatrix **TInt;    // TInt[ns], TExt[ns] = interior and exterior
    HMatrix **TExt;    // contributions to BEM block for surface #ns
    HMatrix **U;       // U[nb] = // off-diagonal U-matrix block #nb 
+   KrylovSolver *KS;  // iterative solver (if NULL, use LU factorization)
+   BEMMatrixInterpolator *BMI; // frequency interpolator for TInt, TExt (may be NULL)
 
    /*--------------------------------------------------------------*/
    /*- miscellaneous other options                                -*/
@@ -116,6 +118,16 @@ typedef struct SNEQData
    HVector *DSIOmegaPoints;
    bool PlotFlux;       // generate flux plots
    bool OmitSelfTerms;
+   CheckpointFile *Checkpoint; // fluxes at each (Tag, Omega, kBloch) point
+
+   /*--------------------------------------------------------------*/
+   /*- if these are non-NULL, output that would otherwise be       */
+   /*- appended to the .SIFlux and .SRFlux files is written to     */
+   /*- these streams instead (used by the frequency scheduler to   */
+   /*- write results for concurrent frequencies in order)          */
+   /*--------------------------------------------------------------*/
+   FILE *SIFluxStreams[MAXPFTMETHODS];
+   FILE *SRFluxStream;
 
  } SNEQData;
 
@@ -126,9 +138,33 @@ SNEQData *CreateSNEQData(char *GeoFile, char *TransFile,
                          int *PFTMethods, int NumPFTMethods,
                          char *EPFile, char *pFileBase);
 
+SNEQData *CloneSNEQData(SNEQData *SNEQD);
+
 /*--------------------------------------------------------------*/
 /*- in GetFlux.cc ----------------------------------------------*/
 /*--------------------------------------------------------------*/
 void WriteFlux(SNEQData *SNEQD, cdouble Omega, double *kBloch=0);
+int GetCheckpointSize(SNEQData *SNEQD);
+
+/*--------------------------------------------------------------*/
+/*- in FrequencyScheduler.cc -----------------------------------*/
+/*--------------------------------------------------------------*/
+// a FrequencyScheduler evaluates batches of frequencies (or
+// (Omega, kBloch) points) concurrently. each of its Slots is an
+// independent SNEQData workspace (with its own geometry and BEM
+// matrix storage) handled by ThreadsPerSlot threads.
+typedef struct FrequencyScheduler
+ { 
+   SNEQData **Slots;
+   int NumSlots;
+   int ThreadsPerSlot;
+
+ } FrequencyScheduler;
+
+FrequencyScheduler *CreateFrequencyScheduler(SNEQData *SNEQD, int Solver,
+                                             int MaxConcurrent,
+                                             double MemoryBudget);
+void WriteFluxBatch(FrequencyScheduler *FS, int NumPoints,
+                    cdouble *OmegaPoints, double *kBlochPoints=0);
 
 #endif
@@ -27,6 +27,13 @@
 
 #include <libSGJC.h>
 
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
 #include "scuff-scatter.h"
 
 #define MAXSTR   1000 
@@ -37,20 +44,92 @@
 
 #define II cdouble(0.0,1.0)
 
+/***************************************************************/
+/* writing of evaluation-point data to the .scattered and      */
+/* .total output files. the points are processed in chunks;    */
+/* where pthreads are available, the output for one chunk is   */
+/* written by a separate thread while the fields for the next  */
+/* chunk are being computed. each chunk holds the fields for   */
+/* all NumRHS incident fields in the current batch.            */
+/*                                                             */
+/* the output files look as if the incident fields had been    */
+/* processed one at a time: a header block followed by all     */
+/* points for the first field, then the same for the second,   */
+/* etc. to this end the output for all but the first field is  */
+/* collected in temporary files and appended at the end.       */
+/***************************************************************/
+typedef struct EPChunk
+ { FILE **f[2];           // [NumRHS] .scattered and .total output streams
+   const char *OmegaStr;
+   const char *TransformLabel;
+   char **IFLabels;       // [NumRHS] or NULL
+   int NumRHS;
+   int NX;
+   double *X;             // coordinates [3*NX]
+   HMatrix *SFMatrix;     // scattered fields [NX x 6*NumRHS]
+   HMatrix *IFMatrix;     // incident fields  [NX x 6*NumRHS]
+ } EPChunk;
+
+void *WriteEPChunk(void *data)
+{
+  EPChunk *Chunk=(EPChunk *)data;
+  for(int ST=0; ST<2; ST++)
+   for(int nrhs=0; nrhs<Chunk->NumRHS; nrhs++)
+   { FILE *f=Chunk->f[ST][nrhs];
+     for(int nr=0; nr<Chunk->NX; nr++)
+      { double *X=Chunk->X + 3*nr;
+        cdouble EH[6];
+        for(int nc=0; nc<6; nc++) 
+         { EH[nc]=Chunk->SFMatrix->GetEntry(nr,6*nrhs+nc);
+           if (ST==1) 
+            EH[nc]+=Chunk->IFMatrix->GetEntry(nr,6*nrhs+nc);
+         };
+        fprintf(f,"%+.8e %+.8e %+.8e ",X[0],X[1],X[2]);
+        fprintf(f,"%s ",Chunk->OmegaStr);
+        if (Chunk->TransformLabel) fprintf(f,"%s ",Chunk->TransformLabel);
+        if (Chunk->IFLabels) fprintf(f,"%s ",Chunk->IFLabels[nrhs]);
+        fprintf(f,"%s %s %s   ",CD2S(EH[0]),CD2S(EH[1]),CD2S(EH[2]));
+        fprintf(f,"%s %s %s\n", CD2S(EH[3]),CD2S(EH[4]),CD2S(EH[5]));
+      };
+   };
+  return 0;
+}
+
+void WriteEPHeader(FILE *f, const char *TransformLabel, bool HaveIFLabel)
+{
+  fprintf(f,"# scuff-scatter run on %s (%s)\n",GetHostName(),GetTimeString());
+  fprintf(f,"# columns: \n");
+  fprintf(f,"# 1,2,3   x,y,z (evaluation point coordinates)\n");
+  fprintf(f,"# 4       omega (angular frequency)\n");
+  int nc=5;
+  if (TransformLabel)
+   fprintf(f,"# %i       geometrical transform\n",nc++);
+  if (HaveIFLabel)
+   fprintf(f,"# %i       incident field\n",nc++);
+  fprintf(f,"# %02i,%02i   real, imag Ex\n",nc,nc+1); nc+=2;
+  fprintf(f,"# %02i,%02i   real, imag Ey\n",nc,nc+1); nc+=2;
+  fprintf(f,"# %02i,%02i   real, imag Ez\n",nc,nc+1); nc+=2;
+  fprintf(f,"# %02i,%02i   real, imag Hx\n",nc,nc+1); nc+=2;
+  fprintf(f,"# %02i,%02i   real, imag Hy\n",nc,nc+1); nc+=2;
+  fprintf(f,"# %02i,%02i   real, imag Hz\n",nc,nc+1); nc+=2;
+}
+
 /***************************************************************/
 /* compute scattered and total fields at a user-specified list */
-/* of evaluation points                                        */
+/* of evaluation points for all incident fields in the current */
+/* batch                                                       */
 /***************************************************************/
 void ProcessEPFile(SSData *SSD, char *EPFileName)
 { 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
-  RWGGeometry *G  = SSD->G;
-  IncField *IF    = SSD->IF;
-  HVector  *KN    = SSD->KN;
-  cdouble  Omega  = SSD->Omega;
-  double *kBloch  = SSD->kBloch;
+  RWGGeometry *G    = SSD->G;
+  int NumRHS        = SSD->NumInBatch;
+  IncField **IFs    = SSD->IFBatch;
+  HMatrix *KN       = SSD->KNBatch;
+  cdouble  Omega    = SSD->Omega;
+  double *kBloch    = SSD->kBloch;
 
   /*--------------------------------------------------------------*/
   /*- try to read eval points from file --------------------------*/
@@ -61,64 +140,127 @@ void ProcessEPFile(SSData *SSD, char *EPFileName)
      delete XMatrix;
      return;
    };
+  int NX=XMatrix->NR;
 
   /*--------------------------------------------------------------*/
-  /*- get components of scattered and incident fields            -*/
-  /*--------------------------------------------------------------*/
-  Log("Evaluating fields at points in file %s...",EPFileName);
-
-  HMatrix *SFMatrix = G->GetFields( 0, KN, Omega, kBloch, XMatrix); // scattered
-  HMatrix *IFMatrix = G->GetFields(IF,  0, Omega, kBloch, XMatrix); // incident
-
-  /*--------------------------------------------------------------*/
-  /*- create .scattered and .total output files and write fields -*/
+  /*- create .scattered and .total output files and write headers-*/
   /*--------------------------------------------------------------*/
   SetDefaultCD2SFormat("%+.8e %+.8e ");
   char OmegaStr[100];
   snprintf(OmegaStr,100,"%s",z2s(Omega));
   char *TransformLabel=SSD->TransformLabel;
-  char *IFLabel=SSD->IFLabel;
+  char **IFLabels=SSD->IFLabelBatch;
   const char *Ext[2]={"scattered","total"};
+  FILE **f[2];
   for(int ST=0; ST<2; ST++)
    { char OutFileName[MAXSTR];
      snprintf(OutFileName,MAXSTR,"%s.%s",GetFileBase(EPFileName),Ext[ST]);
-     FILE *f=fopen(OutFileName,"a");
-     fprintf(f,"# scuff-scatter run on %s (%s)\n",GetHostName(),GetTimeString());
-     fprintf(f,"# columns: \n");
-     fprintf(f,"# 1,2,3   x,y,z (evaluation point coordinates)\n");
-     fprintf(f,"# 4       omega (angular frequency)\n");
-     int nc=5;
-     if (TransformLabel)
-      fprintf(f,"# %i       geometrical transform\n",nc++);
-     if (IFLabel)
-      fprintf(f,"# %i       incident field\n",nc++);
-     fprintf(f,"# %02i,%02i   real, imag Ex\n",nc,nc+1); nc+=2;
-     fprintf(f,"# %02i,%02i   real, imag Ey\n",nc,nc+1); nc+=2;
-     fprintf(f,"# %02i,%02i   real, imag Ez\n",nc,nc+1); nc+=2;
-     fprintf(f,"# %02i,%02i   real, imag Hx\n",nc,nc+1); nc+=2;
-     fprintf(f,"# %02i,%02i   real, imag Hy\n",nc,nc+1); nc+=2;
-     fprintf(f,"# %02i,%02i   real, imag Hz\n",nc,nc+1); nc+=2;
-     for(int nr=0; nr<SFMatrix->NR; nr++)
-      { double X[3];
-        cdouble EH[6];
-        XMatrix->GetEntriesD(nr,":",X);
-        SFMatrix->GetEntries(nr,":",EH);
-        if (ST==1) 
-         for(int nc=0; nc<6; nc++) 
-          EH[nc]+=IFMatrix->GetEntry(nr,nc);
-        fprintf(f,"%+.8e %+.8e %+.8e ",X[0],X[1],X[2]);
-        fprintf(f,"%s ",OmegaStr);
-        if (TransformLabel) fprintf(f,"%s ",TransformLabel);
-        if (IFLabel) fprintf(f,"%s ",IFLabel);
-        fprintf(f,"%s %s %s   ",CD2S(EH[0]),CD2S(EH[1]),CD2S(EH[2]));
-        fprintf(f,"%s %s %s\n", CD2S(EH[3]),CD2S(EH[4]),CD2S(EH[5]));
+     f[ST]=(FILE **)mallocEC(NumRHS*sizeof(FILE *));
+     f[ST][0]=fopen(OutFileName,"a");
+     if (!f[ST][0])
+      ErrExit("could not open file %s",OutFileName);
+     WriteEPHeader(f[ST][0], TransformLabel, IFLabels!=0);
+     for(int nrhs=1; nrhs<NumRHS; nrhs++)
+      if ( !(f[ST][nrhs]=tmpfile()) )
+       ErrExit("could not create temporary file for %s",OutFileName);
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- get scattered and incident fields one chunk of points at a -*/
+  /*- time, so that the storage needed for the field computation -*/
+  /*- and the output stays bounded however many points there are -*/
+  /*--------------------------------------------------------------*/
+  int ChunkSize = G->GetFieldChunkSize();
+  if (ChunkSize>NX) ChunkSize=NX;
+  int NumChunks = (NX + ChunkSize - 1) / ChunkSize;
+  Log("Evaluating fields at %i points in file %s (%i chunks)...",NX,EPFileName,NumChunks);
+
+  EPChunk Chunks[2];
+  for(int nb=0; nb<2; nb++)
+   { Chunks[nb].f[0]           = f[0];
+     Chunks[nb].f[1]           = f[1];
+     Chunks[nb].OmegaStr       = OmegaStr;
+     Chunks[nb].TransformLabel = TransformLabel;
+     Chunks[nb].IFLabels       = IFLabels;
+     Chunks[nb].NumRHS         = NumRHS;
+     Chunks[nb].NX             = 0;
+     Chunks[nb].X              = 0;
+     Chunks[nb].SFMatrix       = 0;
+     Chunks[nb].IFMatrix       = 0;
+   };
+#ifdef HAVE_PTHREAD
+  pthread_t Writer;
+  bool WriterRunning=false;
+#endif
+
+  for(int nc=0; nc<NumChunks; nc++)
+   { 
+     // alternate between two buffers so that the chunk being
+     // written is not the chunk being computed
+     EPChunk *Chunk = Chunks + (nc%2);
+     int nxMin = nc*ChunkSize;
+     int NXC   = (nxMin + ChunkSize <= NX) ? ChunkSize : NX - nxMin;
+     HMatrix *XChunk = new HMatrix(NXC, 3);
+     for(int nx=0; nx<NXC; nx++)
+      for(int Mu=0; Mu<3; Mu++)
+       XChunk->SetEntry(nx, Mu, XMatrix->GetEntryD(nxMin+nx, Mu));
+
+     if (Chunk->NX != NXC)
+      { if (Chunk->X) free(Chunk->X);
+        if (Chunk->SFMatrix) delete Chunk->SFMatrix;
+        if (Chunk->IFMatrix) delete Chunk->IFMatrix;
+        Chunk->NX       = NXC;
+        Chunk->X        = (double *)mallocEC(3*NXC*sizeof(double));
+        Chunk->SFMatrix = new HMatrix(NXC, 6*NumRHS, LHM_COMPLEX);
+        Chunk->IFMatrix = new HMatrix(NXC, 6*NumRHS, LHM_COMPLEX);
       };
-     fclose(f);
+     for(int nx=0; nx<NXC; nx++)
+      XChunk->GetEntriesD(nx, ":", Chunk->X + 3*nx);
+     G->GetFields(  0, KN, NumRHS, Omega, kBloch, XChunk, Chunk->SFMatrix); // scattered
+     G->GetFields(IFs,  0, NumRHS, Omega, kBloch, XChunk, Chunk->IFMatrix); // incident
+     delete XChunk;
+
+#ifdef HAVE_PTHREAD
+     if (WriterRunning)
+      pthread_join(Writer, 0);
+     if ( pthread_create(&Writer, 0, WriteEPChunk, (void *)Chunk)==0 )
+      WriterRunning=true;
+     else
+      { WriterRunning=false;
+        WriteEPChunk( (void *)Chunk );
+      };
+#else
+     WriteEPChunk( (void *)Chunk );
+#endif
    };
 
+#ifdef HAVE_PTHREAD
+  if (WriterRunning)
+   pthread_join(Writer, 0);
+#endif
+
+  /*--------------------------------------------------------------*/
+  /*- append the output for the remaining incident fields         -*/
+  /*--------------------------------------------------------------*/
+  for(int ST=0; ST<2; ST++)
+   { for(int nrhs=1; nrhs<NumRHS; nrhs++)
+      { WriteEPHeader(f[ST][0], TransformLabel, IFLabels!=0);
+        rewind(f[ST][nrhs]);
+        char Buffer[MAXSTR];
+        size_t n;
+        while( (n=fread(Buffer, 1, MAXSTR, f[ST][nrhs])) > 0 )
+         fwrite(Buffer, 1, n, f[ST][0]);
+        fclose(f[ST][nrhs]);
+      };
+     fclose(f[ST][0]);
+     free(f[ST]);
+   };
+  for(int nb=0; nb<2; nb++)
+   { if (Chunks[nb].X) free(Chunks[nb].X);
+     if (Chunks[nb].SFMatrix) delete Chunks[nb].SFMatrix;
+     if (Chunks[nb].IFMatrix) delete Chunks[nb].IFMatrix;
+   };
   delete XMatrix;
-  delete SFMatrix;
-  delete IFMatrix;
 
 }
 
@@ -191,22 +333,25 @@ void VisualizeFields(SSData *SSD, char *MeshFileName)
    };
 
   /*--------------------------------------------------------------*/
-  /*- get the total fields at the panel vertices                 -*/
+  /*- get the total fields at the panel vertices for all incident-*/
+  /*- fields in the current batch                                -*/
   /*--------------------------------------------------------------*/
-  HMatrix *FMatrix=SSD->G->GetFields(SSD->IF, SSD->KN, SSD->Omega, SSD->kBloch, 
-                                     XMatrix);
+  int NumRHS=SSD->NumInBatch;
+  HMatrix *FMatrix=SSD->G->GetFields(SSD->IFBatch, SSD->KNBatch, NumRHS,
+                                     SSD->Omega, SSD->kBloch, XMatrix);
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
-  char *TransformLabel=SSD->TransformLabel, *IFLabel=SSD->IFLabel;
+  char *TransformLabel=SSD->TransformLabel, **IFLabels=SSD->IFLabelBatch;
+  for(int nrhs=0; nrhs<NumRHS; nrhs++)
   for(int nff=0; nff<NUMFIELDFUNCS; nff++)
    { 
      fprintf(f,"View \"%s(%s)",FieldTitles[nff],z2s(SSD->Omega));
      if (TransformLabel)
       fprintf(f,"(%s)",TransformLabel);
-     if (IFLabel)
-      fprintf(f,"(%s)",IFLabel);
+     if (IFLabels)
+      fprintf(f,"(%s)",IFLabels[nrhs]);
      fprintf(f,"\" {\n");
 
      /*--------------------------------------------------------------*/
@@ -224,7 +369,8 @@ void VisualizeFields(SSData *SSD, char *MeshFileName)
            V[nv]  = S->Vertices + 3*VI;
 
            cdouble EH[6];
-           FMatrix->GetEntries(VI, ":", EH);
+           for(int Mu=0; Mu<6; Mu++)
+            EH[Mu]=FMatrix->GetEntry(VI, 6*nrhs + Mu);
            cdouble *F = (nff>=4) ? EH+0 : EH+3;
            if (nff==3 || nff==7)
             Q[nv] = sqrt(norm(F[0]) + norm(F[1]) + norm(F[2]));
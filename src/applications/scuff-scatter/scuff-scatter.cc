@@ -45,6 +45,7 @@
 #define MAXEPF   10    // max number of evaluation-point files
 #define MAXFVM   10    // max number of field visualization meshes
 #define MAXCACHE 10    // max number of cache files for preload
+#define MAXBATCH 64    // max number of incident fields per RHS batch
 
 #define MAXSTR   1000
  
@@ -171,6 +172,11 @@ int main(int argc, char *argv[])
   char *ReadCache[MAXCACHE];         int nReadCache;
   char *WriteCache=0;
   char *LogLevel=0;
+  char *SolverName=0;
+  char *Compression=0;
+  bool InterpolateMatrix=false;
+  bool SymmetricFactorization=false;
+  int FMMOrder=0;
   /* name               type    #args  max_instances  storage           count         description*/
   OptStruct OSArray[]=
    { 
@@ -222,6 +228,12 @@ int main(int argc, char *argv[])
      {"HDF5File",       PA_STRING,  1, 1,       (void *)&HDF5File,   0,             "name of HDF5 file for BEM matrix/vector export"},
 /**/
      {"LogLevel",       PA_STRING,  1, 1,       (void *)&LogLevel,   0,             "none | terse | verbose | verbose2"},
+/**/
+     {"Solver",         PA_STRING,  1, 1,       (void *)&SolverName, 0,             "LU | GMRES | BiCGStab"},
+     {"Compression",    PA_STRING,  1, 1,       (void *)&Compression, 0,            "None | ACA (requires --Solver GMRES or BiCGStab)"},
+     {"InterpolateMatrix", PA_BOOL, 0, 1,       (void *)&InterpolateMatrix, 0,      "interpolate BEM matrix blocks in frequency"},
+     {"SymmetricFactorization", PA_BOOL, 0, 1,  (void *)&SymmetricFactorization, 0, "use LDL^T instead of LU factorization"},
+     {"FMMOrder",       PA_INT,     1, 1,       (void *)&FMMOrder,   0,             "use approximate multipole field evaluation of this order (0=off)"},
 /**/
      {"Cache",          PA_STRING,  1, 1,       (void *)&Cache,      0,             "read/write cache"},
      {"ReadCache",      PA_STRING,  1, MAXCACHE,(void *)ReadCache,   &nReadCache,   "read cache"},
@@ -234,6 +246,20 @@ int main(int argc, char *argv[])
   if (GeoFile==0)
    OSUsage(argv[0], OSArray, "--geometry option is mandatory");
 
+  int Solver = SolverName ? ParseSolverName(SolverName) : SCUFF_SOLVER_LU;
+  if (Solver==-1)
+   OSUsage(argv[0], OSArray, "unknown --Solver (valid choices: LU, GMRES, BiCGStab)");
+
+  bool UseACA=false;
+  if (Compression && !strcasecmp(Compression,"ACA"))
+   UseACA=true;
+  else if (Compression && strcasecmp(Compression,"None"))
+   OSUsage(argv[0], OSArray, "unknown --Compression (valid choices: None, ACA)");
+  if (UseACA && Solver==SCUFF_SOLVER_LU)
+   OSUsage(argv[0], OSArray, "--Compression ACA requires --Solver GMRES or --Solver BiCGStab");
+  if (UseACA && (InterpolateMatrix || SymmetricFactorization || HDF5File) )
+   OSUsage(argv[0], OSArray, "--Compression ACA is incompatible with --InterpolateMatrix, --SymmetricFactorization, and --HDF5File");
+
   /*******************************************************************/
   /* process frequency-related options                               */
   /*******************************************************************/
@@ -326,17 +352,30 @@ int main(int argc, char *argv[])
   SSData MySSData, *SSD=&MySSData;
 
   RWGGeometry *G      = SSD->G   = new RWGGeometry(GeoFile);
-  HMatrix *M          = SSD->M   = G->AllocateBEMMatrix();
+  HMatrix *M          = SSD->M   = UseACA ? 0 : G->AllocateBEMMatrix();
+  ACAMatrix *A        = 0;
   HVector *RHS        = SSD->RHS = G->AllocateRHSVector();
   HVector *KN         = SSD->KN  = G->AllocateRHSVector();
+  HMatrix *RHSBatch   = 0;
+  HMatrix *KNBatch    = 0;
   double *kBloch      = SSD->kBloch = 0;
   SSD->IF             = 0;
   SSD->TransformLabel = 0;
   SSD->IFLabel        = 0;
+  SSD->NumInBatch     = 0;
+  SSD->KNBatch        = 0;
+  SSD->IFBatch        = 0;
+  SSD->IFLabelBatch   = 0;
 
   char GeoFileBase[MAXSTR];
   strncpy(GeoFileBase, GetFileBase(GeoFile), MAXSTR);
   if (LogLevel) G->SetLogLevel(LogLevel);
+  if (SymmetricFactorization) RWGGeometry::UseSymmetricFactorization=true;
+  if (FMMOrder>0) RWGGeometry::FMMOrder=FMMOrder;
+
+  KrylovSolver *KS = (Solver==SCUFF_SOLVER_LU) ? 0 : new KrylovSolver(G, Solver);
+
+  BEMMatrixInterpolator *BMI = InterpolateMatrix ? CreateBEMMatrixInterpolator(G, OmegaList) : 0;
 
   /*--------------------------------------------------------------*/
   /*- read the transformation file if one was specified and check */
@@ -359,7 +398,9 @@ int main(int argc, char *argv[])
   /*******************************************************************/
   double kBlochBuffer[3];
   if (G->LDim>0)
-   { if ( npwPol!=1 || ngbCenter!=0 || npsLoc!=0 )
+   { if (UseACA)
+      ErrExit("--Compression ACA is not available for extended geometries");
+     if ( npwPol!=1 || ngbCenter!=0 || npsLoc!=0 )
       ErrExit("for extended geometries, the incident field must be a single plane wave");
      kBloch = SSD->kBloch = kBlochBuffer;
    };
@@ -390,7 +431,7 @@ int main(int argc, char *argv[])
   /*******************************************************************/
   HMatrix **TBlocks=0, **UBlocks=0;
   int NS=G->NumSurfaces;
-  if (NumTransformations>1)
+  if (NumTransformations>1 && !UseACA)
    { int NADB = NS*(NS-1)/2; // number of above-diagonal blocks
      TBlocks  = (HMatrix **)mallocEC(NS*sizeof(HMatrix *));
      UBlocks  = (HMatrix **)mallocEC(NADB*sizeof(HMatrix *));
@@ -439,14 +480,21 @@ int main(int argc, char *argv[])
      /*******************************************************************/
      /* if we have more than one transformation, pre-assemble diagonal  */
      /* matrix blocks at this frequency; otherwise just assemble the    */
-     /* whole matrix                                                    */
+     /* whole matrix. with --InterpolateMatrix, the matrix (or the      */
+     /* diagonal blocks, which do not change under transformations)     */
+     /* comes from the frequency interpolator. with --Compression ACA,  */
+     /* the compressed matrix is assembled below for each               */
+     /* transformation.                                                 */
      /*******************************************************************/
-     if (NumTransformations==1)
-      G->AssembleBEMMatrix(Omega, kBloch, M);
-     else
+     if (NumTransformations==1 && !UseACA)
+      { if ( !BMI || !BMI->Assemble(Omega, M) )
+         G->AssembleBEMMatrix(Omega, kBloch, M);
+      }
+     else if (NumTransformations>1 && !UseACA)
       for(int ns=0; ns<G->NumSurfaces; ns++)
        if (G->Mate[ns]==-1)
-        G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TBlocks[ns]);
+        if ( !BMI || !BMI->AssembleBlock(ns, ns, Omega, TBlocks[ns]) )
+         G->AssembleBEMMatrixBlock(ns, ns, Omega, kBloch, TBlocks[ns]);
 
      /*******************************************************************/
      /* dump the scuff cache to a cache storage file if requested. note */
@@ -475,9 +523,20 @@ int main(int argc, char *argv[])
          };
 
         /*******************************************************************/
-        /* assemble and insert off-diagonal blocks as necessary ************/
+        /* assemble and insert off-diagonal blocks as necessary. the ACA   */
+        /* cluster tree depends on the positions of the surfaces, so the   */
+        /* compressed matrix is rebuilt from scratch if the geometry has   */
+        /* been transformed.                                               */
         /*******************************************************************/
-        if (NumTransformations>1)
+        if (UseACA)
+         { if (A && NumTransformations>1)
+            { delete A;
+              A=0;
+            };
+           Log("  Assembling compressed BEM matrix...");
+           A=G->AssembleACAMatrix(Omega, A);
+         }
+        else if (NumTransformations>1)
          { for(int ns=0, nb=0; ns<G->NumSurfaces; ns++)
             for(int nsp=ns+1; nsp<G->NumSurfaces; nsp++, nb++)
              G->AssembleBEMMatrixBlock(ns, nsp, Omega, kBloch, UBlocks[nb]);
@@ -494,10 +553,18 @@ int main(int argc, char *argv[])
          };
 
         /*******************************************************************/
-        /* export BEM matrix to a binary .hdf5 file if that was requested  */
+        /* export BEM matrix to a binary .hdf5 file if that was requested. */
+        /* (for the symmetric LDL^T factorization only the upper triangle  */
+        /* of the matrix was filled in, so we first fill in the lower      */
+        /* triangle, which the factorization does not reference.)          */
         /*******************************************************************/
         if (HDF5Context)
-         M->ExportToHDF5(HDF5Context,"M_%s%s",OmegaStr,TransformStr);
+         { if (M->UseLDLT)
+            for(int nr=1; nr<M->NR; nr++)
+             for(int nc=0; nc<nr; nc++)
+              M->SetEntry(nr, nc, M->GetEntry(nc, nr) );
+           M->ExportToHDF5(HDF5Context,"M_%s%s",OmegaStr,TransformStr);
+         };
 
         /*******************************************************************/
         /* if the user requested no output options (for example, if she   **/
@@ -509,17 +576,60 @@ int main(int argc, char *argv[])
 
         /*******************************************************************/
         /* LU-factorize the BEM matrix to prepare for solving scattering   */
-        /* problems                                                        */
+        /* problems, or set up the preconditioner for the iterative solver */
         /*******************************************************************/
-        Log("  LU-factorizing BEM matrix...");
-        M->LUFactorize();
+        if (KS)
+         { Log("  Factorizing preconditioner blocks...");
+           if (A)
+            KS->SetMatrix(A, Omega);
+           else
+            KS->SetMatrix(M);
+         }
+        else
+         { Log("  LU-factorizing BEM matrix...");
+           M->LUFactorize();
+         };
 
         /***************************************************************/
-        /* loop over incident fields                                   */
+        /* loop over incident fields. the RHS vectors for up to        */
+        /* MAXBATCH incident fields are assembled together and the     */
+        /* corresponding BEM systems are solved with a single          */
+        /* multiple-RHS solve; most output modules then process the    */
+        /* solution vectors one at a time, while the field-evaluation  */
+        /* modules process the whole batch together.                   */
         /***************************************************************/
         for(int nIF=0; nIF<IFList->NumIFs; nIF++)
          { 
-           IncField *IF = SSD->IF = IFList->IFs[nIF];
+           int nc = nIF % MAXBATCH;
+           if (nc==0)
+            { int NumInBatch = IFList->NumIFs - nIF;
+              if (NumInBatch > MAXBATCH) NumInBatch=MAXBATCH;
+              if (KNBatch && KNBatch->NC!=NumInBatch)
+               { delete KNBatch; 
+                 delete RHSBatch;
+                 KNBatch=RHSBatch=0;
+               };
+              if (KNBatch==0)
+               { KNBatch  = new HMatrix(G->TotalBFs, NumInBatch, LHM_COMPLEX);
+                 RHSBatch = new HMatrix(G->TotalBFs, NumInBatch, LHM_COMPLEX);
+               };
+
+              Log("  Assembling RHS vectors for %i incident fields...",NumInBatch);
+              G->AssembleRHSMatrix(Omega, kBloch, IFList->IFs + nIF, NumInBatch, RHSBatch);
+              KNBatch->Copy(RHSBatch); // copy RHS vectors for later 
+              Log("  Solving the BEM system...");
+              if (KS)
+               KS->Solve(KNBatch);
+              else
+               M->LUSolve(KNBatch);
+
+              SSD->NumInBatch   = NumInBatch;
+              SSD->KNBatch      = KNBatch;
+              SSD->IFBatch      = IFList->IFs + nIF;
+              SSD->IFLabelBatch = IFFile ? IFList->Labels + nIF : 0;
+            };
+
+           SSD->IF = IFList->IFs[nIF];
            SSD->IFLabel = IFFile ? IFList->Labels[nIF] : 0;
            if (SSD->IFLabel)
             Log("  Processing incident field %s...",SSD->IFLabel);
@@ -529,13 +639,10 @@ int main(int argc, char *argv[])
             snprintf(IFStr,100,"_%s",SSD->IFLabel);
    
            /***************************************************************/
-           /* assemble RHS vector and solve BEM system*********************/
+           /* extract RHS and solution vectors for this incident field    */
            /***************************************************************/
-           Log("  Assembling RHS vector...");
-           G->AssembleRHSVector(Omega, kBloch, IF, KN);
-           RHS->Copy(KN); // copy RHS vector for later 
-           Log("  Solving the BEM system...");
-           M->LUSolve(KN);
+           RHSBatch->GetEntries(":", nc, RHS->ZV);
+           KNBatch->GetEntries(":", nc, KN->ZV);
    
            if (HDF5Context)
             { RHS->ExportToHDF5(HDF5Context,"RHS_%s%s%s",OmegaStr,TransformStr,IFStr);
@@ -574,13 +681,6 @@ int main(int argc, char *argv[])
            if (PSDFile)
             WritePSDFile(SSD, PSDFile);
        
-           /*--------------------------------------------------------------*/
-           /*- scattered fields at user-specified points ------------------*/
-           /*--------------------------------------------------------------*/
-           int nepf;
-           for(nepf=0; nepf<nEPFiles; nepf++)
-            ProcessEPFile(SSD, EPFiles[nepf]);
-      
            /*--------------------------------------------------------------*/
            /*- induced dipole moments       -------------------------------*/
            /*--------------------------------------------------------------*/
@@ -594,11 +694,16 @@ int main(int argc, char *argv[])
             G->PlotSurfaceCurrents(KN, Omega, SSD->kBloch, "%s.pp",GetFileBase(GeoFile));
       
            /*--------------------------------------------------------------*/
-           /*- field visualization meshes ---------------------------------*/
+           /*- scattered fields at user-specified points and field        -*/
+           /*- visualization meshes: these are computed for all incident  -*/
+           /*- fields in the batch at once, after the last one            -*/
            /*--------------------------------------------------------------*/
-           int nfm;
-           for(nfm=0; nfm<nFVMeshes; nfm++)
-            VisualizeFields(SSD, FVMeshes[nfm]);
+           if ( nc==SSD->NumInBatch-1 )
+            { for(int nepf=0; nepf<nEPFiles; nepf++)
+               ProcessEPFile(SSD, EPFiles[nepf]);
+              for(int nfm=0; nfm<nFVMeshes; nfm++)
+               VisualizeFields(SSD, FVMeshes[nfm]);
+            };
 
          }; // for(int nIF=0; nIF<IFList->NumIFs; nIF++
       
@@ -46,12 +46,23 @@ typedef struct SSData
    double *kBloch;
    IncField *IF;
    char *TransformLabel, *IFLabel;
+
+   // the current batch of incident fields and the corresponding
+   // solution vectors (the columns of KNBatch); IFLabelBatch is
+   // NULL if the incident fields are unlabeled
+   int NumInBatch;
+   HMatrix *KNBatch;
+   IncField **IFBatch;
+   char **IFLabelBatch;
  } SSData;
  
 
 /***************************************************************/
 /* these are the 'output modules' that compute and process the */
-/* scattered fields in various ways.                           */
+/* scattered fields in various ways. ProcessEPFile and         */
+/* VisualizeFields handle all incident fields in the current   */
+/* batch at once; the others handle the single incident field  */
+/* SSD->IF.                                                    */
 /***************************************************************/
 void WritePFTFile(SSData *SSD, PFTOptions *PFTOpts, int Method,
                   bool PlotFlux, char *FileName);
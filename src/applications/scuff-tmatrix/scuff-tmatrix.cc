@@ -65,6 +65,7 @@ int main(int argc, char *argv[])
   char *OmegaFile=0;    // list of angular frequencies
   char *Cache=0;        // scuff cache file 
   char *FileBase=0;     // base filename for output file
+  char *SolverName=0;   // LU (default) or an iterative solver
   /* name        type    #args  max_instances  storage    count  description*/
   OptStruct OSArray[]=
    { {"geometry",  PA_STRING,  1, 1, (void *)&GeoFileName,  0,  ".scuffgeo file"},
@@ -73,11 +74,15 @@ int main(int argc, char *argv[])
      {"OmegaFile", PA_STRING,  1, 1, (void *)&OmegaFile,    0,  "list of angular frequencies"},
      {"Cache",     PA_STRING,  1, 1, (void *)&Cache,        0,  "scuff cache file"},
      {"FileBase",  PA_STRING,  1, 1, (void *)&FileBase,     0,  "base filename for output file"},
+     {"Solver",    PA_STRING,  1, 1, (void *)&SolverName,   0,  "LU | GMRES | BiCGStab"},
      {0,0,0,0,0,0,0}
    };
   ProcessOptions(argc, argv, OSArray);
   if (GeoFileName==0)
    OSUsage(argv[0],OSArray,"--geometry option is mandatory");
+  int Solver = SolverName ? ParseSolverName(SolverName) : SCUFF_SOLVER_LU;
+  if (Solver==-1)
+   OSUsage(argv[0],OSArray,"unknown --Solver (valid choices: LU, GMRES, BiCGStab)");
 
   /*--------------------------------------------------------------*/
   /*- process frequency options ----------------------------------*/
@@ -105,6 +110,7 @@ int main(int argc, char *argv[])
   /*--------------------------------------------------------------*/
   HMatrix *M  = G->AllocateBEMMatrix();
   HVector *KN = G->AllocateRHSVector();
+  KrylovSolver *KS = (Solver==SCUFF_SOLVER_LU) ? 0 : new KrylovSolver(G, Solver);
 
   /*--------------------------------------------------------------*/
   /*- preallocate an HMatrix to store the T-matrix data           */
@@ -140,7 +146,10 @@ int main(int argc, char *argv[])
      /*--------------------------------------------------------------*/
      Omega=OmegaVector->GetEntry(nOmega);
      G->AssembleBEMMatrix(Omega, M);
-     M->LUFactorize();
+     if (KS)
+      KS->SetMatrix(M);
+     else
+      M->LUFactorize();
 
      /*--------------------------------------------------------------*/
      /*- inner loop over incident spherical waves (i.e. over columns-*/
@@ -161,7 +170,10 @@ int main(int argc, char *argv[])
            // solve the scattering problem for this incident spherical wave
            Log("Solving scattering problem with incident spherical wave P(l,m)=%c(%i,%i)",TypeChar[Type],l,m);
            G->AssembleRHSVector(Omega, &SW, KN);
-           M->LUSolve(KN);
+           if (KS)
+            KS->Solve(KN);
+           else
+            M->LUSolve(KN);
 
            // compute the spherical multipole moments induced by the 
            // incident wave on the object 
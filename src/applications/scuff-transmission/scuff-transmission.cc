@@ -131,6 +131,7 @@ int main(int argc, char *argv[])
   char *ReadCache[MAXCACHE];         int nReadCache;
   char *WriteCache=0;
   bool FromAbove=false;
+  char *SolverName=0;
   /* name        type    #args  max_instances  storage    count  description*/
   OptStruct OSArray[]=
    { {"geometry",    PA_STRING,  1, 1,       (void *)&GeoFileName,  0,       ".scuffgeo file"},
@@ -158,6 +159,8 @@ int main(int argc, char *argv[])
      {"WriteCache",  PA_STRING,  1, 1,       (void *)&WriteCache,   0,             "write cache"},
 /**/
      {"FromAbove",   PA_BOOL,    0, 1,       (void *)&FromAbove,    0,       "plane wave impinges from above"},
+/**/
+     {"Solver",      PA_STRING,  1, 1,       (void *)&SolverName,   0,       "LU | GMRES | BiCGStab"},
      {0,0,0,0,0,0,0}
    };
   ProcessOptions(argc, argv, OSArray);
@@ -167,6 +170,9 @@ int main(int argc, char *argv[])
   /*******************************************************************/
   if (GeoFileName==0)
    OSUsage(argv[0], OSArray, "--geometry option is mandatory");
+  int Solver = SolverName ? ParseSolverName(SolverName) : SCUFF_SOLVER_LU;
+  if (Solver==-1)
+   OSUsage(argv[0], OSArray, "unknown --Solver (valid choices: LU, GMRES, BiCGStab)");
   if (!FileBase)
    FileBase=vstrdup(GetFileBase(GeoFileName));
   SetLogFileName("%s.log",FileBase);
@@ -267,6 +273,7 @@ int main(int argc, char *argv[])
 
   HMatrix *M   = G->AllocateBEMMatrix();
   HVector *KN  = G->AllocateRHSVector();
+  KrylovSolver *KS = (Solver==SCUFF_SOLVER_LU) ? 0 : new KrylovSolver(G, Solver);
 
   /*******************************************************************/
   /* set up output files *********************************************/
@@ -311,7 +318,10 @@ int main(int argc, char *argv[])
        { StoreCache( WriteCache );
          WriteCache=0;
        };
-      M->LUFactorize();
+      if (KS)
+       KS->SetMatrix(M);
+      else
+       M->LUFactorize();
 
       /*--------------------------------------------------------------*/
       /* set plane wave direction and compute polarization vectors    */
@@ -335,7 +345,10 @@ int main(int argc, char *argv[])
          E0[2]=EpsVectors[IncPol][2];
          PW.SetE0(E0);
          G->AssembleRHSVector(Omega, kBloch, &PW, KN);
-         M->LUSolve(KN);
+         if (KS)
+          KS->Solve(KN);
+         else
+          M->LUSolve(KN);
 
          double Flux[NUMREGIONS];
          GetFlux(G, &PW, KN, Omega, kBloch, NQPoints, ZAbove, ZBelow, Flux);
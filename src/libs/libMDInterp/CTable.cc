@@ -0,0 +1,114 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * CTable.cc -- allocation of interpolation coefficient tables
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libhrutil.h>
+
+#include "libMDInterp.h"
+
+/***************************************************************/
+/* allocate (and zero) a table of NumDoubles doubles whose     */
+/* start is aligned to a cache-line boundary. the coefficient  */
+/* tables are stored cell by cell, with all nFun*NCOEFF        */
+/* coefficients for one grid cell contiguous, so with this     */
+/* alignment the coefficients of each cell occupy whole cache  */
+/* lines whenever nFun*NCOEFF is a multiple of 8 (always true  */
+/* for Interp2D, Interp3D, and Interp4D).                      */
+/* the table may be released with free().                      */
+/***************************************************************/
+double *AllocateCTable(size_t NumDoubles)
+{
+  void *p=0;
+  size_t Size=NumDoubles*sizeof(double);
+  if ( posix_memalign(&p, LMDI_CTABLE_ALIGNMENT, Size ? Size : 1) )
+   ErrExit("out of memory");
+  memset(p, 0, Size);
+  return (double *)p;
+}
+
+/***************************************************************/
+/* write a coefficient table at the current position in f,     */
+/* preceded by enough zero bytes to align it                   */
+/***************************************************************/
+void WriteCTable(FILE *f, double *CTable, size_t NumDoubles)
+{
+  static const char Zeros[LMDI_CTABLE_ALIGNMENT]={0};
+  long Offset=ftell(f);
+  long Pad = (LMDI_CTABLE_ALIGNMENT - Offset%LMDI_CTABLE_ALIGNMENT) % LMDI_CTABLE_ALIGNMENT;
+  fwrite(Zeros, 1, Pad, f);
+  fwrite(CTable, sizeof(double), NumDoubles, f);
+}
+
+/***************************************************************/
+/* read (or map) a coefficient table written by WriteCTable(). */
+/* files written before the table was aligned (in which the    */
+/* table immediately follows the header) are also accepted.    */
+/***************************************************************/
+double *ReadCTable(FILE *f, const char *FileName, size_t NumDoubles,
+                   bool MapTable, void **pMapping, size_t *pMappingSize)
+{
+  *pMapping=0;
+  *pMappingSize=0;
+
+  struct stat FileStats;
+  if ( fstat(fileno(f), &FileStats) )
+   ErrExit("%s: could not stat file",FileName);
+  size_t FileSize = (size_t)FileStats.st_size;
+  size_t Size     = NumDoubles*sizeof(double);
+
+  long Offset  = ftell(f);
+  long Aligned = Offset + (LMDI_CTABLE_ALIGNMENT - Offset%LMDI_CTABLE_ALIGNMENT) % LMDI_CTABLE_ALIGNMENT;
+  if ( FileSize == Aligned + Size )
+   Offset=Aligned;
+  else if ( FileSize != Offset + Size )
+   ErrExit("%s: data file is invalid",FileName);
+
+  if (MapTable)
+   { // private mapping, so that ReInitialize() on the table
+     // modifies our copy and not the file
+     void *p=mmap(0, FileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+     if (p!=MAP_FAILED)
+      { *pMapping=p;
+        *pMappingSize=FileSize;
+        return (double *)( ((char *)p) + Offset );
+      };
+     // if the mapping failed we fall back to reading the table
+   };
+
+  double *CTable=AllocateCTable(NumDoubles);
+  fseek(f, Offset, SEEK_SET);
+  freadEC(CTable, sizeof(double), NumDoubles, f, FileName);
+  return CTable;
+}
+
+void FreeCTable(double *CTable, void *Mapping, size_t MappingSize)
+{
+  if (Mapping)
+   munmap(Mapping, MappingSize);
+  else
+   free(CTable);
+}
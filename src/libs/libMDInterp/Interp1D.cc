@@ -227,7 +227,7 @@ void Interp1D::InitInterp1D(Phi1D PhiFunc, void *UserData)
    /*- grid cell #n is defined to be the region                    */
    /*-  XPoints[n] <= X < XPoints[n+1]                             */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N-1)*nFun*NCOEFF);
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -448,7 +448,7 @@ Interp1D::Interp1D(double *pXPoints, double *YPoints,
    /*- grid cell #n is defined to be the region                    */
    /*-  XPoints[n] <= X < XPoints[n+1]                             */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N-1)*nFun*NCOEFF);
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -565,7 +565,7 @@ Interp1D::Interp1D(const char *FileName)
   freadEC(&fCTableSize, sizeof(int), 1, f, FileName);
   if (fCTableSize!=CTableSize)
    ErrExit("%s: data file is invalid",FileName);
-  CTable=(double *)mallocEC(CTableSize*sizeof(double));
+  CTable=AllocateCTable(CTableSize);
   freadEC(CTable, sizeof(double), CTableSize, f, FileName);
 
   fclose(f);
@@ -592,7 +592,7 @@ Interp1D::Interp1D(Interp1D *Original)
    XPoints=0;
      
   int CTableSize = (N-1)*nFun*NCOEFF*sizeof(double);
-  CTable=(double *)mallocEC(CTableSize);
+  CTable=AllocateCTable((N-1)*nFun*NCOEFF);
   memcpy(CTable, Original->CTable, CTableSize);
 
 }
@@ -691,9 +691,21 @@ void Interp1D::Evaluate(double X, double *Phi)
 /***************************************************************/
 /***************************************************************/
 double Interp1D::Evaluate(double X)
-{ double *Phi = new double[nFun];
+{ 
+  double PhiBuffer[8];
+  double *Phi = (nFun<=8) ? PhiBuffer : new double[nFun];
   Evaluate(X,Phi);
   double Phi0 = Phi[0];
-  delete[] Phi;
+  if (Phi!=PhiBuffer) delete[] Phi;
   return Phi0;
 }
+
+/***************************************************************/
+/* batch version: evaluate at NumPoints points X[n]; the       */
+/* output for point #n begins at Phi + n*nFun.                 */
+/***************************************************************/
+void Interp1D::Evaluate(int NumPoints, const double *X, double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   Evaluate(X[n], Phi + n*nFun);
+}
@@ -32,6 +32,7 @@
 #include <libhmat.h>
 
 #include "libMDInterp.h"
+#include "InterpKernels.h"
 
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
@@ -206,7 +207,9 @@ Interp2D::Interp2D(double *pX1Points, int pN1,
    /*-  X1Points[n1] <= X1 < X1Points[n1+1]                        */
    /*-  X2Points[n2] <= X2 < X2Points[n2+1]                        */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*nFun*NCOEFF);
+   CTableMapping=0;
+   CTableMappingSize=0;
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -258,7 +261,9 @@ Interp2D::Interp2D(double pX1Min, double X1Max, int pN1,
    /*- allocate space for the CTable (see comment above on how it  */ 
    /*- works)                                                      */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*nFun*NCOEFF);
+   CTableMapping=0;
+   CTableMappingSize=0;
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -478,14 +483,16 @@ void Interp2D::ReInitialize(Phi2D PhiFunc, void *UserData)
 /* class constructor 3: construct the class from a data file    */
 /* generated by a previous call to Interp2D::WriteToFile()      */
 /****************************************************************/
-Interp2D::Interp2D(const char *FileName)
+Interp2D::Interp2D(const char *FileName, bool MapTable)
 {
+   LogLevel=LMDI_LOGLEVEL_TERSE;
+
    if (LogLevel>=LMDI_LOGLEVEL_TERSE)
     Log("Attempting to read interpolation table from file %s...",FileName);
 
    FILE *f=fopen(FileName,"r");
    if (!f)
-    ErrExit("could not open file %s");
+    ErrExit("could not open file %s",FileName);
    
    freadEC(&N1  , sizeof(int), 1, f, FileName);
    freadEC(&N2  , sizeof(int), 1, f, FileName);
@@ -514,8 +521,8 @@ Interp2D::Interp2D(const char *FileName)
    if (fCTableSize!=CTableSize)
     ErrExit("%s: data file is invalid",FileName);
 
-   CTable=(double *)mallocEC(CTableSize*sizeof(double));
-   freadEC(CTable, sizeof(double), CTableSize, f, FileName);
+   CTable=ReadCTable(f, FileName, CTableSize, MapTable,
+                     &CTableMapping, &CTableMappingSize);
 
    fclose(f);
 
@@ -535,7 +542,7 @@ void Interp2D::WriteToFile(const char *FileName)
 
    FILE *f=fopen(FileName,"w");
    if (!f)
-    ErrExit("could not open file %s");
+    ErrExit("could not open file %s",FileName);
 
    fwrite(&N1  , sizeof(int), 1, f);
    fwrite(&N2  , sizeof(int), 1, f);
@@ -557,7 +564,7 @@ void Interp2D::WriteToFile(const char *FileName)
 
    int CTableSize=(N1-1)*(N2-1)*nFun*NCOEFF;
    fwrite(&CTableSize, sizeof(int), 1, f);
-   fwrite(CTable, sizeof(double), CTableSize, f);
+   WriteCTable(f, CTable, CTableSize);
 
    fclose(f);
 
@@ -572,7 +579,7 @@ Interp2D::~Interp2D()
 { 
   if (X1Points) free(X1Points);
   if (X2Points) free(X2Points);
-  free(CTable);
+  FreeCTable(CTable, CTableMapping, CTableMappingSize);
 }
 
 /****************************************************************/
@@ -652,16 +659,6 @@ void Interp2D::EvaluatePlus(double X1, double X2, double *Phi)
   FindInterval(X1, X1Points, N1, X1Min, DX1, &n1, &X1Bar);
   FindInterval(X2, X2Points, N2, X2Min, DX2, &n2, &X2Bar);
 
-  /****************************************************************/
-  /* tabulate powers of the scaled/shifted coordinates            */
-  /****************************************************************/
-  double X1Powers[4], X2Powers[4];
-  X1Powers[0]=X2Powers[0]=1.0;
-  for(int np=1; np<4; np++)
-   { X1Powers[np]=X1Powers[np-1]*X1Bar;
-     X2Powers[np]=X2Powers[np-1]*X2Bar;
-   };
-
   /****************************************************************/
   /* get the widths of this grid cell *****************************/
   /****************************************************************/
@@ -676,43 +673,30 @@ void Interp2D::EvaluatePlus(double X1, double X2, double *Phi)
    };
 
   /****************************************************************/
-  /* construct the NCOEFF-element vector of monomial values that  */
-  /* I dot with the NCOEFF-element vector of coefficients to get  */
-  /* the value of the interpolating polynomial                    */
+  /* tabulate powers of the scaled/shifted coordinates and their  */
+  /* first derivatives                                            */
   /****************************************************************/
-  double MVP[NCOEFF], MVPX[NCOEFF], MVPY[NCOEFF], MVPXY[NCOEFF];
-  int nm, p, q;
-  for(nm=p=0; p<4; p++)
-   for(q=0; q<4; q++, nm++)
-    { MVP[nm]   = X1Powers[p]*X2Powers[q];
-      MVPX[nm]  = p==0 ? 0.0 : p*X1Powers[p-1]*X2Powers[q]/L1;
-      MVPY[nm]  = q==0 ? 0.0 : q*X1Powers[p]*X2Powers[q-1]/L2;
-      MVPXY[nm] = (p==0 || q==0) ? 0.0 : p*q*X1Powers[p-1]*X2Powers[q-1]/(L1*L2);
-    };
+  double M1[3][4], M2[3][4];
+  GetMonomials(X1Bar, L1, 2, M1);
+  GetMonomials(X2Bar, L2, 2, M2);
 
   /****************************************************************/
   /* for each component of the Phi function vector, look up the   */
   /* coefficients of the interpolating polynomial for that        */
   /* component and use them to get the value of the interpolant   */
+  /* and its derivatives; D[2*i+j] is the derivative of order     */
+  /* (i,j) in (X1,X2).                                            */
   /****************************************************************/
-  double P, PX, PY, PXY;
-  double *C;
-  int nf;
-  for(nf=0; nf<nFun; nf++)
+  const double *CCell=CTable + GetCTableOffset(0, nFun, n1, N1, n2, N2);
+  for(int nf=0; nf<nFun; nf++)
    { 
-     C=CTable + GetCTableOffset(nf, nFun, n1, N1, n2, N2);
-
-     for(P=PX=PY=PXY=0.0, nm=0; nm<NCOEFF; nm++)
-      { P+=C[nm]*MVP[nm];
-        PX+=C[nm]*MVPX[nm];
-        PY+=C[nm]*MVPY[nm];
-        PXY+=C[nm]*MVPXY[nm];
-      };
+     double D[4];
+     Contract2D(CCell + nf*NCOEFF, M1, M2, 2, D);
 
-     Phi[4*nf+0]=P;
-     Phi[4*nf+1]=PX;
-     Phi[4*nf+2]=PY;
-     Phi[4*nf+3]=PXY;
+     Phi[4*nf+0]=D[0];
+     Phi[4*nf+1]=D[2];
+     Phi[4*nf+2]=D[1];
+     Phi[4*nf+3]=D[3];
 
    };
 
@@ -740,17 +724,6 @@ void Interp2D::EvaluatePlusPlus(double X1, double X2, double *Phi)
   FindInterval(X1, X1Points, N1, X1Min, DX1, &n1, &X1Bar);
   FindInterval(X2, X2Points, N2, X2Min, DX2, &n2, &X2Bar);
 
-  /****************************************************************/
-  /* tabulate powers of the scaled/shifted coordinates            */
-  /****************************************************************/
-  double X1Powers[4], X2Powers[4];
-  int np;
-  X1Powers[0]=X2Powers[0]=1.0;
-  for(np=1; np<4; np++)
-   { X1Powers[np]=X1Powers[np-1]*X1Bar;
-     X2Powers[np]=X2Powers[np-1]*X2Bar;
-   };
-
   /****************************************************************/
   /* get the widths of this grid cell *****************************/
   /****************************************************************/
@@ -765,49 +738,59 @@ void Interp2D::EvaluatePlusPlus(double X1, double X2, double *Phi)
    };
 
   /****************************************************************/
-  /* construct the NCOEFF-element vector of monomial values that  */
-  /* I dot with the NCOEFF-element vector of coefficients to get  */
-  /* the value of the interpolating polynomial                    */
+  /* tabulate powers of the scaled/shifted coordinates and their  */
+  /* first and second derivatives                                 */
   /****************************************************************/
-  double MVP[NCOEFF], MVPX[NCOEFF], MVPY[NCOEFF]; 
-  double MVPXX[NCOEFF], MVPXY[NCOEFF], MVPYY[NCOEFF];
-  int nm, p, q;
-  for(nm=p=0; p<4; p++)
-   for(q=0; q<4; q++, nm++)
-    { MVP[nm]   = X1Powers[p]*X2Powers[q];
-      MVPX[nm]  = p==0 ? 0.0 : p*X1Powers[p-1]*X2Powers[q]/L1;
-      MVPY[nm]  = q==0 ? 0.0 : q*X1Powers[p]*X2Powers[q-1]/L2;
-      MVPXX[nm] = (p<=1)         ? 0.0 : p*(p-1)*X1Powers[p-2]*X2Powers[q]/(L1*L1);
-      MVPXY[nm] = (p==0 || q==0) ? 0.0 : p*q*X1Powers[p-1]*X2Powers[q-1]/(L1*L2);
-      MVPYY[nm] = (q<=1)         ? 0.0 : q*(q-1)*X1Powers[p]*X2Powers[q-2]/(L2*L2);
-    };
+  double M1[3][4], M2[3][4];
+  GetMonomials(X1Bar, L1, 3, M1);
+  GetMonomials(X2Bar, L2, 3, M2);
 
   /****************************************************************/
   /* for each component of the Phi function vector, look up the   */
   /* coefficients of the interpolating polynomial for that        */
   /* component and use them to get the value of the interpolant   */
+  /* and its derivatives; D[3*i+j] is the derivative of order     */
+  /* (i,j) in (X1,X2).                                            */
   /****************************************************************/
+  const double *CCell=CTable + GetCTableOffset(0, nFun, n1, N1, n2, N2);
   for(int nf=0; nf<nFun; nf++)
    { 
-     double *C=CTable + GetCTableOffset(nf, nFun, n1, N1, n2, N2);
-
-     double P, PX, PY, PXX, PXY, PYY;
-     for(P=PX=PY=PXX=PXY=PYY=0.0, nm=0; nm<NCOEFF; nm++)
-      { P   += C[nm]*MVP[nm];
-        PX  += C[nm]*MVPX[nm];
-        PY  += C[nm]*MVPY[nm];
-        PXX += C[nm]*MVPXX[nm];
-        PXY += C[nm]*MVPXY[nm];
-        PYY += C[nm]*MVPYY[nm];
-      };
-
-     Phi[6*nf+0]=P;
-     Phi[6*nf+1]=PX;
-     Phi[6*nf+2]=PY;
-     Phi[6*nf+3]=PXX;
-     Phi[6*nf+4]=PXY;
-     Phi[6*nf+5]=PYY;
+     double D[9];
+     Contract2D(CCell + nf*NCOEFF, M1, M2, 3, D);
+
+     Phi[6*nf+0]=D[0];
+     Phi[6*nf+1]=D[3];
+     Phi[6*nf+2]=D[1];
+     Phi[6*nf+3]=D[6];
+     Phi[6*nf+4]=D[4];
+     Phi[6*nf+5]=D[2];
 
    };
 
 }
+
+/****************************************************************/
+/* batch versions of the above: evaluate at NumPoints points    */
+/* (X1[n], X2[n]); the output for point #n begins at            */
+/* Phi + n*nFun, Phi + 4*n*nFun, or Phi + 6*n*nFun.             */
+/****************************************************************/
+void Interp2D::Evaluate(int NumPoints, const double *X1, const double *X2,
+                        double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   Evaluate(X1[n], X2[n], Phi + n*nFun);
+}
+
+void Interp2D::EvaluatePlus(int NumPoints, const double *X1, const double *X2,
+                            double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   EvaluatePlus(X1[n], X2[n], Phi + 4*n*nFun);
+}
+
+void Interp2D::EvaluatePlusPlus(int NumPoints, const double *X1, const double *X2,
+                                double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   EvaluatePlusPlus(X1[n], X2[n], Phi + 6*n*nFun);
+}
@@ -32,6 +32,7 @@
 #include <libhmat.h>
 
 #include "libMDInterp.h"
+#include "InterpKernels.h"
 
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
@@ -222,7 +223,9 @@ Interp3D::Interp3D(double *pX1Points, int pN1,
    /*-  X2Points[n2] <= X2 < X2Points[n2+1]                        */
    /*-  X3Points[n3] <= X3 < X3Points[n3+1].                       */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*(N3-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*(N3-1)*nFun*NCOEFF);
+   CTableMapping=0;
+   CTableMappingSize=0;
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -278,7 +281,9 @@ Interp3D::Interp3D(double pX1Min, double X1Max, int pN1,
    /*--------------------------------------------------------------*/ 
    /*- allocate space for the CTable (see previous routine)        */ 
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*(N3-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*(N3-1)*nFun*NCOEFF);
+   CTableMapping=0;
+   CTableMappingSize=0;
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -529,14 +534,16 @@ void Interp3D::ReInitialize(Phi3D PhiFunc, void *UserData)
 /* class constructor 3: construct the class from a data file    */
 /* generated by a previous call to Interp3D::WriteToFile()      */
 /****************************************************************/
-Interp3D::Interp3D(const char *FileName)
-{ 
+Interp3D::Interp3D(const char *FileName, bool MapTable)
+{
+   LogLevel=LMDI_LOGLEVEL_TERSE;
+
    if (LogLevel >= LMDI_LOGLEVEL_TERSE)
     Log("Attempting to read interpolation table from file %s...",FileName);
 
    FILE *f=fopen(FileName,"r");
    if (!f)
-    ErrExit("could not open file %s");
+    ErrExit("could not open file %s",FileName);
    
    freadEC(&N1  , sizeof(int), 1, f, FileName);
    freadEC(&N2  , sizeof(int), 1, f, FileName);
@@ -570,8 +577,8 @@ Interp3D::Interp3D(const char *FileName)
    if (fCTableSize!=CTableSize)
     ErrExit("%s: data file is invalid",FileName);
 
-   CTable=(double *)mallocEC(CTableSize*sizeof(double));
-   freadEC(CTable, sizeof(double), CTableSize, f, FileName);
+   CTable=ReadCTable(f, FileName, CTableSize, MapTable,
+                     &CTableMapping, &CTableMappingSize);
 
    fclose(f);
 
@@ -590,7 +597,7 @@ void Interp3D::WriteToFile(const char *FileName)
 
    FILE *f=fopen(FileName,"w");
    if (!f)
-    ErrExit("could not open file %s");
+    ErrExit("could not open file %s",FileName);
 
    fwrite(&N1  , sizeof(int), 1, f);
    fwrite(&N2  , sizeof(int), 1, f);
@@ -616,7 +623,7 @@ void Interp3D::WriteToFile(const char *FileName)
 
    int CTableSize=(N1-1)*(N2-1)*(N3-1)*nFun*NCOEFF;
    fwrite(&CTableSize, sizeof(int), 1, f);
-   fwrite(CTable, sizeof(double), CTableSize, f);
+   WriteCTable(f, CTable, CTableSize);
 
    fclose(f);
 
@@ -632,7 +639,7 @@ Interp3D::~Interp3D()
   if (X1Points) free(X1Points);
   if (X2Points) free(X2Points);
   if (X3Points) free(X3Points);
-  free(CTable);
+  FreeCTable(CTable, CTableMapping, CTableMappingSize);
 }
 
 /****************************************************************/
@@ -747,70 +754,35 @@ void Interp3D::EvaluatePlus(double X1, double X2, double X3, double *PhiVD)
    };
 
   /****************************************************************/
-  /* tabulate powers of the scaled/shifted coordinates            */
-  /****************************************************************/
-  double X1Powers[4], X2Powers[4], X3Powers[4];
-  X1Powers[0]=X2Powers[0]=X3Powers[0]=1.0;
-  for(int np=1; np<4; np++)
-   { X1Powers[np]=X1Powers[np-1]*X1Bar;
-     X2Powers[np]=X2Powers[np-1]*X2Bar;
-     X3Powers[np]=X3Powers[np-1]*X3Bar;
-   };
-
-  /****************************************************************/
-  /* construct the NCOEFF-element vector of monomial values that  */
-  /* I dot with the NCOEFF-element vector of coefficients to get  */
-  /* the value of the interpolating polynomial                    */
+  /* tabulate powers of the scaled/shifted coordinates and their  */
+  /* first derivatives                                            */
   /****************************************************************/
-  double MVP[NCOEFF]; 
-  double MVPX[NCOEFF], MVPY[NCOEFF], MVPZ[NCOEFF];
-  double MVPXY[NCOEFF], MVPXZ[NCOEFF], MVPYZ[NCOEFF];
-  double MVPXYZ[NCOEFF];
-  int nm, p, q, r;
-  for(nm=p=0; p<4; p++)
-   for(q=0; q<4; q++)
-    for(r=0; r<4; r++, nm++)
-     { MVP[nm]   = X1Powers[p]*X2Powers[q]*X3Powers[r];
-       MVPX[nm]  = p==0 ? 0.0 : p*X1Powers[p-1]*X2Powers[q]*X3Powers[r]/L1;
-       MVPY[nm]  = q==0 ? 0.0 : q*X1Powers[p]*X2Powers[q-1]*X3Powers[r]/L2;
-       MVPZ[nm]  = r==0 ? 0.0 : r*X1Powers[p]*X2Powers[q]*X3Powers[r-1]/L3;
-       MVPXY[nm] = (p==0 || q==0) ? 0.0 : p*q*X1Powers[p-1]*X2Powers[q-1]*X3Powers[r]/(L1*L2);
-       MVPXZ[nm] = (p==0 || r==0) ? 0.0 : p*r*X1Powers[p-1]*X2Powers[q]*X3Powers[r-1]/(L1*L3);
-       MVPYZ[nm] = (q==0 || r==0) ? 0.0 : q*r*X1Powers[p]*X2Powers[q-1]*X3Powers[r-1]/(L2*L3);
-       MVPXYZ[nm] = (p==0 || q==0 || r==0) ? 0.0 : p*q*r*X1Powers[p-1]*X2Powers[q-1]*X3Powers[r-1]/(L1*L2*L3);
-    };
+  double M1[3][4], M2[3][4], M3[3][4];
+  GetMonomials(X1Bar, L1, 2, M1);
+  GetMonomials(X2Bar, L2, 2, M2);
+  GetMonomials(X3Bar, L3, 2, M3);
 
   /****************************************************************/
   /* for each component of the Phi function vector, look up the   */
   /* coefficients of the interpolating polynomial for that        */
   /* component and use them to get the value of the interpolant   */
+  /* and its derivatives; D[4*i+2*j+k] is the derivative of       */
+  /* order (i,j,k) in (X1,X2,X3).                                 */
   /****************************************************************/
-  double P, PX, PY, PZ, PXY, PXZ, PYZ, PXYZ;
-  double *C;
-  int nf;
-  for(nf=0; nf<nFun; nf++)
+  const double *CCell=CTable + GetCTableOffset(0, nFun, n1, N1, n2, N2, n3, N3);
+  for(int nf=0; nf<nFun; nf++)
    { 
-     C=CTable + GetCTableOffset(nf, nFun, n1, N1, n2, N2, n3, N3);
-
-     for(P=PX=PY=PZ=PXY=PXZ=PYZ=PXYZ=0.0, nm=0; nm<NCOEFF; nm++)
-      { P+=C[nm]*MVP[nm];
-        PX+=C[nm]*MVPX[nm];
-        PY+=C[nm]*MVPY[nm];
-        PZ+=C[nm]*MVPZ[nm];
-        PXY+=C[nm]*MVPXY[nm];
-        PXZ+=C[nm]*MVPXZ[nm];
-        PYZ+=C[nm]*MVPYZ[nm];
-        PXYZ+=C[nm]*MVPXYZ[nm];
-      };
-
-     PhiVD[8*nf+0]=P;
-     PhiVD[8*nf+1]=PX;
-     PhiVD[8*nf+2]=PY;
-     PhiVD[8*nf+3]=PZ;
-     PhiVD[8*nf+4]=PXY;
-     PhiVD[8*nf+5]=PXZ;
-     PhiVD[8*nf+6]=PYZ;
-     PhiVD[8*nf+7]=PXYZ;
+     double D[8];
+     Contract3D(CCell + nf*NCOEFF, M1, M2, M3, 2, D);
+
+     PhiVD[8*nf+0]=D[0];
+     PhiVD[8*nf+1]=D[4];
+     PhiVD[8*nf+2]=D[2];
+     PhiVD[8*nf+3]=D[1];
+     PhiVD[8*nf+4]=D[6];
+     PhiVD[8*nf+5]=D[5];
+     PhiVD[8*nf+6]=D[3];
+     PhiVD[8*nf+7]=D[7];
 
    };
 
@@ -846,17 +818,6 @@ void Interp3D::EvaluatePlusPlus(double X1, double X2, double X3, double *PhiVD)
   FindInterval(X2, X2Points, N2, X2Min, DX2, &n2, &X2Bar);
   FindInterval(X3, X3Points, N3, X3Min, DX3, &n3, &X3Bar);
 
-  /****************************************************************/
-  /* tabulate powers of the scaled/shifted coordinates            */
-  /****************************************************************/
-  double X1Powers[4], X2Powers[4], X3Powers[4];
-  X1Powers[0]=X2Powers[0]=X3Powers[0]=1.0;
-  for(int np=1; np<4; np++)
-   { X1Powers[np]=X1Powers[np-1]*X1Bar;
-     X2Powers[np]=X2Powers[np-1]*X2Bar;
-     X3Powers[np]=X3Powers[np-1]*X3Bar;
-   };
-
   /****************************************************************/
   /* get the widths of this grid cell *****************************/
   /****************************************************************/
@@ -873,65 +834,64 @@ void Interp3D::EvaluatePlusPlus(double X1, double X2, double X3, double *PhiVD)
    };
 
   /****************************************************************/
-  /* construct the NCOEFF-element vector of monomial values that  */
-  /* I dot with the NCOEFF-element vector of coefficients to get  */
-  /* the value of the interpolating polynomial                    */
+  /* tabulate powers of the scaled/shifted coordinates and their  */
+  /* first and second derivatives                                 */
   /****************************************************************/
-  double MVP[NCOEFF]; 
-  double MVPX[NCOEFF], MVPY[NCOEFF], MVPZ[NCOEFF];
-  double MVPXX[NCOEFF], MVPXY[NCOEFF], MVPXZ[NCOEFF], MVPYY[NCOEFF], MVPYZ[NCOEFF], MVPZZ[NCOEFF];
-  int nm, p, q, r;
-  for(nm=p=0; p<4; p++)
-   for(q=0; q<4; q++)
-    for(r=0; r<4; r++, nm++)
-     { MVP[nm]   = X1Powers[p]*X2Powers[q]*X3Powers[r];
-       MVPX[nm]  = p==0 ? 0.0 : p*X1Powers[p-1]*X2Powers[q]*X3Powers[r]/L1;
-       MVPY[nm]  = q==0 ? 0.0 : q*X1Powers[p]*X2Powers[q-1]*X3Powers[r]/L2;
-       MVPZ[nm]  = r==0 ? 0.0 : r*X1Powers[p]*X2Powers[q]*X3Powers[r-1]/L3;
-       MVPXX[nm] = (p<=1)         ? 0.0 : p*(p-1)*X1Powers[p-2]*X2Powers[q]*X3Powers[r]/(L1*L1);
-       MVPXY[nm] = (p==0 || q==0) ? 0.0 :   p*q*X1Powers[p-1]*X2Powers[q-1]*X3Powers[r]/(L1*L2);
-       MVPXZ[nm] = (p==0 || r==0) ? 0.0 :   p*r*X1Powers[p-1]*X2Powers[q]*X3Powers[r-1]/(L1*L3);
-       MVPYY[nm] = (q<=1)         ? 0.0 : q*(q-1)*X1Powers[p]*X2Powers[q-2]*X3Powers[r]/(L2*L2);
-       MVPYZ[nm] = (q==0 || r==0) ? 0.0 :   q*r*X1Powers[p]*X2Powers[q-1]*X3Powers[r-1]/(L2*L3);
-       MVPZZ[nm] = (r<=1)         ? 0.0 : r*(r-1)*X1Powers[p]*X2Powers[q]*X3Powers[r-2]/(L3*L3);
-    };
+  double M1[3][4], M2[3][4], M3[3][4];
+  GetMonomials(X1Bar, L1, 3, M1);
+  GetMonomials(X2Bar, L2, 3, M2);
+  GetMonomials(X3Bar, L3, 3, M3);
 
   /****************************************************************/
   /* for each component of the Phi function vector, look up the   */
   /* coefficients of the interpolating polynomial for that        */
   /* component and use them to get the value of the interpolant   */
+  /* and its derivatives; D[9*i+3*j+k] is the derivative of       */
+  /* order (i,j,k) in (X1,X2,X3).                                 */
   /****************************************************************/
-  double P, PX, PY, PZ, PXX, PXY, PXZ, PYY, PYZ, PZZ;
-  double *C;
-  int nf;
-  for(nf=0; nf<nFun; nf++)
+  const double *CCell=CTable + GetCTableOffset(0, nFun, n1, N1, n2, N2, n3, N3);
+  for(int nf=0; nf<nFun; nf++)
    { 
-     C=CTable + GetCTableOffset(nf, nFun, n1, N1, n2, N2, n3, N3);
+     double D[27];
+     Contract3D(CCell + nf*NCOEFF, M1, M2, M3, 3, D);
+
+     PhiVD[10*nf+0]=D[0];
+     PhiVD[10*nf+1]=D[9];
+     PhiVD[10*nf+2]=D[3];
+     PhiVD[10*nf+3]=D[1];
+     PhiVD[10*nf+4]=D[18];
+     PhiVD[10*nf+5]=D[12];
+     PhiVD[10*nf+6]=D[10];
+     PhiVD[10*nf+7]=D[6];
+     PhiVD[10*nf+8]=D[4];
+     PhiVD[10*nf+9]=D[2];
 
-     for(P=PX=PY=PZ=PXX=PXY=PXZ=PYY=PYZ=PZZ=0.0, nm=0; nm<NCOEFF; nm++)
-      { P+=C[nm]*MVP[nm];
-        PX+=C[nm]*MVPX[nm];
-        PY+=C[nm]*MVPY[nm];
-        PZ+=C[nm]*MVPZ[nm];
-        PXX+=C[nm]*MVPXX[nm];
-        PXY+=C[nm]*MVPXY[nm];
-        PXZ+=C[nm]*MVPXZ[nm];
-        PYY+=C[nm]*MVPYY[nm];
-        PYZ+=C[nm]*MVPYZ[nm];
-        PZZ+=C[nm]*MVPZZ[nm];
-      };
+   };
 
-     PhiVD[10*nf+0]=P;
-     PhiVD[10*nf+1]=PX;
-     PhiVD[10*nf+2]=PY;
-     PhiVD[10*nf+3]=PZ;
-     PhiVD[10*nf+4]=PXX;
-     PhiVD[10*nf+5]=PXY;
-     PhiVD[10*nf+6]=PXZ;
-     PhiVD[10*nf+7]=PYY;
-     PhiVD[10*nf+8]=PYZ;
-     PhiVD[10*nf+9]=PZZ;
+}
 
-   };
+/****************************************************************/
+/* batch versions of the above: evaluate at NumPoints points    */
+/* (X1[n], X2[n], X3[n]); the output for point #n begins at     */
+/* Phi + n*nFun, Phi + 8*n*nFun, or Phi + 10*n*nFun.            */
+/****************************************************************/
+void Interp3D::Evaluate(int NumPoints, const double *X1, const double *X2,
+                        const double *X3, double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   Evaluate(X1[n], X2[n], X3[n], Phi + n*nFun);
+}
 
+void Interp3D::EvaluatePlus(int NumPoints, const double *X1, const double *X2,
+                            const double *X3, double *PhiVD)
+{
+  for(int n=0; n<NumPoints; n++)
+   EvaluatePlus(X1[n], X2[n], X3[n], PhiVD + 8*n*nFun);
+}
+
+void Interp3D::EvaluatePlusPlus(int NumPoints, const double *X1, const double *X2,
+                                const double *X3, double *PhiVD)
+{
+  for(int n=0; n<NumPoints; n++)
+   EvaluatePlusPlus(X1[n], X2[n], X3[n], PhiVD + 10*n*nFun);
 }
@@ -234,7 +234,7 @@ Interp4D::Interp4D(double *pX1Points, int pN1,
    /*-  X3Points[n3] <= X3 < X3Points[n3+1].                       */
    /*-  X4Points[n4] <= X4 < X4Points[n4+1].                       */
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*(N3-1)*(N4-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*(N3-1)*(N4-1)*nFun*NCOEFF);
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -288,7 +288,7 @@ Interp4D::Interp4D(double pX1Min, double X1Max, int pN1,
    /*--------------------------------------------------------------*/ 
    /*- allocate space for the CTable (see previous routine)        */ 
    /*--------------------------------------------------------------*/ 
-   CTable=(double *)mallocEC((N1-1)*(N2-1)*(N3-1)*(N4-1)*nFun*NCOEFF*sizeof(double));
+   CTable=AllocateCTable((N1-1)*(N2-1)*(N3-1)*(N4-1)*nFun*NCOEFF);
    if (!CTable)
     ErrExit("%s:%i:out of memory",__FILE__,__LINE__);
 
@@ -594,7 +594,7 @@ Interp4D::Interp4D(const char *FileName)
    if (fCTableSize!=CTableSize)
     ErrExit("%s: data file is invalid",FileName);
 
-   CTable=(double *)mallocEC(CTableSize*sizeof(double));
+   CTable=AllocateCTable(CTableSize);
    freadEC(CTable, sizeof(double), CTableSize, f, FileName);
 
    fclose(f);
@@ -718,3 +718,15 @@ void Interp4D::Evaluate(double X1, double X2, double X3, double X4, double *Phi)
    };
 
 }
+
+/****************************************************************/
+/* batch version: evaluate at NumPoints points                  */
+/* (X1[n], X2[n], X3[n], X4[n]); the output for point #n begins */
+/* at Phi + n*nFun.                                             */
+/****************************************************************/
+void Interp4D::Evaluate(int NumPoints, const double *X1, const double *X2,
+                        const double *X3, const double *X4, double *Phi)
+{
+  for(int n=0; n<NumPoints; n++)
+   Evaluate(X1[n], X2[n], X3[n], X4[n], Phi + n*nFun);
+}
@@ -0,0 +1,111 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * InterpKernels.h -- inner loops shared by Interp2D and Interp3D for
+ *                 -- evaluating the interpolating polynomial and its
+ *                 -- derivatives in one grid cell
+ */
+
+#ifndef INTERPKERNELS_H
+#define INTERPKERNELS_H
+
+/***************************************************************/
+/* M[d][p] = (d/dX)^d XBar^p, where XBar = (X-X_n)/L is the    */
+/* scaled coordinate in a grid cell of width L,                */
+/* for d=0,...,NumOrders-1 (NumOrders<=3)                      */
+/***************************************************************/
+static inline void GetMonomials(double XBar, double L, int NumOrders,
+                                double M[3][4])
+{
+  M[0][0]=1.0;
+  M[0][1]=XBar;
+  M[0][2]=XBar*XBar;
+  M[0][3]=XBar*M[0][2];
+  if (NumOrders<2) return;
+
+  double OneOverL=1.0/L;
+  M[1][0]=0.0;
+  M[1][1]=OneOverL;
+  M[1][2]=2.0*XBar*OneOverL;
+  M[1][3]=3.0*M[0][2]*OneOverL;
+  if (NumOrders<3) return;
+
+  M[2][0]=M[2][1]=0.0;
+  M[2][2]=2.0*OneOverL*OneOverL;
+  M[2][3]=6.0*XBar*OneOverL*OneOverL;
+}
+
+/***************************************************************/
+/* Given the 16 coefficients C[4*p+q] of a bicubic polynomial  */
+/* in one grid cell, compute                                   */
+/*  Out[i*NumOrders + j] = sum_{pq} C[4p+q] M1[i][p] M2[j][q]  */
+/* for all i,j < NumOrders, i.e. the polynomial and all its    */
+/* partial derivatives up to order NumOrders-1 in each         */
+/* variable. The sums are done one dimension at a time (sum    */
+/* factorization), which takes fewer operations than dotting   */
+/* C with a separate monomial vector for each derivative and   */
+/* leaves short fixed-length loops that compilers vectorize.   */
+/***************************************************************/
+static inline void Contract2D(const double *C, double M1[3][4], double M2[3][4],
+                              int NumOrders, double *Out)
+{
+  double T[4][3];
+  for(int p=0; p<4; p++)
+   for(int j=0; j<NumOrders; j++)
+    T[p][j] =  C[4*p+0]*M2[j][0] + C[4*p+1]*M2[j][1]
+              +C[4*p+2]*M2[j][2] + C[4*p+3]*M2[j][3];
+
+  for(int i=0; i<NumOrders; i++)
+   for(int j=0; j<NumOrders; j++)
+    Out[i*NumOrders + j] =  M1[i][0]*T[0][j] + M1[i][1]*T[1][j]
+                           +M1[i][2]*T[2][j] + M1[i][3]*T[3][j];
+}
+
+/***************************************************************/
+/* like Contract2D, but for the 64 coefficients                */
+/* C[16*p + 4*q + r] of a tricubic polynomial:                 */
+/*  Out[(i*NumOrders + j)*NumOrders + k]                       */
+/*   = sum_{pqr} C[16p+4q+r] M1[i][p] M2[j][q] M3[k][r]        */
+/***************************************************************/
+static inline void Contract3D(const double *C, double M1[3][4], double M2[3][4],
+                              double M3[3][4], int NumOrders, double *Out)
+{
+  double T1[16][3];
+  for(int pq=0; pq<16; pq++)
+   for(int k=0; k<NumOrders; k++)
+    T1[pq][k] =  C[4*pq+0]*M3[k][0] + C[4*pq+1]*M3[k][1]
+                +C[4*pq+2]*M3[k][2] + C[4*pq+3]*M3[k][3];
+
+  double T2[4][3][3];
+  for(int p=0; p<4; p++)
+   for(int j=0; j<NumOrders; j++)
+    for(int k=0; k<NumOrders; k++)
+     T2[p][j][k] =  M2[j][0]*T1[4*p+0][k] + M2[j][1]*T1[4*p+1][k]
+                   +M2[j][2]*T1[4*p+2][k] + M2[j][3]*T1[4*p+3][k];
+
+  for(int i=0; i<NumOrders; i++)
+   for(int j=0; j<NumOrders; j++)
+    for(int k=0; k<NumOrders; k++)
+     Out[(i*NumOrders + j)*NumOrders + k]
+      =  M1[i][0]*T2[0][j][k] + M1[i][1]*T2[1][j][k]
+        +M1[i][2]*T2[2][j][k] + M1[i][3]*T2[3][j][k];
+}
+
+#endif // #ifndef INTERPKERNELS_H
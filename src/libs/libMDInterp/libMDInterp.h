@@ -35,6 +35,9 @@
 #define LMDI_LOGLEVEL_TERSE   1
 #define LMDI_LOGLEVEL_VERBOSE 2
 
+// alignment (in bytes) of the interpolation coefficient tables
+#define LMDI_CTABLE_ALIGNMENT 64
+
 /***************************************************************/
 /* prototype for a user-supplied function of one variable.     */
 /*                                                             */
@@ -222,6 +225,11 @@ class Interp1D
     void Evaluate(double X, double *Phi);
     double Evaluate(double X); // returns Phi[0]
 
+    /*--------------------------------------------------------------*/
+    /*- batch version: Phi[n*nFun + nf] = Phi_nf(X[n])              */
+    /*--------------------------------------------------------------*/
+    void Evaluate(int NumPoints, const double *X, double *Phi);
+
     /*--------------------------------------------------------------*/
     /*- class method that writes all internal data to a binary file */
     /*- that may be subsequently used to reconstruct the class     -*/
@@ -283,9 +291,11 @@ class Interp2D
 
     /*--------------------------------------------------------------*/
     /*- class constructor 3: construct from a data file previously  */
-    /*- generated by a call to WriteToFile()                        */
+    /*- generated by a call to WriteToFile(). if MapTable is true,  */
+    /*- the coefficient table is mapped from the file rather than   */
+    /*- read into memory.                                           */
     /*--------------------------------------------------------------*/
-    Interp2D(const char *FileName);
+    Interp2D(const char *FileName, bool MapTable=false);
 
     /*--------------------------------------------------------------*/
     /*- class destructor -------------------------------------------*/
@@ -300,6 +310,14 @@ class Interp2D
     void EvaluatePlus(double X1, double X2, double *Phi);
     void EvaluatePlusPlus(double X1, double X2, double *Phi);
 
+    /*--------------------------------------------------------------*/
+    /*- batch versions of the above for NumPoints points; the output*/
+    /*- for point #n follows that of point #n-1 in Phi              */
+    /*--------------------------------------------------------------*/
+    void Evaluate(int NumPoints, const double *X1, const double *X2, double *Phi);
+    void EvaluatePlus(int NumPoints, const double *X1, const double *X2, double *Phi);
+    void EvaluatePlusPlus(int NumPoints, const double *X1, const double *X2, double *Phi);
+
     /*--------------------------------------------------------------*/
     /*- class method that writes all internal data to a binary file */
     /*- that may be subsequently used to reconstruct the class     -*/
@@ -318,6 +336,8 @@ class Interp2D
     int LogLevel;
 
     double *CTable;
+    void *CTableMapping;      // nonzero if CTable is mapped from a file
+    size_t CTableMappingSize;
     
  };
 
@@ -364,9 +384,11 @@ class Interp3D
 
     /*--------------------------------------------------------------*/
     /*- class constructor 3: construct from a data file previously  */
-    /*- generated by a call to WriteToFile()                        */
+    /*- generated by a call to WriteToFile(). if MapTable is true,  */
+    /*- the coefficient table is mapped from the file rather than   */
+    /*- read into memory.                                           */
     /*--------------------------------------------------------------*/
-    Interp3D(const char *FileName);
+    Interp3D(const char *FileName, bool MapTable=false);
 
     /*--------------------------------------------------------------*/
     /*- class destructor -------------------------------------------*/
@@ -381,6 +403,17 @@ class Interp3D
     void EvaluatePlus(double X1, double X2, double X3, double *PhiVD);
     void EvaluatePlusPlus(double X1, double X2, double X3, double *PhiVD);
 
+    /*--------------------------------------------------------------*/
+    /*- batch versions of the above for NumPoints points; the output*/
+    /*- for point #n follows that of point #n-1 in Phi / PhiVD      */
+    /*--------------------------------------------------------------*/
+    void Evaluate(int NumPoints, const double *X1, const double *X2,
+                  const double *X3, double *Phi);
+    void EvaluatePlus(int NumPoints, const double *X1, const double *X2,
+                      const double *X3, double *PhiVD);
+    void EvaluatePlusPlus(int NumPoints, const double *X1, const double *X2,
+                          const double *X3, double *PhiVD);
+
     /*--------------------------------------------------------------*/
     /*- return true if point lies in the interior or on the boundary*/
     /*- of the interpolation grid; false otherwise.                 */
@@ -408,6 +441,8 @@ class Interp3D
     int LogLevel;
 
     double *CTable;
+    void *CTableMapping;      // nonzero if CTable is mapped from a file
+    size_t CTableMappingSize;
     
  };
 
@@ -469,6 +504,12 @@ class Interp4D
     /*--------------------------------------------------------------*/
     void Evaluate(double X1, double X2, double X3, double X4, double *Phi);
 
+    /*--------------------------------------------------------------*/
+    /*- batch version: Phi[n*nFun + nf] = Phi_nf(X1[n],...,X4[n])   */
+    /*--------------------------------------------------------------*/
+    void Evaluate(int NumPoints, const double *X1, const double *X2,
+                  const double *X3, const double *X4, double *Phi);
+
     /*--------------------------------------------------------------*/
     /*- class method that writes all internal data to a binary file */
     /*- that may be subsequently used to reconstruct the class     -*/
@@ -501,4 +542,24 @@ bool FindInterval(double X, double *XPoints, int N, double XMin, double DX,
 /***************************************************************/
 void freadEC(void *p, size_t size, size_t nmemb, FILE *f, const char *FileName); 
 
+/***************************************************************/
+/* allocate a zeroed, cache-line-aligned coefficient table     */
+/* (may be released with free())                               */
+/***************************************************************/
+double *AllocateCTable(size_t NumDoubles);
+
+/***************************************************************/
+/* reading and writing coefficient tables in the binary files  */
+/* written by the WriteToFile() class methods. the table is    */
+/* written at an offset from the start of the file that is a   */
+/* multiple of LMDI_CTABLE_ALIGNMENT, so that it may be mapped */
+/* into memory and used in place; in that case *pMapping and   */
+/* *pMappingSize describe the mapping on return, and the table */
+/* must be released with FreeCTable() rather than free().      */
+/***************************************************************/
+void WriteCTable(FILE *f, double *CTable, size_t NumDoubles);
+double *ReadCTable(FILE *f, const char *FileName, size_t NumDoubles,
+                   bool MapTable, void **pMapping, size_t *pMappingSize);
+void FreeCTable(double *CTable, void *Mapping, size_t MappingSize);
+
 #endif
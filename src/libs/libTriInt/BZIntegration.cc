@@ -155,6 +155,53 @@ int BZIntegrand_CCCubature(unsigned ndim, const double *u,
   return 0;
 }
 
+/***************************************************************/
+/* vectorized version of the above for CC cubature with        */
+/* Order>=0: the BZ samples handed to us in one batch are      */
+/* shared out over MPI ranks (if any), with Result[FDim] used  */
+/* to count the samples that actually called BZIFunc.          */
+/***************************************************************/
+typedef struct BZTaskData
+ { GetBZIArgStruct *Args;
+   unsigned ndim;
+   const double *u;
+ } BZTaskData;
+
+static void BZIntegrand_Task(void *UserData, int nTask, double *Result)
+{
+  BZTaskData *Data      = (BZTaskData *)UserData;
+  GetBZIArgStruct *Args = Data->Args;
+  int FDim              = Args->FDim;
+  int NumCalls          = Args->NumCalls;
+  BZIntegrand_CCCubature(Data->ndim, Data->u + nTask*Data->ndim,
+                         (void *)Args, FDim, Result);
+  Result[FDim] = (double)(Args->NumCalls - NumCalls);
+}
+
+int BZIntegrand_CCCubature_v(unsigned ndim, size_t npt, const double *u,
+                             void *pArgs, unsigned fdim, double *fval)
+{
+  GetBZIArgStruct *Args = (GetBZIArgStruct *)pArgs;
+
+  BZTaskData Data;
+  Data.Args = Args;
+  Data.ndim = ndim;
+  Data.u    = u;
+
+  int NumCalls    = Args->NumCalls;
+  double *Results = new double[npt*(fdim+1)];
+  DistributeTasks(BZIntegrand_Task, (void *)&Data, npt, fdim+1, Results);
+
+  for(size_t np=0; np<npt; np++)
+   { memcpy(fval + np*fdim, Results + np*(fdim+1), fdim*sizeof(double));
+     NumCalls += (int)Results[np*(fdim+1) + fdim];
+   };
+  Args->NumCalls = NumCalls;
+
+  delete[] Results;
+  return 0;
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
@@ -192,9 +239,14 @@ void GetBZIntegral_CC(GetBZIArgStruct *Args,
              Upper[0]=0.5; Upper[1]=(Order==0) ? 1.0 : 0.5;
              break;
    };
-  CCCubature(Order, FDim, BZIntegrand_CCCubature, (void *)Args, LDim,
-	     Lower, Upper, MaxEvals, AbsTol, RelTol,
-	     ERROR_INDIVIDUAL, BZIntegral, DataBuffer[0]);
+  if (Order<0)
+   CCCubature(Order, FDim, BZIntegrand_CCCubature, (void *)Args, LDim,
+	      Lower, Upper, MaxEvals, AbsTol, RelTol,
+	      ERROR_INDIVIDUAL, BZIntegral, DataBuffer[0]);
+  else
+   CCCubature_v(Order, FDim, BZIntegrand_CCCubature_v, (void *)Args, LDim,
+	        Lower, Upper, MaxEvals, AbsTol, RelTol,
+	        ERROR_INDIVIDUAL, BZIntegral, DataBuffer[0]);
   VecScale(BZIntegral, SymmetryFactor, FDim);
  
 }
@@ -93,6 +93,71 @@ int CCCubature(int Order, unsigned fdim, integrand f, void *fdata,
   return nCalls;
 }
 
+/***************************************************************/
+/* vectorized version of the above: the fixed-order rule is    */
+/* evaluated with a single call to f, which may then spread    */
+/* the points over threads or MPI ranks.                       */
+/***************************************************************/
+int CCCubature_v(int Order, unsigned fdim, integrand_v f, void *fdata,
+	         unsigned dim, const double *xmin, const double *xmax, 
+	         size_t maxEval, double reqAbsError, double reqRelError,
+                 error_norm norm, double *Integral, double *Error)
+{
+  if (Order==0)
+   return pcubature_v(fdim, f, fdata, dim, xmin, xmax, maxEval,
+                      reqAbsError, reqRelError, norm, Integral, Error);
+
+  if (Order<0)
+   ErrExit("%s:%i: CCCubature_v does not support RR cubature",__FILE__,__LINE__);
+
+  double *CCQR = GetCCRule(Order);
+  if (!CCQR) 
+   ErrExit("invalid CCRule order (%i) in CCCubature",Order);
+
+  if (dim>MAXDIM) 
+   ErrExit("dimension too high in CCCubature");
+
+  double uAvg[MAXDIM], uDelta[MAXDIM];
+  size_t NumPoints=1;
+  for(unsigned d=0; d<dim; d++)
+   { uAvg[d]   = 0.5*(xmax[d] + xmin[d]);
+     uDelta[d] = 0.5*(xmax[d] - xmin[d]);
+     NumPoints *= Order;
+   };
+
+  double *u = new double[NumPoints*dim];
+  double *w = new double[NumPoints];
+  int ncp[MAXDIM];
+  memset(ncp, 0, dim*sizeof(int));
+  for(size_t np=0; np<NumPoints; np++)
+   { 
+     w[np]=1.0;
+     for(unsigned nd=0; nd<dim; nd++)
+      { u[np*dim + nd] = uAvg[nd] - uDelta[nd]*CCQR[2*ncp[nd] + 0];
+        w[np]         *=            uDelta[nd]*CCQR[2*ncp[nd] + 1];
+      }; 
+
+     for(unsigned nd=0; nd<dim; nd++)
+      { ncp[nd] = (ncp[nd]+1)%Order;
+        if(ncp[nd]) break;
+      };
+   };
+
+  double *Integrand = new double[NumPoints*fdim];
+  f(dim, NumPoints, u, fdata, fdim, Integrand);
+
+  memset(Integral, 0, fdim*sizeof(double));
+  memset(Error, 0, fdim*sizeof(double));
+  for(size_t np=0; np<NumPoints; np++)
+   VecPlusEquals(Integral, w[np], Integrand + np*fdim, fdim);
+
+  delete[] Integrand;
+  delete[] w;
+  delete[] u;
+
+  return NumPoints;
+}
+
 
 /***************************************************************/
 /* embedded clenshaw-curtis cubature in two dimensions.        */
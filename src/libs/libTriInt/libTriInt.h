@@ -104,6 +104,13 @@ int CCCubature(int Order, unsigned fdim, integrand f, void *fdata,
 	       size_t maxEval, double reqAbsError, double reqRelError,
                error_norm norm, double *Integral, double *Error);
 
+// as CCCubature (Order >= 0), but with a vectorized integrand
+// that is handed all cubature points of a rule at once
+int CCCubature_v(int Order, unsigned fdim, integrand_v f, void *fdata,
+	         unsigned dim, const double *xmin, const double *xmax, 
+	         size_t maxEval, double reqAbsError, double reqRelError,
+                 error_norm norm, double *Integral, double *Error);
+
 int RRCubature(int Order, int *Orders, 
                int FDim, integrand f, void *UserData,
 	       int IDim, const double *Lower, const double *Upper,
@@ -62,6 +62,7 @@ HMatrix::HMatrix(HMatrix *M, bool takedatandownership) {
     InitHMatrix(M->NR, M->NC, M->RealComplex, M->StorageType);
     Copy(M);
   }
+  UseLDLT=M->UseLDLT;
 }
 
 /***************************************************************/
@@ -73,6 +74,7 @@ void HMatrix::InitHMatrix(int NRows, int NCols, int pRealComplex,
    RealComplex=pRealComplex;
    StorageType=pStorageType;
    ipiv=0;
+   UseLDLT=LDLFactored=false;
    lwork=0;
    work=0;
    liwork=0;
@@ -156,6 +158,7 @@ void HMatrix::ReadFromFile(const char *FileName, int FileType, const char *Optio
   DM=0;
   ZM=0;
   ipiv=0;
+  UseLDLT=LDLFactored=false;
   lwork=0;
   work=0;
   liwork=0;
@@ -202,6 +205,7 @@ HMatrix::HMatrix(SMatrix *S)
    RealComplex=S->RealComplex;
    StorageType=LHM_NORMAL;
    ipiv=0;
+   UseLDLT=LDLFactored=false;
    lwork=0;
    work=0;
    liwork=0;
@@ -152,6 +152,10 @@ int HMatrix::LUFactorize()
 { 
   int info;
 
+  if ( UseLDLT && StorageType==LHM_NORMAL )
+   return LDLFactorize();
+  LDLFactored=false;
+
   if (ipiv==0)
    ipiv=(int *)mallocEC(NR*sizeof(int));
 
@@ -169,6 +173,59 @@ int HMatrix::LUFactorize()
   return info;
 }
 
+/***************************************************************/
+/* forget any previous LU / LDL^T factorization; called when   */
+/* the matrix entries are about to be overwritten, so that     */
+/* Apply() and LUSolve() do not mistake freshly-assembled      */
+/* entries for factors.                                        */
+/***************************************************************/
+void HMatrix::ResetFactorization()
+{
+  LDLFactored=false;
+  if (ipiv) 
+   free(ipiv);
+  ipiv=0;
+}
+
+/***************************************************************/
+/* replace the (symmetric) matrix with its LDL^T factorization */
+/***************************************************************/
+int HMatrix::LDLFactorize()
+{ 
+  if ( StorageType!=LHM_NORMAL || NR!=NC )
+   ErrExit("%s:%i: LDLFactorize() requires a square matrix in normal storage",__FILE__,__LINE__);
+
+  if (ipiv==0)
+   ipiv=(int *)mallocEC(NR*sizeof(int));
+
+  // workspace size query
+  int info, MinusOne=-1, lworkOptimal;
+  if ( RealComplex==LHM_REAL )
+   { double dlworkOptimal;
+     dsytrf_("U", &NR, DM, &NR, ipiv, &dlworkOptimal, &MinusOne, &info);
+     lworkOptimal=(int)dlworkOptimal;
+   }
+  else
+   { cdouble zlworkOptimal;
+     zsytrf_("U", &NR, ZM, &NR, ipiv, &zlworkOptimal, &MinusOne, &info);
+     lworkOptimal=(int)real(zlworkOptimal);
+   };
+
+  if (lworkOptimal > lwork)
+   { if (work) free(work);
+     work=mallocEC(lworkOptimal*(RealComplex==LHM_REAL ? sizeof(double) : sizeof(cdouble)));
+     lwork=lworkOptimal;
+   };
+
+  if ( RealComplex==LHM_REAL )
+   dsytrf_("U", &NR, DM, &NR, ipiv, (double *)work, &lwork, &info);
+  else
+   zsytrf_("U", &NR, ZM, &NR, ipiv, (cdouble *)work, &lwork, &info);
+
+  LDLFactored=true;
+  return info;
+}
+
 /***************************************************************/
 /* solve linear system using LU factorization ******************/
 /***************************************************************/
@@ -185,7 +242,11 @@ int HMatrix::LUSolve(HVector *X)
   if (ipiv==0)  
    ErrExit("LUFactorize() must be called before LUSolve()");
 
-  if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
+  if ( LDLFactored && RealComplex==LHM_REAL )
+   dsytrs_("U", &NR, &iOne, DM, &NR, ipiv, X->DV, &NR, &info);
+  else if ( LDLFactored && RealComplex==LHM_COMPLEX )
+   zsytrs_("U", &NR, &iOne, ZM, &NR, ipiv, X->ZV, &NR, &info);
+  else if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
    dgetrs_("N", &NR, &iOne, DM, &NR, ipiv, X->DV, &NR, &info);
   else if ( RealComplex==LHM_REAL && StorageType==LHM_SYMMETRIC )
    dsptrs_("U", &NR, &iOne, DM, ipiv, X->DV, &NR, &info);
@@ -219,7 +280,24 @@ int HMatrix::LUSolve(HMatrix *X, char Trans, int nrhs)
    ErrExit("LUFactorize() must be called before LUSolve()");
   if ( Trans!='N' && StorageType!=LHM_NORMAL )
    ErrExit("transposed LU-solves not available for packed matrices");
-if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
+
+  /*--------------------------------------------------------------*/
+  /*- for symmetric A we have A^T = A and A^H = A^*, so we solve  */
+  /*- A^H X = B as A X^* = B^*                                    */
+  /*--------------------------------------------------------------*/
+  if ( LDLFactored )
+   { bool Conjugate = (Trans=='C' && RealComplex==LHM_COMPLEX);
+     size_t NX = ((size_t)NR)*nrhs;
+     if (Conjugate)
+      for(size_t n=0; n<NX; n++) X->ZM[n]=conj(X->ZM[n]);
+     if ( RealComplex==LHM_REAL )
+      dsytrs_("U", &NR, &nrhs, DM, &NR, ipiv, X->DM, &NR, &info);
+     else
+      zsytrs_("U", &NR, &nrhs, ZM, &NR, ipiv, X->ZM, &NR, &info);
+     if (Conjugate)
+      for(size_t n=0; n<NX; n++) X->ZM[n]=conj(X->ZM[n]);
+   }
+  else if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
    dgetrs_(&Trans, &NR, &nrhs, DM, &NR, ipiv, X->DM, &NR, &info);
   else if ( RealComplex==LHM_REAL && StorageType==LHM_SYMMETRIC )
    dsptrs_("U", &NR, &nrhs, DM, ipiv, X->DM, &NR, &info);
@@ -264,7 +342,30 @@ int HMatrix::LUInvert()
    ErrExit("LUFactorize() must be called before LUInvert()");
 
   int MinusOne=-1;
-  if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
+  if ( LDLFactored )
+   { 
+     // xsytri only fills in the upper triangle of the inverse
+     lworkOptimal = (RealComplex==LHM_REAL) ? NR : 2*NR;
+     if (lworkOptimal > lwork)
+      { if (work) free(work);
+        work=mallocEC(lworkOptimal*(RealComplex==LHM_REAL ? sizeof(double) : sizeof(cdouble)));
+        lwork=lworkOptimal;
+      };
+
+     if ( RealComplex==LHM_REAL )
+      { dsytri_("U", &NR, DM, &NR, ipiv, (double *)work, &info);
+        for(int nc=0; nc<NC; nc++)
+         for(int nr=nc+1; nr<NR; nr++)
+          DM[nr + ((size_t)nc)*NR] = DM[nc + ((size_t)nr)*NR];
+      }
+     else
+      { zsytri_("U", &NR, ZM, &NR, ipiv, (cdouble *)work, &info);
+        for(int nc=0; nc<NC; nc++)
+         for(int nr=nc+1; nr<NR; nr++)
+          ZM[nr + ((size_t)nc)*NR] = ZM[nc + ((size_t)nr)*NR];
+      };
+   }
+  else if ( RealComplex==LHM_REAL && StorageType==LHM_NORMAL )
    {
      // workspace size query
      dgetri_(&NR, DM, &NR, ipiv, &dlworkOptimal, &MinusOne, &info);
@@ -334,6 +435,48 @@ int HMatrix::LUInvert()
   return info;
 }
 
+/***************************************************************/
+/* log of the determinant of the matrix from its LU or LDL^T    */
+/* factorization. for LU factorizations the determinant is the */
+/* product of the diagonal of U times the sign of the row      */
+/* permutation. for the symmetric and hermitian factorizations */
+/* it is the product of the determinants of the 1x1 and 2x2    */
+/* diagonal blocks of D (in the 'U' convention, a 2x2 block    */
+/* occupies rows k, k+1 if ipiv[k]=ipiv[k+1]<0).               */
+/***************************************************************/
+cdouble HMatrix::GetLogDeterminant()
+{ 
+  if ( NR!=NC )
+   ErrExit("%s:%i: determinant of non-square matrix",__FILE__,__LINE__);
+  if (ipiv==0)
+   ErrExit("LUFactorize() must be called before GetLogDeterminant()");
+
+  cdouble LogDet=0.0;
+  if ( StorageType==LHM_NORMAL && !LDLFactored )
+   { for(int n=0; n<NR; n++)
+      { LogDet += log( cdouble(GetEntry(n,n)) );
+        if ( ipiv[n] != n+1 )
+         LogDet += cdouble(0.0,M_PI);
+      };
+   }
+  else
+   { for(int n=0; n<NR; n++)
+      { if ( ipiv[n]>0 )
+         LogDet += log( cdouble(GetEntry(n,n)) );
+        else
+         { cdouble D01=GetEntry(n,n+1);
+           cdouble D01D10 = (StorageType==LHM_HERMITIAN) ? norm(D01) : D01*D01;
+           LogDet += log( GetEntry(n,n)*GetEntry(n+1,n+1) - D01D10 );
+           n++;
+         };
+      };
+   };
+
+  // put the phase in (-pi, pi]
+  double Phase = remainder(imag(LogDet), 2.0*M_PI);
+  return cdouble(real(LogDet), Phase);
+}
+
 /***************************************************************/
 /* replace the matrix with its cholesky factorization **********/
 /***************************************************************/
@@ -995,7 +1138,24 @@ void HMatrix::Apply(HVector *X, HVector *Y, char TransChar)
   double dOne=1.0, dZero=0.0;
   cdouble zOne=1.0, zZero=0.0;
 
-  if (RealComplex==LHM_REAL)
+  if (UseLDLT && !LDLFactored)
+   { // symmetric matrix with only the upper triangle filled in;
+     // A^T = A and A^H X = (A X^*)^*
+     bool Conjugate = (Trans[0]=='C' && RealComplex==LHM_COMPLEX);
+     if (RealComplex==LHM_REAL)
+      dsymv_("U", &NR, &dOne, DM, &NR, X->DV, &IncX, &dZero, Y->DV, &IncY);
+     else
+      { if (Conjugate)
+         for(int n=0; n<NR; n++) X->ZV[n]=conj(X->ZV[n]);
+        zsymv_("U", &NR, &zOne, ZM, &NR, X->ZV, &IncX, &zZero, Y->ZV, &IncY);
+        if (Conjugate)
+         for(int n=0; n<NR; n++) 
+          { X->ZV[n]=conj(X->ZV[n]);
+            Y->ZV[n]=conj(Y->ZV[n]);
+          };
+      };
+   }
+  else if (RealComplex==LHM_REAL)
    dgemv_(Trans, &NR, &NC, &dOne, DM, &NR, X->DV, &IncX, &dZero, Y->DV, &IncY);
   else 
    zgemv_(Trans, &NR, &NC, &zOne, ZM, &NR, X->ZV, &IncX, &zZero, Y->ZV, &IncY);
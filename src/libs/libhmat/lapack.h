@@ -5140,6 +5140,10 @@ void dgemv_(const char *TRANS, int *M, int *N, double *Alpha,
             double *A, int *lda, double *X, int *incx, double *beta,
             double *Y, int *incy);
 
+void dsymv_(const char *UPLO, int *N, double *Alpha,
+            double *A, int *lda, double *X, int *incx, double *beta,
+            double *Y, int *incy);
+
 void zgemm_(const char *TRANSA, const char *TRANSB, int *M, int *N, int *K,
             cdouble *ALPHA, cdouble *A, int *LDA, cdouble *B, int *LDB,
             cdouble *BETA, cdouble *C, int *LDC);
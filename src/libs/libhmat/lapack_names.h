@@ -1227,6 +1227,7 @@
 #define zupmtr_ F77_FUNC(zupmtr,ZUPMTR)
 #define dgemm_ F77_FUNC(dgemm,DGEMM)
 #define dgemv_ F77_FUNC(dgemv,DGEMV)
+#define dsymv_ F77_FUNC(dsymv,DSYMV)
 #define zgemm_ F77_FUNC(zgemm,ZGEMM)
 #define zgemv_ F77_FUNC(zgemv,ZGEMV)
 #endif
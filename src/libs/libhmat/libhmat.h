@@ -298,6 +298,21 @@ class HMatrix
    int LUSolve(HMatrix *X, char Trans, int nrhs);
    int LUInvert();
 
+   /* routine for LDL^T-factorizing a symmetric (not hermitian) */
+   /* matrix in normal storage by blocked Bunch-Kaufman pivoting */
+   /* (xsytrf); only the upper triangle is referenced. after    */
+   /* this, LUSolve() and LUInvert() may be used as usual.      */
+   /* LUFactorize() calls this routine if UseLDLT is true.      */
+   int LDLFactorize();
+
+   /* discard the pivot state and LDLFactored flag of a previous */
+   /* factorization before re-filling the matrix                 */
+   void ResetFactorization();
+
+   /* log of the determinant (the imaginary part is the phase),  */
+   /* assuming LUFactorize() or LDLFactorize() has been called   */
+   cdouble GetLogDeterminant();
+
    /* routines for cholesky-factorizing, solving, inverting */
    /* (xpotrf, xpotrs, xpotri) */
    int CholFactorize();
@@ -336,6 +351,13 @@ class HMatrix
    int StorageType;
    int *ipiv;
 
+   // if UseLDLT is true, the matrix (which must have normal storage)
+   // is taken to be symmetric, only its upper triangle need be filled
+   // in, and LUFactorize() and Apply() use symmetric LAPACK/BLAS
+   // routines. LDLFactored is set by LDLFactorize().
+   bool UseLDLT;
+   bool LDLFactored;
+
    // pointers to the actual data storage. only one of these is 
    // used in a given instance so if i wanted to save 8 bytes i 
    // could put them into a union
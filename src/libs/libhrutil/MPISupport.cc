@@ -0,0 +1,392 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * MPISupport.cc -- optional distributed-memory parallelism: a
+ *               -- dynamically load-balanced pool of tasks shared
+ *               -- by all MPI ranks, with any output written by
+ *               -- a task forwarded to the root rank and appended
+ *               -- to its file in task order
+ *
+ * Without MPI (or when running on a single rank) everything here
+ * reduces to a plain loop over tasks and plain fopen/fclose.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef HAVE_MPI
+#  include <mpi.h>
+#endif
+
+#include "libhrutil.h"
+
+#define MAXSTR 1000
+#define TASKOUTPUT_TAG 4242
+
+static int MPIRank=0;
+static int MPISize=1;
+#ifdef HAVE_MPI
+static bool MPIActive=false;
+#endif
+
+// index of the task currently being evaluated on this rank, or
+// -1 if we are not inside DistributeTasks
+static int CurrentTask=-1;
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void InitMPI(int *argc, char ***argv)
+{
+#ifdef HAVE_MPI
+  // MPI is only ever called from the master thread; OpenMP
+  // threads inside tasks never touch it
+  int Provided;
+  MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &Provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &MPIRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &MPISize);
+  MPIActive=true;
+#else
+  (void) argc;
+  (void) argv;
+#endif
+}
+
+void FinalizeMPI()
+{
+#ifdef HAVE_MPI
+  if (MPIActive)
+   { MPI_Finalize();
+     MPIActive=false;
+   };
+#endif
+}
+
+int GetMPIRank() { return MPIRank; }
+int GetMPISize() { return MPISize; }
+
+/***************************************************************/
+/* output produced by tasks is captured in temporary streams;  */
+/* when a stream is closed its contents are appended to the    */
+/* list of records for the current task.                       */
+/***************************************************************/
+typedef struct TaskStream
+ { FILE *f;
+   char *FileName;
+ } TaskStream;
+
+static TaskStream *TaskStreams=0;
+static int NumTaskStreams=0;
+
+// records for the current task, packed as a sequence of
+//  [int NameLength][FileName][size_t Size][Size bytes]
+static char *TaskOutput=0;
+static size_t TaskOutputSize=0;
+static int NumTaskRecords=0;
+
+static void AppendRecord(const char *FileName, const char *Data, size_t Size)
+{
+  int NameLength = strlen(FileName) + 1;
+  size_t RecordSize = sizeof(int) + NameLength + sizeof(size_t) + Size;
+  TaskOutput = (char *)reallocEC(TaskOutput, TaskOutputSize + RecordSize);
+  char *p = TaskOutput + TaskOutputSize;
+  memcpy(p, &NameLength, sizeof(int));    p+=sizeof(int);
+  memcpy(p, FileName, NameLength);        p+=NameLength;
+  memcpy(p, &Size, sizeof(size_t));       p+=sizeof(size_t);
+  if (Size) memcpy(p, Data, Size);
+  TaskOutputSize += RecordSize;
+  NumTaskRecords++;
+}
+
+/***************************************************************/
+/* open FileName for appending. inside DistributeTasks on more */
+/* than one rank, the returned stream is a temporary stream    */
+/* whose contents are written to FileName on the root rank     */
+/* (in task order) once CloseOutputFile is called; outside     */
+/* DistributeTasks only the root rank writes anything.         */
+/***************************************************************/
+FILE *OpenOutputFile(const char *format, ...)
+{
+  va_list ap;
+  char FileName[MAXSTR];
+  va_start(ap,format);
+  vsnprintfEC(FileName,MAXSTR,format,ap);
+  va_end(ap);
+
+  if (MPISize==1)
+   return fopen(FileName,"a");
+
+  if (CurrentTask==-1)
+   return (MPIRank==0) ? fopen(FileName,"a") : tmpfile();
+
+  FILE *f=tmpfile();
+  if (f==0)
+   ErrExit("could not create temporary stream for %s",FileName);
+  TaskStreams=(TaskStream *)reallocEC(TaskStreams, (NumTaskStreams+1)*sizeof(TaskStream));
+  TaskStreams[NumTaskStreams].f=f;
+  TaskStreams[NumTaskStreams].FileName=strdupEC(FileName);
+  NumTaskStreams++;
+  return f;
+}
+
+void CloseOutputFile(FILE *f)
+{
+  if (f==0) return;
+
+  int nts;
+  for(nts=0; nts<NumTaskStreams; nts++)
+   if (TaskStreams[nts].f==f)
+    break;
+  if (nts==NumTaskStreams)
+   { fclose(f);
+     return;
+   };
+
+  fflush(f);
+  long Size=ftell(f);
+  char *Data = (Size>0) ? (char *)mallocEC(Size) : 0;
+  rewind(f);
+  if ( Size>0 && fread(Data, 1, Size, f) != (size_t)Size )
+   ErrExit("%s:%i: error reading temporary output stream",__FILE__,__LINE__);
+  fclose(f);
+
+  AppendRecord(TaskStreams[nts].FileName, Data, Size>0 ? Size : 0);
+  if (Data) free(Data);
+  free(TaskStreams[nts].FileName);
+  TaskStreams[nts]=TaskStreams[--NumTaskStreams];
+}
+
+#ifdef HAVE_MPI
+/***************************************************************/
+/* append all records in a packed task-output buffer to their  */
+/* files (root rank only)                                      */
+/***************************************************************/
+static void WriteTaskOutput(char *Buffer)
+{
+  int NumRecords;
+  char *p=Buffer;
+  memcpy(&NumRecords, p, sizeof(int)); p+=sizeof(int);
+  for(int nr=0; nr<NumRecords; nr++)
+   { int NameLength;
+     size_t Size;
+     memcpy(&NameLength, p, sizeof(int)); p+=sizeof(int);
+     char *FileName=p;                    p+=NameLength;
+     memcpy(&Size, p, sizeof(size_t));    p+=sizeof(size_t);
+     if (Size>0)
+      { FILE *f=fopen(FileName,"a");
+        if (!f)
+         ErrExit("could not open file %s",FileName);
+        fwrite(p, 1, Size, f);
+        fclose(f);
+      };
+     p+=Size;
+   };
+}
+
+/***************************************************************/
+/* write the output of all tasks, in order, up to the first    */
+/* one that is still outstanding                               */
+/***************************************************************/
+static void FlushTaskOutput(char **Pending, int NumTasks, int *pNextToWrite)
+{
+  int NextToWrite=*pNextToWrite;
+  for(; NextToWrite<NumTasks && Pending[NextToWrite]; NextToWrite++)
+   { WriteTaskOutput(Pending[NextToWrite] + sizeof(int));
+     free(Pending[NextToWrite]);
+     Pending[NextToWrite]=0;
+   };
+  *pNextToWrite=NextToWrite;
+}
+
+/***************************************************************/
+/* package the records of the task that just finished as       */
+/*  [int nTask][int NumRecords][records...]                    */
+/***************************************************************/
+static char *PackTaskOutput(int nTask, int *pSize)
+{
+  int Size = 2*sizeof(int) + TaskOutputSize;
+  char *Buffer = (char *)mallocEC(Size);
+  memcpy(Buffer, &nTask, sizeof(int));
+  memcpy(Buffer + sizeof(int), &NumTaskRecords, sizeof(int));
+  if (TaskOutputSize)
+   memcpy(Buffer + 2*sizeof(int), TaskOutput, TaskOutputSize);
+  free(TaskOutput);
+  TaskOutput=0;
+  TaskOutputSize=0;
+  NumTaskRecords=0;
+  *pSize=Size;
+  return Buffer;
+}
+
+/***************************************************************/
+/* the task counter lives in an RMA window on the root rank;   */
+/* each rank grabs the next task with an atomic fetch-and-add, */
+/* so expensive tasks never hold up cheap ones.                */
+/***************************************************************/
+static int FetchNextTask(MPI_Win Win)
+{
+  int One=1, nTask;
+  MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, Win);
+  MPI_Fetch_and_op(&One, &nTask, MPI_INT, 0, 0, MPI_SUM, Win);
+  MPI_Win_unlock(0, Win);
+  return nTask;
+}
+
+/***************************************************************/
+/* root rank: receive output from finished tasks, blocking     */
+/* until at least one message arrives if Wait==true            */
+/***************************************************************/
+static void ReceiveTaskOutput(char **Pending, bool Wait)
+{
+  for(;;)
+   { int Flag=1;
+     MPI_Status Status;
+     if (Wait)
+      MPI_Probe(MPI_ANY_SOURCE, TASKOUTPUT_TAG, MPI_COMM_WORLD, &Status);
+     else
+      MPI_Iprobe(MPI_ANY_SOURCE, TASKOUTPUT_TAG, MPI_COMM_WORLD, &Flag, &Status);
+     if (!Flag)
+      return;
+
+     int Size;
+     MPI_Get_count(&Status, MPI_BYTE, &Size);
+     char *Buffer=(char *)mallocEC(Size);
+     MPI_Recv(Buffer, Size, MPI_BYTE, Status.MPI_SOURCE, TASKOUTPUT_TAG,
+              MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+     int nTask;
+     memcpy(&nTask, Buffer, sizeof(int));
+     Pending[nTask]=Buffer;
+     Wait=false;
+   };
+}
+#endif // HAVE_MPI
+
+/***************************************************************/
+/* evaluate Task(UserData, nTask, Results + nTask*ResultSize)  */
+/* for nTask=0..NumTasks-1. Under MPI the tasks are shared out */
+/* dynamically among all ranks, which must all call this       */
+/* routine with the same arguments; on return every rank holds */
+/* the full Results array.                                     */
+/*                                                             */
+/* a single task, or a call made from inside another task, is  */
+/* simply evaluated locally, so that a caller evaluating one   */
+/* point at a time can leave it to nested routines to spread   */
+/* their own work over the ranks.                              */
+/***************************************************************/
+void DistributeTasks(TaskFunction Task, void *UserData, int NumTasks,
+                     int ResultSize, double *Results)
+{
+  if (MPISize==1 || CurrentTask!=-1 || NumTasks<=1)
+   { for(int nTask=0; nTask<NumTasks; nTask++)
+      Task(UserData, nTask, Results ? Results + nTask*ResultSize : 0);
+     return;
+   };
+
+#ifdef HAVE_MPI
+  if (Results)
+   memset(Results, 0, NumTasks*ResultSize*sizeof(double));
+
+  /*--------------------------------------------------------------*/
+  /*- create and zero the shared task counter ---------------------*/
+  /*--------------------------------------------------------------*/
+  int *Counter;
+  MPI_Win Win;
+  MPI_Win_allocate( (MPIRank==0 ? sizeof(int) : 0), sizeof(int),
+                    MPI_INFO_NULL, MPI_COMM_WORLD, &Counter, &Win);
+  if (MPIRank==0)
+   { MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, Win);
+     *Counter=0;
+     MPI_Win_unlock(0, Win);
+   };
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  /*--------------------------------------------------------------*/
+  /*- the root rank keeps the output of finished tasks until all  */
+  /*- earlier tasks have finished too                             */
+  /*--------------------------------------------------------------*/
+  char **Pending=0;
+  int NextToWrite=0;
+  if (MPIRank==0)
+   { Pending=(char **)mallocEC(NumTasks*sizeof(char *));
+     memset(Pending, 0, NumTasks*sizeof(char *));
+   };
+  MPI_Request *Requests=0;
+  char **SendBuffers=0;
+  int NumSent=0, NumDone=0;
+
+  int nTask;
+  while( (nTask=FetchNextTask(Win)) < NumTasks )
+   {
+     CurrentTask=nTask;
+     Task(UserData, nTask, Results ? Results + nTask*ResultSize : 0);
+     CurrentTask=-1;
+     NumDone++;
+
+     int Size;
+     char *Buffer=PackTaskOutput(nTask, &Size);
+     if (MPIRank==0)
+      { Pending[nTask]=Buffer;
+        ReceiveTaskOutput(Pending, false);
+        FlushTaskOutput(Pending, NumTasks, &NextToWrite);
+      }
+     else
+      { Requests=(MPI_Request *)reallocEC(Requests, (NumSent+1)*sizeof(MPI_Request));
+        SendBuffers=(char **)reallocEC(SendBuffers, (NumSent+1)*sizeof(char *));
+        SendBuffers[NumSent]=Buffer;
+        MPI_Isend(Buffer, Size, MPI_BYTE, 0, TASKOUTPUT_TAG, MPI_COMM_WORLD,
+                  Requests + NumSent);
+        NumSent++;
+      };
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- root collects and writes everything still outstanding;     -*/
+  /*- the other ranks wait for their sends to complete            */
+  /*--------------------------------------------------------------*/
+  if (MPIRank==0)
+   { while(NextToWrite<NumTasks)
+      { if (Pending[NextToWrite]==0)
+         ReceiveTaskOutput(Pending, true);
+        FlushTaskOutput(Pending, NumTasks, &NextToWrite);
+      };
+     free(Pending);
+   }
+  else if (NumSent>0)
+   { MPI_Waitall(NumSent, Requests, MPI_STATUSES_IGNORE);
+     for(int ns=0; ns<NumSent; ns++)
+      free(SendBuffers[ns]);
+     free(Requests);
+     free(SendBuffers);
+   };
+
+  MPI_Win_free(&Win);
+
+  if (Results)
+   MPI_Allreduce(MPI_IN_PLACE, Results, NumTasks*ResultSize,
+                 MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  Log("evaluated %i of %i distributed tasks on rank %i",NumDone,NumTasks,MPIRank);
+#endif // HAVE_MPI
+}
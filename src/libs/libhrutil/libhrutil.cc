@@ -426,7 +426,11 @@ void SetLogFileName(const char *format, ...)
   va_start(ap,format);
   vsnprintfEC(buffer,MAXSTR,format,ap);
   if (LogFileName) free(LogFileName);
-  LogFileName=strdupEC(buffer);
+  // each MPI rank other than the root gets its own log file
+  if (GetMPIRank()>0)
+   LogFileName=vstrdup("%s.rank%i",buffer,GetMPIRank());
+  else
+   LogFileName=strdupEC(buffer);
   va_end(ap);
 }
 
@@ -110,6 +110,23 @@ unsigned long GetMemoryUsage(unsigned long *MemoryUsage=0);
 void SetCPUAffinity(int WhichProcessor);
 void EnableAllCPUs();
 
+/***************************************************************/
+/* distributed-memory parallelism over MPI ranks. these are    */
+/* trivial unless SCUFF-EM was configured --with-mpi and the   */
+/* code is running on more than one rank.                      */
+/***************************************************************/
+void InitMPI(int *argc, char ***argv);
+void FinalizeMPI();
+int GetMPIRank();
+int GetMPISize();
+
+typedef void (*TaskFunction)(void *UserData, int nTask, double *Result);
+void DistributeTasks(TaskFunction Task, void *UserData, int NumTasks,
+                     int ResultSize=0, double *Results=0);
+
+FILE *OpenOutputFile(const char *format, ...);
+void CloseOutputFile(FILE *f);
+
 /***************************************************************/
 /* complex arithmetic ******************************************/
 /***************************************************************/
@@ -0,0 +1,719 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * ACAMatrix.cc  -- compressed (hierarchical) storage of the BEM matrix
+ *               -- in which well-separated blocks are approximated by
+ *               -- low-rank factors obtained via adaptive cross
+ *               -- approximation with partial pivoting. Matrix entries
+ *               -- are sampled on demand via GetEdgeEdgeInteractions().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include <libhrutil.h>
+#include <libhmat.h>
+
+#include "libscuff.h"
+#include "libscuffInternals.h"
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef USE_OPENMP
+#  include <omp.h>
+#endif
+
+#define II cdouble(0,1)
+
+namespace scuff {
+
+/***************************************************************/
+/* ACAWorkspace holds everything needed to compute individual  */
+/* BEM matrix entries for a single pair of surfaces; the       */
+/* prefactors are the same as those in GSSIThread().           */
+/***************************************************************/
+typedef struct ACAWorkspace
+ {
+   GetEEIArgStruct EEIArgs;
+   bool SaIsPEC, SbIsPEC;
+   cdouble kA, PreFac1A, PreFac2A, PreFac3A;
+   cdouble kB, PreFac1B, PreFac2B, PreFac3B;
+   bool HaveA, HaveB;
+ } ACAWorkspace;
+
+static void InitACAWorkspace(ACAWorkspace *W, RWGGeometry *G,
+                             int nsa, int nsb, cdouble Omega)
+{
+  RWGSurface *Sa=G->Surfaces[nsa];
+  RWGSurface *Sb=G->Surfaces[nsb];
+
+  InitGetEEIArgs(&(W->EEIArgs));
+  W->EEIArgs.Sa=Sa;
+  W->EEIArgs.Sb=Sb;
+
+  W->SaIsPEC = (Sa->IsPEC==1);
+  W->SbIsPEC = (Sb->IsPEC==1);
+
+  double Signs[2];
+  int CommonRegions[2];
+  int NumCommonRegions=CountCommonRegions(Sa, Sb, CommonRegions, Signs);
+
+  W->HaveA = W->HaveB = false;
+  if (NumCommonRegions>=1)
+   { cdouble EpsA = G->EpsTF[ CommonRegions[0] ];
+     cdouble MuA  = G->MuTF[ CommonRegions[0] ];
+     W->HaveA     = (EpsA!=0.0);
+     W->kA        = csqrt2(EpsA*MuA)*Omega;
+     W->PreFac1A  =  Signs[0]*II*MuA*Omega;
+     W->PreFac2A  = -Signs[0]*II*W->kA;
+     W->PreFac3A  = -Signs[0]*II*EpsA*Omega;
+   };
+  if (NumCommonRegions==2)
+   { cdouble EpsB = G->EpsTF[ CommonRegions[1] ];
+     cdouble MuB  = G->MuTF[ CommonRegions[1] ];
+     W->HaveB     = (EpsB!=0.0);
+     W->kB        = csqrt2(EpsB*MuB)*Omega;
+     W->PreFac1B  =  Signs[1]*II*MuB*Omega;
+     W->PreFac2B  = -Signs[1]*II*W->kB;
+     W->PreFac3B  = -Signs[1]*II*EpsB*Omega;
+   };
+}
+
+/***************************************************************/
+/* get the (up to) 2x2 block of BEM matrix entries describing  */
+/* the interaction of edge nea on Sa with edge neb on Sb.      */
+/* E[a][b] is the entry for the a-th basis function on edge    */
+/* nea (a=0,1 for K,N) and the b-th basis function on neb.     */
+/***************************************************************/
+static void GetEdgePairEntries(ACAWorkspace *W, int nea, int neb,
+                               cdouble E[2][2])
+{
+  E[0][0]=E[0][1]=E[1][0]=E[1][1]=0.0;
+
+  GetEEIArgStruct *EEIArgs=&(W->EEIArgs);
+  cdouble *GC=EEIArgs->GC;
+  EEIArgs->nea=nea;
+  EEIArgs->neb=neb;
+
+  if (W->HaveA)
+   { EEIArgs->k = W->kA;
+     GetEdgeEdgeInteractions(EEIArgs);
+     E[0][0] += W->PreFac1A*GC[0];
+     if ( !W->SbIsPEC )
+      E[0][1] += W->PreFac2A*GC[1];
+     if ( !W->SaIsPEC )
+      E[1][0] += W->PreFac2A*GC[1];
+     if ( !W->SaIsPEC && !W->SbIsPEC )
+      E[1][1] += W->PreFac3A*GC[0];
+   };
+
+  if (W->HaveB)
+   { EEIArgs->k = W->kB;
+     GetEdgeEdgeInteractions(EEIArgs);
+     E[0][0] += W->PreFac1B*GC[0];
+     E[0][1] += W->PreFac2B*GC[1];
+     E[1][0] += W->PreFac2B*GC[1];
+     E[1][1] += W->PreFac3B*GC[0];
+   };
+}
+
+/***************************************************************/
+/* fill in Row[0..NC-1] with the entries of the block in row   */
+/* nr (a basis function in CA) and the columns of CB.          */
+/***************************************************************/
+static void GetBlockRow(ACAWorkspace *W, ACACluster *CA, int nr,
+                        ACACluster *CB, cdouble *Row)
+{
+  int MultA = (CA->NumBFs / CA->NumEdges);
+  int MultB = (CB->NumBFs / CB->NumEdges);
+  int nea   = CA->EdgeIndices[nr / MultA];
+  int a     = nr % MultA;
+  cdouble E[2][2];
+  for(int nEdge=0; nEdge<CB->NumEdges; nEdge++)
+   { GetEdgePairEntries(W, nea, CB->EdgeIndices[nEdge], E);
+     for(int b=0; b<MultB; b++)
+      Row[MultB*nEdge + b] = E[a][b];
+   };
+}
+
+static void GetBlockColumn(ACAWorkspace *W, ACACluster *CA,
+                           ACACluster *CB, int nc, cdouble *Col)
+{
+  int MultA = (CA->NumBFs / CA->NumEdges);
+  int MultB = (CB->NumBFs / CB->NumEdges);
+  int neb   = CB->EdgeIndices[nc / MultB];
+  int b     = nc % MultB;
+  cdouble E[2][2];
+  for(int nEdge=0; nEdge<CA->NumEdges; nEdge++)
+   { GetEdgePairEntries(W, CA->EdgeIndices[nEdge], neb, E);
+     for(int a=0; a<MultA; a++)
+      Col[MultA*nEdge + a] = E[a][b];
+   };
+}
+
+/***************************************************************/
+/* compute all entries of a block directly                     */
+/***************************************************************/
+static void GetDenseBlock(ACAWorkspace *W, ACABlock *B)
+{
+  ACACluster *CA=B->CA, *CB=B->CB;
+  int MultA = (CA->NumBFs / CA->NumEdges);
+  int MultB = (CB->NumBFs / CB->NumEdges);
+  bool SameCluster = (CA==CB);
+
+  B->D = new HMatrix(CA->NumBFs, CB->NumBFs, LHM_COMPLEX);
+  cdouble E[2][2];
+  for(int nEdgeA=0; nEdgeA<CA->NumEdges; nEdgeA++)
+   for(int nEdgeB=(SameCluster ? nEdgeA : 0); nEdgeB<CB->NumEdges; nEdgeB++)
+    {
+      GetEdgePairEntries(W, CA->EdgeIndices[nEdgeA], CB->EdgeIndices[nEdgeB], E);
+      for(int a=0; a<MultA; a++)
+       for(int b=0; b<MultB; b++)
+        { B->D->SetEntry(MultA*nEdgeA + a, MultB*nEdgeB + b, E[a][b]);
+          if (SameCluster)
+           B->D->SetEntry(MultB*nEdgeB + b, MultA*nEdgeA + a, E[a][b]);
+        };
+    };
+  B->Rank=-1;
+}
+
+/***************************************************************/
+/* adaptive cross approximation with partial pivoting.         */
+/* returns false if the block could not be compressed to the   */
+/* requested tolerance with a rank small enough to save memory.*/
+/***************************************************************/
+static bool GetLowRankBlock(ACAWorkspace *W, ACABlock *B, double Tolerance)
+{
+  ACACluster *CA=B->CA, *CB=B->CB;
+  int NR=CA->NumBFs, NC=CB->NumBFs;
+  int MaxRank = (NR*NC) / (NR+NC);
+  if (MaxRank<1) return false;
+
+  cdouble *U = new cdouble[ NR*MaxRank ]; // U[k*NR + nr]
+  cdouble *V = new cdouble[ NC*MaxRank ]; // V[k*NC + nc]
+  bool *RowUsed = new bool[NR];
+  for(int nr=0; nr<NR; nr++) RowUsed[nr]=false;
+
+  double Norm2=0.0;
+  int Rank=0, NextRow=0;
+  bool Converged=false;
+  while( Rank<MaxRank )
+   {
+     /*--------------------------------------------------------------*/
+     /*- get the residual of the pivot row --------------------------*/
+     /*--------------------------------------------------------------*/
+     cdouble *v=V + Rank*NC;
+     RowUsed[NextRow]=true;
+     GetBlockRow(W, CA, NextRow, CB, v);
+     for(int k=0; k<Rank; k++)
+      { cdouble Ukr = U[k*NR + NextRow];
+        for(int nc=0; nc<NC; nc++)
+         v[nc] -= Ukr*V[k*NC + nc];
+      };
+
+     int PivotCol=0;
+     double MaxAbs=0.0;
+     for(int nc=0; nc<NC; nc++)
+      if ( abs(v[nc]) > MaxAbs )
+       { MaxAbs=abs(v[nc]); PivotCol=nc; };
+
+     if (MaxAbs==0.0)
+      { // residual row vanishes; try the next unused row
+        NextRow=-1;
+        for(int nr=0; nr<NR && NextRow==-1; nr++)
+         if (!RowUsed[nr]) NextRow=nr;
+        if (NextRow==-1) { Converged=true; break; };
+        continue;
+      };
+
+     cdouble PivotInverse = 1.0/v[PivotCol];
+     for(int nc=0; nc<NC; nc++)
+      v[nc]*=PivotInverse;
+
+     /*--------------------------------------------------------------*/
+     /*- get the residual of the pivot column -----------------------*/
+     /*--------------------------------------------------------------*/
+     cdouble *u=U + Rank*NR;
+     GetBlockColumn(W, CA, CB, PivotCol, u);
+     for(int k=0; k<Rank; k++)
+      { cdouble Vkc = V[k*NC + PivotCol];
+        for(int nr=0; nr<NR; nr++)
+         u[nr] -= Vkc*U[k*NR + nr];
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- update estimate of the Frobenius norm of the approximant   -*/
+     /*--------------------------------------------------------------*/
+     double uNorm2=0.0, vNorm2=0.0;
+     for(int nr=0; nr<NR; nr++) uNorm2+=norm(u[nr]);
+     for(int nc=0; nc<NC; nc++) vNorm2+=norm(v[nc]);
+     for(int k=0; k<Rank; k++)
+      { cdouble uDot=0.0, vDot=0.0;
+        for(int nr=0; nr<NR; nr++) uDot += conj(U[k*NR+nr])*u[nr];
+        for(int nc=0; nc<NC; nc++) vDot += conj(V[k*NC+nc])*v[nc];
+        Norm2 += 2.0*real(uDot*vDot);
+      };
+     Norm2 += uNorm2*vNorm2;
+     Rank++;
+
+     if ( sqrt(uNorm2*vNorm2) <= Tolerance*sqrt(Norm2) )
+      { Converged=true;
+        break;
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- next pivot row is the largest entry of u among unused rows  */
+     /*--------------------------------------------------------------*/
+     NextRow=-1;
+     MaxAbs=-1.0;
+     for(int nr=0; nr<NR; nr++)
+      if ( !RowUsed[nr] && abs(u[nr])>MaxAbs )
+       { MaxAbs=abs(u[nr]); NextRow=nr; };
+     if (NextRow==-1)
+      { Converged=true;
+        break;
+      };
+   };
+
+  delete[] RowUsed;
+  if (!Converged || Rank==0)
+   { delete[] U;
+     delete[] V;
+     return false;
+   };
+
+  B->Rank = Rank;
+  B->U = new HMatrix(NR, Rank, LHM_COMPLEX);
+  B->V = new HMatrix(Rank, NC, LHM_COMPLEX);
+  for(int k=0; k<Rank; k++)
+   { for(int nr=0; nr<NR; nr++)
+      B->U->SetEntry(nr, k, U[k*NR + nr]);
+     for(int nc=0; nc<NC; nc++)
+      B->V->SetEntry(k, nc, V[k*NC + nc]);
+   };
+  delete[] U;
+  delete[] V;
+  return true;
+}
+
+/***************************************************************/
+/* comparison functor used to sort edges by centroid coordinate*/
+/***************************************************************/
+typedef struct EdgeCoordinateLess
+ { RWGSurface *S;
+   int Axis;
+   bool operator()(int ne1, int ne2) const
+    { return S->Edges[ne1]->Centroid[Axis] < S->Edges[ne2]->Centroid[Axis]; }
+ } EdgeCoordinateLess;
+
+/***************************************************************/
+/* build the cluster tree for a set of edges on surface ns by  */
+/* recursive bisection along the longest bounding-box axis     */
+/***************************************************************/
+ACACluster *ACAMatrix::CreateCluster(int ns, int *EdgeIndices, int NumEdges)
+{
+  RWGSurface *S=G->Surfaces[ns];
+  int Mult = S->IsPEC ? 1 : 2;
+
+  ACACluster *C=(ACACluster *)mallocEC(sizeof(ACACluster));
+  C->ns          = ns;
+  C->EdgeIndices = EdgeIndices;
+  C->NumEdges    = NumEdges;
+  C->NumBFs      = Mult*NumEdges;
+  C->BFIndices   = (int *)mallocEC(C->NumBFs*sizeof(int));
+
+  double XMin[3], XMax[3];
+  VecZero(C->Center);
+  for(int i=0; i<3; i++)
+   { XMin[i]=HUGE_VAL; XMax[i]=-HUGE_VAL; };
+  for(int n=0; n<NumEdges; n++)
+   { double *X=S->Edges[EdgeIndices[n]]->Centroid;
+     VecPlusEquals(C->Center, 1.0/((double)NumEdges), X);
+     for(int i=0; i<3; i++)
+      { XMin[i]=fmin(XMin[i], X[i]);
+        XMax[i]=fmax(XMax[i], X[i]);
+      };
+   };
+  C->Radius=0.0;
+  for(int n=0; n<NumEdges; n++)
+   { RWGEdge *E=S->Edges[EdgeIndices[n]];
+     C->Radius=fmax(C->Radius, VecDistance(C->Center,E->Centroid) + E->Radius);
+   };
+
+  C->Children[0]=C->Children[1]=0;
+  if (NumEdges>LeafSize)
+   { 
+     int Axis=0;
+     for(int i=1; i<3; i++)
+      if ( (XMax[i]-XMin[i]) > (XMax[Axis]-XMin[Axis]) )
+       Axis=i;
+
+     EdgeCoordinateLess Less;
+     Less.S=S;
+     Less.Axis=Axis;
+     int NumEdges0 = NumEdges/2;
+     std::nth_element(EdgeIndices, EdgeIndices+NumEdges0, EdgeIndices+NumEdges, Less);
+
+     C->Children[0]=CreateCluster(ns, EdgeIndices, NumEdges0);
+     C->Children[1]=CreateCluster(ns, EdgeIndices+NumEdges0, NumEdges-NumEdges0);
+   };
+
+  // the partitioning above (and in the child clusters) reorders
+  // EdgeIndices in place, so the basis-function indices must be
+  // filled in only after the subtree has been built
+  for(int n=0; n<NumEdges; n++)
+   for(int m=0; m<Mult; m++)
+    C->BFIndices[Mult*n + m] = G->BFIndexOffset[ns] + Mult*EdgeIndices[n] + m;
+
+  return C;
+}
+
+void ACAMatrix::DestroyCluster(ACACluster *C)
+{
+  if (C==0) return;
+  DestroyCluster(C->Children[0]);
+  DestroyCluster(C->Children[1]);
+  free(C->BFIndices);
+  free(C);
+}
+
+/***************************************************************/
+/* build the block-cluster tree for the (CA, CB) submatrix.    */
+/***************************************************************/
+void ACAMatrix::AddBlock(ACACluster *CA, ACACluster *CB,
+                         bool Symmetric, bool Admissible)
+{
+  if (NumBlocks==NumBlocksAllocated)
+   { NumBlocksAllocated = (NumBlocksAllocated==0) ? 1024 : 2*NumBlocksAllocated;
+     Blocks=(ACABlock *)reallocEC(Blocks, NumBlocksAllocated*sizeof(ACABlock));
+   };
+  ACABlock *B=Blocks + (NumBlocks++);
+  B->CA=CA;
+  B->CB=CB;
+  B->Symmetric=Symmetric;
+  B->Admissible=Admissible;
+  B->Rank=-1;
+  B->D=B->U=B->V=0;
+}
+
+void ACAMatrix::AddBlocks(ACACluster *CA, ACACluster *CB, bool Symmetric)
+{
+  bool LeafA = (CA->Children[0]==0);
+  bool LeafB = (CB->Children[0]==0);
+
+  /*--------------------------------------------------------------*/
+  /*- diagonal blocks: the (C1,C0) block is the transpose of the  */
+  /*- (C0,C1) block, so we only store the latter                  */
+  /*--------------------------------------------------------------*/
+  if (CA==CB)
+   { if (LeafA)
+      AddBlock(CA, CA, false, false);
+     else
+      { AddBlocks(CA->Children[0], CA->Children[0], false);
+        AddBlocks(CA->Children[0], CA->Children[1], true);
+        AddBlocks(CA->Children[1], CA->Children[1], false);
+      };
+     return;
+   };
+
+  double Distance = VecDistance(CA->Center, CB->Center) - CA->Radius - CB->Radius;
+  double Diameter = 2.0*fmin(CA->Radius, CB->Radius);
+  if ( Distance>0.0 && Diameter <= Eta*Distance )
+   AddBlock(CA, CB, Symmetric, true);
+  else if (LeafA && LeafB)
+   AddBlock(CA, CB, Symmetric, false);
+  else if ( !LeafA && (LeafB || CA->Radius>=CB->Radius) )
+   { AddBlocks(CA->Children[0], CB, Symmetric);
+     AddBlocks(CA->Children[1], CB, Symmetric);
+   }
+  else
+   { AddBlocks(CA, CB->Children[0], Symmetric);
+     AddBlocks(CA, CB->Children[1], Symmetric);
+   };
+}
+
+/***************************************************************/
+/* ACAMatrix constructor: build cluster trees and the block    */
+/* structure; matrix entries are computed later by Assemble(). */
+/***************************************************************/
+ACAMatrix::ACAMatrix(RWGGeometry *pG, double pTolerance, double pEta, int pLeafSize)
+{
+  G         = pG;
+  N         = G->TotalBFs;
+  Tolerance = pTolerance;
+  Eta       = pEta;
+  LeafSize  = pLeafSize;
+
+  if (G->LBasis)
+   ErrExit("compressed BEM matrices are not supported for periodic geometries");
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   if (G->Surfaces[ns]->SurfaceZeta)
+    ErrExit("compressed BEM matrices are not supported for surfaces with finite impedance");
+
+  /*--------------------------------------------------------------*/
+  /*- cluster trees, one per surface ------------------------------*/
+  /*--------------------------------------------------------------*/
+  EdgeIndexBuffer=(int *)mallocEC(G->TotalEdges * sizeof(int));
+  Roots=(ACACluster **)mallocEC(G->NumSurfaces * sizeof(ACACluster *));
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   { int *EdgeIndices = EdgeIndexBuffer + G->EdgeIndexOffset[ns];
+     int NE = G->Surfaces[ns]->NumEdges;
+     for(int ne=0; ne<NE; ne++)
+      EdgeIndices[ne]=ne;
+     Roots[ns]=CreateCluster(ns, EdgeIndices, NE);
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- block-cluster tree: the BEM matrix is symmetric for compact */
+  /*- geometries, so we only need the upper block triangle        */
+  /*--------------------------------------------------------------*/
+  Blocks=0;
+  NumBlocks=NumBlocksAllocated=0;
+  for(int nsa=0; nsa<G->NumSurfaces; nsa++)
+   for(int nsb=nsa; nsb<G->NumSurfaces; nsb++)
+    { int CommonRegions[2];
+      double Signs[2];
+      if ( CountCommonRegions(G->Surfaces[nsa], G->Surfaces[nsb], CommonRegions, Signs)==0 )
+       continue;
+      AddBlocks(Roots[nsa], Roots[nsb], nsa!=nsb);
+    };
+
+  Log("Created compressed BEM matrix (%i blocks, tolerance %e, eta %g)",
+       NumBlocks, Tolerance, Eta);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+ACAMatrix::~ACAMatrix()
+{
+  for(int nb=0; nb<NumBlocks; nb++)
+   { if (Blocks[nb].D) delete Blocks[nb].D;
+     if (Blocks[nb].U) delete Blocks[nb].U;
+     if (Blocks[nb].V) delete Blocks[nb].V;
+   };
+  free(Blocks);
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   DestroyCluster(Roots[ns]);
+  free(Roots);
+  free(EdgeIndexBuffer);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void ACAMatrix::Assemble(cdouble Omega)
+{
+  G->UpdateCachedEpsMuValues(Omega);
+
+  for(int nb=0; nb<NumBlocks; nb++)
+   { ACABlock *B=Blocks+nb;
+     if (B->D) delete B->D;
+     if (B->U) delete B->U;
+     if (B->V) delete B->V;
+     B->D=B->U=B->V=0;
+     B->Rank=-1;
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- compute all blocks in parallel; the expensive blocks come   */
+  /*- first in the list, so dynamic scheduling works well here   -*/
+  /*--------------------------------------------------------------*/
+  double Time=Secs();
+#ifdef USE_OPENMP
+  int NumThreads=GetNumThreads();
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+  for(int nb=0; nb<NumBlocks; nb++)
+   { ACABlock *B=Blocks+nb;
+     ACAWorkspace MyWorkspace, *W=&MyWorkspace;
+     InitACAWorkspace(W, G, B->CA->ns, B->CB->ns, Omega);
+     if ( !(B->Admissible && GetLowRankBlock(W, B, Tolerance)) )
+      GetDenseBlock(W, B);
+   };
+  Time=Secs()-Time;
+
+  /*--------------------------------------------------------------*/
+  /*- report storage and rank statistics for each surface block   */
+  /*--------------------------------------------------------------*/
+  for(int nsa=0; nsa<G->NumSurfaces; nsa++)
+   for(int nsb=nsa; nsb<G->NumSurfaces; nsb++)
+    { int NumDense=0, NumLowRank=0, MaxRank=0;
+      double MeanRank=0.0, Bytes=0.0;
+      for(int nb=0; nb<NumBlocks; nb++)
+       { ACABlock *B=Blocks+nb;
+         if ( B->CA->ns!=nsa || B->CB->ns!=nsb ) continue;
+         int NR=B->CA->NumBFs, NC=B->CB->NumBFs;
+         if (B->Rank==-1)
+          { NumDense++;
+            Bytes += ((double)NR)*NC*sizeof(cdouble);
+          }
+         else
+          { NumLowRank++;
+            MeanRank += B->Rank;
+            MaxRank = (B->Rank>MaxRank) ? B->Rank : MaxRank;
+            Bytes += ((double)B->Rank)*(NR+NC)*sizeof(cdouble);
+          };
+       };
+      if (NumDense+NumLowRank==0) continue;
+      if (NumLowRank>0) MeanRank/=((double)NumLowRank);
+      double DenseBytes = ((double)G->Surfaces[nsa]->NumBFs)
+                          *G->Surfaces[nsb]->NumBFs*sizeof(cdouble);
+      if (nsa==nsb) DenseBytes*=0.5;
+      Log("ACA block (%i,%i): %i low-rank (mean rank %.1f, max %i), %i dense, %.1f MB (%.1f %% of dense)",
+           nsa,nsb,NumLowRank,MeanRank,MaxRank,NumDense,
+           Bytes/1048576.0, 100.0*Bytes/DenseBytes);
+    };
+  Log("Assembled compressed BEM matrix (%.1f MB) in %.1f s",GetStorage()/1048576.0,Time);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+size_t ACAMatrix::GetStorage()
+{
+  size_t Bytes=0;
+  for(int nb=0; nb<NumBlocks; nb++)
+   { ACABlock *B=Blocks+nb;
+     size_t NR=B->CA->NumBFs, NC=B->CB->NumBFs;
+     if (B->Rank==-1)
+      Bytes += NR*NC*sizeof(cdouble);
+     else
+      Bytes += B->Rank*(NR+NC)*sizeof(cdouble);
+   };
+  return Bytes;
+}
+
+/***************************************************************/
+/* Y = M*X *****************************************************/
+/***************************************************************/
+void ACAMatrix::Apply(HVector *X, HVector *Y)
+{
+  if ( X->N!=N || Y->N!=N )
+   ErrExit("%s:%i: dimension mismatch in ACAMatrix::Apply",__FILE__,__LINE__);
+  if ( X->RealComplex!=LHM_COMPLEX || Y->RealComplex!=LHM_COMPLEX )
+   ErrExit("%s:%i: ACAMatrix::Apply requires complex vectors",__FILE__,__LINE__);
+
+  int NumThreads=1;
+#ifdef USE_OPENMP
+  NumThreads=GetNumThreads();
+#endif
+  cdouble *YBuffers = new cdouble[NumThreads*N];
+  memset(YBuffers, 0, NumThreads*N*sizeof(cdouble));
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+  for(int nb=0; nb<NumBlocks; nb++)
+   {
+     int nt=0;
+#ifdef USE_OPENMP
+     nt=omp_get_thread_num();
+#endif
+     cdouble *YT = YBuffers + nt*N;
+
+     ACABlock *B=Blocks+nb;
+     int NR=B->CA->NumBFs, NC=B->CB->NumBFs;
+     HVector XA(NR, LHM_COMPLEX), XB(NC, LHM_COMPLEX);
+     HVector YA(NR, LHM_COMPLEX), YB(NC, LHM_COMPLEX);
+     for(int nr=0; nr<NR; nr++) XA.ZV[nr]=X->ZV[ B->CA->BFIndices[nr] ];
+     for(int nc=0; nc<NC; nc++) XB.ZV[nc]=X->ZV[ B->CB->BFIndices[nc] ];
+
+     if (B->Rank==-1)
+      { B->D->Apply(&XB, &YA);
+        if (B->Symmetric) B->D->Apply(&XA, &YB, 'T');
+      }
+     else
+      { HVector T(B->Rank, LHM_COMPLEX);
+        B->V->Apply(&XB, &T);
+        B->U->Apply(&T, &YA);
+        if (B->Symmetric)
+         { B->U->Apply(&XA, &T, 'T');
+           B->V->Apply(&T, &YB, 'T');
+         };
+      };
+
+     for(int nr=0; nr<NR; nr++) YT[ B->CA->BFIndices[nr] ] += YA.ZV[nr];
+     if (B->Symmetric)
+      for(int nc=0; nc<NC; nc++) YT[ B->CB->BFIndices[nc] ] += YB.ZV[nc];
+   };
+
+  Y->Zero();
+  for(int nt=0; nt<NumThreads; nt++)
+   for(int n=0; n<N; n++)
+    Y->ZV[n] += YBuffers[nt*N + n];
+  delete[] YBuffers;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+HMatrix *ACAMatrix::GetDenseMatrix(HMatrix *M)
+{
+  if ( M==0 || M->NR!=N || M->NC!=N || M->RealComplex!=LHM_COMPLEX )
+   { if (M) Warn("wrong-size matrix passed to GetDenseMatrix (reallocating)");
+     M=new HMatrix(N, N, LHM_COMPLEX);
+   };
+  M->Zero();
+
+  for(int nb=0; nb<NumBlocks; nb++)
+   { ACABlock *B=Blocks+nb;
+     int NR=B->CA->NumBFs, NC=B->CB->NumBFs;
+     HMatrix *D=B->D;
+     if (B->Rank!=-1)
+      { D=new HMatrix(NR, NC, LHM_COMPLEX);
+        B->U->Multiply(B->V, D);
+      };
+     for(int nr=0; nr<NR; nr++)
+      for(int nc=0; nc<NC; nc++)
+       { cdouble Entry=D->GetEntry(nr,nc);
+         M->SetEntry(B->CA->BFIndices[nr], B->CB->BFIndices[nc], Entry);
+         if (B->Symmetric)
+          M->SetEntry(B->CB->BFIndices[nc], B->CA->BFIndices[nr], Entry);
+       };
+     if (B->Rank!=-1) delete D;
+   };
+  return M;
+}
+
+/***************************************************************/
+/* RWGGeometry entry point, analogous to AssembleBEMMatrix().  */
+/* The tolerance may be set with SCUFF_ACA_TOLERANCE.          */
+/***************************************************************/
+ACAMatrix *RWGGeometry::AssembleACAMatrix(cdouble Omega, ACAMatrix *M)
+{
+  if (M==0)
+   { double Tolerance=1.0e-4;
+     char *s=getenv("SCUFF_ACA_TOLERANCE");
+     if (s)
+      { sscanf(s,"%le",&Tolerance);
+        Log("Setting ACA tolerance to %e.",Tolerance);
+      };
+     M=new ACAMatrix(this, Tolerance);
+   };
+  M->Assemble(Omega);
+  return M;
+}
+
+} // namespace scuff
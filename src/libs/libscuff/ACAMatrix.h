@@ -0,0 +1,119 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * ACAMatrix.h   -- hierarchical storage of the BEM matrix in which
+ *               -- blocks describing interactions between well-separated
+ *               -- clusters of basis functions are stored in low-rank
+ *               -- form computed by adaptive cross approximation (ACA)
+ */
+
+#ifndef ACAMATRIX_H
+#define ACAMATRIX_H
+
+#include <libhmat.h>
+
+namespace scuff {
+
+class RWGGeometry;
+
+/***************************************************************/
+/* an ACACluster is a set of interior edges on a single surface*/
+/* together with a bounding sphere for the set. clusters are   */
+/* organized into a binary tree by recursive bisection.        */
+/***************************************************************/
+typedef struct ACACluster
+ {
+   int ns;                     // index of surface
+   int *EdgeIndices;           // edges in this cluster (points into parent's array)
+   int NumEdges;
+   int *BFIndices;             // global indices of basis functions in this cluster
+   int NumBFs;
+   double Center[3], Radius;   // bounding sphere
+   struct ACACluster *Children[2];
+
+ } ACACluster;
+
+/***************************************************************/
+/* an ACABlock is a leaf of the block-cluster tree. It stores  */
+/* the submatrix of the BEM matrix whose rows and columns are  */
+/* the basis functions in clusters CA and CB, either densely   */
+/* (Rank==-1) or in the low-rank form D \approx U*V, where U   */
+/* is (NumBFs in CA) x Rank and V is Rank x (NumBFs in CB).    */
+/* If Symmetric is true, the transpose of the block is also    */
+/* used for the (CB, CA) submatrix.                            */
+/***************************************************************/
+typedef struct ACABlock
+ {
+   ACACluster *CA, *CB;
+   bool Symmetric;
+   bool Admissible;
+   int Rank;
+   HMatrix *D, *U, *V;
+
+ } ACABlock;
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+class ACAMatrix
+ {
+  public:
+
+   // Tolerance = relative accuracy of low-rank blocks
+   // Eta       = admissibility parameter: clusters A, B are
+   //             compressed if diam(A,B) <= Eta*dist(A,B)
+   // LeafSize  = max number of edges in a leaf cluster
+   ACAMatrix(RWGGeometry *G, double Tolerance=1.0e-4,
+             double Eta=1.0, int LeafSize=32);
+   ~ACAMatrix();
+
+   // (re)compute all matrix blocks at a new frequency
+   void Assemble(cdouble Omega);
+
+   // matrix-vector product Y = M*X (X, Y complex)
+   void Apply(HVector *X, HVector *Y);
+
+   // expand to an ordinary dense HMatrix (for testing)
+   HMatrix *GetDenseMatrix(HMatrix *M=0);
+
+   // total storage in bytes
+   size_t GetStorage();
+
+  private:
+   RWGGeometry *G;
+   int N;
+   double Tolerance, Eta;
+   int LeafSize;
+
+   ACACluster **Roots;         // one cluster tree per surface
+   int *EdgeIndexBuffer;
+
+   ACABlock *Blocks;
+   int NumBlocks, NumBlocksAllocated;
+
+   ACACluster *CreateCluster(int ns, int *EdgeIndices, int NumEdges);
+   void DestroyCluster(ACACluster *C);
+   void AddBlocks(ACACluster *CA, ACACluster *CB, bool Symmetric);
+   void AddBlock(ACACluster *CA, ACACluster *CB, bool Symmetric, bool Admissible);
+ };
+
+} // namespace scuff
+
+#endif // ACAMATRIX_H
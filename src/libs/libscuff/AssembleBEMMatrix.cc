@@ -114,193 +114,6 @@ void StampInNeighborBlock(HMatrix *B, HMatrix **GradB,
    };
 }
 
-/***************************************************************/
-/* this is a simple quick-and-dirty mechanism for saving       */
-/* and retrieving diagonal T-matrix blocks to disk.            */
-/***************************************************************/
-#define TBCOP_READ  0
-#define TBCOP_WRITE 1
-bool TBlockCacheOp(int Op, RWGGeometry *G, int ns,
-                   cdouble Omega, double *kBloch,
-                   HMatrix *M, int RowOffset, int ColOffset)
-{
-  char *Dir = getenv("SCUFF_TBLOCK_PATH");
-  if (Dir==0 && Op==TBCOP_READ)
-   Dir = getenv("SCUFF_TBLOCK_READPATH");
-  if (!Dir) return false;
-
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  char K4VStr[50];
-  if (imag(Omega)==0.0)
-   sprintf(K4VStr,"%.6e",real(Omega));
-  else if (real(Omega)==0.0)
-   sprintf(K4VStr,"%.6eI",imag(Omega));
-  else 
-   sprintf(K4VStr,"%.6e+%.6eI",real(Omega),imag(Omega));
-  if (G->LDim>=1)
-   vstrappend(K4VStr,"_%.6e",kBloch[0]);
-  if (G->LDim>=2)
-   vstrappend(K4VStr,"_%.6e",kBloch[1]);
-
-  int nr1=G->Surfaces[ns]->RegionIndices[0];
-  int nr2=G->Surfaces[ns]->RegionIndices[1];
-  if (G->RegionMPs[nr1]->Zeroed)
-   strcat(K4VStr,"_Interior");
-  else if (nr2!=-1 && G->RegionMPs[nr2]->Zeroed)
-   strcat(K4VStr,"_Exterior");
-    
-  char *FileBase = GetFileBase(G->Surfaces[ns]->MeshFileName); 
-  const char *Addendum = G->TBlockCacheNameAddendum;
-  if (Addendum==0) Addendum="";
-  char FileName[200];
-  snprintf(FileName,200,"%s/%s%s_%s.hdf5",Dir,FileBase,Addendum,K4VStr);
-
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  int NBF        = G->Surfaces[ns]->NumBFs;
-  bool IsComplex = (M->RealComplex==LHM_COMPLEX);
-  off_t DataSize = NBF*NBF*(IsComplex ? sizeof(double) : sizeof(cdouble) );
-
-  /***************************************************************/
-  /* if the block we are reading/writing is a proper subblock of */
-  /* M, then we will need to allocate an HMatrix for just that   */
-  /* block, but we hold off on doing that until necessary        */
-  /***************************************************************/
-  HMatrix *B=0;
-  bool OwnsB=false;
-  if ( RowOffset==0 && ColOffset==0 && (M->NR==NBF) && (M->NC==NBF) )
-   B=M;
-
-  bool Success=false;
-  FILE *f=0;
-  if (Op==TBCOP_READ)	
-   {
-     Log("Attempting to read T-block (%s,%s) from file %s...",FileBase,z2s(Omega),FileName);
-     struct stat st;
-     int Status=stat(FileName, &st);
-     f=fopen(FileName,"r");
-     if (Status!=0 || f==0)
-      Log("...could not access file");
-     else if (st.st_size!=DataSize)
-      Log("...file had incorrect size %lu (should be %lu)",st.st_size,DataSize);
-     else 
-      { 
-        if (B==0)
-         { OwnsB=true;
-           B=new HMatrix(NBF,NBF,M->RealComplex);
-           if (B->ErrMsg)
-            { Log("...could not allocate matrix (%s)",B->ErrMsg);
-              delete B;
-              fclose(f);
-              return false;
-            };
-         };
-
-        void *DataBuffer = (IsComplex ? ((void *)(B->ZM)) : ((void *)(B->DM)));
-        ssize_t SizeToRead = (ssize_t)DataSize;
-        ssize_t SizeRead = read(fileno(f), DataBuffer, SizeToRead);
-        Success = (SizeRead==SizeToRead);
-        if (Success)
-         { Log("...success!");
-           if (OwnsB)
-            M->InsertBlock(B, RowOffset, ColOffset);
-         }
-        else
-         Log("...failed to read full size (%lu)",SizeToRead);
-      };
-   }
-  else //(Op==TBCOP_WRITE)
-   { 
-     Log("Attempting to write T-block (%s,%s) to file %s...",FileBase,z2s(Omega),FileName);
-     if (B==0)
-      { OwnsB=true;
-        B=new HMatrix(NBF,NBF,M->RealComplex);
-        if (B->ErrMsg)
-         { Log("...could not allocate matrix (%s)",B->ErrMsg);
-           delete B;
-           return false;
-         };
-        M->ExtractBlock(RowOffset, ColOffset, B);
-      };
-     void *DataBuffer = (IsComplex ? ((void *)(B->ZM)) : ((void *)(B->DM)));
-     f=fopen(FileName,"w");
-     if (!f) 
-      Log("...could not access file");
-     else if (DataSize != write(fileno(f), DataBuffer, DataSize))
-      Log("...failed to write full file");
-     else
-      { Log("...success!");
-        Success=true;
-      };
-   };
-
-  if (B && OwnsB) delete B;
-  if (f) fclose(f);
-  return Success; 
-}
-
-
-#if 0 // old HDF5 approach which is memory-inefficient
-  if (Op==TBCOP_READ)
-{
-     bool AbortOnIOErrorSave=HMatrix::AbortOnIOError;
-     HMatrix::AbortOnIOError=false;
-
-     HMatrix *MFile=M;
-     bool OwnsMFile=false;
-     if (RowOffset==0 && ColOffset==0 && M->NR==NBFs && M->NC==NBFs)
-      M->ImportFromHDF5(FileName,"T",false);
-     else
-      { MFile=new HMatrix(FileName,LHM_HDF5,"T");
-        OwnsMFile=true;
-      };
-     bool Success = (MFile->ErrMsg == 0);
-     if (Success)
-      { Log("...success!");
-        if (OwnsMFile)
-         M->InsertBlock(MFile, RowOffset, ColOffset);
-      }
-     else 
-      { Log("...failed: %s",MFile->ErrMsg);
-        if (!OwnsMFile) 
-         { free(M->ErrMsg);
-           M->ErrMsg=0;
-         };
-      };
-     if (OwnsMFile) delete MFile;
-     HMatrix::AbortOnIOError=AbortOnIOErrorSave;
-     return Success;
-   }
-  else if (Op==TBCOP_WRITE)
-   { 
-      HMatrix *MFile;
-      bool OwnsMFile=false;
-      bool AbortOnIOErrorSave=HMatrix::AbortOnIOError;
-      HMatrix::AbortOnIOError=false;
-      if (RowOffset==0 && ColOffset==0 && M->NR==NBFs && M->NC==NBFs)
-       MFile=M;
-      else
-       { MFile = new HMatrix(NBFs, NBFs, M->RealComplex);
-         OwnsMFile=true;
-         M->ExtractBlock(RowOffset, ColOffset, MFile);
-       };
-      MFile->ExportToHDF5(FileName,"T");
-      Log("Writing T-block (%s,%s) to file %s...",FileBase,z2s(Omega),FileName);
-      if (MFile->ErrMsg)
-       { Log("...failed! %s",MFile->ErrMsg);
-         free(MFile->ErrMsg);
-         MFile->ErrMsg=0;
-       };
-      if (OwnsMFile) delete MFile;
-      HMatrix::AbortOnIOError=AbortOnIOErrorSave;
-   };
-  return false; // never get here 
-}
-#endif
-
 /***************************************************************/
 /* KBIMBCache = 'kBloch-independent matrix-block cache.'       */
 /***************************************************************/
@@ -416,7 +229,7 @@ void RWGGeometry::AssembleBEMMatrixBlock(int nsa, int nsb,
 
   if (    nsa==nsb
        && GradM==0
-       && TBlockCacheOp(TBCOP_READ, this, nsa, Omega, kBloch, M, RowOffset, ColOffset)
+       && ReadTBlockStore(this, nsa, Omega, kBloch, M, RowOffset, ColOffset)
      ) return;
 
   if (LogLevel>=SCUFF_VERBOSELOGGING)
@@ -443,7 +256,7 @@ void RWGGeometry::AssembleBEMMatrixBlock(int nsa, int nsb,
      Args->ColOffset=ColOffset;
      GetSurfaceSurfaceInteractions(Args);
      if (nsa==nsb)
-      TBlockCacheOp(TBCOP_WRITE, this, nsa, Omega, kBloch, M, RowOffset, ColOffset);
+      WriteTBlockStore(this, nsa, Omega, kBloch, M, RowOffset, ColOffset);
      return;
    };
 
@@ -617,7 +430,7 @@ done:
   if (Args->GBA2) DestroyGBarAccelerator(Args->GBA2);
 
   if (nsa==nsb)
-   TBlockCacheOp(TBCOP_WRITE, this, nsa, Omega, kBloch, M, RowOffset, ColOffset);
+   WriteTBlockStore(this, nsa, Omega, kBloch, M, RowOffset, ColOffset);
 
 }
 
@@ -650,9 +463,17 @@ HMatrix *RWGGeometry::AssembleBEMMatrix(cdouble Omega, double *kBloch, HMatrix *
      M=AllocateBEMMatrix();
    };
 
+  // M may hold the factorization of a previously-assembled 
+  // matrix (the usual case in frequency loops); its entries are
+  // about to be overwritten, so forget the old pivots and LDL^T
+  // state, and set UseLDLT before any entries are filled in.
+  M->ResetFactorization();
+
   // the overall BEM matrix is symmetric as long as we 
   // don't have a nonzero bloch wavevector.
   bool MatrixIsSymmetric = ( !kBloch || (kBloch[0]==0.0 && kBloch[1]==0.0) );
+  M->UseLDLT = (    MatrixIsSymmetric && UseSymmetricFactorization
+                 && M->StorageType==LHM_NORMAL );
 
   /***************************************************************/
   /* loop over all pairs of objects to assemble the diagonal and */
@@ -679,14 +500,15 @@ HMatrix *RWGGeometry::AssembleBEMMatrix(cdouble Omega, double *kBloch, HMatrix *
   /***************************************************************/
   /* if the matrix is symmetric, then the computations above have*/
   /* only filled in its upper triangle, so we need to go back and*/
-  /* fill in the lower triangle. (The exception is if the matrix */
-  /* is defined to use packed storage, in which case only the    */
+  /* fill in the lower triangle. (The exceptions are if the      */
+  /* matrix is defined to use packed storage, or if we are using */
+  /* the symmetric LDL^T factorization, in which cases only the  */
   /* upper triangle is needed anyway.)                           */
   /* Note: Technically the lower-triangular parts of the diagonal*/
   /* blocks should already have been filled in, so this code is  */
   /* slightly redundant because it re-fills-in those entries.    */
   /***************************************************************/
-  if (MatrixIsSymmetric && M->StorageType==LHM_NORMAL)
+  if (MatrixIsSymmetric && M->StorageType==LHM_NORMAL && !M->UseLDLT)
    { 
      for(int nr=1; nr<TotalBFs; nr++)
       for(int nc=0; nc<nr; nc++)
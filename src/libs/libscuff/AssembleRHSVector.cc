@@ -246,16 +246,22 @@ void GetInnerProducts(RWGSurface *S, int ne,
 }
 
 /***************************************************************/
-/* data structure used to pass data to AssembleRHS_Thread      */
+/* data structure used to pass data to AssembleRHS_Thread.     */
+/* each of the NumColumns columns of the RHS has its own chain */
+/* of IncFields, of length NIFs[nc]; the results go into the   */
+/* vector RHS (if NumColumns==1) or into the columns of the    */
+/* matrix RHSMatrix.                                           */
 /***************************************************************/
 typedef struct ThreadData
  { 
    int nt, NumTasks;
 
    RWGGeometry *G;
-   IncField *IF;
-   int NIF;
+   IncField **IFs;
+   int *NIFs;
+   int NumColumns;
    HVector *RHS;
+   HMatrix *RHSMatrix;
 
  } ThreadData;
 
@@ -273,18 +279,23 @@ void *AssembleRHS_Thread(void *data)
   /***************************************************************/
   /* extract fields from thread data structure *******************/
   /***************************************************************/
-  RWGGeometry *G   = TD->G;
-  IncField *IFList = TD->IF;
-  int NIF          = TD->NIF;
-  HVector *RHS     = TD->RHS;
+  RWGGeometry *G     = TD->G;
+  IncField **IFLists = TD->IFs;
+  int *NIFs          = TD->NIFs;
+  int NumColumns     = TD->NumColumns;
+  HVector *RHS       = TD->RHS;
+  HMatrix *RHSMatrix = TD->RHSMatrix;
 
   /***************************************************************/
   /***************************************************************/
   /***************************************************************/
-  IncField **PositiveIFs = new IncField *[NIF];
-  IncField **NegativeIFs = new IncField *[NIF];
-  int NPositiveIFs;
-  int NNegativeIFs;
+  int TotalNIF=0;
+  for(int nc=0; nc<NumColumns; nc++)
+   TotalNIF+=NIFs[nc];
+  IncField **PositiveIFs = new IncField *[TotalNIF];
+  IncField **NegativeIFs = new IncField *[TotalNIF];
+  int *NPositiveIFs = new int[NumColumns];
+  int *NNegativeIFs = new int[NumColumns];
 
   /***************************************************************/
   /* loop over all surfaces to get contributions to RHS vector   */
@@ -311,14 +322,20 @@ void *AssembleRHS_Thread(void *data)
      /*- associated with this surface contribute with a plus sign;   */
      /*- and all other IncFields do not contribute.                  */
      /*--------------------------------------------------------------*/
-     for(NPositiveIFs=NNegativeIFs=0, IF=IFList; IF; IF=IF->Next)
-      { 
-        if (S->RegionIndices[0]==IF->RegionIndex)
-         NegativeIFs[NNegativeIFs++] = IF;
-        else if (S->RegionIndices[1]==IF->RegionIndex)
-         PositiveIFs[NPositiveIFs++] = IF;
+     bool AnyContribution=false;
+     for(int nc=0, nif=0; nc<NumColumns; nif+=NIFs[nc++])
+      { NPositiveIFs[nc]=NNegativeIFs[nc]=0;
+        for(IF=IFLists[nc]; IF; IF=IF->Next)
+         { 
+           if (S->RegionIndices[0]==IF->RegionIndex)
+            NegativeIFs[nif + NNegativeIFs[nc]++] = IF;
+           else if (S->RegionIndices[1]==IF->RegionIndex)
+            PositiveIFs[nif + NPositiveIFs[nc]++] = IF;
+         };
+        if ( NPositiveIFs[nc]>0 || NNegativeIFs[nc]>0 )
+         AnyContribution=true;
       };
-     if ( NPositiveIFs==0 && NNegativeIFs==0 )
+     if (!AnyContribution)
       continue;
 
      /*--------------------------------------------------------------*/
@@ -331,18 +348,28 @@ void *AssembleRHS_Thread(void *data)
         if (nt==TD->NumTasks) nt=0;
         if (nt!=TD->nt) continue;
 
-        GetInnerProducts(S,ne, 
-                         PositiveIFs, NPositiveIFs,
-                         NegativeIFs, NNegativeIFs,
-                         &EProd, IsPEC ? 0 : &HProd );
-
-        if ( IsPEC )
+        for(int nc=0, nif=0; nc<NumColumns; nif+=NIFs[nc++])
          { 
-           RHS->SetEntry(Offset + ne, EProd / ZVAC);
-         }
-        else 
-         { RHS->SetEntry(Offset + 2*ne+0, EProd / ZVAC);
-           RHS->SetEntry(Offset + 2*ne+1, HProd);
+           if ( NPositiveIFs[nc]==0 && NNegativeIFs[nc]==0 )
+            continue;
+
+           GetInnerProducts(S,ne, 
+                            PositiveIFs + nif, NPositiveIFs[nc],
+                            NegativeIFs + nif, NNegativeIFs[nc],
+                            &EProd, IsPEC ? 0 : &HProd );
+
+           if ( IsPEC && RHSMatrix )
+            RHSMatrix->SetEntry(Offset + ne, nc, EProd / ZVAC);
+           else if ( IsPEC )
+            RHS->SetEntry(Offset + ne, EProd / ZVAC);
+           else if ( RHSMatrix )
+            { RHSMatrix->SetEntry(Offset + 2*ne+0, nc, EProd / ZVAC);
+              RHSMatrix->SetEntry(Offset + 2*ne+1, nc, HProd);
+            }
+           else 
+            { RHS->SetEntry(Offset + 2*ne+0, EProd / ZVAC);
+              RHS->SetEntry(Offset + 2*ne+1, HProd);
+            };
          };
 
       }; // for ne=...
@@ -351,30 +378,19 @@ void *AssembleRHS_Thread(void *data)
 
   delete[] PositiveIFs;
   delete[] NegativeIFs;
+  delete[] NPositiveIFs;
+  delete[] NNegativeIFs;
 
   return 0;
  
 }
 
 /***************************************************************/
-/* Assemble the RHS vector.  ***********************************/
+/* launch AssembleRHS_Thread on all threads                    */
 /***************************************************************/
-HVector *RWGGeometry::AssembleRHSVector(cdouble Omega, double *kBloch,
-                                        IncField *IF, HVector *RHS)
+static void AssembleRHS(ThreadData *ReferenceTD)
 { 
-  if (RHS==NULL)
-   RHS=AllocateRHSVector();
-
-  RHS->Zero();
-   
   int nt, NumTasks, NumThreads = GetNumThreads();
-  int NIF=UpdateIncFields(IF, Omega, kBloch);
-
-  ThreadData ReferenceTD;
-  ReferenceTD.G=this;
-  ReferenceTD.IF=IF;
-  ReferenceTD.NIF=NIF;
-  ReferenceTD.RHS=RHS;
 
 #ifdef USE_PTHREAD
   ThreadData *TDs = new ThreadData[NumThreads], *TD;
@@ -382,7 +398,7 @@ HVector *RWGGeometry::AssembleRHSVector(cdouble Omega, double *kBloch,
   for(nt=0; nt<NumThreads; nt++)
    { 
      TD=&(TDs[nt]);
-     memcpy(TD, &ReferenceTD, sizeof(ThreadData));
+     memcpy(TD, ReferenceTD, sizeof(ThreadData));
      TD->nt=nt;
      TD->NumTasks=NumThreads;
 
@@ -408,13 +424,77 @@ HVector *RWGGeometry::AssembleRHSVector(cdouble Omega, double *kBloch,
   for(nt=0; nt<NumTasks; nt++)
    { 
      ThreadData TD1;
-     memcpy(&TD1, &ReferenceTD, sizeof(ThreadData));
+     memcpy(&TD1, ReferenceTD, sizeof(ThreadData));
      TD1.nt=nt;
      TD1.NumTasks=NumTasks;
      AssembleRHS_Thread((void *)&TD1);
    };
 #endif
+}
+
+/***************************************************************/
+/* Assemble the RHS vector.  ***********************************/
+/***************************************************************/
+HVector *RWGGeometry::AssembleRHSVector(cdouble Omega, double *kBloch,
+                                        IncField *IF, HVector *RHS)
+{ 
+  if (RHS==NULL)
+   RHS=AllocateRHSVector();
+
+  RHS->Zero();
+   
+  int NIF=UpdateIncFields(IF, Omega, kBloch);
+
+  ThreadData ReferenceTD;
+  ReferenceTD.G=this;
+  ReferenceTD.IFs=&IF;
+  ReferenceTD.NIFs=&NIF;
+  ReferenceTD.NumColumns=1;
+  ReferenceTD.RHS=RHS;
+  ReferenceTD.RHSMatrix=0;
+  AssembleRHS(&ReferenceTD);
+
+  return RHS;
+}
 
+/***************************************************************/
+/* Assemble the RHS vectors for NumIFs incident fields at once */
+/* into the first NumIFs columns of a matrix, which may then   */
+/* be passed to LUSolve(HMatrix *, nrhs) to solve for all the  */
+/* surface-current vectors with a single (level-3 BLAS) solve. */
+/* the work of computing the RHS entries for all incident      */
+/* fields is shared among all threads.                         */
+/*                                                             */
+/* If RHS is NULL or has the wrong size on entry, a new        */
+/* TotalBFs x NumIFs matrix is allocated and returned.         */
+/***************************************************************/
+HMatrix *RWGGeometry::AssembleRHSMatrix(cdouble Omega, double *kBloch,
+                                        IncField **IFs, int NumIFs,
+                                        HMatrix *RHS)
+{ 
+  if (RHS && (RHS->NR!=TotalBFs || RHS->NC<NumIFs) )
+   { Warn("wrong-size matrix passed to AssembleRHSMatrix; reallocating...");
+     RHS=0;
+   };
+  if (RHS==NULL)
+   RHS=new HMatrix(TotalBFs, NumIFs, LHM_COMPLEX);
+
+  RHS->Zero();
+
+  int *NIFs = new int[NumIFs];
+  for(int nc=0; nc<NumIFs; nc++)
+   NIFs[nc]=UpdateIncFields(IFs[nc], Omega, kBloch);
+
+  ThreadData ReferenceTD;
+  ReferenceTD.G=this;
+  ReferenceTD.IFs=IFs;
+  ReferenceTD.NIFs=NIFs;
+  ReferenceTD.NumColumns=NumIFs;
+  ReferenceTD.RHS=0;
+  ReferenceTD.RHSMatrix=RHS;
+  AssembleRHS(&ReferenceTD);
+
+  delete[] NIFs;
   return RHS;
 }
 
@@ -0,0 +1,618 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * BEMMatrixInterpolator.cc -- fast assembly of the BEM matrix at many
+ *                          -- closely-spaced frequencies by Chebyshev
+ *                          -- interpolation of the edge-edge integrals
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <libhrutil.h>
+#include <libhmat.h>
+
+#include "libscuff.h"
+#include "libscuffInternals.h"
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef USE_OPENMP
+#  include <omp.h>
+#endif
+
+#define II cdouble(0,1)
+
+namespace scuff {
+
+#define BMI_DEFAULT_INTERVALS  8
+#define BMI_DEFAULT_NODES      9
+#define BMI_DEFAULT_TOLERANCE  1.0e-6
+#define BMI_MAX_BISECTIONS     4
+#define BMI_MAX_NODES          33
+
+// default memory budget, as a fraction of the physical memory,
+// and the budget assumed if the physical memory is unknown
+#define BMI_MEMORY_FRACTION    0.5
+#define BMI_FALLBACK_MEMORY    4.0e9
+
+// exp(-i*k*R) overflows when the integral it multiplies has
+// already underflowed; such integrals are tabulated as zero
+#define BMI_MAX_DECAY 600.0
+
+/***************************************************************/
+/* the Chebyshev coefficients for a block are stored in a flat */
+/* array indexed by edge pair p=nea*NEb + neb, region r (in    */
+/* the order returned by CountCommonRegions), integral type    */
+/* gc (0=G, 1=C), and polynomial degree k.                     */
+/***************************************************************/
+static inline size_t CoeffIndex(int p, int r, int gc, int k,
+                                int NumRegions, int NumNodes)
+{ return ( ((size_t)p*NumRegions + r)*2 + gc )*NumNodes + k; }
+
+/***************************************************************/
+/* memory needed for the tabulated data of block (nsa,nsb)     */
+/***************************************************************/
+double BEMMatrixInterpolator::GetBlockMemory(int nsa, int nsb)
+{
+  RWGSurface *Sa = G->Surfaces[nsa];
+  RWGSurface *Sb = G->Surfaces[nsb];
+  double Signs[2];
+  int CommonRegions[2];
+  int NumRegions=CountCommonRegions(Sa, Sb, CommonRegions, Signs);
+  double NumPairs = ((double)Sa->NumEdges)*((double)Sb->NumEdges);
+  return NumPairs*( sizeof(double) + 2.0*NumRegions*NumNodes*sizeof(cdouble) );
+}
+
+static double GetDefaultMemoryBudget()
+{
+  long Pages=sysconf(_SC_PHYS_PAGES), PageSize=sysconf(_SC_PAGESIZE);
+  if (Pages<=0 || PageSize<=0)
+   return BMI_FALLBACK_MEMORY;
+  return BMI_MEMORY_FRACTION*((double)Pages)*((double)PageSize);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+BEMMatrixInterpolator::BEMMatrixInterpolator(RWGGeometry *_G,
+                                             cdouble _OmegaMin, cdouble OmegaMax,
+                                             int _NumIntervals, int _NumNodes,
+                                             double _Tolerance)
+{
+  G=_G;
+  if (G->LBasis)
+   ErrExit("%s:%i: BEM matrix interpolation is not supported for periodic geometries",__FILE__,__LINE__);
+
+  OmegaMin   = _OmegaMin;
+  DeltaOmega = OmegaMax - OmegaMin;
+  if ( abs(DeltaOmega)==0.0 )
+   ErrExit("%s:%i: empty frequency range",__FILE__,__LINE__);
+
+  NumIntervals  = _NumIntervals>0 ? _NumIntervals : BMI_DEFAULT_INTERVALS;
+  NumNodes      = _NumNodes>0     ? _NumNodes     : BMI_DEFAULT_NODES;
+  Tolerance     = _Tolerance>0.0  ? _Tolerance    : BMI_DEFAULT_TOLERANCE;
+  MaxBisections = BMI_MAX_BISECTIONS;
+
+  char *s;
+  if ( (s=getenv("SCUFF_INTERP_INTERVALS")) )
+   { sscanf(s,"%i",&NumIntervals);
+     Log("Setting BEM matrix interpolation intervals=%i.",NumIntervals);
+   };
+  if ( (s=getenv("SCUFF_INTERP_NODES")) )
+   { sscanf(s,"%i",&NumNodes);
+     Log("Setting BEM matrix interpolation nodes=%i.",NumNodes);
+   };
+  if ( (s=getenv("SCUFF_INTERP_TOLERANCE")) )
+   { sscanf(s,"%le",&Tolerance);
+     Log("Setting BEM matrix interpolation tolerance=%e.",Tolerance);
+   };
+  MaxMemory=GetDefaultMemoryBudget();
+  if ( (s=getenv("SCUFF_INTERP_MAX_MB")) )
+   { double MaxMB;
+     if ( sscanf(s,"%le",&MaxMB)==1 && MaxMB>=0.0 )
+      { MaxMemory=MaxMB*1048576.0;
+        Log("Limiting BEM matrix interpolation data to %g MB.",MaxMB);
+      }
+     else
+      Warn("invalid value %s for SCUFF_INTERP_MAX_MB (ignoring)",s);
+   };
+  MemoryUsed=0.0;
+  if (NumIntervals<1) NumIntervals=1;
+  if (NumNodes<2) NumNodes=2;
+  if (NumNodes>BMI_MAX_NODES) NumNodes=BMI_MAX_NODES;
+
+  int NS=G->NumSurfaces;
+  Blocks=(BMIBlock **)mallocEC(NS*NS*sizeof(BMIBlock *));
+  memset(Blocks, 0, NS*NS*sizeof(BMIBlock *));
+
+  /*--------------------------------------------------------------*/
+  /*- matrix that maps values at the Chebyshev-Lobatto nodes     -*/
+  /*- x_j = cos(pi*j/n), j=0..n, to the coefficients of the      -*/
+  /*- interpolating Chebyshev series                             -*/
+  /*--------------------------------------------------------------*/
+  int n=NumNodes-1;
+  DCTMatrix=(double *)mallocEC(NumNodes*NumNodes*sizeof(double));
+  for(int k=0; k<=n; k++)
+   for(int j=0; j<=n; j++)
+    { double Weight = 2.0/n;
+      if (j==0 || j==n) Weight*=0.5;
+      if (k==0 || k==n) Weight*=0.5;
+      DCTMatrix[k*NumNodes + j] = Weight*cos(M_PI*j*k/n);
+    };
+
+  Log("BEM matrix interpolation on [%s,%s]: %i intervals, %i nodes, tolerance %.1e",
+       CD2S(OmegaMin),CD2S(OmegaMax),NumIntervals,NumNodes,Tolerance);
+
+  /*--------------------------------------------------------------*/
+  /*- data are only allocated for the blocks that are requested, -*/
+  /*- but report what the full matrix would take                 -*/
+  /*--------------------------------------------------------------*/
+  double FullMemory=0.0;
+  for(int ns=0; ns<NS; ns++)
+   for(int nsp=ns; nsp<NS; nsp++)
+    if ( nsp!=ns || G->Mate[ns]==-1 )
+     FullMemory+=GetBlockMemory(ns, nsp);
+  Log(" interpolation data for the full matrix: %.0f MB (budget %.0f MB)",
+       FullMemory/1048576.0, MaxMemory/1048576.0);
+  if (FullMemory>MaxMemory)
+   Log(" (blocks beyond the budget will be assembled directly)");
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+BEMMatrixInterpolator::~BEMMatrixInterpolator()
+{
+  Reset();
+  free(Blocks);
+  free(DCTMatrix);
+}
+
+void BEMMatrixInterpolator::Reset()
+{
+  int NS=G->NumSurfaces;
+  for(int nb=0; nb<NS*NS; nb++)
+   if (Blocks[nb])
+    { free(Blocks[nb]->R);
+      free(Blocks[nb]->Coefficients);
+      free(Blocks[nb]);
+      Blocks[nb]=0;
+    };
+  MemoryUsed=0.0;
+}
+
+/***************************************************************/
+/* map Omega to the parameter t in [0,1] along the frequency   */
+/* segment                                                     */
+/***************************************************************/
+double BEMMatrixInterpolator::GetT(cdouble Omega, bool *InRange)
+{
+  double t = real( (Omega-OmegaMin)*conj(DeltaOmega) ) / norm(DeltaOmega);
+  double Residual = abs( Omega - (OmegaMin + t*DeltaOmega) );
+  if (InRange)
+   *InRange = (t>=-1.0e-10 && t<=1.0+1.0e-10 && Residual<=1.0e-8*abs(DeltaOmega));
+  return (t<0.0) ? 0.0 : (t>1.0) ? 1.0 : t;
+}
+
+bool BEMMatrixInterpolator::Contains(cdouble Omega)
+{ bool InRange;
+  GetT(Omega, &InRange);
+  return InRange;
+}
+
+/***************************************************************/
+/* compute the edge-edge integrals for block B at the nodes of */
+/* [tMin, tMax] and convert to Chebyshev coefficients          */
+/***************************************************************/
+void BEMMatrixInterpolator::TabulateBlock(BMIBlock *B, double tMin, double tMax)
+{
+  RWGSurface *Sa = G->Surfaces[B->nsa];
+  RWGSurface *Sb = G->Surfaces[B->nsb];
+  int NEa = Sa->NumEdges, NEb = Sb->NumEdges;
+  int NumPairs = NEa*NEb;
+  int NumRegions = B->NumRegions;
+
+  double Signs[2];
+  int CommonRegions[2];
+  CountCommonRegions(Sa, Sb, CommonRegions, Signs);
+
+  if (G->LogLevel>=SCUFF_VERBOSELOGGING)
+   Log("Tabulating BEM matrix block (%i,%i) at %i frequencies in [%s,%s]...",
+        B->nsa,B->nsb,NumNodes,
+        CD2S(OmegaMin + tMin*DeltaOmega), CD2S(OmegaMin + tMax*DeltaOmega));
+
+  /*--------------------------------------------------------------*/
+  /*- the integrals are needed for all common regions, even those */
+  /*- the caller has currently zeroed                             */
+  /*--------------------------------------------------------------*/
+  int SavedZeroed[2];
+  for(int r=0; r<NumRegions; r++)
+   { SavedZeroed[r] = G->RegionMPs[CommonRegions[r]]->Zeroed;
+     G->RegionMPs[CommonRegions[r]]->UnZero();
+   };
+
+  size_t BufferSize = 2*((size_t)NumRegions)*NumPairs;
+  cdouble *Buffer = (cdouble *)mallocEC(BufferSize*sizeof(cdouble));
+
+  GetSSIArgStruct GetSSIArgs, *Args=&GetSSIArgs;
+  InitGetSSIArgs(Args);
+  Args->G         = G;
+  Args->Sa        = Sa;
+  Args->Sb        = Sb;
+  Args->Symmetric = (B->nsa==B->nsb);
+  Args->B         = 0;
+  Args->GCBuffer  = Buffer;
+
+  int n=NumNodes-1;
+  for(int j=0; j<=n; j++)
+   {
+     double t = 0.5*(tMin+tMax) + 0.5*(tMax-tMin)*cos(M_PI*j/n);
+     cdouble Omega = OmegaMin + t*DeltaOmega;
+
+     cdouble k[2];
+     for(int r=0; r<NumRegions; r++)
+      { cdouble Eps, Mu;
+        G->RegionMPs[CommonRegions[r]]->GetEpsMu(Omega, &Eps, &Mu);
+        k[r] = csqrt2(Eps*Mu)*Omega;
+      };
+
+     memset(Buffer, 0, BufferSize*sizeof(cdouble));
+     Args->Omega = Omega;
+     GetSurfaceSurfaceInteractions(Args);
+
+     for(int p=0; p<NumPairs; p++)
+      for(int r=0; r<NumRegions; r++)
+       { double Decay = imag(k[r])*B->R[p];
+         cdouble Phase = (Decay > BMI_MAX_DECAY) ? 0.0 : exp(-II*k[r]*B->R[p]);
+         for(int gc=0; gc<2; gc++)
+          B->Coefficients[CoeffIndex(p,r,gc,j,NumRegions,NumNodes)]
+           = Phase*Buffer[ (size_t)r*2*NumPairs + 2*p + gc ];
+       };
+   };
+
+  free(Buffer);
+  for(int r=0; r<NumRegions; r++)
+   G->RegionMPs[CommonRegions[r]]->Zeroed=SavedZeroed[r];
+
+  /*--------------------------------------------------------------*/
+  /*- convert node values to Chebyshev coefficients, and estimate */
+  /*- the interpolation error from the size of the last one       */
+  /*--------------------------------------------------------------*/
+  double NormC0=0.0, NormCN=0.0;
+  int NumSeries = 2*NumRegions*NumPairs;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static), num_threads(GetNumThreads()), reduction(+:NormC0,NormCN)
+#endif
+  for(int ns=0; ns<NumSeries; ns++)
+   { cdouble *C = B->Coefficients + ((size_t)ns)*NumNodes;
+     cdouble Values[BMI_MAX_NODES];
+     memcpy(Values, C, NumNodes*sizeof(cdouble));
+     for(int kk=0; kk<NumNodes; kk++)
+      { cdouble Sum=0.0;
+        for(int j=0; j<NumNodes; j++)
+         Sum += DCTMatrix[kk*NumNodes + j]*Values[j];
+        C[kk]=Sum;
+      };
+     NormC0 += norm(C[0]);
+     NormCN += norm(C[n]);
+   };
+
+  B->tMin  = tMin;
+  B->tMax  = tMax;
+  B->Error = (NormC0==0.0) ? 0.0 : sqrt(NormCN/NormC0);
+
+  if (G->LogLevel>=SCUFF_VERBOSELOGGING)
+   Log(" ...estimated relative interpolation error %.1e",B->Error);
+}
+
+/***************************************************************/
+/* evaluate a Chebyshev series at x in [-1,1] (Clenshaw)       */
+/***************************************************************/
+static inline cdouble Clenshaw(const cdouble *C, int NumNodes, double x)
+{ cdouble b1=0.0, b2=0.0;
+  for(int k=NumNodes-1; k>=1; k--)
+   { cdouble b0 = C[k] + 2.0*x*b1 - b2;
+     b2=b1;
+     b1=b0;
+   };
+  return C[0] + x*b1 - b2;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+bool BEMMatrixInterpolator::AssembleBlock(int nsa, int nsb, cdouble Omega,
+                                          HMatrix *M, int RowOffset, int ColOffset)
+{
+  bool InRange;
+  double t=GetT(Omega, &InRange);
+  if (!InRange)
+   return false;
+
+  /*--------------------------------------------------------------*/
+  /*- identical surfaces share diagonal-block data ---------------*/
+  /*--------------------------------------------------------------*/
+  int nsaData=nsa, nsbData=nsb;
+  if (nsa==nsb && G->Mate[nsa]!=-1)
+   nsaData=nsbData=G->Mate[nsa];
+
+  RWGSurface *Sa = G->Surfaces[nsaData];
+  RWGSurface *Sb = G->Surfaces[nsbData];
+  int NEa = Sa->NumEdges, NEb = Sb->NumEdges;
+  bool Symmetric = (nsa==nsb);
+
+  double Signs[2];
+  int CommonRegions[2];
+  int NumRegions=CountCommonRegions(Sa, Sb, CommonRegions, Signs);
+
+  /*--------------------------------------------------------------*/
+  /*- create the block data if this is the first request, and    -*/
+  /*- (re)tabulate if Omega is outside the current interval      -*/
+  /*--------------------------------------------------------------*/
+  BMIBlock **pB = Blocks + nsaData*G->NumSurfaces + nsbData;
+  if (*pB==0)
+   { BMIBlock *B=(BMIBlock *)mallocEC(sizeof(BMIBlock));
+     B->nsa=nsaData;
+     B->nsb=nsbData;
+     B->NumRegions=NumRegions;
+     B->tMin=B->tMax=-1.0;
+     B->R=0;
+     B->Coefficients=0;
+     *pB=B;
+
+     double Memory=GetBlockMemory(nsaData, nsbData);
+     B->OverBudget = (MemoryUsed + Memory > MaxMemory);
+     if (B->OverBudget)
+      { Log("Interpolation data for block (%i,%i) (%.0f MB) exceed the memory budget "
+            "(%.0f/%.0f MB in use); assembling the block directly",
+             nsaData,nsbData,Memory/1048576.0,MemoryUsed/1048576.0,MaxMemory/1048576.0);
+        return false;
+      };
+     MemoryUsed+=Memory;
+
+     B->R=(double *)mallocEC(((size_t)NEa)*NEb*sizeof(double));
+     for(int nea=0; nea<NEa; nea++)
+      for(int neb=0; neb<NEb; neb++)
+       B->R[nea*NEb + neb]=VecDistance(Sa->Edges[nea]->Centroid, Sb->Edges[neb]->Centroid);
+     size_t NumCoefficients = 2*((size_t)NumRegions)*NEa*NEb*NumNodes;
+     B->Coefficients=(cdouble *)mallocEC(NumCoefficients*sizeof(cdouble));
+     if (G->LogLevel>=SCUFF_VERBOSELOGGING)
+      Log("Allocated %lu MB for interpolation of block (%i,%i)",
+           NumCoefficients*sizeof(cdouble)/(1<<20),nsaData,nsbData);
+   };
+  BMIBlock *B=*pB;
+  if (B->OverBudget)
+   return false;
+
+  if ( NumRegions==0 )
+   { M->ZeroBlock(RowOffset, Sa->NumBFs, ColOffset, Sb->NumBFs);
+     return true;
+   };
+
+  if ( t<B->tMin || t>B->tMax )
+   {
+     double Width = 1.0/NumIntervals;
+     int ni = (int)floor(t/Width);
+     if (ni>=NumIntervals) ni=NumIntervals-1;
+     double tMin = ni*Width, tMax = (ni+1)*Width;
+     TabulateBlock(B, tMin, tMax);
+
+     for(int nb=0; nb<MaxBisections && B->Error>Tolerance; nb++)
+      { double tMid=0.5*(tMin+tMax);
+        if (t<=tMid)
+         tMax=tMid;
+        else
+         tMin=tMid;
+        TabulateBlock(B, tMin, tMax);
+      };
+     if (B->Error>Tolerance)
+      Warn("BEM matrix interpolation for block (%i,%i) has estimated error %.1e (tolerance %.1e)",
+            nsa,nsb,B->Error,Tolerance);
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- prefactors at this frequency, as in GSSIThread(); regions   */
+  /*- the caller has zeroed are omitted. (for a block that uses   */
+  /*- the data of a mate, these are the regions of the requested  */
+  /*- surface, not those of the mate, which may be zeroed         */
+  /*- differently.)                                               */
+  /*--------------------------------------------------------------*/
+  if (nsaData!=nsa)
+   CountCommonRegions(G->Surfaces[nsa], G->Surfaces[nsb], CommonRegions, Signs);
+  G->UpdateCachedEpsMuValues(Omega);
+  cdouble k[2], PreFac1[2], PreFac2[2], PreFac3[2];
+  bool HaveRegion[2];
+  for(int r=0; r<NumRegions; r++)
+   { cdouble Eps = G->EpsTF[ CommonRegions[r] ];
+     cdouble Mu  = G->MuTF[ CommonRegions[r] ];
+     HaveRegion[r] = (Eps!=0.0);
+     k[r]       = csqrt2(Eps*Mu)*Omega;
+     PreFac1[r] =  Signs[r]*II*Mu*Omega;
+     PreFac2[r] = -Signs[r]*II*k[r];
+     PreFac3[r] = -Signs[r]*II*Eps*Omega;
+   };
+
+  bool SaIsPEC = (Sa->IsPEC==1);
+  bool SbIsPEC = (Sb->IsPEC==1);
+  int NumNodes = this->NumNodes;
+  double x = (2.0*t - B->tMin - B->tMax) / (B->tMax - B->tMin);
+
+  /*--------------------------------------------------------------*/
+  /*- evaluate and stamp -----------------------------------------*/
+  /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,16), num_threads(GetNumThreads())
+#endif
+  for(int nea=0; nea<NEa; nea++)
+   for(int neb=(Symmetric ? nea : 0); neb<NEb; neb++)
+    {
+      int p = nea*NEb + neb;
+      cdouble GC[2][2];
+      for(int r=0; r<NumRegions; r++)
+       { cdouble Phase = HaveRegion[r] ? exp(II*k[r]*B->R[p]) : 0.0;
+         for(int gc=0; gc<2; gc++)
+          GC[r][gc] = Phase*Clenshaw(B->Coefficients + CoeffIndex(p,r,gc,0,NumRegions,NumNodes), NumNodes, x);
+       };
+
+      // Entries[i][j] is the (X+i, Y+j) matrix entry; the first
+      // region contributes as in GSSIThread(), with the PEC-specific
+      // index conventions, and the second region (present only for
+      // pairs of non-PEC surfaces) contributes to all four entries
+      cdouble Entries[2][2];
+      Entries[0][0] = PreFac1[0]*GC[0][0];
+      Entries[0][1] = Entries[1][0] = PreFac2[0]*GC[0][1];
+      Entries[1][1] = PreFac3[0]*GC[0][0];
+      if (NumRegions==2)
+       { Entries[0][0] += PreFac1[1]*GC[1][0];
+         Entries[0][1] += PreFac2[1]*GC[1][1];
+         Entries[1][0] += PreFac2[1]*GC[1][1];
+         Entries[1][1] += PreFac3[1]*GC[1][0];
+       };
+
+      int X = RowOffset + (SaIsPEC ? nea : 2*nea);
+      int Y = ColOffset + (SbIsPEC ? neb : 2*neb);
+      int NR = SaIsPEC ? 1 : 2;
+      int NC = SbIsPEC ? 1 : 2;
+      for(int i=0; i<NR; i++)
+       for(int j=0; j<NC; j++)
+        { // for a PEC row or column, the lone entry is the (0,j) or (i,0)
+          // entry with the G-type prefactor in the first slot
+          cdouble Entry = Entries[i][j];
+          M->SetEntry(X+i, Y+j, Entry);
+          if (Symmetric && nea!=neb)
+           M->SetEntry(Y+j, X+i, Entry);
+        };
+    };
+
+  /*--------------------------------------------------------------*/
+  /*- surface-impedance contributions are computed directly      -*/
+  /*--------------------------------------------------------------*/
+  if ( Symmetric && G->Surfaces[nsa]->SurfaceZeta )
+   { GetSSIArgStruct GetSSIArgs, *Args=&GetSSIArgs;
+     InitGetSSIArgs(Args);
+     Args->G=G;
+     Args->Sa=Args->Sb=G->Surfaces[nsa];
+     Args->Omega=Omega;
+     Args->B=M;
+     Args->RowOffset=RowOffset;
+     Args->ColOffset=ColOffset;
+     AddSurfaceZetaContributionToBEMMatrix(Args);
+   };
+
+  return true;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+HMatrix *BEMMatrixInterpolator::Assemble(cdouble Omega, HMatrix *M)
+{
+  if (!Contains(Omega))
+   return 0;
+
+  if (M==0)
+   M=G->AllocateBEMMatrix();
+  else if ( M->NR != G->TotalBFs || M->NC != G->TotalBFs )
+   { Warn("wrong-size matrix passed to BEMMatrixInterpolator::Assemble; reallocating...");
+     M=G->AllocateBEMMatrix();
+   };
+
+  // as in RWGGeometry::AssembleBEMMatrix, forget any factorization
+  // of the previous matrix before overwriting its entries
+  M->ResetFactorization();
+  M->UseLDLT = ( RWGGeometry::UseSymmetricFactorization && M->StorageType==LHM_NORMAL );
+
+  int NS=G->NumSurfaces;
+  for(int ns=0; ns<NS; ns++)
+   for(int nsp=ns; nsp<NS; nsp++)
+    { int RowOffset=G->BFIndexOffset[ns], ColOffset=G->BFIndexOffset[nsp];
+      if ( AssembleBlock(ns, nsp, Omega, M, RowOffset, ColOffset) )
+       continue;
+
+      // blocks over the memory budget are assembled as in
+      // RWGGeometry::AssembleBEMMatrix, reusing the (already
+      // assembled) diagonal block of an identical object
+      int nsm=G->Mate[ns];
+      if (ns==nsp && nsm!=-1)
+       { int Dim=G->Surfaces[ns]->NumBFs, MateOffset=G->BFIndexOffset[nsm];
+         M->InsertBlock(M, RowOffset, RowOffset, Dim, Dim, MateOffset, MateOffset);
+       }
+      else
+       G->AssembleBEMMatrixBlock(ns, nsp, Omega, 0, M, 0, RowOffset, ColOffset);
+    };
+
+  // the matrix is symmetric; fill in the blocks below the diagonal
+  if (M->StorageType==LHM_NORMAL)
+   for(int ns=0; ns<NS; ns++)
+    for(int nsp=ns+1; nsp<NS; nsp++)
+     { int RowOffset=G->BFIndexOffset[ns], NR=G->Surfaces[ns]->NumBFs;
+       int ColOffset=G->BFIndexOffset[nsp], NC=G->Surfaces[nsp]->NumBFs;
+       for(int nr=0; nr<NR; nr++)
+        for(int nc=0; nc<NC; nc++)
+         M->SetEntry(ColOffset+nc, RowOffset+nr, M->GetEntry(RowOffset+nr, ColOffset+nc));
+     };
+
+  return M;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+BEMMatrixInterpolator *CreateBEMMatrixInterpolator(RWGGeometry *G, HVector *OmegaList)
+{
+  if (G->LBasis)
+   { Warn("BEM matrix interpolation is not supported for periodic geometries (disabling)");
+     return 0;
+   };
+  if ( OmegaList==0 || OmegaList->N<2 )
+   { Warn("BEM matrix interpolation requires at least two frequencies (disabling)");
+     return 0;
+   };
+
+  bool AllReal=true, AllImag=true;
+  double Min=HUGE_VAL, Max=-HUGE_VAL;
+  for(int n=0; n<OmegaList->N; n++)
+   { cdouble Omega=OmegaList->GetEntry(n);
+     if (imag(Omega)!=0.0) AllReal=false;
+     if (real(Omega)!=0.0) AllImag=false;
+     double x = (real(Omega)!=0.0) ? real(Omega) : imag(Omega);
+     if (x<Min) Min=x;
+     if (x>Max) Max=x;
+   };
+
+  if ( !AllReal && !AllImag )
+   { Warn("BEM matrix interpolation requires all-real or all-imaginary frequencies (disabling)");
+     return 0;
+   };
+  if ( Min==Max )
+   { Warn("BEM matrix interpolation requires at least two distinct frequencies (disabling)");
+     return 0;
+   };
+
+  cdouble Unit = AllReal ? 1.0 : II;
+  return new BEMMatrixInterpolator(G, Min*Unit, Max*Unit);
+}
+
+} // namespace scuff
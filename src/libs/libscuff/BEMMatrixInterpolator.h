@@ -0,0 +1,135 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * BEMMatrixInterpolator.h -- fast assembly of the BEM matrix at many
+ *                         -- closely-spaced frequencies by Chebyshev
+ *                         -- interpolation of the edge-edge integrals
+ */
+
+#ifndef BEMMATRIXINTERPOLATOR_H
+#define BEMMATRIXINTERPOLATOR_H
+
+#include <libhmat.h>
+
+namespace scuff {
+
+class RWGGeometry;
+
+/***************************************************************/
+/* The BEM matrix entries are linear combinations of the       */
+/* integrals <b_a|G_r|b_b> and <b_a|C_r|b_b> of the homogeneous */
+/* dyadic Green's functions of each region r, with frequency-  */
+/* and material-dependent prefactors. After dividing out the   */
+/* phase exp(i*k_r*R_ab), where R_ab is the distance between   */
+/* the edge centroids, those integrals are smooth functions of */
+/* frequency, so we tabulate them once at a few Chebyshev nodes */
+/* on a frequency interval and then rebuild the matrix at any  */
+/* frequency in the interval by evaluating the Chebyshev series,*/
+/* restoring the phase, and applying the exact prefactors      */
+/* (including the material properties) at that frequency.      */
+/*                                                             */
+/* The frequency range [OmegaMin, OmegaMax] (a line segment in */
+/* the complex plane, e.g. a range of real or of imaginary     */
+/* frequencies) is split into NumIntervals equal intervals.    */
+/* The data for each matrix block are computed the first time  */
+/* the block is requested at a frequency in a given interval,  */
+/* and the interval is bisected (up to MaxBisections times) if */
+/* the estimated interpolation error exceeds Tolerance. Only   */
+/* one interval per block is kept in memory, so sweeps should  */
+/* visit frequencies in order.                                 */
+/*                                                             */
+/* The tabulated data for a block take NumNodes x 2 x (number */
+/* of common regions) complex numbers per edge pair, i.e. 9-18 */
+/* times the storage of the block itself with the default      */
+/* settings. Blocks whose data would take the total beyond a   */
+/* memory budget (by default, half of the physical memory) are */
+/* not interpolated: AssembleBlock() returns false for them,   */
+/* and Assemble() assembles them directly.                     */
+/*                                                             */
+/* Defaults may be overridden by the environment variables     */
+/* SCUFF_INTERP_INTERVALS, SCUFF_INTERP_NODES,                 */
+/* SCUFF_INTERP_TOLERANCE, and SCUFF_INTERP_MAX_MB (the memory */
+/* budget in megabytes).                                       */
+/*                                                             */
+/* Limitations: compact (non-periodic) geometries only, and    */
+/* off-diagonal blocks are assumed not to change between calls */
+/* (call Reset() after transforming the geometry).             */
+/***************************************************************/
+typedef struct BMIBlock
+ { int nsa, nsb;
+   int NumRegions;
+   double tMin, tMax;          // interval covered, in [0,1]
+   double Error;               // estimated relative interpolation error
+   double *R;                  // distances between edge centroids
+   cdouble *Coefficients;      // Chebyshev coefficients, see .cc file
+   bool OverBudget;            // true if the block is assembled directly
+ } BMIBlock;
+
+class BEMMatrixInterpolator
+ {
+  public:
+
+   BEMMatrixInterpolator(RWGGeometry *G, cdouble OmegaMin, cdouble OmegaMax,
+                         int NumIntervals=0, int NumNodes=0, double Tolerance=0.0);
+   ~BEMMatrixInterpolator();
+
+   // true if Omega lies in the frequency range
+   bool Contains(cdouble Omega);
+
+   // stamp the (nsa,nsb) block of the BEM matrix at frequency Omega
+   // into M (same conventions as RWGGeometry::AssembleBEMMatrixBlock);
+   // returns false, leaving M untouched, if Omega is out of range or
+   // if the block is not interpolated because of the memory budget
+   bool AssembleBlock(int nsa, int nsb, cdouble Omega, HMatrix *M,
+                      int RowOffset=0, int ColOffset=0);
+
+   // assemble the full BEM matrix (same conventions as
+   // RWGGeometry::AssembleBEMMatrix), assembling any blocks that
+   // are over the memory budget directly; returns 0 if Omega is
+   // out of range
+   HMatrix *Assemble(cdouble Omega, HMatrix *M=0);
+
+   // discard all tabulated data
+   void Reset();
+
+  private:
+   RWGGeometry *G;
+   cdouble OmegaMin, DeltaOmega;
+   int NumIntervals, NumNodes, MaxBisections;
+   double Tolerance;
+   double MaxMemory;           // memory budget for tabulated data, in bytes
+   double MemoryUsed;
+
+   BMIBlock **Blocks;          // NumSurfaces x NumSurfaces, created on demand
+   double *DCTMatrix;          // node values -> Chebyshev coefficients
+
+   double GetT(cdouble Omega, bool *InRange=0);
+   double GetBlockMemory(int nsa, int nsb);
+   void TabulateBlock(BMIBlock *B, double tMin, double tMax);
+ };
+
+// create an interpolator covering all frequencies in OmegaList,
+// which must be all real or all imaginary; returns 0 (with a
+// warning) if the list or the geometry is not suitable
+BEMMatrixInterpolator *CreateBEMMatrixInterpolator(RWGGeometry *G, HVector *OmegaList);
+
+} // namespace scuff
+
+#endif // BEMMATRIXINTERPOLATOR_H
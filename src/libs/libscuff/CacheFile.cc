@@ -0,0 +1,571 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * CacheFile.cc  -- indexed, memory-mappable binary files of fixed-size
+ *               -- (key, data) records, used to store the FIPPI and
+ *               -- FIBBI caches on disk
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <libhrutil.h>
+
+#include "CacheFile.h"
+
+namespace scuff {
+
+/***************************************************************/
+/* file layout (all multi-byte quantities little-endian):      */
+/*                                                             */
+/*  bytes   0--127: header                                     */
+/*     0-- 15  'SCUFFCACHEFILE' + zero padding                 */
+/*    16-- 19  byte-order mark 0x01020304                      */
+/*    20-- 23  format version                                  */
+/*    24-- 31  record type ('FIPPI', 'FIBBI') + zero padding   */
+/*    32-- 51  key size, key word size, data size, data word   */
+/*             size, record size (uint32 each)                 */
+/*    56-- 95  number of indexed records, number of index      */
+/*             slots, offset of index, offset of first record, */
+/*             number of appended records (uint64 each)        */
+/*                                                             */
+/*  next 8*NumIndexSlots bytes: open-addressing hash index of  */
+/*  the indexed records. each slot is zero (empty) or holds    */
+/*  the upper 32 bits of the key hash in its upper half and    */
+/*  (record number + 1) in its lower half, so that most probes */
+/*  that do not match are rejected without touching the record.*/
+/*                                                             */
+/*  next NumIndexed*RecordSize bytes: the indexed records.     */
+/*  next NumAppended*RecordSize bytes: records appended since  */
+/*  the index was last built (indexed in memory on loading).   */
+/*                                                             */
+/*  each record is the key, zero-padded to a multiple of 8     */
+/*  bytes, followed by the data, zero-padded likewise, so that */
+/*  the data of every record is 8-byte aligned in the mapping. */
+/*                                                             */
+/* any bytes beyond the end of the last appended record (left  */
+/* by an append that was interrupted before it could update    */
+/* the header) are ignored.                                    */
+/***************************************************************/
+#define CF_HEADERSIZE 128
+#define CF_VERSION    1
+#define CF_BYTEORDER  0x01020304
+#define CF_MINSLOTS   16
+#define CF_MAXKEYSIZE 256
+
+static const char CF_Signature[16]="SCUFFCACHEFILE";
+
+typedef struct CacheFileHeader
+ { char Type[8];
+   uint32_t KeySize, KeyWordSize, DataSize, DataWordSize, RecordSize;
+   uint64_t NumIndexed, NumIndexSlots, IndexOffset, RecordOffset, NumAppended;
+ } CacheFileHeader;
+
+/*--------------------------------------------------------------*/
+/*- byte-order utilities ---------------------------------------*/
+/*--------------------------------------------------------------*/
+static bool HostIsLittleEndian()
+{ uint32_t One=1;
+  return *((unsigned char *)&One)==1;
+}
+
+static void SwapWords(char *Buffer, size_t Size, int WordSize)
+{ for(size_t n=0; n+WordSize<=Size; n+=WordSize)
+   for(int i=0, j=WordSize-1; i<j; i++, j--)
+    { char c=Buffer[n+i]; Buffer[n+i]=Buffer[n+j]; Buffer[n+j]=c; };
+}
+
+static void Put32(unsigned char *p, uint32_t u)
+{ for(int n=0; n<4; n++) p[n] = (unsigned char)(u>>(8*n)); }
+
+static void Put64(unsigned char *p, uint64_t u)
+{ for(int n=0; n<8; n++) p[n] = (unsigned char)(u>>(8*n)); }
+
+static uint32_t Get32(const unsigned char *p)
+{ uint32_t u=0;
+  for(int n=3; n>=0; n--) u = (u<<8) | p[n];
+  return u;
+}
+
+static uint64_t Get64(const unsigned char *p)
+{ uint64_t u=0;
+  for(int n=7; n>=0; n--) u = (u<<8) | p[n];
+  return u;
+}
+
+static int RoundUp8(int n) { return (n+7) & ~7; }
+
+/*--------------------------------------------------------------*/
+/*- header encoding / decoding ---------------------------------*/
+/*--------------------------------------------------------------*/
+static void InitHeader(CacheFileHeader *H, const CacheFileFormat *F)
+{ memset(H, 0, sizeof(*H));
+  strncpy(H->Type, F->Type, 7);
+  H->KeySize      = F->KeySize;
+  H->KeyWordSize  = F->KeyWordSize;
+  H->DataSize     = F->DataSize;
+  H->DataWordSize = F->DataWordSize;
+  H->RecordSize   = RoundUp8(F->KeySize) + RoundUp8(F->DataSize);
+  H->IndexOffset  = CF_HEADERSIZE;
+}
+
+static void EncodeHeader(const CacheFileHeader *H, unsigned char *p)
+{ memset(p, 0, CF_HEADERSIZE);
+  memcpy(p, CF_Signature, 16);
+  Put32(p+16, CF_BYTEORDER);
+  Put32(p+20, CF_VERSION);
+  memcpy(p+24, H->Type, 8);
+  Put32(p+32, H->KeySize);
+  Put32(p+36, H->KeyWordSize);
+  Put32(p+40, H->DataSize);
+  Put32(p+44, H->DataWordSize);
+  Put32(p+48, H->RecordSize);
+  Put64(p+56, H->NumIndexed);
+  Put64(p+64, H->NumIndexSlots);
+  Put64(p+72, H->IndexOffset);
+  Put64(p+80, H->RecordOffset);
+  Put64(p+88, H->NumAppended);
+}
+
+// returns an error message, or 0 if the header is valid and matches F
+static const char *DecodeHeader(const unsigned char *p, const CacheFileFormat *F,
+                                CacheFileHeader *H)
+{
+  if ( memcmp(p, CF_Signature, 16) )
+   return "invalid cache file";
+  if ( Get32(p+16)!=CF_BYTEORDER )
+   return "invalid byte-order mark";
+  if ( Get32(p+20)!=CF_VERSION )
+   return "unsupported cache file version";
+
+  memcpy(H->Type, p+24, 8);
+  H->Type[7]=0;
+  H->KeySize       = Get32(p+32);
+  H->KeyWordSize   = Get32(p+36);
+  H->DataSize      = Get32(p+40);
+  H->DataWordSize  = Get32(p+44);
+  H->RecordSize    = Get32(p+48);
+  H->NumIndexed    = Get64(p+56);
+  H->NumIndexSlots = Get64(p+64);
+  H->IndexOffset   = Get64(p+72);
+  H->RecordOffset  = Get64(p+80);
+  H->NumAppended   = Get64(p+88);
+
+  CacheFileHeader Expected;
+  InitHeader(&Expected, F);
+  if (    strcmp(H->Type, Expected.Type)
+       || H->KeySize!=Expected.KeySize
+       || H->KeyWordSize!=Expected.KeyWordSize
+       || H->DataSize!=Expected.DataSize
+       || H->DataWordSize!=Expected.DataWordSize
+       || H->RecordSize!=Expected.RecordSize
+     )
+   return "cache file record format does not match";
+
+  if (    H->NumIndexSlots<CF_MINSLOTS
+       || (H->NumIndexSlots & (H->NumIndexSlots-1))
+       || H->NumIndexSlots < H->NumIndexed+1
+       || H->IndexOffset!=CF_HEADERSIZE
+       || H->RecordOffset!=H->IndexOffset + 8*H->NumIndexSlots
+     )
+   return "corrupted cache file index";
+
+  return 0;
+}
+
+static uint64_t ValidSize(const CacheFileHeader *H)
+{ return H->RecordOffset + (H->NumIndexed + H->NumAppended)*H->RecordSize; }
+
+/*--------------------------------------------------------------*/
+/*- convert a record between host and file representations.    -*/
+/*- Buffer must have room for RecordSize bytes.                -*/
+/*--------------------------------------------------------------*/
+static void PackRecord(const CacheFileFormat *F, const void *Key, const void *Data,
+                       char *Buffer)
+{ int KeySlotSize=RoundUp8(F->KeySize);
+  int RecordSize=KeySlotSize + RoundUp8(F->DataSize);
+  memset(Buffer, 0, RecordSize);
+  memcpy(Buffer, Key, F->KeySize);
+  memcpy(Buffer+KeySlotSize, Data, F->DataSize);
+  if (!HostIsLittleEndian())
+   { SwapWords(Buffer, F->KeySize, F->KeyWordSize);
+     SwapWords(Buffer+KeySlotSize, F->DataSize, F->DataWordSize);
+   };
+}
+
+/***************************************************************/
+/* 64-bit FNV-1a hash of the little-endian representation of   */
+/* the key, followed by a final avalanche step so that the low */
+/* bits used to select index slots are well mixed.             */
+/***************************************************************/
+uint64_t CacheFileHash(const CacheFileFormat *F, const void *Key)
+{
+  const unsigned char *p=(const unsigned char *)Key;
+  unsigned char Buffer[CF_MAXKEYSIZE];
+  if (!HostIsLittleEndian())
+   { memcpy(Buffer, Key, F->KeySize);
+     SwapWords((char *)Buffer, F->KeySize, F->KeyWordSize);
+     p=Buffer;
+   };
+
+  uint64_t h=14695981039346656037ULL;
+  for(int n=0; n<F->KeySize; n++)
+   { h ^= p[n];
+     h *= 1099511628211ULL;
+   };
+
+  h ^= h>>33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h>>33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h>>33;
+  return h;
+}
+
+/*--------------------------------------------------------------*/
+/*- index slot manipulation ------------------------------------*/
+/*--------------------------------------------------------------*/
+static uint64_t MakeSlot(uint64_t Hash, unsigned long nr)
+{ return (Hash & 0xFFFFFFFF00000000ULL) | (uint64_t)(nr+1); }
+
+static const void *ProbeIndex(CacheFile *CF, const uint64_t *Slots,
+                              unsigned long NumSlots, const void *Key,
+                              uint64_t Hash)
+{
+  uint64_t Mask=NumSlots-1, Tag=Hash>>32;
+  for(uint64_t n=Hash&Mask; ; n=(n+1)&Mask)
+   { uint64_t Slot=Slots[n];
+     if (Slot==0)
+      return 0;
+     if ( (Slot>>32)!=Tag )
+      continue;
+     unsigned long nr=(unsigned long)(Slot & 0xFFFFFFFFULL) - 1;
+     if ( !memcmp(GetCacheFileKey(CF, nr), Key, CF->KeySize) )
+      return GetCacheFileData(CF, nr);
+   };
+}
+
+static unsigned long NumSlotsFor(unsigned long NumRecords)
+{ unsigned long NumSlots=CF_MINSLOTS;
+  while( NumSlots < 2*NumRecords )
+   NumSlots*=2;
+  return NumSlots;
+}
+
+/***************************************************************/
+/* open a cache file for reading.                              */
+/* the file is locked (shared) while the header is read and    */
+/* the file is mapped, so that we never see a header that is   */
+/* being updated by a process appending to the file. once      */
+/* mapped, the file may be appended to or replaced by other    */
+/* processes without affecting us.                             */
+/***************************************************************/
+CacheFile *OpenCacheFile(const char *FileName, const CacheFileFormat *F,
+                         const char **ErrMsg)
+{
+  const char *DummyErrMsg;
+  if (ErrMsg==0) ErrMsg=&DummyErrMsg;
+  *ErrMsg=0;
+
+  if (F->KeySize > CF_MAXKEYSIZE)
+   { *ErrMsg="key size too large";
+     return 0;
+   };
+
+  int fd=open(FileName, O_RDONLY);
+  if (fd<0)
+   { *ErrMsg="could not open file";
+     return 0;
+   };
+  flock(fd, LOCK_SH);
+
+  CacheFile *CF=0;
+  CacheFileHeader H;
+  unsigned char HBuffer[CF_HEADERSIZE];
+  struct stat FileStats;
+  char *Base=0;
+  size_t Size=0;
+  bool Mapped=false;
+  if (    fstat(fd, &FileStats)
+       || FileStats.st_size < CF_HEADERSIZE
+       || pread(fd, HBuffer, CF_HEADERSIZE, 0)!=CF_HEADERSIZE
+     )
+   *ErrMsg="invalid cache file";
+  else
+   *ErrMsg=DecodeHeader(HBuffer, F, &H);
+
+  if (*ErrMsg==0)
+   { Size=(size_t)ValidSize(&H);
+     if ( (uint64_t)FileStats.st_size < Size )
+      *ErrMsg="cache file is truncated";
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- on little-endian hosts we map the file and use it in place; */
+  /*- otherwise we read it into memory and convert to host order. */
+  /*--------------------------------------------------------------*/
+  if (*ErrMsg==0 && HostIsLittleEndian())
+   { void *p=mmap(0, Size, PROT_READ, MAP_SHARED, fd, 0);
+     if (p==MAP_FAILED)
+      *ErrMsg="could not map cache file";
+     else
+      { Base=(char *)p;
+        Mapped=true;
+#ifdef MADV_RANDOM
+        madvise(p, Size, MADV_RANDOM);
+#endif
+      };
+   }
+  else if (*ErrMsg==0)
+   { Base=(char *)mallocEC(Size);
+     if ( pread(fd, Base, Size, 0) != (ssize_t)Size )
+      { *ErrMsg="could not read cache file";
+        free(Base);
+        Base=0;
+      }
+     else
+      { SwapWords(Base + H.IndexOffset, 8*H.NumIndexSlots, 8);
+        int KeySlotSize=RoundUp8(H.KeySize);
+        for(uint64_t nr=0; nr<H.NumIndexed+H.NumAppended; nr++)
+         { char *R=Base + H.RecordOffset + nr*H.RecordSize;
+           SwapWords(R, H.KeySize, H.KeyWordSize);
+           SwapWords(R+KeySlotSize, H.DataSize, H.DataWordSize);
+         };
+      };
+   };
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  if (*ErrMsg)
+   return 0;
+
+  CF=(CacheFile *)mallocEC(sizeof(CacheFile));
+  CF->FileName      = strdupEC(FileName);
+  CF->Base          = Base;
+  CF->Size          = Size;
+  CF->Mapped        = Mapped;
+  CF->KeySize       = H.KeySize;
+  CF->KeySlotSize   = RoundUp8(H.KeySize);
+  CF->RecordSize    = H.RecordSize;
+  CF->NumIndexed    = H.NumIndexed;
+  CF->NumIndexSlots = H.NumIndexSlots;
+  CF->NumAppended   = H.NumAppended;
+  CF->Index         = (const uint64_t *)(Base + H.IndexOffset);
+  CF->Records       = Base + H.RecordOffset;
+
+  /*--------------------------------------------------------------*/
+  /*- build an in-memory index for the appended records          -*/
+  /*--------------------------------------------------------------*/
+  CF->NumAppendSlots = NumSlotsFor(CF->NumAppended);
+  CF->AppendIndex    = (uint64_t *)mallocEC(CF->NumAppendSlots*sizeof(uint64_t));
+  memset(CF->AppendIndex, 0, CF->NumAppendSlots*sizeof(uint64_t));
+  uint64_t Mask=CF->NumAppendSlots-1;
+  for(unsigned long nr=CF->NumIndexed; nr<GetCacheFileRecords(CF); nr++)
+   { uint64_t Hash=CacheFileHash(F, GetCacheFileKey(CF,nr));
+     uint64_t n=Hash&Mask;
+     while( CF->AppendIndex[n] )
+      n=(n+1)&Mask;
+     CF->AppendIndex[n]=MakeSlot(Hash, nr);
+   };
+
+  return CF;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void CloseCacheFile(CacheFile *CF)
+{
+  if (!CF) return;
+  if (CF->Mapped)
+   munmap(CF->Base, CF->Size);
+  else
+   free(CF->Base);
+  free(CF->AppendIndex);
+  free(CF->FileName);
+  free(CF);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+const void *LookupCacheFile(CacheFile *CF, const void *Key, uint64_t Hash)
+{
+  const void *Data=ProbeIndex(CF, CF->Index, CF->NumIndexSlots, Key, Hash);
+  if (Data==0 && CF->NumAppended>0)
+   Data=ProbeIndex(CF, CF->AppendIndex, CF->NumAppendSlots, Key, Hash);
+  return Data;
+}
+
+/***************************************************************/
+/* write a complete cache file with a freshly-built index.     */
+/***************************************************************/
+long WriteCacheFile(const char *FileName, const CacheFileFormat *F,
+                    unsigned long NumRecords, const void **Keys, const void **Data)
+{
+  if ( F->KeySize > CF_MAXKEYSIZE || NumRecords >= 0xFFFFFFFFUL )
+   return -1;
+
+  /*--------------------------------------------------------------*/
+  /*- build the index, dropping duplicate keys -------------------*/
+  /*--------------------------------------------------------------*/
+  CacheFileHeader H;
+  InitHeader(&H, F);
+  H.NumIndexSlots = NumSlotsFor(NumRecords);
+  H.RecordOffset  = H.IndexOffset + 8*H.NumIndexSlots;
+
+  uint64_t *Index=(uint64_t *)mallocEC(H.NumIndexSlots*sizeof(uint64_t));
+  memset(Index, 0, H.NumIndexSlots*sizeof(uint64_t));
+  unsigned long *Order=(unsigned long *)mallocEC((NumRecords+1)*sizeof(unsigned long));
+  unsigned long NumUnique=0;
+  uint64_t Mask=H.NumIndexSlots-1;
+  for(unsigned long nr=0; nr<NumRecords; nr++)
+   { uint64_t Hash=CacheFileHash(F, Keys[nr]), Tag=Hash>>32;
+     for(uint64_t n=Hash&Mask; ; n=(n+1)&Mask)
+      { if (Index[n]==0)
+         { Index[n]=MakeSlot(Hash, NumUnique);
+           Order[NumUnique++]=nr;
+           break;
+         };
+        unsigned long nu=(unsigned long)(Index[n] & 0xFFFFFFFFULL) - 1;
+        if ( (Index[n]>>32)==Tag && !memcmp(Keys[Order[nu]], Keys[nr], F->KeySize) )
+         break;
+      };
+   };
+  H.NumIndexed=NumUnique;
+
+  /*--------------------------------------------------------------*/
+  /*- write everything to a temporary file in the same directory -*/
+  /*--------------------------------------------------------------*/
+  char *TempName=vstrdup("%s.XXXXXX",FileName);
+  int fd=mkstemp(TempName);
+  FILE *f = (fd<0) ? 0 : fdopen(fd,"w");
+  bool Success = (f!=0);
+  if (Success)
+   { fchmod(fd, 0644);
+
+     unsigned char HBuffer[CF_HEADERSIZE];
+     EncodeHeader(&H, HBuffer);
+     Success = (fwrite(HBuffer, CF_HEADERSIZE, 1, f)==1);
+
+     if (!HostIsLittleEndian())
+      SwapWords((char *)Index, 8*H.NumIndexSlots, 8);
+     Success = Success && (fwrite(Index, 8, H.NumIndexSlots, f)==H.NumIndexSlots);
+
+     char *Buffer=(char *)mallocEC(H.RecordSize);
+     for(unsigned long nu=0; Success && nu<NumUnique; nu++)
+      { PackRecord(F, Keys[Order[nu]], Data[Order[nu]], Buffer);
+        Success = (fwrite(Buffer, H.RecordSize, 1, f)==1);
+      };
+     free(Buffer);
+
+     Success = Success && (fflush(f)==0) && (fsync(fd)==0);
+     if ( fclose(f) ) Success=false;
+   }
+  else if (fd>=0)
+   close(fd);
+
+  /*--------------------------------------------------------------*/
+  /*- rename into place; any process currently appending to the  -*/
+  /*- old file holds an exclusive lock on it, so we wait for that -*/
+  /*- to finish, and the appender checks after locking that the   -*/
+  /*- file it opened has not been replaced in the meantime.       -*/
+  /*--------------------------------------------------------------*/
+  if (Success)
+   { int oldfd=open(FileName, O_RDONLY);
+     if (oldfd>=0) flock(oldfd, LOCK_EX);
+     Success = (rename(TempName, FileName)==0);
+     if (oldfd>=0) { flock(oldfd, LOCK_UN); close(oldfd); };
+   };
+  if (!Success && fd>=0)
+   unlink(TempName);
+
+  free(TempName);
+  free(Index);
+  free(Order);
+  return Success ? (long)NumUnique : -1;
+}
+
+/***************************************************************/
+/* append records to an existing file. the records are written */
+/* first, and the header is updated only once they are safely  */
+/* on disk, so an interrupted append leaves the file valid.    */
+/***************************************************************/
+long AppendCacheFile(const char *FileName, const CacheFileFormat *F,
+                     unsigned long NumRecords, const void **Keys, const void **Data,
+                     double MaxAppendFraction)
+{
+  int fd=open(FileName, O_RDWR);
+  if (fd<0)
+   return -1;
+  flock(fd, LOCK_EX);
+
+  CacheFileHeader H;
+  unsigned char HBuffer[CF_HEADERSIZE];
+  struct stat FileStats, PathStats;
+  bool Success
+   =    fstat(fd, &FileStats)==0
+     && stat(FileName, &PathStats)==0
+     && FileStats.st_ino==PathStats.st_ino
+     && FileStats.st_dev==PathStats.st_dev
+     && FileStats.st_size>=CF_HEADERSIZE
+     && pread(fd, HBuffer, CF_HEADERSIZE, 0)==CF_HEADERSIZE
+     && DecodeHeader(HBuffer, F, &H)==0
+     && (uint64_t)FileStats.st_size >= ValidSize(&H)
+     && H.NumIndexed + H.NumAppended + NumRecords < 0xFFFFFFFFUL
+     && (    MaxAppendFraction<0.0
+          || (double)(H.NumAppended + NumRecords) <= MaxAppendFraction*(double)H.NumIndexed
+        );
+
+  if (Success && NumRecords>0)
+   {
+     off_t Offset=(off_t)ValidSize(&H);
+     char *Buffer=(char *)mallocEC(H.RecordSize);
+     for(unsigned long nr=0; Success && nr<NumRecords; nr++, Offset+=H.RecordSize)
+      { PackRecord(F, Keys[nr], Data[nr], Buffer);
+        Success = (pwrite(fd, Buffer, H.RecordSize, Offset)==(ssize_t)H.RecordSize);
+      };
+     free(Buffer);
+     Success = Success && (fsync(fd)==0);
+
+     if (Success)
+      { H.NumAppended += NumRecords;
+        EncodeHeader(&H, HBuffer);
+        Success =    pwrite(fd, HBuffer, CF_HEADERSIZE, 0)==CF_HEADERSIZE
+                  && fsync(fd)==0;
+      };
+   };
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  return Success ? (long)NumRecords : -1;
+}
+
+} // namespace scuff
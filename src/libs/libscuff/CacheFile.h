@@ -0,0 +1,106 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * CacheFile.h   -- indexed, memory-mappable binary files of fixed-size
+ *               -- (key, data) records, used to store the FIPPI and
+ *               -- FIBBI caches on disk
+ */
+
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace scuff {
+
+/***************************************************************/
+/* description of the records stored in a cache file. keys and */
+/* data are arrays of KeyWordSize-byte (resp. DataWordSize-byte)*/
+/* words (i.e. float / double), which is all we need to know   */
+/* to convert between host and file byte order.                */
+/***************************************************************/
+typedef struct CacheFileFormat
+ { const char *Type;           // e.g. "FIPPI", at most 7 characters
+   int KeySize, KeyWordSize;
+   int DataSize, DataWordSize;
+ } CacheFileFormat;
+
+/***************************************************************/
+/* an open (read-only) cache file. on little-endian hosts the  */
+/* file is mapped into memory and queried in place; on         */
+/* big-endian hosts it is read into memory and byte-swapped.   */
+/***************************************************************/
+typedef struct CacheFile
+ { char *FileName;
+   char *Base;                 // start of mapped (or loaded) file
+   size_t Size;
+   bool Mapped;
+
+   int KeySize, KeySlotSize, RecordSize;
+   unsigned long NumIndexed, NumIndexSlots, NumAppended;
+   const uint64_t *Index;      // on-disk index of the first NumIndexed records
+   const char *Records;        // record i starts at Records + i*RecordSize
+   uint64_t *AppendIndex;      // in-memory index of appended records
+   unsigned long NumAppendSlots;
+ } CacheFile;
+
+// hash of a key (in host byte order) as used by the file index
+uint64_t CacheFileHash(const CacheFileFormat *Format, const void *Key);
+
+// open a cache file; returns 0 (and sets *ErrMsg, if non-null)
+// if the file does not exist or does not match Format
+CacheFile *OpenCacheFile(const char *FileName, const CacheFileFormat *Format,
+                         const char **ErrMsg=0);
+void CloseCacheFile(CacheFile *CF);
+
+// look up a key; returns a pointer to the data for the key
+// (valid until CloseCacheFile) or 0 if the key is not present
+const void *LookupCacheFile(CacheFile *CF, const void *Key, uint64_t Hash);
+
+// total number of records, and access to the nrth record
+inline unsigned long GetCacheFileRecords(CacheFile *CF)
+ { return CF->NumIndexed + CF->NumAppended; }
+inline const char *GetCacheFileKey(CacheFile *CF, unsigned long nr)
+ { return CF->Records + nr*CF->RecordSize; }
+inline const char *GetCacheFileData(CacheFile *CF, unsigned long nr)
+ { return CF->Records + nr*CF->RecordSize + CF->KeySlotSize; }
+
+// write a new cache file containing the given records (duplicate
+// keys are written only once). the file is written under a temporary
+// name and renamed into place, so processes that have the old file
+// open are unaffected. returns the number of records written, or -1.
+long WriteCacheFile(const char *FileName, const CacheFileFormat *Format,
+                    unsigned long NumRecords, const void **Keys, const void **Data);
+
+// append records to an existing cache file without rewriting it.
+// returns the number of records appended, or -1 if the file is
+// missing, does not match Format, or if the unindexed appended
+// section would grow beyond MaxAppendFraction times the size of
+// the indexed section (in which case the caller should rewrite
+// the file with WriteCacheFile to rebuild the index). a negative
+// MaxAppendFraction places no limit on the appended section.
+long AppendCacheFile(const char *FileName, const CacheFileFormat *Format,
+                     unsigned long NumRecords, const void **Keys, const void **Data,
+                     double MaxAppendFraction=0.25);
+
+} // namespace scuff
+
+#endif // CACHEFILE_H
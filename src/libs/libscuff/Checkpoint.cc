@@ -0,0 +1,351 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checkpoint.cc -- checkpoint files of integrand samples, used by
+ *               -- the applications to resume interrupted runs
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libhrutil.h>
+
+#include "libscuff.h"
+#include "CacheFile.h"
+#include "rwlock.h"
+
+namespace scuff {
+
+/***************************************************************/
+/* a checkpoint file is a cache file (see CacheFile.h) whose   */
+/* records have keys                                           */
+/*                                                             */
+/*  (TagHash, real(Omega), imag(Omega), HaveK, kx, ky)         */
+/*                                                             */
+/* where TagHash is a hash of the caller's context string and  */
+/* the transformation tag, and whose data are the NumValues    */
+/* integrand values at that point. new samples are appended to */
+/* the file (and synced to disk) as soon as they are computed. */
+/*                                                             */
+/* when running on several MPI ranks, rank r>0 appends to      */
+/* FileName.rank<r> so that no two processes write the same    */
+/* file; on startup, every rank reads all of these files.      */
+/***************************************************************/
+#define CP_KEYLEN 6
+
+static CacheFileFormat CheckpointFormat(int NumValues)
+{ CacheFileFormat F;
+  F.Type         = "CKPT";
+  F.KeySize      = CP_KEYLEN*sizeof(double);
+  F.KeyWordSize  = sizeof(double);
+  F.DataSize     = NumValues*sizeof(double);
+  F.DataWordSize = sizeof(double);
+  return F;
+}
+
+struct CheckpointFile
+ {
+   char *FileName;           // file this process appends to (0 if disabled)
+   char *Context;
+   int NumValues;
+   CacheFileFormat Format;
+
+   // all records known to this process, indexed by an
+   // open-addressing table of (record number + 1)
+   double *Keys, *Values;
+   unsigned long NumRecords, MaxRecords;
+   unsigned long *Slots, NumSlots;
+
+   rwlock Lock;
+ };
+
+/*--------------------------------------------------------------*/
+/*- the first key word is a 64-bit FNV-1a hash of the context  -*/
+/*- string and the tag                                         -*/
+/*--------------------------------------------------------------*/
+static void MakeKey(CheckpointFile *CPF, const char *Tag, cdouble Omega,
+                    const double *kBloch, double Key[CP_KEYLEN])
+{
+  uint64_t h=14695981039346656037ULL;
+  for(const char *p=CPF->Context; *p; p++)
+   { h ^= (unsigned char)(*p); h *= 1099511628211ULL; };
+  h *= 1099511628211ULL;   // separator
+  for(const char *p=(Tag ? Tag : ""); *p; p++)
+   { h ^= (unsigned char)(*p); h *= 1099511628211ULL; };
+  memcpy(Key, &h, sizeof(double));
+
+  // adding 0.0 turns -0.0 into +0.0 so that the two compare equal
+  Key[1] = real(Omega) + 0.0;
+  Key[2] = imag(Omega) + 0.0;
+  Key[3] = kBloch ? 1.0 : 0.0;
+  Key[4] = kBloch ? kBloch[0] + 0.0 : 0.0;
+  Key[5] = kBloch ? kBloch[1] + 0.0 : 0.0;
+}
+
+// must be called with the lock held
+static long FindRecord(CheckpointFile *CPF, const double *Key)
+{ uint64_t Hash=CacheFileHash(&(CPF->Format), Key);
+  unsigned long Mask=CPF->NumSlots-1;
+  for(unsigned long n=Hash&Mask; CPF->Slots[n]; n=(n+1)&Mask)
+   { unsigned long nr=CPF->Slots[n]-1;
+     if ( !memcmp(CPF->Keys + nr*CP_KEYLEN, Key, CP_KEYLEN*sizeof(double)) )
+      return (long)nr;
+   };
+  return -1;
+}
+
+static void IndexRecord(CheckpointFile *CPF, unsigned long nr)
+{ uint64_t Hash=CacheFileHash(&(CPF->Format), CPF->Keys + nr*CP_KEYLEN);
+  unsigned long Mask=CPF->NumSlots-1;
+  unsigned long n=Hash&Mask;
+  while(CPF->Slots[n])
+   n=(n+1)&Mask;
+  CPF->Slots[n]=nr+1;
+}
+
+// add a record to the in-memory store if its key is new;
+// returns false if the key was already present
+static bool AddRecord(CheckpointFile *CPF, const double *Key, const double *Values)
+{
+  if ( FindRecord(CPF, Key) != -1 )
+   return false;
+
+  int NV=CPF->NumValues;
+  if (CPF->NumRecords==CPF->MaxRecords)
+   { CPF->MaxRecords *= 2;
+     CPF->Keys   = (double *)reallocEC(CPF->Keys, CPF->MaxRecords*CP_KEYLEN*sizeof(double));
+     CPF->Values = (double *)reallocEC(CPF->Values, CPF->MaxRecords*NV*sizeof(double));
+   };
+  unsigned long nr=CPF->NumRecords++;
+  memcpy(CPF->Keys + nr*CP_KEYLEN, Key, CP_KEYLEN*sizeof(double));
+  memcpy(CPF->Values + nr*NV, Values, NV*sizeof(double));
+
+  if ( 2*CPF->NumRecords > CPF->NumSlots )
+   { free(CPF->Slots);
+     CPF->NumSlots *= 2;
+     CPF->Slots = (unsigned long *)mallocEC(CPF->NumSlots*sizeof(unsigned long));
+     memset(CPF->Slots, 0, CPF->NumSlots*sizeof(unsigned long));
+     for(unsigned long n=0; n<CPF->NumRecords; n++)
+      IndexRecord(CPF, n);
+   }
+  else
+   IndexRecord(CPF, nr);
+
+  return true;
+}
+
+/***************************************************************/
+/* read all records from one checkpoint file into the store.   */
+/* if NumOwn is non-null, the keys and data of the records in  */
+/* the file are also returned so that it can be rewritten.     */
+/* returns false if the file exists but could not be read.     */
+/***************************************************************/
+static bool LoadCheckpointFile(CheckpointFile *CPF, const char *FileName,
+                               unsigned long *NumOwn=0, double **OwnKeys=0,
+                               double **OwnValues=0)
+{
+  if ( access(FileName, F_OK) )
+   return true;
+
+  const char *ErrMsg;
+  CacheFile *CF=OpenCacheFile(FileName, &(CPF->Format), &ErrMsg);
+  if (CF==0)
+   { Warn("could not read checkpoint file %s (%s)",FileName,ErrMsg);
+     return false;
+   };
+
+  int NV=CPF->NumValues;
+  unsigned long NR=GetCacheFileRecords(CF);
+  if (NumOwn)
+   { *NumOwn    = NR;
+     *OwnKeys   = (double *)mallocEC((NR+1)*CP_KEYLEN*sizeof(double));
+     *OwnValues = (double *)mallocEC((NR+1)*NV*sizeof(double));
+   };
+  for(unsigned long nr=0; nr<NR; nr++)
+   { const double *Key    = (const double *)GetCacheFileKey(CF, nr);
+     const double *Values = (const double *)GetCacheFileData(CF, nr);
+     AddRecord(CPF, Key, Values);
+     if (NumOwn)
+      { memcpy(*OwnKeys + nr*CP_KEYLEN, Key, CP_KEYLEN*sizeof(double));
+        memcpy(*OwnValues + nr*NV, Values, NV*sizeof(double));
+      };
+   };
+  CloseCacheFile(CF);
+
+  Log("Read %lu samples from checkpoint file %s.",NR,FileName);
+  return true;
+}
+
+/***************************************************************/
+/* open a checkpoint file.                                     */
+/*                                                             */
+/* Context is a string identifying the calculation (records    */
+/* written under a different context are never matched), and   */
+/* NumValues is the number of doubles stored per sample.       */
+/*                                                             */
+/* if ReadExisting is true, samples already present in the     */
+/* file are available to ReadCheckpoint; otherwise the file is */
+/* started afresh.                                             */
+/***************************************************************/
+CheckpointFile *OpenCheckpointFile(const char *FileName, const char *Context,
+                                   int NumValues, bool ReadExisting)
+{
+  CheckpointFile *CPF = new CheckpointFile;
+  CPF->Context    = strdupEC(Context ? Context : "");
+  CPF->NumValues  = NumValues;
+  CPF->Format     = CheckpointFormat(NumValues);
+  CPF->NumRecords = 0;
+  CPF->MaxRecords = 64;
+  CPF->Keys       = (double *)mallocEC(CPF->MaxRecords*CP_KEYLEN*sizeof(double));
+  CPF->Values     = (double *)mallocEC(CPF->MaxRecords*NumValues*sizeof(double));
+  CPF->NumSlots   = 256;
+  CPF->Slots      = (unsigned long *)mallocEC(CPF->NumSlots*sizeof(unsigned long));
+  memset(CPF->Slots, 0, CPF->NumSlots*sizeof(unsigned long));
+
+  int Rank=GetMPIRank(), Size=GetMPISize();
+  CPF->FileName = Rank==0 ? strdupEC(FileName) : vstrdup("%s.rank%i",FileName,Rank);
+
+  /*--------------------------------------------------------------*/
+  /*- read existing samples from the files written by all ranks  -*/
+  /*- of previous runs (which may have used a different number   -*/
+  /*- of ranks). the records in our own file are kept so that we -*/
+  /*- can rewrite it below with a freshly-built index.           -*/
+  /*--------------------------------------------------------------*/
+  unsigned long NumOwn=0;
+  double *OwnKeys=0, *OwnValues=0;
+  bool OwnFileOK=true;
+  if (ReadExisting)
+   { for(int r=0; ; r++)
+      { char *RFileName = r==0 ? strdupEC(FileName) : vstrdup("%s.rank%i",FileName,r);
+        bool Exists = ( access(RFileName, F_OK)==0 );
+        bool Success;
+        if (r==Rank)
+         Success=LoadCheckpointFile(CPF, RFileName, &NumOwn, &OwnKeys, &OwnValues);
+        else
+         Success=LoadCheckpointFile(CPF, RFileName);
+        if (r==Rank) OwnFileOK=Success;
+        free(RFileName);
+        if (!Exists && r>=Size)
+         break;
+      };
+   }
+  else if (Rank==0)
+   { // remove files left by higher ranks of an earlier run
+     for(int r=Size; ; r++)
+      { char *RFileName=vstrdup("%s.rank%i",FileName,r);
+        int Status=unlink(RFileName);
+        free(RFileName);
+        if (Status)
+         break;
+      };
+   };
+
+  // keep a file we could not read rather than overwriting it
+  if (!OwnFileOK)
+   { char *OldFileName=vstrdup("%s.old",CPF->FileName);
+     Warn("moving unreadable checkpoint file %s to %s",CPF->FileName,OldFileName);
+     rename(CPF->FileName, OldFileName);
+     free(OldFileName);
+   };
+
+  const void **KeyPtrs  = (const void **)mallocEC((NumOwn+1)*sizeof(void *));
+  const void **DataPtrs = (const void **)mallocEC((NumOwn+1)*sizeof(void *));
+  for(unsigned long nr=0; nr<NumOwn; nr++)
+   { KeyPtrs[nr]  = OwnKeys + nr*CP_KEYLEN;
+     DataPtrs[nr] = OwnValues + nr*NumValues;
+   };
+  if ( WriteCacheFile(CPF->FileName, &(CPF->Format), NumOwn, KeyPtrs, DataPtrs) < 0 )
+   { Warn("could not create checkpoint file %s (checkpointing disabled)",CPF->FileName);
+     free(CPF->FileName);
+     CPF->FileName=0;
+   };
+  free(KeyPtrs);
+  free(DataPtrs);
+  free(OwnKeys);
+  free(OwnValues);
+
+  return CPF;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void CloseCheckpointFile(CheckpointFile *CPF)
+{
+  if (!CPF) return;
+  free(CPF->FileName);
+  free(CPF->Context);
+  free(CPF->Keys);
+  free(CPF->Values);
+  free(CPF->Slots);
+  delete CPF;
+}
+
+/***************************************************************/
+/* look up the sample at (Tag, Omega, kBloch); kBloch is either*/
+/* null or a 2-vector. returns true (and fills in Values) if   */
+/* the sample was found.                                       */
+/***************************************************************/
+bool ReadCheckpoint(CheckpointFile *CPF, const char *Tag, cdouble Omega,
+                    const double *kBloch, double *Values)
+{
+  if (!CPF) return false;
+
+  double Key[CP_KEYLEN];
+  MakeKey(CPF, Tag, Omega, kBloch, Key);
+
+  CPF->Lock.read_lock();
+  long nr=FindRecord(CPF, Key);
+  if (nr!=-1)
+   memcpy(Values, CPF->Values + nr*CPF->NumValues, CPF->NumValues*sizeof(double));
+  CPF->Lock.read_unlock();
+
+  return (nr!=-1);
+}
+
+/***************************************************************/
+/* record the sample at (Tag, Omega, kBloch) and append it to  */
+/* the checkpoint file.                                        */
+/***************************************************************/
+void WriteCheckpoint(CheckpointFile *CPF, const char *Tag, cdouble Omega,
+                     const double *kBloch, const double *Values)
+{
+  if (!CPF) return;
+
+  double Key[CP_KEYLEN];
+  MakeKey(CPF, Tag, Omega, kBloch, Key);
+
+  CPF->Lock.write_lock();
+  if ( AddRecord(CPF, Key, Values) && CPF->FileName )
+   { const void *KeyPtr=(const void *)Key, *DataPtr=(const void *)Values;
+     if ( AppendCacheFile(CPF->FileName, &(CPF->Format), 1, &KeyPtr, &DataPtr, -1.0) < 0 )
+      { Warn("could not append to checkpoint file %s (checkpointing disabled)",CPF->FileName);
+        free(CPF->FileName);
+        CPF->FileName=0;
+      };
+   };
+  CPF->Lock.write_unlock();
+}
+
+} // namespace scuff
@@ -66,7 +66,8 @@ inline int GetSRFluxIndex(int NX, int nt, int nx, int nq)
 { return nt*NX*NUMSRFLUX + nx*NUMSRFLUX + nq; }
 
 HMatrix *GetSRFluxTrace(RWGGeometry *G, HMatrix *XMatrix, cdouble Omega,
-                        HMatrix *DRMatrix, HMatrix *FMatrix)
+                        HMatrix *DRMatrix, HMatrix *FMatrix,
+                        Workspace *WS)
 { 
   /***************************************************************/
   /* (re)allocate FMatrix as necessary ***************************/
@@ -94,21 +95,14 @@ HMatrix *GetSRFluxTrace(RWGGeometry *G, HMatrix *XMatrix, cdouble Omega,
   /***************************************************************/
   /***************************************************************/
   /***************************************************************/
+  Workspace *MyWS = WS ? WS : AcquireWorkspace();
   int NBF = G->TotalBFs;
-  static int NBFSave = 0, NXSave=0;
-  static HMatrix *RFMatrix=0;
-  if (NBFSave!=NBF || NXSave<NX)
-   { NBFSave = NBF;
-     NXSave  = NX;
-     if (RFMatrix) delete RFMatrix;
-     RFMatrix = new HMatrix(NBF, 6*NX, LHM_COMPLEX);
-   };
+  HMatrix *RFMatrix = MyWS->GetHMatrix(WS_SRFLUX_RFMATRIX, NBF, 6*NX);
   G->GetRFMatrix(Omega, 0, XMatrix, RFMatrix);
 
   /***************************************************************/
-  /* allocate per-thread storage to avoid costly synchronization */
+  /* per-thread storage to avoid costly synchronization          */
   /* primitives in the multithreaded loop                        */
-  /* [note the array is automatically zeroed by mallocEC()]      */
   /***************************************************************/
   int NumThreads=1;
 #ifdef USE_OPENMP
@@ -116,13 +110,8 @@ HMatrix *GetSRFluxTrace(RWGGeometry *G, HMatrix *XMatrix, cdouble Omega,
 #endif
 
   size_t DeltaSRFluxSize = NumThreads*NX*NUMSRFLUX*sizeof(cdouble);
-  static size_t DeltaSRFluxSizeSave=0;
-  static cdouble *DeltaSRFlux = 0;
-  if (DeltaSRFluxSizeSave<DeltaSRFluxSize)
-   { 
-     DeltaSRFluxSizeSave=DeltaSRFluxSize;
-     DeltaSRFlux=(cdouble *)reallocEC(DeltaSRFlux,DeltaSRFluxSize);
-   };
+  cdouble *DeltaSRFlux
+   = (cdouble *)MyWS->GetBuffer(WS_SRFLUX_DELTA, DeltaSRFluxSize);
   memset(DeltaSRFlux, 0, DeltaSRFluxSize);
 
   /***************************************************************/
@@ -221,6 +210,8 @@ HMatrix *GetSRFluxTrace(RWGGeometry *G, HMatrix *XMatrix, cdouble Omega,
     for(int nt=0; nt<NumThreads; nt++)
      FMatrix->AddEntry(nx, nq, real(DeltaSRFlux[ GetSRFluxIndex(NX, nt, nx, nq)] ));
 
+  if (WS==0) ReleaseWorkspace(MyWS);
+
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
@@ -587,7 +578,8 @@ void GetDSIPFTTrace(RWGGeometry *G, cdouble Omega, HMatrix *DRMatrix,
                     double PFT[NUMPFT], bool NeedQuantity[NUMPFT],
                     char *BSMesh, double R, int NumPoints,
                     bool FarField, char *PlotFileName,
-                    GTransformation *GT1, GTransformation *GT2)
+                    GTransformation *GT1, GTransformation *GT2,
+                    Workspace *WS)
 {
   (void) FarField;
   (void) PlotFileName;
@@ -610,7 +602,7 @@ void GetDSIPFTTrace(RWGGeometry *G, cdouble Omega, HMatrix *DRMatrix,
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   HMatrix *SCRMatrix = GetSCRMatrix(BSMesh, R, NumPoints, GT1, GT2);
-  HMatrix *SRMatrix  = GetSRFluxTrace(G, SCRMatrix, Omega, DRMatrix);
+  HMatrix *SRMatrix  = GetSRFluxTrace(G, SCRMatrix, Omega, DRMatrix, 0, WS);
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
@@ -468,7 +468,8 @@ void GetExtinctionPFTIntegrals(RWGGeometry *G, int ns, int ne,
 /***************************************************************/
 void GetExtinctionPFTT(RWGGeometry *G, HVector *KN,
                        IncField *IF, cdouble Omega,
-                       HMatrix *PFTTMatrix, bool Interior)
+                       HMatrix *PFTTMatrix, bool Interior,
+                       Workspace *WS)
 {
   if ( PFTTMatrix->NR!=G->NumSurfaces || PFTTMatrix->NC != NUMPFTT )
    ErrExit("%s:%i: internal error", __FILE__, __LINE__);
@@ -481,12 +482,9 @@ void GetExtinctionPFTT(RWGGeometry *G, HVector *KN,
   int NQ=NUMPFTT;
   int NTNSNQ=NT*NS*NQ;
 
-  static int DeltaPFTTSize=0;
-  static double *DeltaPFTT=0;
-  if (DeltaPFTTSize < NTNSNQ)
-   { DeltaPFTTSize=NTNSNQ;
-     DeltaPFTT=(double *)reallocEC(DeltaPFTT, DeltaPFTTSize*sizeof(double));
-   };
+  Workspace *MyWS = WS ? WS : AcquireWorkspace();
+  double *DeltaPFTT
+   = (double *)MyWS->GetBuffer(WS_EXTPFTT_DELTA, NTNSNQ*sizeof(double));
   memset(DeltaPFTT, 0, NTNSNQ*sizeof(double));
 
 #ifdef USE_OPENMP
@@ -536,6 +534,8 @@ void GetExtinctionPFTT(RWGGeometry *G, HVector *KN,
        for(int nq=PFT_XFORCE; nq<NUMPFTT; nq++)
         PFTTMatrix->AddEntry(ns, nq, FTFactor*dPFTT[nq]);
      };
+
+   if (WS==0) ReleaseWorkspace(MyWS);
 }
 
 /***************************************************************/
@@ -544,7 +544,8 @@ void GetExtinctionPFTT(RWGGeometry *G, HVector *KN,
 HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
                          HVector *KNVector, HMatrix *DRMatrix,
                          HMatrix *PFTMatrix, bool Interior,
-                         int EMTPFTIMethod, bool Itemize)
+                         int EMTPFTIMethod, bool Itemize,
+                         Workspace *WS)
 { 
   /***************************************************************/
   /***************************************************************/
@@ -566,26 +567,15 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
    ErrExit("invalid PFTMatrix in GetEMTPFT");
 
   /***************************************************************/
-  /* ScatteredPFTT[ns] = contributions of surface #ns to         */
-  /*                     scattered PFTT                          */
+  /* ScatteredPFTT[nsb*NS + nsa, nq] = contribution of surface   */
+  /*                                   #nsb to scattered PFTT    */
+  /*                                   quantity #nq on #nsa      */
   /***************************************************************/
-  static int NSSave=0;
-  static HMatrix **ScatteredPFTT=0, *ExtinctionPFTT=0;
-  if (NSSave!=NS)
-   { if (ScatteredPFTT)
-      { for(int ns=0; ns<NSSave; ns++)
-         if (ScatteredPFTT[ns]) 
-          delete ScatteredPFTT[ns];
-        free(ScatteredPFTT);
-       if (ExtinctionPFTT)
-        delete ExtinctionPFTT;
-      };
-     NSSave=NS;
-     ScatteredPFTT=(HMatrix **)mallocEC(NS*sizeof(HMatrix));
-     for(int ns=0; ns<NS; ns++)
-      ScatteredPFTT[ns]=new HMatrix(NS, NUMPFTT);
-     ExtinctionPFTT=new HMatrix(NS, NUMPFTT);
-   };
+  Workspace *MyWS = WS ? WS : AcquireWorkspace();
+  HMatrix *ScatteredPFTT
+   = MyWS->GetHMatrix(WS_EMTPFT_SCATTERED, NS*NS, NUMPFTT, LHM_REAL);
+  HMatrix *ExtinctionPFTT
+   = MyWS->GetHMatrix(WS_EMTPFT_EXTINCTION, NS, NUMPFTT, LHM_REAL);
 
   /***************************************************************/
   /***************************************************************/
@@ -610,14 +600,8 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
   int NQ      = NUMPFTT;
   int NS2NQ   = NS*NS*NQ;
   int NTNS2NQ = NT*NS*NS*NQ; 
-  static int DeltaPFTTSize=0;
-  static double *DeltaPFTT=0;
-  if ( DeltaPFTTSize < NTNS2NQ )
-   { Log("(re)allocating DeltaPFTT (%i,%i)",DeltaPFTTSize,NTNS2NQ);
-     DeltaPFTTSize=NTNS2NQ;
-     if (DeltaPFTT) free(DeltaPFTT);
-     DeltaPFTT = (double *)mallocEC(DeltaPFTTSize*sizeof(double));
-   };
+  double *DeltaPFTT
+   = (double *)MyWS->GetBuffer(WS_EMTPFT_DELTA, NTNS2NQ*sizeof(double));
   memset(DeltaPFTT, 0, NTNS2NQ*sizeof(double));
 
   /*--------------------------------------------------------------*/
@@ -773,19 +757,18 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
   /*--------------------------------------------------------------*/
   /*- accumulate contributions of all threads                     */
   /*--------------------------------------------------------------*/
-  for(int ns=0; ns<NS; ns++)
-   ScatteredPFTT[ns]->Zero();
+  ScatteredPFTT->Zero();
   for(int nsa=0; nsa<NS; nsa++)
    for(int nsb=0; nsb<NS; nsb++)
     for(int nq=0; nq<NQ; nq++)
      for(int nt=0; nt<NT; nt++)
-      ScatteredPFTT[nsb]->AddEntry(nsa, nq, DeltaPFTT[ nt*NS2NQ + nsa*NS*NQ + nsb*NQ + nq ]);
+      ScatteredPFTT->AddEntry(nsb*NS+nsa, nq, DeltaPFTT[ nt*NS2NQ + nsa*NS*NQ + nsb*NQ + nq ]);
 
   /***************************************************************/
   /* get incident-field contributions ****************************/
   /***************************************************************/
   if (IF)
-   GetExtinctionPFTT(G, KNVector, IF, Omega, ExtinctionPFTT, Interior);
+   GetExtinctionPFTT(G, KNVector, IF, Omega, ExtinctionPFTT, Interior, MyWS);
   else
    ExtinctionPFTT->Zero();
    
@@ -806,17 +789,17 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
       for(int nsb=0; nsb<NS; nsb++)
        { 
          if (nq==PFT_PABS)
-          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFTT[nsb]->GetEntry(nsa,PFT_PSCAT));
+          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFTT->GetEntry(nsb*NS+nsa,PFT_PSCAT));
          else if (nq==PFT_PSCAT)
-          PFTMatrix->AddEntry(nsa,nq,+1.0*ScatteredPFTT[nsb]->GetEntry(nsa,PFT_PSCAT));
+          PFTMatrix->AddEntry(nsa,nq,+1.0*ScatteredPFTT->GetEntry(nsb*NS+nsa,PFT_PSCAT));
          else // force or torque 
-          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFTT[nsb]->GetEntry(nsa,nq));
+          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFTT->GetEntry(nsb*NS+nsa,nq));
        };
 
       if (PFT_XTORQUE<=nq && nq<=PFT_ZTORQUE)
        { PFTMatrix->AddEntry(nsa,nq,ExtinctionPFTT->GetEntry(nsa,nq+3));
          for(int nsb=0; nsb<NS; nsb++)
-          PFTMatrix->AddEntry(nsa, nq, -1.0*ScatteredPFTT[nsb]->GetEntry(nsa,nq+3));
+          PFTMatrix->AddEntry(nsa, nq, -1.0*ScatteredPFTT->GetEntry(nsb*NS+nsa,nq+3));
        };
     };
   
@@ -864,7 +847,7 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
          fprintf(f,"%e ",ExtinctionPFTT->GetEntryD(nsa,nq));
         for(int nsb=0; nsb<NS; nsb++)
          for(int nq=0; nq<NUMPFTT; nq++)
-          fprintf(f,"%e ",ScatteredPFTT[nsb]->GetEntryD(nsa,nq));
+          fprintf(f,"%e ",ScatteredPFTT->GetEntryD(nsb*NS+nsa,nq));
         fprintf(f,"\n");
         fclose(f);
       };
@@ -886,6 +869,7 @@ HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
      };
 #endif
 
+  if (WS==0) ReleaseWorkspace(MyWS);
   return PFTMatrix;
 }
   
@@ -143,6 +143,7 @@ void GetEdgeEdgeInteractions(GetEEIArgStruct *Args)
   GetPPIArgs->NumTorqueAxes          = NumTorqueAxes;
   GetPPIArgs->GammaMatrix            = Args->GammaMatrix;
   GetPPIArgs->opFC                   = Args->opFC;
+  GetPPIArgs->opPPC                  = Args->opPPC;
   GetPPIArgs->Displacement           = Args->Displacement;
   GetPPIArgs->GBA                    = Args->GBA;    
   GetPPIArgs->ForceFullEwald         = Args->ForceFullEwald;
@@ -301,6 +302,7 @@ void InitGetEEIArgs(GetEEIArgStruct *Args)
   Args->GammaMatrix=0;
   Args->Displacement=0;
   Args->opFC=0;
+  Args->opPPC=0;
   Args->Force=EEI_NOFORCE;
   Args->GBA=0;
   Args->ForceFullEwald=false;
@@ -0,0 +1,369 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * EdgeMoments.cc -- multipole moments of RWG basis functions, and
+ *                -- evaluation of edge-edge interactions between
+ *                -- well-separated basis functions from the moments
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <libhrutil.h>
+#include <libTriInt.h>
+
+#include "libscuff.h"
+#include "libscuffInternals.h"
+
+namespace scuff {
+
+#define II cdouble(0,1)
+
+/***************************************************************/
+/* For each basis function b(x) we store the moments           */
+/*                                                             */
+/*  \int b_i(x) * xi_{j1} * ... * xi_{jn}  dA,   n=0..3        */
+/*  \int rho(x) * xi_{j1} * ... * xi_{jn}  dA,   n=0..3        */
+/*                                                             */
+/* where xi = x - (edge centroid) and rho = div b. Each moment */
+/* of degree n is stored as a full 3^n tensor with the first   */
+/* index running fastest. Moments about the edge centroid are  */
+/* unchanged when the surface is displaced, so they only need  */
+/* to be recomputed when the surface is rotated.               */
+/***************************************************************/
+#define MOMENTS_PER_DENSITY 40     // 1 + 3 + 9 + 27
+#define MOMENTS_PER_EDGE    160    // 4 densities (b_x, b_y, b_z, rho)
+
+static const int DegreeOffset[4]={0, 1, 4, 13};
+
+// highest Taylor degree retained for the current-current terms
+// (G and C integrals) and the charge-charge terms (G integral);
+// both truncations leave relative errors of order (r/R)^3
+#define MAXDEGREE_J 2
+#define MAXDEGREE_Q 4
+
+/***************************************************************/
+/* compute the moments of a single basis function              */
+/***************************************************************/
+static void ComputeEdgeMoments(RWGSurface *S, RWGEdge *E, double *Moments)
+{
+  memset(Moments, 0, MOMENTS_PER_EDGE*sizeof(double));
+
+  int NumPts;
+  double *TCR=GetTCR(5, &NumPts);  // exact for the degree-4 integrands
+
+  for(int Sign=+1, nPanel=0; nPanel<2; nPanel++, Sign=-1)
+   {
+     int np = (nPanel==0) ? E->iPPanel : E->iMPanel;
+     if (np==-1) continue;
+     RWGPanel *P = S->Panels[np];
+     double *Q   = S->Vertices + 3*((nPanel==0) ? E->iQP : E->iQM);
+     double *V0  = S->Vertices + 3*P->VI[0];
+     double *V1  = S->Vertices + 3*P->VI[1];
+     double *V2  = S->Vertices + 3*P->VI[2];
+     double bPreFac   = Sign*E->Length/(2.0*P->Area);
+     double rhoPreFac = Sign*E->Length/P->Area;
+
+     for(int ncp=0; ncp<NumPts; ncp++)
+      { double u=TCR[3*ncp+0], v=TCR[3*ncp+1], w=2.0*P->Area*TCR[3*ncp+2];
+        double X[3], Xi[3], Density[4];
+        for(int Mu=0; Mu<3; Mu++)
+         { X[Mu]  = V0[Mu] + u*(V1[Mu]-V0[Mu]) + v*(V2[Mu]-V0[Mu]);
+           Xi[Mu] = X[Mu] - E->Centroid[Mu];
+           Density[Mu] = w*bPreFac*(X[Mu]-Q[Mu]);
+         };
+        Density[3] = w*rhoPreFac;
+
+        for(int d=0; d<4; d++)
+         { double *M = Moments + d*MOMENTS_PER_DENSITY;
+           M[0] += Density[d];
+           for(int i=0; i<3; i++)
+            { M[1 + i] += Density[d]*Xi[i];
+              for(int j=0; j<3; j++)
+               { M[4 + i + 3*j] += Density[d]*Xi[i]*Xi[j];
+                 for(int k=0; k<3; k++)
+                  M[13 + i + 3*j + 9*k] += Density[d]*Xi[i]*Xi[j]*Xi[k];
+               };
+            };
+         };
+      };
+   };
+}
+
+/***************************************************************/
+/* return the moment data for all edges of S, (re)computing    */
+/* them if they have not yet been computed or if S has been    */
+/* rotated since they were computed. the returned data must    */
+/* not be used across a subsequent rotation of the surface.    */
+/***************************************************************/
+static pthread_mutex_t EdgeMomentMutex = PTHREAD_MUTEX_INITIALIZER;
+
+EdgeMomentData *GetEdgeMoments(RWGSurface *S)
+{
+  static const double Identity[3][3]={ {1.0,0.0,0.0}, {0.0,1.0,0.0}, {0.0,0.0,1.0} };
+  const double (*Rotation)[3] = S->GT ? S->GT->M : Identity;
+
+  pthread_mutex_lock(&EdgeMomentMutex);
+
+  EdgeMomentData *EMD = (EdgeMomentData *)S->EdgeMoments;
+  if (EMD && !memcmp(EMD->Rotation, Rotation, 9*sizeof(double)))
+   { pthread_mutex_unlock(&EdgeMomentMutex);
+     return EMD;
+   };
+
+  if (EMD==0)
+   { EMD = (EdgeMomentData *)mallocEC(sizeof(EdgeMomentData));
+     EMD->NumEdges = S->NumEdges;
+     EMD->Moments  = (double *)mallocEC(((size_t)S->NumEdges)*MOMENTS_PER_EDGE*sizeof(double));
+     S->EdgeMoments = (void *)EMD;
+   };
+
+  Log("Computing multipole moments for %i edges of surface %s",S->NumEdges,S->Label);
+  for(int ne=0; ne<S->NumEdges; ne++)
+   ComputeEdgeMoments(S, S->Edges[ne], EMD->Moments + ((size_t)ne)*MOMENTS_PER_EDGE);
+  memcpy(EMD->Rotation, Rotation, 9*sizeof(double));
+
+  pthread_mutex_unlock(&EdgeMomentMutex);
+  return EMD;
+}
+
+void DestroyEdgeMoments(RWGSurface *S)
+{
+  EdgeMomentData *EMD = (EdgeMomentData *)S->EdgeMoments;
+  if (EMD==0) return;
+  free(EMD->Moments);
+  free(EMD);
+  S->EdgeMoments=0;
+}
+
+/***************************************************************/
+/* The nth derivatives of Phi(r)=e^{ikr}/(4 pi r) are          */
+/*                                                             */
+/*  d^n Phi / dR_{i1}...dR_{in} = sum_p D_p(r) B^{np}_{i1..in} */
+/*                                                             */
+/* where D_p = ((1/r) d/dr)^p Phi and the B^{np} are real      */
+/* tensors built from R and the Kronecker delta. We contract   */
+/* the moments with the real tensors B^{np} and only multiply  */
+/* by the (complex) radial functions at the end.               */
+/***************************************************************/
+static const int Pow3[6]={1, 3, 9, 27, 81, 243};
+
+typedef struct KernelTensors
+ { double B[5][3][81];     // B[n][p - pMin(n)][...]
+   int pMin[5], pMax[5];
+ } KernelTensors;
+
+static void GetKernelTensors(const double R[3], KernelTensors *KT)
+{
+  for(int n=0; n<=4; n++)
+   { KT->pMin[n] = (n+1)/2;
+     KT->pMax[n] = n;
+   };
+
+  KT->B[0][0][0]=1.0;
+  for(int i=0; i<3; i++)
+   { KT->B[1][0][i] = R[i];
+     for(int j=0; j<3; j++)
+      { double dij = (i==j) ? 1.0 : 0.0;
+        int ij=i+3*j;
+        KT->B[2][0][ij] = dij;
+        KT->B[2][1][ij] = R[i]*R[j];
+        for(int k=0; k<3; k++)
+         { double dik = (i==k) ? 1.0 : 0.0, djk = (j==k) ? 1.0 : 0.0;
+           int ijk=ij+9*k;
+           KT->B[3][0][ijk] = dij*R[k] + dik*R[j] + djk*R[i];
+           KT->B[3][1][ijk] = R[i]*R[j]*R[k];
+           for(int l=0; l<3; l++)
+            { double dil = (i==l) ? 1.0 : 0.0, djl = (j==l) ? 1.0 : 0.0, dkl = (k==l) ? 1.0 : 0.0;
+              int ijkl=ijk+27*l;
+              KT->B[4][0][ijkl] = dij*dkl + dik*djl + dil*djk;
+              KT->B[4][1][ijkl] =  dij*R[k]*R[l] + dik*R[j]*R[l] + dil*R[j]*R[k]
+                                 + djk*R[i]*R[l] + djl*R[i]*R[k] + dkl*R[i]*R[j];
+              KT->B[4][2][ijkl] = R[i]*R[j]*R[k]*R[l];
+            };
+         };
+      };
+   };
+}
+
+/***************************************************************/
+/* P += Weight * sum_{m=mMin}^{mMax} binom(n,m) (-1)^{n-m}     */
+/*                  * A_m (x) B_{n-m}                          */
+/* where A_m, B_m are the degree-m moments of one density on   */
+/* each of the two edges (tensor product with the indices of   */
+/* A running fastest)                                          */
+/***************************************************************/
+static const double Binomial[5][5]=
+ { {1, 0, 0, 0, 0},
+   {1, 1, 0, 0, 0},
+   {1, 2, 1, 0, 0},
+   {1, 3, 3, 1, 0},
+   {1, 4, 6, 4, 1}
+ };
+
+static void AddMomentProduct(const double *A, const double *B, int n,
+                             int mMin, int mMax, double Weight, double *P)
+{
+  for(int m=mMin; m<=mMax; m++)
+   { const double *Am = A + DegreeOffset[m];
+     const double *Bm = B + DegreeOffset[n-m];
+     double c = Weight * Binomial[n][m] * ( ((n-m)%2) ? -1.0 : 1.0 );
+     for(int J=0; J<Pow3[n-m]; J++)
+      { double cB = c*Bm[J];
+        double *PJ = P + J*Pow3[m];
+        for(int I=0; I<Pow3[m]; I++)
+         PJ[I] += cB*Am[I];
+      };
+   };
+}
+
+/***************************************************************/
+/* P : (nth derivative tensor of Phi), or, if l>=0, P : (slice */
+/* of the (n+1)th derivative tensor with last index = l)       */
+/***************************************************************/
+static cdouble ContractKernel(const double *P, int n, KernelTensors *KT,
+                              const cdouble *D, int l=-1)
+{
+  int nT = (l==-1) ? n : n+1;
+  int Offset = (l==-1) ? 0 : l*Pow3[n];
+  cdouble Sum=0.0;
+  for(int p=KT->pMin[nT]; p<=KT->pMax[nT]; p++)
+   { const double *B = KT->B[nT][p - KT->pMin[nT]] + Offset;
+     double Dot=0.0;
+     for(int I=0; I<Pow3[n]; I++)
+      Dot += P[I]*B[I];
+     Sum += D[p]*Dot;
+   };
+  return Sum;
+}
+
+/***************************************************************/
+/* get the G and C edge-edge integrals (same normalization as  */
+/* GetEdgeEdgeInteractions) for basis functions with moments   */
+/* MA, MB whose centroids are separated by R = Ca - Cb, by     */
+/* Taylor-expanding the Helmholtz kernel about R.              */
+/***************************************************************/
+void GetEEIsFromMoments(const double *MA, const double *MB,
+                        const double R[3], cdouble k, cdouble GC[2])
+{
+  /*--------------------------------------------------------------*/
+  /*- radial functions D_p = ((1/r) d/dr)^p Phi, p=0..4           */
+  /*--------------------------------------------------------------*/
+  double r2 = R[0]*R[0] + R[1]*R[1] + R[2]*R[2], r=sqrt(r2), r4=r2*r2;
+  cdouble ik=II*k, ikr=ik*r, ikr2=ikr*ikr;
+  cdouble D[5];
+  D[0] = exp(ikr) / (4.0*M_PI*r);
+  D[1] = D[0]*(ikr - 1.0)/r2;
+  D[2] = D[0]*(ikr2 - 3.0*ikr + 3.0)/r4;
+  D[3] = D[0]*(ikr2*ikr - 6.0*ikr2 + 15.0*ikr - 15.0)/(r4*r2);
+  D[4] = D[0]*(ikr2*ikr2 - 10.0*ikr2*ikr + 45.0*ikr2 - 105.0*ikr + 105.0)/(r4*r4);
+
+  KernelTensors KT;
+  GetKernelTensors(R, &KT);
+
+  static const double InvFactorial[5]={1.0, 1.0, 0.5, 1.0/6.0, 1.0/24.0};
+  double P[81];
+
+  /*--------------------------------------------------------------*/
+  /*- G integral: <b_a|b_b> Phi - (1/k^2) <rho_a|rho_b> Phi       */
+  /*--------------------------------------------------------------*/
+  cdouble GJ=0.0;
+  for(int n=0; n<=MAXDEGREE_J; n++)
+   { memset(P, 0, Pow3[n]*sizeof(double));
+     for(int i=0; i<3; i++)
+      AddMomentProduct(MA + i*MOMENTS_PER_DENSITY, MB + i*MOMENTS_PER_DENSITY,
+                       n, 0, n, InvFactorial[n], P);
+     GJ += ContractKernel(P, n, &KT, D);
+   };
+
+  // the total charge of a basis function vanishes, so the
+  // terms involving zeroth-degree charge moments are omitted
+  const double *QA = MA + 3*MOMENTS_PER_DENSITY, *QB = MB + 3*MOMENTS_PER_DENSITY;
+  cdouble GQ=0.0;
+  for(int n=2; n<=MAXDEGREE_Q; n++)
+   { memset(P, 0, Pow3[n]*sizeof(double));
+     AddMomentProduct(QA, QB, n, 1, n-1, InvFactorial[n], P);
+     GQ += ContractKernel(P, n, &KT, D);
+   };
+
+  GC[0] = GJ - GQ/(k*k);
+
+  /*--------------------------------------------------------------*/
+  /*- C integral: (1/ik) <b_a| grad Phi x |b_b>                    */
+  /*--------------------------------------------------------------*/
+  static const int Cyclic[3][3]={ {0,1,2}, {1,2,0}, {2,0,1} };
+  cdouble C=0.0;
+  for(int nc=0; nc<3; nc++)
+   { int i=Cyclic[nc][0], j=Cyclic[nc][1], l=Cyclic[nc][2];
+     for(int n=0; n<=MAXDEGREE_J; n++)
+      { memset(P, 0, Pow3[n]*sizeof(double));
+        AddMomentProduct(MA + i*MOMENTS_PER_DENSITY, MB + j*MOMENTS_PER_DENSITY,
+                         n, 0, n, InvFactorial[n], P);
+        AddMomentProduct(MA + j*MOMENTS_PER_DENSITY, MB + i*MOMENTS_PER_DENSITY,
+                         n, 0, n, -InvFactorial[n], P);
+        C += ContractKernel(P, n, &KT, D, l);
+      };
+   };
+  GC[1] = C/ik;
+}
+
+/***************************************************************/
+/* decide whether the interactions of basis functions Ea, Eb   */
+/* at wavenumber k may be computed from their moments.         */
+/*                                                             */
+/* the Taylor expansion of the kernel about the centroid       */
+/* separation R converges like (a/|R|)^n and like (|k|a)^n,    */
+/* where a is the sum of the edge radii, so in addition to the */
+/* separation test we require |k|a <= EDGEMOMENT_MAXKA.        */
+/*                                                             */
+/* at small |k|, the G integral is dominated by the charge     */
+/* term GQ/k^2, which amplifies its truncation error and is    */
+/* singular at k=0, so in the quasistatic regime |k||R| <      */
+/* EDGEMOMENT_MINKR we fall back to cubature.                  */
+/***************************************************************/
+#define EDGEMOMENT_MAXKA 1.0
+#define EDGEMOMENT_MINKR 1.0e-3
+
+bool EdgeMomentsAdmissible(RWGEdge *Ea, RWGEdge *Eb, const double R[3],
+                           cdouble k, double Threshold)
+{
+  double r      = sqrt(R[0]*R[0] + R[1]*R[1] + R[2]*R[2]);
+  double Radius = Ea->Radius + Eb->Radius;
+  double kAbs   = abs(k);
+
+  if ( r <= Threshold*Radius )
+   return false;
+  if ( kAbs*Radius > EDGEMOMENT_MAXKA )
+   return false;
+  if ( kAbs*r < EDGEMOMENT_MINKR )
+   return false;
+  return true;
+}
+
+/***************************************************************/
+/* pointer to the moment data for edge #ne                     */
+/***************************************************************/
+const double *GetEdgeMomentPointer(EdgeMomentData *EMD, int ne)
+{ return EMD->Moments + ((size_t)ne)*MOMENTS_PER_EDGE; }
+
+} // namespace scuff
@@ -47,6 +47,7 @@
 
 #include <libhrutil.h>
 #include "libscuff.h"
+#include "CacheFile.h"
 
 namespace scuff {
 
@@ -95,6 +96,10 @@ typedef struct { double Data[DATALEN];  } DataStruct;
 
 typedef std::pair<KeyStruct, DataStruct> KDPair;
 
+// record format of FIBBI cache files (see CacheFile.cc)
+static CacheFileFormat FIBBIFormat
+ = { "FIBBI", KEYSIZE, sizeof(float), DATASIZE, sizeof(double) };
+
 struct KeyHash
  {
    long operator() (const KeyStruct &K) const 
@@ -144,12 +149,12 @@ public:
 
    // data
    int Hits, Misses;
-   void *opTable;
+   void *opTable;     // records not yet written to File
+   void *File;        // preloaded cache file (CacheFile *)
 
    pthread_rwlock_t lock;
 
    char *LastFileName;
-   unsigned int NumRecordsInFile;
 
 };
 
@@ -169,7 +174,7 @@ FIBBICache::FIBBICache(char *MeshFileName)
   /*- attempt to preload cache                                   -*/
   /*--------------------------------------------------------------*/
   LastFileName=0;
-  NumRecordsInFile=0;
+  File=0;
   if (MeshFileName)
    { 
      char CacheFileName[MAXSTR];
@@ -201,6 +206,8 @@ FIBBICache::~FIBBICache()
 
   if (LastFileName) free(LastFileName);
 
+  CloseCacheFile((CacheFile *)File);
+
   KDMap *KDM = (KDMap *)opTable;
   delete KDM;
 
@@ -283,6 +290,17 @@ void FIBBICache::GetFIBBIData(RWGSurface *SA, int neA,
   KeyStruct Key;
   GetFIBBICacheKey(SA, neA, SB, neB, Key.Key);
 
+  CacheFile *CF = (CacheFile *)File;
+  if (CF)
+   { const void *Data
+      = LookupCacheFile(CF, Key.Key, CacheFileHash(&FIBBIFormat, Key.Key));
+     if (Data)
+      { memcpy(FIBBIs, Data, DATASIZE);
+        Hits++;
+        return;
+      };
+   };
+
   KDMap *KDM    = (KDMap *)opTable;
   bool Found;
   pthread_rwlock_rdlock(&lock);
@@ -322,18 +340,16 @@ void FIBBICache::GetFIBBIData(RWGSurface *SA, int neA,
 /* if that environment variable is defined, and otherwise to   */
 /* the current working directory.                              */
 /*                                                             */
-/* the file format is pretty simple (and non-portable w.r.t.   */
-/* endianness):                                                */
-/*  bytes 0--11:   'FIBBI_CACHE' + 0                           */
-/*  next xx bytes:  first record                               */ 
-/*  next xx bytes:  second record                              */
-/*  ...             ...                                        */
-/*                                                             */
-/* where xx is the size of the record; each record consists of */
-/* a search key (KEYLEN float values) followed by the content  */
-/* of the FIBBI data record for that search key.               */
+/* Cache files are indexed, endian-independent files in the    */
+/* format described in CacheFile.cc. A preloaded file is mapped*/
+/* read-only and queried in place; the in-memory table holds   */
+/* only records that are not yet in the file. Storing the cache*/
+/* to the file from which it was loaded appends those records  */
+/* to the file; otherwise a new file is written.               */
 /*                                                             */
-/* note: FIBBICF = 'FIBBI cache file'                          */
+/* Files in the original (unindexed, host-byte-order) format,  */
+/* which began with the signature 'FIBBI_CACHE', are still     */
+/* accepted by PreLoad and are read into the in-memory table.  */
 /***************************************************************/
 const char FIBBICF_GSignature[]  = "FIBBI_CACHE";
 #define FIBBICF_SIGSIZE (sizeof(FIBBICF_GSignature))
@@ -354,68 +370,91 @@ void FIBBICache::Store(const char *MeshFileName)
    snprintf(FileName,MAXSTR,"%s/%s.%s",s,GetFileBase(MFNCopy),SUFFIX);
 
   KDMap *KDM = (KDMap *)opTable;
+  CacheFile *CF = (CacheFile *)File;
 
   /*--------------------------------------------------------------*/
+  /*- i assume that Preload() and Store() won't be called from    */
+  /*- multithreaded code sections.                                */
   /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  unsigned int NumRecords = KDM->size();
-  if (    NumRecords==NumRecordsInFile
-       && LastFileName 
-       && !strcmp(FileName, LastFileName)
-     )
+  bool SameFile = LastFileName && !strcmp(FileName, LastFileName);
+  unsigned long NumNew = KDM->size();
+  if ( SameFile && NumNew==0 )
    { Log("FC::S FIBBI cache unchanged since last disk operation (skipping cache dump)");
      return;
    };
-Log("I checked and: (%i,%i), (%s,%s)",NumRecords,NumRecordsInFile,FileName,(LastFileName ? "" : LastFileName));
-  if (LastFileName) free(LastFileName);
-  LastFileName=strdup(FileName);
 
   /*--------------------------------------------------------------*/
-  /*- i assume that Preload() and Store() won't be called from    */
-  /*- multithreaded code sections.                                */
+  /*- collect the new records ------------------------------------*/
   /*--------------------------------------------------------------*/
-  //FCLock.read_lock();
+  const void **Keys=(const void **)mallocEC((NumNew+1)*sizeof(void *));
+  const void **Data=(const void **)mallocEC((NumNew+1)*sizeof(void *));
+  unsigned long n=0;
+  for(KDMap::iterator it=KDM->begin(); it!=KDM->end(); it++, n++)
+   { Keys[n]=it->first.Key;
+     Data[n]=it->second.Data;
+   };
 
-  FILE *f=fopen(FileName,"w");
-  if (!f)
-   { Log("FC::S warning: could not open file %s (aborting cache dump)...",FileName);
-     return;
+  /*--------------------------------------------------------------*/
+  /*- append them to the file they came from if possible, or else */
+  /*- write a new file containing everything we have, plus any    */
+  /*- records already in a file of that name (which may have been */
+  /*- added by other processes)                                   */
+  /*--------------------------------------------------------------*/
+  long Written=-1;
+  CacheFile *Target=0;
+  if (SameFile)
+   { Written=AppendCacheFile(FileName, &FIBBIFormat, NumNew, Keys, Data);
+     if (Written>=0)
+      Log("FC::S Appended %lu FIBBI records to %s.",NumNew,FileName);
    };
-  Log("FC::S Writing FIBBI cache to file %s...",FileName);
-
-  /*---------------------------------------------------------------------*/
-  /*- write file signature ----------------------------------------------*/
-  /*---------------------------------------------------------------------*/
-  fwrite(FIBBICF_GSignature, FIBBICF_SIGSIZE,1,f);
-
-  /*---------------------------------------------------------------------*/
-  /*- iterate through the table and write entries to the file one-by-one */
-  /*---------------------------------------------------------------------*/
-  NumRecordsInFile=0;
-  KDMap::iterator it;
-  for ( it = KDM->begin(); it != KDM->end(); it++ )
-   { 
-     const float *Key   = it->first.Key;
-     double *Data = it->second.Data;
-     if (    (1 != fwrite(Key,  KEYSIZE,  1, f )) 
-          || (1 != fwrite(Data, DATASIZE, 1, f ))
-        ) break;
-     NumRecordsInFile++;
+
+  if (Written<0)
+   { Target=OpenCacheFile(FileName, &FIBBIFormat);
+     unsigned long NumInFile   = CF ? GetCacheFileRecords(CF) : 0;
+     unsigned long NumInTarget = Target ? GetCacheFileRecords(Target) : 0;
+     Keys=(const void **)reallocEC(Keys, (n+NumInFile+NumInTarget+1)*sizeof(void *));
+     Data=(const void **)reallocEC(Data, (n+NumInFile+NumInTarget+1)*sizeof(void *));
+     for(unsigned long nr=0; nr<NumInFile; nr++, n++)
+      { Keys[n]=GetCacheFileKey(CF,nr);
+        Data[n]=GetCacheFileData(CF,nr);
+      };
+     for(unsigned long nr=0; nr<NumInTarget; nr++, n++)
+      { Keys[n]=GetCacheFileKey(Target,nr);
+        Data[n]=GetCacheFileData(Target,nr);
+      };
+     Log("FC::S Writing FIBBI cache to file %s...",FileName);
+     Written=WriteCacheFile(FileName, &FIBBIFormat, n, Keys, Data);
+     if (Written>=0)
+      Log("FC::S ...wrote %li FIBBI records.",Written);
    };
+  free(Keys);
+  free(Data);
+  CloseCacheFile(Target);
 
-  /*---------------------------------------------------------------------*/
-  /*- and that's it -----------------------------------------------------*/
-  /*---------------------------------------------------------------------*/
-  fclose(f);
-  Log("FC::S ...wrote %i/%i FIBBI records.",NumRecordsInFile,NumRecords);
+  if (Written<0)
+   { Log("FC::S warning: could not write file %s (aborting cache dump)...",FileName);
+     return;
+   };
 
-  //FCLock.read_unlock();
+  /*--------------------------------------------------------------*/
+  /*- switch over to the updated file; the in-memory records are -*/
+  /*- now all on disk                                            -*/
+  /*--------------------------------------------------------------*/
+  CacheFile *NewCF=OpenCacheFile(FileName, &FIBBIFormat);
+  if (NewCF)
+   { CloseCacheFile(CF);
+     File=(void *)NewCF;
+     KDM->clear();
+   };
+  if (LastFileName) free(LastFileName);
+  LastFileName=strdupEC(FileName);
 }
 
 /***************************************************************/
+/* read a legacy-format cache file into the in-memory table.   */
 /* return 0 on success, nonzero on failure                     */
 /***************************************************************/
-int FIBBICache::PreLoad(const char *FileName)
+static int PreLoadLegacy(KDMap *KDM, const char *FileName)
 {
   /*--------------------------------------------------------------*/
   /*- try to open the file ---------------------------------------*/
@@ -426,7 +465,6 @@ int FIBBICache::PreLoad(const char *FileName)
      return 1;
    };
 
-  KDMap *KDM       = (KDMap *)opTable;
   int RecordSize   = KEYSIZE + DATASIZE;
   int NumRecords   = 0; 
   int RecordsRead  = 0;
@@ -474,7 +512,7 @@ int FIBBICache::PreLoad(const char *FileName)
   /*- now just read records from the file one at a time and add   */
   /*- them to the table.                                          */
   /*--------------------------------------------------------------*/
-  Log("FC::P Preloading FIBBI records from file %s...",FileName);
+  Log("FC::P Preloading FIBBI records from legacy-format file %s...",FileName);
   NumRecords = FileSize / RecordSize;
   for(int nr=0; nr<NumRecords; nr++)
    { 
@@ -493,16 +531,6 @@ int FIBBICache::PreLoad(const char *FileName)
      RecordsRead++;
    };
 
-  /*--------------------------------------------------------------*/
-  /* the most recent file from which we preloaded, and the number */
-  /* of records preloaded, are stored within the class body to    */
-  /* allow us to skip dumping the cache back to disk in cases     */
-  /* where that would amount to just rewriting the same cache     */
-  /*--------------------------------------------------------------*/
-  if (LastFileName) free(LastFileName);
-  LastFileName=strdupEC(FileName);
-  NumRecordsInFile=RecordsRead;
-
   Log("FC::P ...successfully preloaded %i FIBBI records.",RecordsRead);
 #define ONEMEG (1<<20)
   Log("FC::P Cache memory use: %i MB.",(GetMemoryUsage() - M0)/(ONEMEG));
@@ -518,6 +546,32 @@ int FIBBICache::PreLoad(const char *FileName)
   return 1;
 }
 
+/***************************************************************/
+/* return 0 on success, nonzero on failure                     */
+/***************************************************************/
+int FIBBICache::PreLoad(const char *FileName)
+{
+  const char *ErrMsg;
+  CacheFile *CF=OpenCacheFile(FileName, &FIBBIFormat, &ErrMsg);
+  if (CF==0 && PreLoadLegacy((KDMap *)opTable, FileName)!=0)
+   return 1;
+
+  if (CF)
+   { CloseCacheFile((CacheFile *)File);
+     File=(void *)CF;
+     Log("FC::P Mapped %lu FIBBI records from file %s.",GetCacheFileRecords(CF),FileName);
+   };
+
+  /*--------------------------------------------------------------*/
+  /* the most recent file from which we preloaded is stored within*/
+  /* the class body to allow us to append to it, or to skip       */
+  /* dumping the cache back to disk if nothing has changed        */
+  /*--------------------------------------------------------------*/
+  if (LastFileName) free(LastFileName);
+  LastFileName=strdupEC(FileName);
+  return 0;
+}
+
 /*--------------------------------------------------------------*/
 /*--------------------------------------------------------------*/
 /*--------------------------------------------------------------*/
@@ -527,7 +581,8 @@ int FIBBICache::Size(int *pHits, int *pMisses)
   if (pMisses) *pMisses=Misses;
   if (opTable==0) return -1;
   KDMap *KDM = (KDMap *)opTable;
-  return KDM->size();
+  CacheFile *CF = (CacheFile *)File;
+  return KDM->size() + (CF ? GetCacheFileRecords(CF) : 0);
 
 }
 
@@ -32,16 +32,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#ifdef HAVE_CXX11
-#include <unordered_map>
-#elif defined(HAVE_TR1)
-#include <tr1/unordered_map>
-#endif
+#include <sched.h>
 
 #include <libhrutil.h>
 
 #include "libscuff.h"
 #include "libscuffInternals.h"
+#include "CacheFile.h"
 
 namespace scuff {
 
@@ -78,45 +75,134 @@ typedef struct
  { float Key[KEYLEN];
  } KeyStruct;
 
-typedef std::pair<KeyStruct, QIFIPPIData *> KeyValuePair;
-
-struct KeyHash
- {
-   long operator() (const KeyStruct &K) const { return HashFunction(K.Key); }
- };
-
-typedef struct 
- { 
-   bool operator()(const KeyStruct &K1, const KeyStruct &K2) const
-    { 
-      if ( memcmp( (const void *)K1.Key, (const void *)K2.Key, KEYSIZE) )
-       return false;
-      return true;
-    };
-
- } KeyCmp;
-
-#ifdef HAVE_CXX11
-typedef std::unordered_map< KeyStruct,
-                            QIFIPPIData *,
-                            KeyHash,
-                            KeyCmp> KeyValueMap;
-#elif defined(HAVE_TR1)
-typedef std::tr1::unordered_map< KeyStruct,
-                                 QIFIPPIData *, 
-                                 KeyHash, 
-                                 KeyCmp> KeyValueMap;
-#endif
+/*--------------------------------------------------------------*/
+/*- The cache is split into FIPPI_NUMSHARDS independent shards, */
+/*- selected by the low bits of the hash. Each shard stores its */
+/*- records inline in an arena of fixed-size chunks (so record  */
+/*- addresses never change once handed out) and indexes them    */
+/*- with an open-addressing table of record pointers.           */
+/*-                                                             */
+/*- Lookups do not take any lock: table slots are written once  */
+/*- (from NULL to a fully-initialized record) and a table that  */
+/*- has been outgrown is retired, not freed, so a reader        */
+/*- probing a stale table at worst misses a recent insertion    */
+/*- and falls through to the locked insertion path, which       */
+/*- repeats the lookup in the current table.                    */
+/*-                                                             */
+/*- A thread that misses inserts a PENDING record before        */
+/*- computing the data, so other threads that miss on the same  */
+/*- key wait for that computation instead of repeating it.      */
+/*--------------------------------------------------------------*/
+#define FIPPI_SHARDBITS  6
+#define FIPPI_NUMSHARDS  (1<<FIPPI_SHARDBITS)
+#define FIPPI_CHUNKSIZE  1024   // records per arena chunk
+#define FIPPI_MINSLOTS   1024   // initial table size per shard (power of 2)
+
+#define FIPPI_PENDING 0
+#define FIPPI_READY   1
+
+typedef struct FIPPIRecord
+ { KeyStruct K;
+   unsigned long Hash;
+   volatile int State;
+   bool Stored;                // already written to StoreFileName
+   QIFIPPIData QIFD;
+ } FIPPIRecord;
+
+typedef struct FIPPIChunk
+ { FIPPIRecord Records[FIPPI_CHUNKSIZE];
+   struct FIPPIChunk *Next;
+ } FIPPIChunk;
+
+typedef struct FIPPITable
+ { FIPPIRecord * volatile *Slots;
+   unsigned long NumSlots;
+   struct FIPPITable *Retired; // earlier, smaller tables
+ } FIPPITable;
+
+typedef struct FIPPIShard
+ { FIPPITable * volatile Table;
+   unsigned long NumRecords;
+   FIPPIChunk *Chunks;         // most recently allocated first
+   int NumInHead;              // number of records used in Chunks
+   rwlock Lock;                // serializes insertions
+ } FIPPIShard;
+
+static FIPPITable *CreateFIPPITable(unsigned long NumSlots)
+{ FIPPITable *T=(FIPPITable *)mallocEC(sizeof(FIPPITable));
+  T->Slots=(FIPPIRecord * volatile *)mallocEC(NumSlots*sizeof(FIPPIRecord *));
+  memset((void *)T->Slots, 0, NumSlots*sizeof(FIPPIRecord *));
+  T->NumSlots=NumSlots;
+  T->Retired=0;
+  return T;
+}
+
+static FIPPIRecord *FindRecord(FIPPITable *T, const KeyStruct *K, unsigned long Hash)
+{ unsigned long Mask=T->NumSlots-1;
+  for(unsigned long n=(Hash>>FIPPI_SHARDBITS)&Mask; ; n=(n+1)&Mask)
+   { FIPPIRecord *R=T->Slots[n];
+     if (R==0)
+      return 0;
+     if ( R->Hash==Hash && !memcmp(R->K.Key, K->Key, KEYSIZE) )
+      return R;
+   };
+}
+
+static void InsertPointer(FIPPITable *T, FIPPIRecord *R)
+{ unsigned long Mask=T->NumSlots-1;
+  unsigned long n=(R->Hash>>FIPPI_SHARDBITS)&Mask;
+  while( T->Slots[n] )
+   n=(n+1)&Mask;
+  T->Slots[n]=R;
+}
+
+// the following routines must be called with the shard locked
+static FIPPIRecord *AllocateRecord(FIPPIShard *S)
+{ if ( S->Chunks==0 || S->NumInHead==FIPPI_CHUNKSIZE )
+   { FIPPIChunk *C=(FIPPIChunk *)mallocEC(sizeof(FIPPIChunk));
+     C->Next=S->Chunks;
+     S->Chunks=C;
+     S->NumInHead=0;
+   };
+  return S->Chunks->Records + (S->NumInHead++);
+}
+
+static void InsertRecord(FIPPIShard *S, FIPPIRecord *R)
+{
+  // make sure the record contents are visible before the pointer
+  __sync_synchronize();
+
+  FIPPITable *T=S->Table;
+  if ( 2*(S->NumRecords+1) > T->NumSlots )
+   { FIPPITable *NewT=CreateFIPPITable(2*T->NumSlots);
+     for(unsigned long n=0; n<T->NumSlots; n++)
+      if (T->Slots[n])
+       InsertPointer(NewT, T->Slots[n]);
+     NewT->Retired=T;
+     __sync_synchronize();
+     S->Table=T=NewT;
+   };
+  InsertPointer(T, R);
+  S->NumRecords++;
+}
 
 /*--------------------------------------------------------------*/
 /*- class constructor ------------------------------------------*/
 /*--------------------------------------------------------------*/
 FIPPICache::FIPPICache()
 {
-  KeyValueMap *KVM=new KeyValueMap;
-  opTable = (void *)KVM;
-  PreloadFileName=0;
-  RecordsPreloaded=0;
+  FIPPIShard *Shards=new FIPPIShard[FIPPI_NUMSHARDS];
+  for(int ns=0; ns<FIPPI_NUMSHARDS; ns++)
+   { Shards[ns].Table=CreateFIPPITable(FIPPI_MINSLOTS);
+     Shards[ns].NumRecords=0;
+     Shards[ns].Chunks=0;
+     Shards[ns].NumInHead=0;
+   };
+  opTable = (void *)Shards;
+  Hits=Misses=0;
+  Files=0;
+  NumFiles=0;
+  StoreFileName=0;
 }
 
 /*--------------------------------------------------------------*/
@@ -124,13 +210,33 @@ FIPPICache::FIPPICache()
 /*--------------------------------------------------------------*/
 FIPPICache::~FIPPICache()
 {
-  if (PreloadFileName) 
-   free(PreloadFileName);
-
-  KeyValueMap *KVM=(KeyValueMap *)opTable;
-  delete KVM;
+  if (StoreFileName) 
+   free(StoreFileName);
+
+  CacheFile **CFs=(CacheFile **)Files;
+  for(int nf=0; nf<NumFiles; nf++)
+   CloseCacheFile(CFs[nf]);
+  free(Files);
+
+  FIPPIShard *Shards=(FIPPIShard *)opTable;
+  for(int ns=0; ns<FIPPI_NUMSHARDS; ns++)
+   { for(FIPPITable *T=Shards[ns].Table, *Next; T; T=Next)
+      { Next=T->Retired;
+        free((void *)T->Slots);
+        free(T);
+      };
+     for(FIPPIChunk *C=Shards[ns].Chunks, *Next; C; C=Next)
+      { Next=C->Next;
+        free(C);
+      };
+   };
+  delete[] Shards;
 } 
 
+// record format of FIPPI cache files (see CacheFile.cc)
+static CacheFileFormat FIPPIFormat
+ = { "FIPPI", KEYSIZE, sizeof(float), sizeof(QIFIPPIData), sizeof(double) };
+
 static void inline VecSubFloat(double *V1, double *V2, float *V1mV2)
 { V1mV2[0] = ((float)V1[0]) - ((float)V2[0]);
   V1mV2[1] = ((float)V1[1]) - ((float)V2[1]);
@@ -169,35 +275,68 @@ QIFIPPIData *FIPPICache::GetQIFIPPIData(double **OVa, double **OVb, int ncv)
   VecSubFloat(OVb[1], OVa[0], K.Key+9  );
   VecSubFloat(OVb[2], OVa[0], K.Key+12 );
 
+  unsigned long Hash = (unsigned long)HashFunction(K.Key);
+  FIPPIShard *S = ((FIPPIShard *)opTable) + (Hash & (FIPPI_NUMSHARDS-1));
+
   /***************************************************************/
-  /* look for this key in the cache ******************************/
+  /* look for this key in the cache (no locking) *****************/
   /***************************************************************/
-  KeyValueMap *KVM=(KeyValueMap *)opTable;
+  FIPPIRecord *R=FindRecord(S->Table, &K, Hash);
 
-  FCLock.read_lock();
-  KeyValueMap::iterator p=KVM->find(K);
-  FCLock.read_unlock();
+  /***************************************************************/
+  /* if it was not found, look in the preloaded cache files,     */
+  /* which are used in place without copying                     */
+  /***************************************************************/
+  if (R==0 && NumFiles>0)
+   { uint64_t FileHash=CacheFileHash(&FIPPIFormat, K.Key);
+     CacheFile **CFs=(CacheFile **)Files;
+     for(int nf=0; nf<NumFiles; nf++)
+      { const void *QIFD=LookupCacheFile(CFs[nf], K.Key, FileHash);
+        if (QIFD)
+         { __sync_fetch_and_add(&Hits, 1);
+           return (QIFIPPIData *)QIFD;
+         };
+      };
+   };
 
-  if ( p != (KVM->end()) )
-   { Hits++;
-     return (QIFIPPIData *)(p->second);
+  /***************************************************************/
+  /* if it was not found, repeat the search with the shard       */
+  /* locked, and if it is still not there insert a placeholder   */
+  /* record, then compute the data outside the lock              */
+  /***************************************************************/
+  if (R==0)
+   { bool NeedCompute=false;
+     S->Lock.write_lock();
+     R=FindRecord(S->Table, &K, Hash);
+     if (R==0)
+      { R=AllocateRecord(S);
+        memcpy(R->K.Key, K.Key, KEYSIZE);
+        R->Hash=Hash;
+        R->Stored=false;
+        R->State=FIPPI_PENDING;
+        InsertRecord(S, R);
+        NeedCompute=true;
+      };
+     S->Lock.write_unlock();
+
+     if (NeedCompute)
+      { __sync_fetch_and_add(&Misses, 1);
+        ComputeQIFIPPIData(OVa, OVb, ncv, &(R->QIFD));
+        __sync_synchronize();
+        R->State=FIPPI_READY;
+        return &(R->QIFD);
+      };
    };
-  
+
   /***************************************************************/
-  /* if it was not found, allocate and compute a new QIFIPPIData */
-  /* structure, then add this structure to the cache             */
+  /* the record exists, but another thread may still be in the   */
+  /* process of computing its contents                           */
   /***************************************************************/
-  Misses++;
-  KeyStruct *K2 = (KeyStruct *)mallocEC(sizeof(*K2));
-  memcpy(K2->Key, K.Key, KEYSIZE);
-  QIFIPPIData *QIFD=(QIFIPPIData *)mallocEC(sizeof *QIFD);
-  ComputeQIFIPPIData(OVa, OVb, ncv, QIFD);
-   
-  FCLock.write_lock();
-  KVM->insert( KeyValuePair(*K2, QIFD) );
-  FCLock.write_unlock();
-
-  return QIFD;
+  __sync_fetch_and_add(&Hits, 1);
+  while( R->State!=FIPPI_READY )
+   sched_yield();
+  __sync_synchronize();
+  return &(R->QIFD);
 }
 
 /***************************************************************/
@@ -206,211 +345,242 @@ QIFIPPIData *FIPPICache::GetQIFIPPIData(double **OVa, double **OVb, int ncv)
 /* and subsequently pre-loading a FIPPI cache with the content */
 /* of a file created by this storage operation.                */
 /*                                                             */
-/* the file format is pretty simple (and non-portable w.r.t.   */
-/* endianness):                                                */
-/*  bytes 0--10:   'FIPPICACHE' + 0 (a file signature used as  */
-/*                                   a simple sanity check)    */
-/*  next xx bytes:  first record                               */
-/*  next xx bytes:  second record                              */
-/*  ...             ...                                        */
+/* cache files are indexed, endian-independent files in the    */
+/* format described in CacheFile.cc. preloading a file does not*/
+/* read it into the in-memory table; instead the file is mapped*/
+/* read-only and lookups that miss the in-memory table are     */
+/* answered directly from the mapped file, so several processes*/
+/* on one node preloading the same file share a single copy of */
+/* it in the page cache.                                       */
 /*                                                             */
-/* where xx is the size of the record; each record consists of */
-/* a search key (15 double values) followed by the content     */
-/* of the QIFIPPIDataRecord for that search key.               */
+/* if the cache is stored back to the file from which it was   */
+/* preloaded, the records computed since then are appended to  */
+/* the file instead of rewriting it; otherwise (or once the    */
+/* unindexed appended section grows too large) a new file with */
+/* a fresh index is written and renamed into place.            */
 /*                                                             */
-/* note: FIPPICF = 'FIPPI cache file'                          */
+/* files in the original (unindexed, host-byte-order) format,  */
+/* which began with the signature 'FIPPICACHE', are still      */
+/* accepted by PreLoad and are read into the in-memory table.  */
 /***************************************************************/
 const char FIPPICF_Signature[]="FIPPICACHE";
 #define FIPPICF_SIGSIZE sizeof(FIPPICF_Signature)
 
-// note that this structure differs from the KeyValuePair structure 
-// defined above in that it contains the actual contents of 
-// QIFIPPIData structure, whereas KeyValuePair contains just a 
-// pointer to such a structure.
+// record in a legacy cache file
 typedef struct FIPPICF_Record
  { KeyStruct K;
    QIFIPPIData QIFDBuffer;
  } FIPPICF_Record;
 #define FIPPICF_RECSIZE sizeof(FIPPICF_Record)
 
+/*--------------------------------------------------------------*/
+/*- visit all completed in-memory records (shards locked)      -*/
+/*--------------------------------------------------------------*/
+#define FOREACH_READY_RECORD(Shards, R)                                   \
+ for(int ns=0; ns<FIPPI_NUMSHARDS; ns++)                                  \
+  for(FIPPIChunk *C=Shards[ns].Chunks; C; C=C->Next)                      \
+   for(int nr=0, NumInChunk=(C==Shards[ns].Chunks) ? Shards[ns].NumInHead \
+                                                   : FIPPI_CHUNKSIZE;     \
+       nr<NumInChunk; nr++)                                               \
+    if ( (R=C->Records+nr)->State==FIPPI_READY )
+
 void FIPPICache::Store(const char *FileName)
 {
-  KeyValueMap *KVM=(KeyValueMap *)opTable;
+  FIPPIShard *Shards=(FIPPIShard *)opTable;
+  FIPPIRecord *R;
 
   if (FileName==0) return;
 
+  for(int ns=0; ns<FIPPI_NUMSHARDS; ns++)
+   Shards[ns].Lock.write_lock();
+
   /*--------------------------------------------------------------*/
-  /*- pause to check if the following conditions are satisfied:  -*/
-  /*-  (1) the FIPPI cache was preloaded from an input file whose-*/
-  /*-      name matches the name of the output file to which we  -*/
-  /*-      are being asked to dump the cache                     -*/
-  /*-  (2) the number of cache records hasn't changed since we   -*/
-  /*-      preloaded from the input file.                        -*/
-  /*- if both conditions are satisfied, we don't bother to dump  -*/
-  /*- the cache since the operation would result in a cache dump -*/
-  /*- file identical to the one that already exists.             -*/
+  /*- count records that are not yet reflected in StoreFileName,  */
+  /*- which (if non-null) is a file that already contains all     */
+  /*- mapped records and all in-memory records marked as stored   */
   /*--------------------------------------------------------------*/
-  if (     PreloadFileName 
-       && !strcmp(PreloadFileName, FileName) 
-       && RecordsPreloaded==(KVM->size())
-     )  
-   { Log("FIPPI cache unchanged since reading from %s (skipping cache dump)",FileName);
-     return;
+  unsigned long NumRecords=0, NumUnstored=0;
+  FOREACH_READY_RECORD(Shards, R)
+   { NumRecords++;
+     if (!R->Stored) NumUnstored++;
    };
+  bool CanAppend = StoreFileName && !strcmp(StoreFileName, FileName);
 
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  FCLock.read_lock();
+  const void **Keys=0, **Data=0;
+  unsigned long n=0;
+  long Written=-1;
+  CacheFile *Target=0;
 
-  KeyValueMap::iterator it;
-  int NumRecords=0;
+  if (CanAppend && NumUnstored==0)
+   { Log("FIPPI cache unchanged since reading from %s (skipping cache dump)",FileName);
+     goto done;
+   };
 
   /*--------------------------------------------------------------*/
-  /*- try to open the file ---------------------------------------*/
+  /*- first try appending new records to the existing file       -*/
   /*--------------------------------------------------------------*/
-  FILE *f=fopen(FileName,"w");
-  if (!f)
-   { fprintf(stderr,"warning: could not open file %s (aborting cache dump)...",FileName);
-     goto done;
+  if (CanAppend)
+   { Keys=(const void **)mallocEC(NumUnstored*sizeof(void *));
+     Data=(const void **)mallocEC(NumUnstored*sizeof(void *));
+     FOREACH_READY_RECORD(Shards, R)
+      if (!R->Stored)
+       { Keys[n]=R->K.Key; Data[n]=&(R->QIFD); n++; };
+     Written=AppendCacheFile(FileName, &FIPPIFormat, NumUnstored, Keys, Data);
+     free(Keys);
+     free(Data);
+     if (Written>=0)
+      Log("Appended %lu FIPPI records to cache file %s.",NumUnstored,FileName);
    };
-  Log("Writing FIPPI cache to file %s...",FileName);
 
-  /*---------------------------------------------------------------------*/
-  /*- write file signature ----------------------------------------------*/
-  /*---------------------------------------------------------------------*/
-  fwrite(FIPPICF_Signature,FIPPICF_SIGSIZE,1,f);
+  /*--------------------------------------------------------------*/
+  /*- otherwise write a new file with the union of all mapped     */
+  /*- files, all in-memory records, and the records in any valid  */
+  /*- cache file already present under the target name (which may */
+  /*- include records written by other processes)                 */
+  /*--------------------------------------------------------------*/
+  if (Written<0)
+   { CacheFile **CFs=(CacheFile **)Files;
+     bool TargetMapped=false;
+     for(int nf=0; nf<NumFiles; nf++)
+      if (!strcmp(CFs[nf]->FileName, FileName)) TargetMapped=true;
+     if (!TargetMapped)
+      Target=OpenCacheFile(FileName, &FIPPIFormat);
+
+     unsigned long NumTotal=NumRecords + (Target ? GetCacheFileRecords(Target) : 0);
+     for(int nf=0; nf<NumFiles; nf++)
+      NumTotal+=GetCacheFileRecords(CFs[nf]);
+
+     Keys=(const void **)mallocEC((NumTotal+1)*sizeof(void *));
+     Data=(const void **)mallocEC((NumTotal+1)*sizeof(void *));
+     n=0;
+     FOREACH_READY_RECORD(Shards, R)
+      { Keys[n]=R->K.Key; Data[n]=&(R->QIFD); n++; };
+     for(int nf=-1; nf<NumFiles; nf++)
+      { CacheFile *CF = (nf==-1) ? Target : CFs[nf];
+        if (CF==0) continue;
+        for(unsigned long nr=0; nr<GetCacheFileRecords(CF); nr++, n++)
+         { Keys[n]=GetCacheFileKey(CF,nr); Data[n]=GetCacheFileData(CF,nr); };
+      };
 
-  /*---------------------------------------------------------------------*/
-  /*- iterate through the table and write entries to the file one-by-one */
-  /*---------------------------------------------------------------------*/
-  KeyStruct K;
-  QIFIPPIData *QIFD;
-  FIPPICF_Record MyRecord;
-  for ( it = KVM->begin(); it != KVM->end(); it++ ) 
-   { 
-     K=it->first;
-     QIFD=it->second;
-     memcpy(&(MyRecord.K.Key),       K.Key, sizeof(MyRecord.K.Key ));
-     memcpy(&(MyRecord.QIFDBuffer),  QIFD,  sizeof(MyRecord.QIFDBuffer));
-     if ( 1 != fwrite(&(MyRecord),sizeof(MyRecord),1,f ) )
-      break;
-     NumRecords++;
+     Log("Writing FIPPI cache to file %s...",FileName);
+     Written=WriteCacheFile(FileName, &FIPPIFormat, n, Keys, Data);
+     free(Keys);
+     free(Data);
+     CloseCacheFile(Target);
+     if (Written<0)
+      { Warn("could not write FIPPI cache file %s (aborting cache dump)",FileName);
+        goto done;
+      };
+     Log(" ...wrote %li FIPPI records.",Written);
    };
 
-  /*---------------------------------------------------------------------*/
-  /*- and that's it -----------------------------------------------------*/
-  /*---------------------------------------------------------------------*/
-  fclose(f);
-  Log(" ...wrote %i FIPPI records.",NumRecords);
+  /*--------------------------------------------------------------*/
+  /*- FileName now contains everything we have -------------------*/
+  /*--------------------------------------------------------------*/
+  FOREACH_READY_RECORD(Shards, R)
+   R->Stored=true;
+  if (StoreFileName) free(StoreFileName);
+  StoreFileName=strdupEC(FileName);
 
  done:
-  FCLock.read_unlock();
+  for(int ns=0; ns<FIPPI_NUMSHARDS; ns++)
+   Shards[ns].Lock.write_unlock();
 }
 
-void FIPPICache::PreLoad(const char *FileName)
+/*--------------------------------------------------------------*/
+/*- read a cache file in the legacy format into the in-memory   */
+/*- table; returns 0 on success or an error message.            */
+/*--------------------------------------------------------------*/
+static const char *PreLoadLegacy(FIPPIShard *Shards, const char *FileName,
+                                 unsigned long *pNumRecords)
 {
-
-  FCLock.write_lock();
-
-  KeyValueMap *KVM=(KeyValueMap *)opTable;
-
-  /*--------------------------------------------------------------*/
-  /*- try to open the file ---------------------------------------*/
-  /*--------------------------------------------------------------*/
   FILE *f=fopen(FileName,"r");
   if (!f)
-   { fprintf(stderr,"warning: could not open file %s (skipping cache preload)\n",FileName);
-     Log("Could not open FIPPI cache file %s...",FileName); 
-     goto done;
-   };
+   return "could not open file";
 
-  /*--------------------------------------------------------------*/
-  /*- run through some sanity checks to make sure we have a valid */
-  /*- cache file                                                  */
-  /*--------------------------------------------------------------*/
-  const char *ErrMsg;
-  ErrMsg = 0;
-  
+  const char *ErrMsg=0;
   struct stat fileStats;
+  char FileSignature[FIPPICF_SIGSIZE];
+  off_t FileSize=0;
   if ( fstat(fileno(f), &fileStats) )
    ErrMsg="invalid cache file";
-  
-  // check that the file signature is present and correct 
-  off_t FileSize;
-  FileSize=fileStats.st_size;
-  char FileSignature[FIPPICF_SIGSIZE]; 
+  else
+   FileSize=fileStats.st_size;
   if ( ErrMsg==0 && (FileSize < (signed int )FIPPICF_SIGSIZE) )
    ErrMsg="invalid cache file";
   if ( ErrMsg==0 && 1!=fread(FileSignature, FIPPICF_SIGSIZE, 1, f) )
    ErrMsg="invalid cache file";
-  if ( ErrMsg==0 && strcmp(FileSignature, FIPPICF_Signature) ) 
+  if ( ErrMsg==0 && strcmp(FileSignature, FIPPICF_Signature) )
    ErrMsg="invalid cache file";
 
-  // the file size, minus the portion taken up by the signature, 
+  // the file size, minus the portion taken up by the signature,
   // should be an integer multiple of the size of a FIPPICF_Record
   FileSize-=FIPPICF_SIGSIZE;
   if ( ErrMsg==0 && (FileSize % FIPPICF_RECSIZE)!=0 )
    ErrMsg="cache file has incorrect size";
-
-  /*--------------------------------------------------------------*/
-  /*- allocate memory to store cache entries read from the file. -*/
-  /*- for now, we abort if there is not enough memory to store   -*/
-  /*- the full cache; TODO explore schemes for partial preload.  -*/
-  /*--------------------------------------------------------------*/
-  unsigned int NumRecords;
-  FIPPICF_Record *Records;
-  NumRecords = FileSize / FIPPICF_RECSIZE;
-  if ( ErrMsg==0 )
-   { Records=(FIPPICF_Record *)mallocEC(NumRecords*FIPPICF_RECSIZE);
-     if ( !Records)
-      ErrMsg="insufficient memory to preload cache";
-   };
-
-  /*--------------------------------------------------------------*/
-  /*- pause here to clean up if anything went wrong --------------*/
-  /*--------------------------------------------------------------*/
   if (ErrMsg)
-   { fprintf(stderr,"warning: file %s: %s (skipping cache preload)\n",FileName,ErrMsg);
-     Log("FIPPI cache file %s: %s (skipping cache preload)",FileName,ErrMsg);
-     fclose(f);
-     goto done;
+   { fclose(f);
+     return ErrMsg;
    };
 
-  /*--------------------------------------------------------------*/
-  /*- now just read records from the file one at a time and add   */
-  /*- them to the table.                                          */
-  /*--------------------------------------------------------------*/
-  unsigned int nr;
-  Log("Preloading FIPPI records from file %s...",FileName);
-  for(nr=0; nr<NumRecords; nr++)
+  unsigned long NumRecords=FileSize / FIPPICF_RECSIZE;
+  FIPPICF_Record MyRecord;
+  for(unsigned long nr=0; nr<NumRecords; nr++)
    { 
-     if ( fread(Records+nr, FIPPICF_RECSIZE,1,f) != 1 )
-      { fprintf(stderr,"warning: file %s: read only %i of %i records",FileName,nr+1,NumRecords);
-        fclose(f);
-	goto done;
+     if ( fread(&MyRecord, FIPPICF_RECSIZE,1,f) != 1 )
+      { fclose(f);
+        *pNumRecords=nr;
+        return "file was truncated";
       };
 
-     KVM->insert( KeyValuePair(Records[nr].K, &(Records[nr].QIFDBuffer)) );
+     unsigned long Hash = (unsigned long)HashFunction(MyRecord.K.Key);
+     FIPPIShard *S = Shards + (Hash & (FIPPI_NUMSHARDS-1));
+     S->Lock.write_lock();
+     if ( FindRecord(S->Table, &(MyRecord.K), Hash)==0 )
+      { FIPPIRecord *R=AllocateRecord(S);
+        memcpy(R->K.Key, MyRecord.K.Key, KEYSIZE);
+        memcpy(&(R->QIFD), &(MyRecord.QIFDBuffer), sizeof(QIFIPPIData));
+        R->Hash=Hash;
+        R->Stored=false;
+        R->State=FIPPI_READY;
+        InsertRecord(S, R);
+      };
+     S->Lock.write_unlock();
    };
-
-  /*--------------------------------------------------------------*/
-  /*- the full file was successfully preloaded -------------------*/
-  /*--------------------------------------------------------------*/
-  Log(" ...successfully preloaded %i FIPPI records.",NumRecords);
   fclose(f);
+  *pNumRecords=NumRecords;
+  return 0;
+}
 
-  // the most recent file from which we preloaded, and the number of 
-  // records preloaded, are stored within the class body to allow us 
-  // to skip dumping the cache back to disk in cases where that would
-  // amount to just rewriting the same cache file
-  if (PreloadFileName)
-   free(PreloadFileName);
-  PreloadFileName=strdupEC(FileName);
-  RecordsPreloaded=NumRecords;
+void FIPPICache::PreLoad(const char *FileName)
+{
+  const char *ErrMsg;
+  CacheFile *CF=OpenCacheFile(FileName, &FIPPIFormat, &ErrMsg);
+  if (CF)
+   { 
+     CacheFile **CFs=(CacheFile **)reallocEC(Files, (NumFiles+1)*sizeof(CacheFile *));
+     CFs[NumFiles++]=CF;
+     Files=(void *)CFs;
+     Log("Mapped %lu FIPPI records from cache file %s.",GetCacheFileRecords(CF),FileName);
+
+     // if this is the only file we have mapped, it contains everything
+     // we know about, and subsequent calls to Store() for the same file
+     // can simply append to it
+     if (StoreFileName) free(StoreFileName);
+     StoreFileName = (NumFiles==1) ? strdupEC(FileName) : 0;
+     return;
+   };
 
- done:
-  FCLock.write_unlock();
+  unsigned long NumRecords=0;
+  const char *LegacyErrMsg=PreLoadLegacy((FIPPIShard *)opTable, FileName, &NumRecords);
+  if (LegacyErrMsg==0)
+   Log("Preloaded %lu FIPPI records from legacy-format cache file %s.",NumRecords,FileName);
+  else
+   { // report the more informative of the two error messages
+     if (strcmp(LegacyErrMsg,"invalid cache file")) ErrMsg=LegacyErrMsg;
+     fprintf(stderr,"warning: file %s: %s (skipping cache preload)\n",FileName,ErrMsg);
+     Log("FIPPI cache file %s: %s (skipping cache preload)",FileName,ErrMsg);
+   };
 }
 
 /***************************************************************/
@@ -425,6 +595,9 @@ void PreloadCache(const char *FileName)
 
 void StoreCache(const char *FileName)
 { 
+  // when running on several MPI ranks, only the root writes
+  if (GetMPIRank()>0)
+   return;
   GlobalFIPPICache.Store(FileName);
 }
 
@@ -21,8 +21,17 @@
  * GBarAccelerator.h -- 
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
 
 #include <libhrutil.h>
 #include <libMDInterp.h>
@@ -33,8 +42,35 @@
 
 #define II cdouble(0,1)
 
+#define MAXSTR 1000
+
 namespace scuff{
 
+/***************************************************************/
+/* pack the GBarVD values computed by GBarVDEwald into the     */
+/* PhiVD arrays expected by the Interp2D / Interp3D routines   */
+/***************************************************************/
+static void GBarVDToPhi2D(cdouble *GBarVD, double *PhiVD)
+{
+  PhiVD[0] = real(GBarVD[0]); // real(G)
+  PhiVD[1] = real(GBarVD[1]); // real(dGdX)
+  PhiVD[2] = real(GBarVD[2]); // real(dGdY) = real(dGdRho)
+  PhiVD[3] = real(GBarVD[4]); // real(dG2dXdY) = real(dG2dXdRho)
+
+  PhiVD[4] = imag(GBarVD[0]); // imag(G)
+  PhiVD[5] = imag(GBarVD[1]); // imag(dGdX)
+  PhiVD[6] = imag(GBarVD[2]); // imag(dGdRho)
+  PhiVD[7] = imag(GBarVD[4]); // imag(dG2dXdRho)
+}
+
+static void GBarVDToPhi3D(cdouble *GBarVD, double *PhiVD)
+{
+  for(int ns=0; ns<8; ns++)
+   { PhiVD[ns]   = real(GBarVD[ns]);
+     PhiVD[8+ns] = imag(GBarVD[ns]);
+   };
+}
+
 /***************************************************************/
 /* entry point for GBarVD that has the proper prototype for    */
 /* passage to the Interp2D() initialization routine.           */
@@ -49,19 +85,8 @@ void GBarVDPhi2D(double x, double Rho, void *UserData, double *PhiVD)
   R[2]=0.0;
 
   cdouble GBarVD[8];
-  GBarVDEwald(R, GBA->k, GBA->kBloch, GBA->LBV, GBA->LDim,
-              -1.0, GBA->ExcludeInnerCells, GBarVD);
- 
-  PhiVD[0] = real(GBarVD[0]); // real(G)
-  PhiVD[1] = real(GBarVD[1]); // real(dGdX)
-  PhiVD[2] = real(GBarVD[2]); // real(dGdY) = real(dGdRho)
-  PhiVD[3] = real(GBarVD[4]); // real(dG2dXdY) = real(dG2dXdRho)
-
-  PhiVD[4] = imag(GBarVD[0]); // imag(G)
-  PhiVD[5] = imag(GBarVD[1]); // imag(dGdX)
-  PhiVD[6] = imag(GBarVD[2]); // imag(dGdRho)
-  PhiVD[7] = imag(GBarVD[4]); // imag(dG2dXdRho)
-
+  GBarVDEwald(GBA->ET, R, GBarVD);
+  GBarVDToPhi2D(GBarVD, PhiVD);
 }
 
 /***************************************************************/
@@ -79,196 +104,468 @@ void GBarVDPhi3D(double X1, double X2, double X3, void *UserData, double *PhiVD)
   R[2]=X3;
 
   cdouble GBarVD[8];
-  GBarVDEwald(R, GBA->k, GBA->kBloch, GBA->LBV, GBA->LDim,
-              -1.0, GBA->ExcludeInnerCells, GBarVD);
- 
-  PhiVD[ 0] = real(GBarVD[0]);
-  PhiVD[ 1] = real(GBarVD[1]);
-  PhiVD[ 2] = real(GBarVD[2]);
-  PhiVD[ 3] = real(GBarVD[3]);
-  PhiVD[ 4] = real(GBarVD[4]);
-  PhiVD[ 5] = real(GBarVD[5]);
-  PhiVD[ 6] = real(GBarVD[6]);
-  PhiVD[ 7] = real(GBarVD[7]);
-  PhiVD[ 8] = imag(GBarVD[0]);
-  PhiVD[ 9] = imag(GBarVD[1]);
-  PhiVD[10] = imag(GBarVD[2]);
-  PhiVD[11] = imag(GBarVD[3]);
-  PhiVD[12] = imag(GBarVD[4]);
-  PhiVD[13] = imag(GBarVD[5]);
-  PhiVD[14] = imag(GBarVD[6]);
-  PhiVD[15] = imag(GBarVD[7]);
-
+  GBarVDEwald(GBA->ET, R, GBarVD);
+  GBarVDToPhi3D(GBarVD, PhiVD);
 } 
 
 /***************************************************************/
+/* the full interpolation tables are built from GBarVD values  */
+/* precomputed in batches, one batch per Rho (1D lattices) or  */
+/* z (2D lattices) slice of the grid, so that the Rho- or      */
+/* z-dependent factors in the reciprocal-lattice sum are       */
+/* shared by all points in the slice. the Interp2D / Interp3D  */
+/* initialization routines then fetch the values by looking up */
+/* the grid point.                                             */
+/***************************************************************/
+typedef struct GBarVDGrid
+ { int N[3];
+   double *X[3];
+   cdouble *GBarVD; // GBarVD[8*(n0 + N0*(n1 + N1*n2)) + ns]
+ } GBarVDGrid;
+
+static void ComputeGBarVDGrid(GBarAccelerator *GBA, GBarVDGrid *Grid)
+{
+  int NumDims    = (GBA->LDim==1) ? 2 : 3;
+  int NumSlices  = Grid->N[NumDims-1];
+  int SliceSize  = (NumDims==2) ? Grid->N[0] : Grid->N[0]*Grid->N[1];
+  Grid->GBarVD   = (cdouble *)mallocEC(8*NumSlices*SliceSize*sizeof(cdouble));
+
+#ifdef USE_OPENMP
+  int NumThreads = GetNumThreads();
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+  for(int nSlice=0; nSlice<NumSlices; nSlice++)
+   { double *R = (double *)mallocEC(3*SliceSize*sizeof(double));
+     for(int np=0; np<SliceSize; np++)
+      { R[3*np + 0] = Grid->X[0][ np % Grid->N[0] ];
+        if (NumDims==2)
+         { R[3*np + 1] = Grid->X[1][nSlice];
+           R[3*np + 2] = 0.0;
+         }
+        else
+         { R[3*np + 1] = Grid->X[1][ np / Grid->N[0] ];
+           R[3*np + 2] = Grid->X[2][nSlice];
+         };
+      };
+     GBarVDEwald(GBA->ET, SliceSize, R, Grid->GBarVD + 8*nSlice*SliceSize);
+     free(R);
+   };
+}
+
+static int FindGridPoint(double *X, int N, double x)
+{ 
+  int nMin=0, nMax=N-1;
+  while( nMax-nMin > 1 )
+   { int nMid = (nMin+nMax)/2;
+     if ( X[nMid] <= x )
+      nMin=nMid;
+     else
+      nMax=nMid;
+   };
+  return ( fabs(x-X[nMin]) <= fabs(x-X[nMax]) ) ? nMin : nMax;
+}
+
+static void GBarVDGridPhi2D(double x, double Rho, void *UserData, double *PhiVD)
+{
+  GBarVDGrid *Grid = (GBarVDGrid *)UserData;
+  int n0 = FindGridPoint(Grid->X[0], Grid->N[0], x);
+  int n1 = FindGridPoint(Grid->X[1], Grid->N[1], Rho);
+  GBarVDToPhi2D(Grid->GBarVD + 8*(n0 + Grid->N[0]*n1), PhiVD);
+}
+
+static void GBarVDGridPhi3D(double X1, double X2, double X3, 
+                            void *UserData, double *PhiVD)
+{
+  GBarVDGrid *Grid = (GBarVDGrid *)UserData;
+  int n0 = FindGridPoint(Grid->X[0], Grid->N[0], X1);
+  int n1 = FindGridPoint(Grid->X[1], Grid->N[1], X2);
+  int n2 = FindGridPoint(Grid->X[2], Grid->N[2], X3);
+  GBarVDToPhi3D(Grid->GBarVD + 8*(n0 + Grid->N[0]*(n1 + Grid->N[1]*n2)), PhiVD);
+}
+
 /***************************************************************/
+/* evaluate GBarVD at an arbitrary list of points, splitting   */
+/* the list into chunks that are handed to separate threads.   */
 /***************************************************************/
-void GetOptimalGridSpacing1D(GBarAccelerator *GBA, double x, double Rho,
-                             double RelTol, double OptimalDelta[2],
-                             double *MinDelta)
+static void GetGBarVDList(GBarAccelerator *GBA, int NumPoints,
+                          double *R, cdouble *GBarVD)
 {
-  double Delta[2];
+  int NumThreads = 1;
+#ifdef USE_OPENMP
+  NumThreads = GetNumThreads();
+#endif
+  int ChunkSize  = NumPoints / (4*NumThreads) + 1;
+  if (ChunkSize<16) ChunkSize=16;
+  int NumChunks  = (NumPoints + ChunkSize - 1) / ChunkSize;
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  double L0 = GBA->LBV[0][0];
-  Delta[0] = L0 / 10.0;
-  Delta[1] = (GBA->RhoMax - GBA->RhoMin)/10.0;
-  if (Delta[1]<=0.0)
-   Delta[1] = Delta[0];
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+  for(int nc=0; nc<NumChunks; nc++)
+   { int Offset = nc*ChunkSize;
+     int Count  = ( Offset+ChunkSize <= NumPoints ) ? ChunkSize : NumPoints-Offset;
+     GBarVDEwald(GBA->ET, Count, R + 3*Offset, GBarVD + 8*Offset);
+   };
+}
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  double xMin = x, xMax=x+Delta[0];
-  if (EqualFloat(x,L0))
-   { xMin=x-Delta[0]; xMax=x; }
-  double RhoMin = Rho, RhoMax=Rho+Delta[1];
-  if (EqualFloat(Rho,GBA->RhoMax))
-   { RhoMin = Rho-Delta[1]; RhoMax=Rho;
+/***************************************************************/
+/* evaluate GBarVD at the points X_Mu = XList[0..NX-1] on all */
+/* probe lines (see below). the values at point nx on probe    */
+/* line nl are returned in GBarVD[8*(nl + NumLines*nx) + ...]. */
+/***************************************************************/
+static void EvaluateOnProbeLines(GBarAccelerator *GBA, int NumDims, int Mu,
+                                 double ProbeX[3][3], int NumProbeX[3],
+                                 int NumLines, double *XList, int NX,
+                                 double *R, cdouble *GBarVD)
+{
+  for(int nx=0; nx<NX; nx++)
+   for(int nl=0; nl<NumLines; nl++)
+    { double *RR = R + 3*(nl + NumLines*nx);
+      RR[0]=RR[1]=RR[2]=0.0;
+      for(int Nu=0, Stride=1; Nu<NumDims; Nu++)
+       { if (Nu==Mu)
+          RR[Nu] = XList[nx];
+         else
+          { RR[Nu] = ProbeX[Nu][ (nl/Stride) % NumProbeX[Nu] ];
+            Stride *= NumProbeX[Nu];
+          };
+       };
+    };
+  GetGBarVDList(GBA, NumLines*NX, R, GBarVD);
+}
+
+/***************************************************************/
+/* choose the grid points along table dimension Mu by          */
+/* hierarchical refinement of a coarse uniform grid.           */
+/*                                                             */
+/* GBar and its Mu-derivative are tabulated along a few probe  */
+/* lines parallel to the Mu axis, placed at the endpoints and  */
+/* midpoints of the table range in the other dimensions. at    */
+/* each level of refinement we compute GBar at the midpoints   */
+/* of all intervals not yet known to be converged, on all      */
+/* probe lines at once (in one parallel batch), and compare to */
+/* the cubic Hermite interpolant through the interval          */
+/* endpoints; this is the one-dimensional restriction of the   */
+/* Interp2D / Interp3D interpolant, so its error is a good     */
+/* estimate of the table error. an interval that fails on any  */
+/* probe line is subdivided into as many pieces as the h^4     */
+/* (value) or h^3 (derivative) error scaling says it needs,    */
+/* and the pieces are checked again at the next level.         */
+/* intervals that pass are never revisited.                    */
+/*                                                             */
+/* errors are measured relative to the largest magnitude of    */
+/* GBar (or its derivative) on the interval, which avoids      */
+/* endless refinement near zeros of oscillatory GBar.          */
+/*                                                             */
+/* XMin, XMax are the table ranges in all NumDims dimensions.  */
+/* on return, XPoints[0..*N-1] are the grid points in          */
+/* dimension Mu.                                               */
+/***************************************************************/
+#define NUMCOARSE     5
+#define MAXGRIDPOINTS 1000
+#define MAXSUBDIVIDE  8
+static void RefineGridDimension(GBarAccelerator *GBA, int NumDims, int Mu,
+                                double *XMin, double *XMax, double RelTol,
+                                double *XPoints, int *N)
+{
+  /*--------------------------------------------------------------*/
+  /*- probe-line coordinates in the other dimensions -------------*/
+  /*--------------------------------------------------------------*/
+  double ProbeX[3][3];
+  int NumProbeX[3], NumLines=1;
+  for(int Nu=0; Nu<NumDims; Nu++)
+   { NumProbeX[Nu]=1;
+     ProbeX[Nu][0]=XMin[Nu];
+     if (Nu==Mu || XMax[Nu]<=XMin[Nu]) continue;
+     ProbeX[Nu][1]=0.5*(XMin[Nu] + XMax[Nu]);
+     ProbeX[Nu][2]=XMax[Nu];
+     NumProbeX[Nu]=3;
+     NumLines*=3;
    };
 
-  Interp2D *I2D=new Interp2D(xMin,     xMax, 2,
-                             RhoMin, RhoMax, 2,
-                             2, GBarVDPhi2D, (void *)GBA, LMDI_LOGLEVEL_NONE);
+  /*--------------------------------------------------------------*/
+  /*- FV[2*(nl + NumLines*np) + 0,1] = G, dG/dX_Mu at grid point -*/
+  /*- np on probe line nl                                        -*/
+  /*--------------------------------------------------------------*/
+  cdouble *FV        = (cdouble *)mallocEC(2*NumLines*MAXGRIDPOINTS*sizeof(cdouble));
+  cdouble *NewFV     = (cdouble *)mallocEC(2*NumLines*MAXGRIDPOINTS*sizeof(cdouble));
+  double *R          = (double *)mallocEC(3*NumLines*MAXGRIDPOINTS*sizeof(double));
+  cdouble *GBarVD    = (cdouble *)mallocEC(8*NumLines*MAXGRIDPOINTS*sizeof(cdouble));
+  double *XMid       = (double *)mallocEC(MAXGRIDPOINTS*sizeof(double));
+  double *NewX       = (double *)mallocEC(MAXGRIDPOINTS*sizeof(double));
+  bool *Active       = (bool *)mallocEC(MAXGRIDPOINTS*sizeof(bool));
+  bool *NewActive    = (bool *)mallocEC(MAXGRIDPOINTS*sizeof(bool));
+  double *ParentRatio    = (double *)mallocEC(MAXGRIDPOINTS*sizeof(double));
+  double *NewParentRatio = (double *)mallocEC(MAXGRIDPOINTS*sizeof(double));
+  double *Ratios         = (double *)mallocEC(MAXGRIDPOINTS*sizeof(double));
+  int *NumPieces     = (int *)mallocEC(MAXGRIDPOINTS*sizeof(int));
+
+  double Length   = XMax[Mu] - XMin[Mu];
+  double MinWidth = Length / MAXGRIDPOINTS;
+
+  int NX = NUMCOARSE;
+  for(int n=0; n<NX; n++)
+   { XPoints[n] = XMin[Mu] + n*Length/(NX-1);
+     Active[n]  = (n<NX-1);
+     ParentRatio[n] = HUGE_VAL;
+   };
+  EvaluateOnProbeLines(GBA, NumDims, Mu, ProbeX, NumProbeX, NumLines,
+                       XPoints, NX, R, GBarVD);
+  for(int n=0; n<NX*NumLines; n++)
+   { FV[2*n + 0] = GBarVD[8*n + 0];
+     FV[2*n + 1] = GBarVD[8*n + 1 + Mu];
+   };
+  int TotalEvals = NX*NumLines;
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  double Phi[8];
-  cdouble GExact, GInterp;
-  cdouble dGExact[3], dGInterp[3];
-  double RelError;
-
-  // estimate relative error in Mu direction
-  //int Worst[2];
-  for(int Mu=0; Mu<2; Mu++)
+  for(;;)
    { 
-     double R[2];
-     R[0] = xMin;
-     R[1] = RhoMin;
-     R[Mu] += 0.5*Delta[Mu];
-     GBarVDPhi2D( R[0], R[1], (void *)GBA, Phi);
-     GExact     = cdouble(Phi[0], Phi[4]);
-     dGExact[0] = cdouble(Phi[1], Phi[5]);
-     dGExact[1] = cdouble(Phi[2], Phi[6]);
-     I2D->EvaluatePlus(R[0], R[1], Phi);
-     GInterp     = cdouble(Phi[0], Phi[4]);
-     dGInterp[0] = cdouble(Phi[1], Phi[5]);
-     dGInterp[1] = cdouble(Phi[2], Phi[6]);
-     RelError = abs(GInterp-GExact) / abs(GExact);
-     OptimalDelta[Mu] = Delta[Mu] * pow( RelTol/RelError, 0.25 );
-     //Worst[Mu]=0;
-     for(int Nu=0; Nu<2; Nu++)
-      { if ( abs(dGExact[Nu]) < 1.0e-6*abs(GExact) ) continue;
-        RelError = abs(dGInterp[Nu]-dGExact[Nu]) / abs(dGExact[Nu]);
-        double OptDeltaNu = Delta[Mu] * pow( RelTol/RelError, 0.33 );
-        if (OptDeltaNu < OptimalDelta[Mu] )
-         { OptimalDelta[Mu] = OptDeltaNu;
-           //Worst[Mu]=1+Nu;
+     /*--------------------------------------------------------------*/
+     /*- compute GBar at midpoints of intervals still active --------*/
+     /*--------------------------------------------------------------*/
+     int NumActive=0;
+     for(int n=0; n<NX-1; n++)
+      if (Active[n])
+       XMid[NumActive++] = 0.5*(XPoints[n] + XPoints[n+1]);
+     if (NumActive==0) 
+      break;
+
+     EvaluateOnProbeLines(GBA, NumDims, Mu, ProbeX, NumProbeX, NumLines,
+                          XMid, NumActive, R, GBarVD);
+     TotalEvals += NumActive*NumLines;
+
+     /*--------------------------------------------------------------*/
+     /*- compare against the Hermite interpolant on each interval   -*/
+     /*- and decide how many pieces to split it into                -*/
+     /*--------------------------------------------------------------*/
+     int NewNX=NX;
+     for(int n=0, na=0; n<NX-1; n++)
+      { NumPieces[n]=1;
+        Ratios[n]=HUGE_VAL;
+        if (!Active[n]) 
+         continue;
+
+        double h = XPoints[n+1] - XPoints[n];
+        double Ratio=0.0;
+        for(int nl=0; nl<NumLines; nl++)
+         { cdouble G0  = FV[2*(nl + NumLines*n) + 0];
+           cdouble dG0 = FV[2*(nl + NumLines*n) + 1];
+           cdouble G1  = FV[2*(nl + NumLines*(n+1)) + 0];
+           cdouble dG1 = FV[2*(nl + NumLines*(n+1)) + 1];
+           cdouble GExact   = GBarVD[8*(nl + NumLines*na) + 0];
+           cdouble dGExact  = GBarVD[8*(nl + NumLines*na) + 1 + Mu];
+           cdouble GInterp  = 0.5*(G0+G1) + 0.125*h*(dG0-dG1);
+           cdouble dGInterp = 1.5*(G1-G0)/h - 0.25*(dG0+dG1);
+
+           double GScale  = fmax( abs(GExact), fmax(abs(G0), abs(G1)) );
+           double dGScale = fmax( abs(dGExact), fmax(abs(dG0), abs(dG1)) );
+           if (GScale==0.0) 
+            continue;
+           Ratio = fmax(Ratio, pow( abs(GInterp-GExact) / (RelTol*GScale), 0.25 ) );
+           if ( dGScale >= 1.0e-6*GScale )
+            Ratio = fmax(Ratio, pow( abs(dGInterp-dGExact) / (RelTol*dGScale), 0.33 ) );
+         };
+        na++;
+        Ratios[n]=Ratio;
+
+        // stop if the interval is converged, is as small as we allow,
+        // or has stopped converging because GBar values are only
+        // known to finite precision
+        if (Ratio<=1.0 || h<2.0*MinWidth || Ratio>0.9*ParentRatio[n])
+         { Active[n]=false;
+           continue;
          };
+        NumPieces[n] = (int)ceil(1.1*Ratio);
+        if (NumPieces[n]<2) NumPieces[n]=2;
+        if (NumPieces[n]>MAXSUBDIVIDE) NumPieces[n]=MAXSUBDIVIDE;
+        while( h/NumPieces[n] < MinWidth ) 
+         NumPieces[n]--;
+        NewNX += NumPieces[n]-1;
       };
-   };
 
-  delete I2D;
+     if (NewNX==NX)
+      break;
+     if (NewNX > MAXGRIDPOINTS)
+      { Warn("interpolation grid did not converge to tolerance %e in dimension %i",RelTol,Mu);
+        break;
+      };
 
-#if 0
-  if (RWGGeometry::LogLevel >= SCUFF_VERBOSE2)
-   Log("Optimal spacing at (%e,%e)=(%e,%e) (worst: %s, %s)",
-        x,Rho,OptimalDelta[0],OptimalDelta[1],
-        Worst[0]==0 ? "value" : Worst[0]==1 ? "xDeriv" : "RhoDeriv",
-        Worst[1]==0 ? "value" : Worst[1]==1 ? "xDeriv" : "RhoDeriv");
-#endif
+     /*--------------------------------------------------------------*/
+     /*- insert the new grid points and compute GBar on them        -*/
+     /*--------------------------------------------------------------*/
+     int NumNew=0;
+     for(int n=0, nn=0; n<NX; n++)
+      { NewX[nn]=XPoints[n];
+        NewActive[nn]=false;
+        NewParentRatio[nn]=(n<NX-1) ? Ratios[n] : HUGE_VAL;
+        memcpy(NewFV + 2*NumLines*nn, FV + 2*NumLines*n, 2*NumLines*sizeof(cdouble));
+        nn++;
+        if (n==NX-1)
+         continue;
+        double h = (XPoints[n+1]-XPoints[n]) / NumPieces[n];
+        for(int np=1; np<NumPieces[n]; np++, nn++)
+         { NewX[nn] = XMid[NumNew++] = XPoints[n] + np*h;
+           NewActive[nn-1]=true;
+           NewParentRatio[nn]=Ratios[n];
+         };
+        if (NumPieces[n]>1) 
+         NewActive[nn-1]=true;
+      };
 
-  if (MinDelta)
-   { MinDelta[0] = fmin(MinDelta[0], OptimalDelta[0]);
-     MinDelta[1] = fmin(MinDelta[1], OptimalDelta[1]);
+     EvaluateOnProbeLines(GBA, NumDims, Mu, ProbeX, NumProbeX, NumLines,
+                          XMid, NumNew, R, GBarVD);
+     TotalEvals += NumNew*NumLines;
+
+     for(int nn=0, nNew=0; nn<NewNX; nn++)
+      { if ( nNew==NumNew || NewX[nn]!=XMid[nNew] ) 
+         continue;
+        for(int nl=0; nl<NumLines; nl++)
+         { NewFV[2*(nl + NumLines*nn) + 0] = GBarVD[8*(nl + NumLines*nNew) + 0];
+           NewFV[2*(nl + NumLines*nn) + 1] = GBarVD[8*(nl + NumLines*nNew) + 1 + Mu];
+         };
+        nNew++;
+      };
+
+     NX=NewNX;
+     memcpy(XPoints, NewX, NX*sizeof(double));
+     memcpy(Active, NewActive, NX*sizeof(bool));
+     memcpy(ParentRatio, NewParentRatio, NX*sizeof(double));
+     cdouble *Temp=FV; FV=NewFV; NewFV=Temp;
    };
 
+  Log("  Dimension %i: %i grid points (%i probe evaluations).",Mu,NX,TotalEvals);
+
+  *N=NX;
+  free(FV);
+  free(NewFV);
+  free(R);
+  free(GBarVD);
+  free(XMid);
+  free(NewX);
+  free(Active);
+  free(NewActive);
+  free(ParentRatio);
+  free(NewParentRatio);
+  free(Ratios);
+  free(NumPieces);
 }
 
 /***************************************************************/
+/* optional on-disk cache of interpolation tables. if the      */
+/* environment variable SCUFF_GBA_CACHE_PATH names a directory,*/
+/* each table built by CreateGBarAccelerator is written there  */
+/* (by WriteToFile) under a name derived from a hash of the    */
+/* lattice basis, k, kBloch, Rho range, tolerance, and         */
+/* ExcludeInnerCells flag, and subsequent requests for a table */
+/* with the same parameters---in this run or later ones---map  */
+/* the table from the file instead of recomputing it. a table  */
+/* read from the cache is checked against direct Ewald         */
+/* summation at one point before it is used.                   */
+/*                                                             */
+/* files are written under a temporary name and renamed into   */
+/* place, so concurrent jobs sharing the directory never see   */
+/* partially-written tables.                                   */
 /***************************************************************/
-/***************************************************************/
-void GetOptimalGridSpacing2D(GBarAccelerator *GBA,
-                             double x, double y, double z,
-                             double RelTol, double OptimalDelta[3],
-                             double *MinDelta)
+#define GBA_CACHE_VERSION 2
+
+static void GetGBACacheFileName(GBarAccelerator *GBA, const char *Dir,
+                                char *FileName, size_t Size)
 {
-  double Delta[3];
+  double Key[16];
+  int nk=0;
+  Key[nk++] = GBA_CACHE_VERSION;
+  Key[nk++] = GBA->LDim;
+  for(int nd=0; nd<GBA->LDim; nd++)
+   { Key[nk++] = GBA->LBV[nd][0];
+     Key[nk++] = GBA->LBV[nd][1];
+   };
+  Key[nk++] = real(GBA->k);
+  Key[nk++] = imag(GBA->k);
+  for(int nd=0; nd<GBA->LDim; nd++)
+   Key[nk++] = GBA->kBloch ? GBA->kBloch[nd] : 0.0;
+  Key[nk++] = GBA->RhoMin;
+  Key[nk++] = GBA->RhoMax;
+  Key[nk++] = GBA->RelTol;
+  Key[nk++] = GBA->ExcludeInnerCells ? 1.0 : 0.0;
+
+  // 64-bit FNV-1a hash of the key
+  uint64_t h=14695981039346656037ULL;
+  const unsigned char *p=(const unsigned char *)Key;
+  for(size_t n=0; n<nk*sizeof(double); n++)
+   { h ^= p[n];
+     h *= 1099511628211ULL;
+   };
 
-  if (GBA->LBV[0][1]!=0.0 || GBA->LBV[1][0]!=0.0)
-   ErrExit("%s:%i: non-square lattice not yet supported",__FILE__,__LINE__);
-  double L0x=GBA->LBV[0][0], L0y=GBA->LBV[1][1];
+  snprintf(FileName, Size, "%s/%016llx.gba", Dir, (unsigned long long)h);
+}
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  Delta[0] = L0x / 10.0;
-  Delta[1] = L0y / 10.0;
-  Delta[2] = (GBA->RhoMax - GBA->RhoMin)/10.0;
-  if (Delta[2]<=0.0)
-   Delta[2] = Delta[0];
+// grid point at fractional position Frac along one table dimension
+static double GetTablePoint(double *XPoints, double XMin, double DX,
+                            int N, double Frac)
+{ 
+  if (XPoints)
+   return XPoints[0] + Frac*(XPoints[N-1]-XPoints[0]);
+  return XMin + Frac*DX*(N-1);
+}
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  Interp3D *I3D=new Interp3D(x, x+Delta[0],   2,
-                             y, y+Delta[1],   2,
-                             z, z+Delta[2],   2,
-                             2,   GBarVDPhi3D, (void *)GBA,
-                             LMDI_LOGLEVEL_NONE);
+static bool ReadCachedGBA(GBarAccelerator *GBA, const char *FileName)
+{
+  if ( access(FileName, R_OK) )
+   return false;
 
-  /***************************************************************/
-  /***************************************************************/
-  /***************************************************************/
-  double R[3], Phi[16];
-  cdouble GExact, GInterp;
-  cdouble dGExact[3], dGInterp[3];
-  double RelError;
-  
-  for(int Mu=0; Mu<3; Mu++)
-   { 
-    // estimate relative error in Mu direction
-    R[0] = x;
-    R[1] = y;
-    R[2] = z;
-    R[Mu] += 0.5*Delta[Mu];
-    GBarVDPhi3D( R[0], R[1], R[2], (void *)GBA, Phi);
-    GExact     = cdouble(Phi[0], Phi[8]);
-    dGExact[0] = cdouble(Phi[1], Phi[9]);
-    dGExact[1] = cdouble(Phi[2], Phi[10]);
-    dGExact[2] = cdouble(Phi[3], Phi[11]);
-    I3D->EvaluatePlus(R[0], R[1], R[2], Phi);
-    GInterp     = cdouble(Phi[0], Phi[8]);
-    dGInterp[0] = cdouble(Phi[1], Phi[9]);
-    dGInterp[1] = cdouble(Phi[2], Phi[10]);
-    dGInterp[2] = cdouble(Phi[3], Phi[11]);
-    RelError = abs(GInterp-GExact) / abs(GExact);
-    OptimalDelta[Mu] = Delta[Mu] * pow( RelTol/RelError, 0.25 );
-    for(int Nu=0; Nu<3; Nu++)
-     { if ( abs(dGExact[Nu]) < 1.0e-6*abs(GExact) ) continue;
-       RelError = abs(dGInterp[Nu]-dGExact[Nu]) / abs(dGExact[Nu]);
-       double OptDeltaNu = Delta[Mu] * pow( RelTol/RelError, 0.33 );
-       OptimalDelta[Mu] = fmin(OptimalDelta[Mu], OptDeltaNu);
-     };
+  Log("  Reading interpolation table from %s.",FileName);
+
+  double R[3];
+  cdouble GInterp;
+  if (GBA->LDim==1)
+   { Interp2D *I2D = GBA->I2D = new Interp2D(FileName, true);
+     R[0] = GetTablePoint(I2D->X1Points, I2D->X1Min, I2D->DX1, I2D->N1, 0.37);
+     R[1] = GetTablePoint(I2D->X2Points, I2D->X2Min, I2D->DX2, I2D->N2, 0.61);
+     R[2] = 0.0;
+     I2D->Evaluate(R[0], R[1], (double *)&GInterp);
+   }
+  else
+   { Interp3D *I3D = GBA->I3D = new Interp3D(FileName, true);
+     R[0] = GetTablePoint(I3D->X1Points, I3D->X1Min, I3D->DX1, I3D->N1, 0.37);
+     R[1] = GetTablePoint(I3D->X2Points, I3D->X2Min, I3D->DX2, I3D->N2, 0.61);
+     R[2] = GetTablePoint(I3D->X3Points, I3D->X3Min, I3D->DX3, I3D->N3, 0.43);
+     I3D->Evaluate(R[0], R[1], R[2], (double *)&GInterp);
    };
 
-  delete I3D;
+  cdouble GBarVD[8];
+  GBarVDEwald(GBA->ET, R, GBarVD);
+  if ( abs(GInterp-GBarVD[0]) > 100.0*GBA->RelTol*abs(GBarVD[0]) + 1.0e-12 )
+   { Warn("cached interpolation table %s failed consistency check (recomputing)",FileName);
+     if (GBA->I2D) delete GBA->I2D;
+     if (GBA->I3D) delete GBA->I3D;
+     GBA->I2D=0;
+     GBA->I3D=0;
+     return false;
+   };
 
-#if 0
-  Log("Optimal spacing at (%e,%e,%e)=(%e,%e,%e)",
-       x,y,z,OptimalDelta[0],OptimalDelta[1],OptimalDelta[2]);
-#endif
+  return true;
+}
 
-  if (MinDelta)
-   { MinDelta[0] = fmin(MinDelta[0], OptimalDelta[0]);
-     MinDelta[1] = fmin(MinDelta[1], OptimalDelta[1]);
-     MinDelta[2] = fmin(MinDelta[2], OptimalDelta[2]);
+static void WriteCachedGBA(GBarAccelerator *GBA, const char *Dir, 
+                           const char *FileName)
+{
+  if ( access(Dir, W_OK) )
+   { Warn("could not write to GBA cache directory %s",Dir);
+     return;
    };
 
+  char TmpName[MAXSTR+50];
+  snprintf(TmpName, MAXSTR+50, "%s.%i.%lx.tmp", FileName, (int)getpid(), (unsigned long)GBA);
+  if (GBA->I2D)
+   GBA->I2D->WriteToFile(TmpName);
+  else if (GBA->I3D)
+   GBA->I3D->WriteToFile(TmpName);
+  else
+   return;
+
+  if ( rename(TmpName, FileName) )
+   { Warn("could not rename %s to %s",TmpName,FileName);
+     unlink(TmpName);
+   };
 }
 
 /***************************************************************/
@@ -290,10 +587,21 @@ GBarAccelerator *CreateGBarAccelerator(HMatrix *LBasis,
   GBA->k                  = k;
   GBA->kBloch             = kBloch;
   GBA->ExcludeInnerCells  = ExcludeInnerCells;
+  GBA->RelTol             = RelTol;
   GBA->RhoMin             = RhoMin;
   GBA->RhoMax             = RhoMax;
   GBA->I2D                = 0;
   GBA->I3D                = 0;
+  GBA->ET                 = 0;
+  GBA->RefCount           = 1;
+
+  // keep a private copy of the Bloch vector, since the GBA 
+  // may outlive the caller's array if it is pooled
+  if (kBloch)
+   { GBA->kBlochBuffer[0] = kBloch[0];
+     GBA->kBlochBuffer[1] = kBloch[1];
+     GBA->kBloch = GBA->kBlochBuffer;
+   };
 
   int LDim = GBA->LDim = LBasis->NC;
   for(int nd=0; nd<LDim; nd++)
@@ -316,6 +624,18 @@ GBarAccelerator *CreateGBarAccelerator(HMatrix *LBasis,
    };
   GBA->LMax=LMax;
 
+  /***************************************************************/
+  /* precompute lattice sums for the Ewald evaluations used to   */
+  /* build the table and for points that fall outside it; the    */
+  /* tables cover the unit cell out to Rho=RhoMax                */
+  /***************************************************************/
+  double RMax = fmax(RhoMin, RhoMax);
+  double HalfCell2 = 0.0;
+  for(int nd=0; nd<LDim; nd++)
+   HalfCell2 += 0.25*(GBA->LBV[nd][0]*GBA->LBV[nd][0] + GBA->LBV[nd][1]*GBA->LBV[nd][1]);
+  RMax = sqrt(RMax*RMax + HalfCell2);
+  GBA->ET = CreateEwaldTable(GBA->LBV, LDim, k, GBA->kBloch, ExcludeInnerCells, RMax);
+
   GBA->ForceFullEwald = false;
   if (RhoMin > RhoMax) 
    GBA->ForceFullEwald=true;
@@ -330,127 +650,324 @@ GBarAccelerator *CreateGBarAccelerator(HMatrix *LBasis,
   if (GBA->ForceFullEwald)
    return GBA;
 
+  char *CacheDir=getenv("SCUFF_GBA_CACHE_PATH");
+  char CacheFile[MAXSTR];
+  if (CacheDir && CacheDir[0])
+   { GetGBACacheFileName(GBA, CacheDir, CacheFile, MAXSTR);
+     if ( ReadCachedGBA(GBA, CacheFile) )
+      return GBA;
+   }
+  else 
+   CacheDir=0;
+
   /***************************************************************/
   /***************************************************************/
   /***************************************************************/
-  if (LDim==1)
-   {
-      // sample the optimal grid spacing at a few points
-      // in the domain of interest and take the smallest
-      double L0 = GBA->LBV[0][0], MinDelta[2], Delta[2];
-      if ( L0 > LMax )
-       { L0=LMax;
-         Log("  Cutting off interpolation table at L=LMax=%e.",LMax);
-       };
-      GetOptimalGridSpacing1D(GBA,  0.0*L0, RhoMin, RelTol, MinDelta, 0);
-      GetOptimalGridSpacing1D(GBA, -0.5*L0, RhoMin, RelTol, Delta, MinDelta);
-      GetOptimalGridSpacing1D(GBA,  0.0*L0, RhoMax, RelTol, Delta, MinDelta);
-      GetOptimalGridSpacing1D(GBA, -0.5*L0, RhoMax, RelTol, Delta, MinDelta);
-
-      double DeltaX = MinDelta[0];
-      int nx = ceil( L0 / DeltaX );
-      if (nx<2) nx=2;
-      DeltaX = L0 / ((double)(nx-1));
-      double *XPoints = new double[nx];
-      for(int n=0; n<nx; n++)
-       XPoints[n] = ((double)n)*DeltaX - 0.5*L0;
-
-      #define MAXRHOPOINTS 1000
-      double RhoPoints[MAXRHOPOINTS];
-      double MinDeltaRho = (RhoMax-RhoMin) / MAXRHOPOINTS;
-      RhoPoints[0]=RhoMin;
-      int nRho=0;
-      bool Done=false;
-      while(!Done)
-       { 
-         double Rho = RhoPoints[nRho];
-         GetOptimalGridSpacing1D(GBA,  0.0*L0, Rho, RelTol, MinDelta, 0);
-         GetOptimalGridSpacing1D(GBA, -0.5*L0, Rho, RelTol, Delta, MinDelta);
-         double DeltaRho = fmax(MinDeltaRho,MinDelta[1]);
-         if (Rho + DeltaRho >= RhoMax)
-          { DeltaRho = RhoMax - Rho;
-            Done=true;
-          };
-         RhoPoints[++nRho] = Rho + DeltaRho;
-       };
-      nRho++; 
-
-      Log("  Initializing %ix%i interpolation table with ",nx,nRho);
-      Log("  X points at [%g:%g:%g] ",0.0,DeltaX,L0);
-      Log("  Rho points at (");
-      for(int n=0; n<(nRho-1); n++)
-       LogC("%.2e, ",RhoPoints[n]);
-      LogC("%.2e)",RhoPoints[nRho-1]);
-
-      GBA->I3D=0;
-      GBA->I2D=new Interp2D(XPoints, nx, RhoPoints, nRho,
-                            2, GBarVDPhi2D, (void *)GBA, LMDILogLevel);
+  if (LDim==2 && (GBA->LBV[0][1]!=0.0 || GBA->LBV[1][0]!=0.0) )
+   ErrExit("%s:%i: non-square lattice not yet supported",__FILE__,__LINE__);
 
-      delete[] XPoints;
+  /***************************************************************/
+  /* table ranges: the unit cell (cut off at LMax if that is     */
+  /* smaller) times [RhoMin, RhoMax]                             */
+  /***************************************************************/
+  int NumDims = (LDim==1) ? 2 : 3;
+  double XMin[3], XMax[3];
+  for(int nd=0; nd<LDim; nd++)
+   { double L = GBA->LBV[nd][nd];
+     if ( L > LMax )
+      { L=LMax;
+        Log("  Cutting off interpolation table at L%c=LMax=%e.",'x'+nd,LMax);
+      };
+     XMin[nd] = -0.5*L;
+     XMax[nd] =  0.5*L;
+   };
+  XMin[NumDims-1] = RhoMin;
+  XMax[NumDims-1] = RhoMax;
 
-   }
-  else // LDim==2
-   {
-      double Lx = GBA->LBV[0][0], Ly=GBA->LBV[1][1];
-      if ( LMax<Lx ) 
-       { Lx=LMax;
-         Log("  Cutting off interpolation table at Lx=LMax=%e.",LMax);
-       };
-      if ( LMax<Ly ) 
-       { Ly=LMax;
-         Log("  Cutting off interpolation table at Ly=LMax=%e.",LMax);
-       };
+  /***************************************************************/
+  /* choose nonuniform grids in each dimension by hierarchical   */
+  /* refinement. if RhoMin==RhoMax the Rho dimension gets a      */
+  /* single interval whose width matches the finest x spacing.   */
+  /***************************************************************/
+  GBarVDGrid Grid;
+  for(int Mu=0; Mu<NumDims; Mu++)
+   { Grid.X[Mu] = new double[MAXGRIDPOINTS];
+     if (Mu==NumDims-1 && RhoMax<=RhoMin)
+      continue;
+     RefineGridDimension(GBA, NumDims, Mu, XMin, XMax, RelTol, Grid.X[Mu], Grid.N + Mu);
+   };
+  if (RhoMax<=RhoMin)
+   { double MinDX = XMax[0]-XMin[0];
+     for(int n=0; n<Grid.N[0]-1; n++)
+      MinDX = fmin(MinDX, Grid.X[0][n+1] - Grid.X[0][n]);
+     Grid.N[NumDims-1]    = 2;
+     Grid.X[NumDims-1][0] = RhoMin;
+     Grid.X[NumDims-1][1] = RhoMin + MinDX;
+   };
 
-      // estimate the optimal grid spacings at a few points
-      // in the domain of interest and take the smallest
-      double MinDelta[3], Delta[3];
-      GetOptimalGridSpacing2D(GBA,  0.0*Lx,  0.0*Ly, RhoMin, RelTol, MinDelta, 0);
-      GetOptimalGridSpacing2D(GBA,  0.0*Lx, -0.5*Ly, RhoMin, RelTol, Delta, MinDelta);
-      GetOptimalGridSpacing2D(GBA, -0.5*Lx,  0.0*Ly, RhoMin, RelTol, Delta, MinDelta);
-      GetOptimalGridSpacing2D(GBA, -0.5*Lx, -0.5*Ly, RhoMin, RelTol, Delta, MinDelta);
-      if (RhoMax!=RhoMin)
-       { GetOptimalGridSpacing2D(GBA,  0.0*Lx,  0.0*Ly, RhoMax, RelTol, Delta, MinDelta);
-         GetOptimalGridSpacing2D(GBA,  0.0*Lx, -0.5*Ly, RhoMax, RelTol, Delta, MinDelta);
-         GetOptimalGridSpacing2D(GBA, -0.5*Lx,  0.0*Ly, RhoMax, RelTol, Delta, MinDelta);
-         GetOptimalGridSpacing2D(GBA, -0.5*Lx, -0.5*Ly, RhoMax, RelTol, Delta, MinDelta);
-       };
+  if (LDim==1)
+   Log("  Initializing %ix%i interpolation table",Grid.N[0],Grid.N[1]);
+  else
+   Log("  Initializing %ix%ix%i interpolation table",Grid.N[0],Grid.N[1],Grid.N[2]);
+  Log("  Rho points at (");
+  for(int n=0; n<(Grid.N[NumDims-1]-1); n++)
+   LogC("%.2e, ",Grid.X[NumDims-1][n]);
+  LogC("%.2e)",Grid.X[NumDims-1][Grid.N[NumDims-1]-1]);
 
-      int nx   = ceil( Lx / MinDelta[0] );
-      if (nx<2) nx=2;
+  ComputeGBarVDGrid(GBA, &Grid);
 
-      int ny   = ceil( Ly / MinDelta[1] );
-      if (ny<2) ny=2;
+  if (LDim==1)
+   GBA->I2D=new Interp2D(Grid.X[0], Grid.N[0], Grid.X[1], Grid.N[1],
+                         2, GBarVDGridPhi2D, (void *)&Grid, LMDILogLevel);
+  else
+   GBA->I3D=new Interp3D(Grid.X[0], Grid.N[0], Grid.X[1], Grid.N[1],
+                         Grid.X[2], Grid.N[2],
+                         2, GBarVDGridPhi3D, (void *)&Grid, LMDILogLevel);
 
-      int nRho; 
-      if (RhoMax<=RhoMin)
-       { RhoMax = RhoMin + MinDelta[0];
-         nRho=2;
-       }
-      else
-       { nRho = ceil( (RhoMax-RhoMin) / MinDelta[1] );
-         if (nRho<2) nRho=2;
-       };
+  free(Grid.GBarVD);
+  for(int Mu=0; Mu<NumDims; Mu++)
+   delete[] Grid.X[Mu];
 
-      GBA->I2D=0;
-      GBA->I3D=new Interp3D(-0.5*Lx, 0.5*Lx, nx, -0.5*Ly, 0.5*Ly, ny,
-                            RhoMin, RhoMax, nRho,
-                            2, GBarVDPhi3D, (void *)GBA, LMDILogLevel);
-   };
+  if (CacheDir)
+   WriteCachedGBA(GBA, CacheDir, CacheFile);
 
   return GBA;
    
 }
 
 /***************************************************************/
+/* drop one reference to a GBarAccelerator, destroying it if   */
+/* that was the last one. callers that obtained the GBA from   */
+/* a pool (via RWGGeometry::CreateRegionGBA) destroy it in the */
+/* usual way; the table itself survives until it is evicted.   */
 /***************************************************************/
-/***************************************************************/
-void DestroyGBarAccelerator(GBarAccelerator *GBA)
+static pthread_mutex_t GBAPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ReleaseGBA(GBarAccelerator *GBA)
 { 
+  if ( --(GBA->RefCount) > 0 )
+   return;
+
   if (GBA->I2D) delete GBA->I2D;
   if (GBA->I3D) delete GBA->I3D;
+  DestroyEwaldTable(GBA->ET);
   free(GBA);
 }
 
+void DestroyGBarAccelerator(GBarAccelerator *GBA)
+{ 
+  pthread_mutex_lock(&GBAPoolMutex);
+  ReleaseGBA(GBA);
+  pthread_mutex_unlock(&GBAPoolMutex);
+}
+
+/***************************************************************/
+/* GBarAccelerator pool. entries are matched on lattice,       */
+/* wavenumber, Bloch vector, tolerance, and ExcludeInnerCells, */
+/* and a pooled table is reused if its Rho range contains the  */
+/* requested range. Bloch vectors that differ by a reciprocal- */
+/* lattice vector define the same GBar and are treated as      */
+/* equal. if the requested range overlaps the range of a       */
+/* matching entry without being contained in it, the new table */
+/* is built over the union of the two ranges and replaces the  */
+/* old entry. when the pool is full the least-recently-used    */
+/* entry is dropped.                                           */
+/*                                                             */
+/* tables are built without holding GBAPoolMutex: the builder  */
+/* first claims a pool slot with a placeholder entry that      */
+/* carries the matching parameters but no table, and threads   */
+/* that need a matching table wait on GBAPoolCond until the    */
+/* builder installs the finished table and broadcasts.         */
+/***************************************************************/
+static pthread_cond_t GBAPoolCond = PTHREAD_COND_INITIALIZER;
+
+typedef struct GBAPool
+ { int NumEntries, MaxEntries;
+   GBarAccelerator **Entries;
+   bool *Pending;
+   unsigned long *LastUsed;
+   unsigned long Clock;
+ } GBAPool;
+
+static bool SameBlochPhase(double *kBloch1, double *kBloch2, double (*LBV)[3], int LDim)
+{
+  if ( kBloch1==0 || kBloch2==0 )
+   return kBloch1==kBloch2;
+
+  for(int nd=0; nd<LDim; nd++)
+   { double Phase1 = kBloch1[0]*LBV[nd][0] + kBloch1[1]*LBV[nd][1];
+     double Phase2 = kBloch2[0]*LBV[nd][0] + kBloch2[1]*LBV[nd][1];
+     double Delta  = remainder(Phase1 - Phase2, 2.0*M_PI);
+     if ( fabs(Delta) > 1.0e-12*(1.0 + fabs(Phase1) + fabs(Phase2)) )
+      return false;
+   };
+  return true;
+}
+
+static bool GBAMatches(GBarAccelerator *GBA, HMatrix *LBasis, cdouble k,
+                       double *kBloch, double RelTol, bool ExcludeInnerCells)
+{
+  if (    GBA->LDim!=LBasis->NC || GBA->k!=k 
+       || GBA->RelTol!=RelTol || GBA->ExcludeInnerCells!=ExcludeInnerCells
+     ) return false;
+
+  for(int nd=0; nd<GBA->LDim; nd++)
+   for(int j=0; j<3; j++)
+    if ( GBA->LBV[nd][j] != LBasis->GetEntryD(j,nd) )
+     return false;
+
+  return SameBlochPhase(GBA->kBloch, kBloch, GBA->LBV, GBA->LDim);
+}
+
+/***************************************************************/
+/* placeholder pool entry: just the fields that GBAMatches()   */
+/* and the range tests look at, with no tables                 */
+/***************************************************************/
+static GBarAccelerator *CreatePlaceholderGBA(HMatrix *LBasis,
+                                             double RhoMin, double RhoMax,
+                                             cdouble k, double *kBloch,
+                                             double RelTol, bool ExcludeInnerCells)
+{
+  GBarAccelerator *GBA = (GBarAccelerator *)mallocEC( sizeof(GBarAccelerator) );
+  GBA->k                 = k;
+  GBA->kBloch            = 0;
+  GBA->ExcludeInnerCells = ExcludeInnerCells;
+  GBA->RelTol            = RelTol;
+  GBA->RhoMin            = RhoMin;
+  GBA->RhoMax            = RhoMax;
+  GBA->RefCount          = 1;
+  if (kBloch)
+   { GBA->kBlochBuffer[0] = kBloch[0];
+     GBA->kBlochBuffer[1] = kBloch[1];
+     GBA->kBloch = GBA->kBlochBuffer;
+   };
+  GBA->LDim = LBasis->NC;
+  for(int nd=0; nd<GBA->LDim; nd++)
+   for(int j=0; j<3; j++)
+    GBA->LBV[nd][j] = LBasis->GetEntryD(j,nd);
+  return GBA;
+}
+
+GBarAccelerator *GetPooledGBA(void **pPool, int MaxEntries,
+                              HMatrix *LBasis, double RhoMin, double RhoMax,
+                              cdouble k, double *kBloch,
+                              double RelTol, bool ExcludeInnerCells,
+                              int LMDILogLevel)
+{
+  if ( MaxEntries<=0 || RhoMin>RhoMax )
+   return CreateGBarAccelerator(LBasis, RhoMin, RhoMax, k, kBloch,
+                                RelTol, ExcludeInnerCells, LMDILogLevel);
+
+  pthread_mutex_lock(&GBAPoolMutex);
+
+  GBAPool *Pool = (GBAPool *)(*pPool);
+  if (Pool==0)
+   { Pool = (GBAPool *)mallocEC(sizeof(GBAPool));
+     Pool->Entries  = (GBarAccelerator **)mallocEC(MaxEntries*sizeof(GBarAccelerator *));
+     Pool->Pending  = (bool *)mallocEC(MaxEntries*sizeof(bool));
+     Pool->LastUsed = (unsigned long *)mallocEC(MaxEntries*sizeof(unsigned long));
+     Pool->NumEntries = 0;
+     Pool->MaxEntries = MaxEntries;
+     Pool->Clock = 0;
+     *pPool = (void *)Pool;
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- look for a pooled table that covers the requested range, or */
+  /*- one that we can subsume by building over a wider range. if  */
+  /*- a matching table is still being built by another thread,    */
+  /*- wait for it and start over.                                 */
+  /*--------------------------------------------------------------*/
+  int Replace;
+  bool Retry;
+  do
+   { Replace=-1;
+     Retry=false;
+     for(int ne=0; ne<Pool->NumEntries && !Retry; ne++)
+      { GBarAccelerator *GBA = Pool->Entries[ne];
+        if ( !GBAMatches(GBA, LBasis, k, kBloch, RelTol, ExcludeInnerCells) )
+         continue;
+
+        bool Overlaps = (RhoMin<=GBA->RhoMax && GBA->RhoMin<=RhoMax);
+        if ( Pool->Pending[ne] && Overlaps )
+         { pthread_cond_wait(&GBAPoolCond, &GBAPoolMutex);
+           Retry=true;
+         }
+        else if ( GBA->RhoMin<=RhoMin && RhoMax<=GBA->RhoMax )
+         { GBA->RefCount++;
+           Pool->LastUsed[ne] = ++Pool->Clock;
+           pthread_mutex_unlock(&GBAPoolMutex);
+           return GBA;
+         }
+        else if ( Overlaps )
+         { RhoMin = fmin(RhoMin, GBA->RhoMin);
+           RhoMax = fmax(RhoMax, GBA->RhoMax);
+           Replace=ne;
+         };
+      };
+   } while(Retry);
+
+  /*--------------------------------------------------------------*/
+  /*- claim a slot for the new table, evicting the least-recently-*/
+  /*- used finished entry if necessary; if every slot is waiting  */
+  /*- on a build, the new table is not pooled                     */
+  /*--------------------------------------------------------------*/
+  if (Replace==-1 && Pool->NumEntries<Pool->MaxEntries)
+   Pool->Entries[Replace = Pool->NumEntries++] = 0;
+  else if (Replace==-1)
+   { for(int ne=0; ne<Pool->NumEntries; ne++)
+      if ( !Pool->Pending[ne] && (Replace==-1 || Pool->LastUsed[ne] < Pool->LastUsed[Replace]) )
+       Replace=ne;
+   };
+
+  if (Replace==-1)
+   { pthread_mutex_unlock(&GBAPoolMutex);
+     return CreateGBarAccelerator(LBasis, RhoMin, RhoMax, k, kBloch,
+                                  RelTol, ExcludeInnerCells, LMDILogLevel);
+   };
+
+  if (Pool->Entries[Replace])
+   ReleaseGBA(Pool->Entries[Replace]); // drop the pool's reference
+  Pool->Entries[Replace] = CreatePlaceholderGBA(LBasis, RhoMin, RhoMax, k, kBloch,
+                                                RelTol, ExcludeInnerCells);
+  Pool->Pending[Replace] = true;
+  pthread_mutex_unlock(&GBAPoolMutex);
+
+  /*--------------------------------------------------------------*/
+  /*- build the table outside the lock, then install it in place  */
+  /*- of the placeholder and wake up any waiting threads          */
+  /*--------------------------------------------------------------*/
+  GBarAccelerator *GBA = CreateGBarAccelerator(LBasis, RhoMin, RhoMax, k, kBloch,
+                                               RelTol, ExcludeInnerCells, LMDILogLevel);
+
+  pthread_mutex_lock(&GBAPoolMutex);
+  ReleaseGBA(Pool->Entries[Replace]);
+  GBA->RefCount++;
+  Pool->Entries[Replace]  = GBA;
+  Pool->Pending[Replace]  = false;
+  Pool->LastUsed[Replace] = ++Pool->Clock;
+  pthread_cond_broadcast(&GBAPoolCond);
+  pthread_mutex_unlock(&GBAPoolMutex);
+
+  return GBA;
+}
+
+void DestroyGBAPool(void *p)
+{
+  GBAPool *Pool = (GBAPool *)p;
+  if (Pool==0)
+   return;
+
+  pthread_mutex_lock(&GBAPoolMutex);
+  for(int ne=0; ne<Pool->NumEntries; ne++)
+   ReleaseGBA(Pool->Entries[ne]);
+  free(Pool->Entries);
+  free(Pool->Pending);
+  free(Pool->LastUsed);
+  free(Pool);
+  pthread_mutex_unlock(&GBAPoolMutex);
+}
+
 /***************************************************************/
 /* Similar to AddGFull, but computes unmixed second partials.  */
 /* T[0] += GFull                                               */
@@ -507,48 +1024,43 @@ void AddGFullTerm(double R[3], cdouble k, double kBloch[2],
 cdouble GetGBarFullEwald(double R[3], GBarAccelerator *GBA,
                          cdouble *dGBar, cdouble *ddGBar)
 {
-  cdouble G[8];
-
-  cdouble k              = GBA->k;
-  double *kBloch         = GBA->kBloch;
-  int LDim               = GBA->LDim;
-  bool ExcludeInnerCells = GBA->ExcludeInnerCells;
+  /*--------------------------------------------------------------*/
+  /* the unmixed second partials are obtained by finite-          */
+  /* differencing, so we evaluate GBarVD at R and (if necessary)  */
+  /* at R +- Delta*\hat{x}_Mu in a single batch                   */
+  /*--------------------------------------------------------------*/
+  double RR[7][3], Delta[3];
+  int NumPoints = ddGBar ? 7 : 1;
+  for(int np=0; np<NumPoints; np++)
+   { RR[np][0]=R[0]; RR[np][1]=R[1]; RR[np][2]=R[2]; }
+  if (ddGBar)
+   for(int Mu=0; Mu<3; Mu++)
+    { Delta[Mu] = (R[Mu]==0.0) ? 1.0e-4 : 1.0e-4*fabs(R[Mu]);
+      RR[1+2*Mu][Mu] += Delta[Mu];
+      RR[2+2*Mu][Mu] -= Delta[Mu];
+    };
 
-  GBarVDEwald(R, k, kBloch, GBA->LBV, LDim, -1.0, ExcludeInnerCells, G);
+  cdouble G[7][8];
+  GBarVDEwald(GBA->ET, NumPoints, RR[0], G[0]);
 
   if (dGBar) 
-   { dGBar[0]=G[1];
-     dGBar[1]=G[2];
-     dGBar[2]=G[3];
+   { dGBar[0]=G[0][1];
+     dGBar[1]=G[0][2];
+     dGBar[2]=G[0][3];
    };
 
   if (ddGBar)
    { 
-     ddGBar[3*0 + 1] = ddGBar[3*1 + 0] = G[4];
-     ddGBar[3*0 + 2] = ddGBar[3*2 + 0] = G[5];
-     ddGBar[3*1 + 2] = ddGBar[3*2 + 1] = G[6];
+     ddGBar[3*0 + 1] = ddGBar[3*1 + 0] = G[0][4];
+     ddGBar[3*0 + 2] = ddGBar[3*2 + 0] = G[0][5];
+     ddGBar[3*1 + 2] = ddGBar[3*2 + 1] = G[0][6];
     
-     // finite-differencing to get unmixed second partials
      for(int Mu=0; Mu<3; Mu++)
-      { 
-         double Delta = (R[Mu]==0.0) ? 1.0e-4 : 1.0e-4*fabs(R[Mu]);
-         double RR[3];
-         RR[0]=R[0]; RR[1]=R[1]; RR[2]=R[2]; 
-
-         RR[Mu] += Delta;
-         cdouble Gp[8];
-         GBarVDEwald(RR, k, kBloch, GBA->LBV, LDim, -1.0, ExcludeInnerCells, Gp);
-
-         RR[Mu] -= 2.0*Delta;
-         cdouble Gm[8];
-         GBarVDEwald(RR, k, kBloch, GBA->LBV, LDim, -1.0, ExcludeInnerCells, Gm);
-
-         ddGBar[3*Mu + Mu] = (Gp[0] + Gm[0] - 2.0*G[0]) / (Delta*Delta);
-      };
-
+      ddGBar[3*Mu + Mu] = (G[1+2*Mu][0] + G[2+2*Mu][0] - 2.0*G[0][0]) 
+                           / (Delta[Mu]*Delta[Mu]);
    };
 
-  return G[0];
+  return G[0][0];
 }
 
 /***************************************************************/
@@ -866,6 +1378,13 @@ cdouble GetGBar(double R[3], GBarAccelerator *GBA,
 /* Create a GBar accelerator suitable for computing GBar at    */
 /* points R in the three-dimensional box with corners RMin and */
 /* RMax.                                                       */
+/*                                                             */
+/* Unless GBAPoolSize is 0, the accelerator is taken from (or  */
+/* added to) the geometry's GBA pool, so repeated requests for */
+/* the same region, frequency, and Bloch vector (e.g. from the */
+/* blocks of one BEM matrix, or from GetFields calls at the    */
+/* same kBloch) share one interpolation table. The caller      */
+/* releases it with DestroyGBarAccelerator() as usual.         */
 /***************************************************************/
 GBarAccelerator *RWGGeometry::CreateRegionGBA(int nr, cdouble Omega, double *kBloch,
                                               double RMin[3], double RMax[3],
@@ -975,9 +1494,8 @@ GBarAccelerator *RWGGeometry::CreateRegionGBA(int nr, cdouble Omega, double *kBl
   int LMDILogLevel = LMDI_LOGLEVEL_TERSE;
   if (LogLevel>=SCUFF_VERBOSE2)
    LMDILogLevel = LMDI_LOGLEVEL_VERBOSE;
-  return CreateGBarAccelerator(GBA_LBasis, RhoMin, RhoMax,
-                               k, kBloch, RelTol, ExcludeInnerCells,
-                               LMDILogLevel);
+  return GetPooledGBA(&GBAPool, GBAPoolSize, GBA_LBasis, RhoMin, RhoMax,
+                      k, kBloch, RelTol, ExcludeInnerCells, LMDILogLevel);
 }
 
 /***************************************************************/
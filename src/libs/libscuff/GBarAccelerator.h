@@ -39,6 +39,25 @@ void GBarVDEwald(double *R, cdouble k, double *kBloch,
                  double (*LBV)[3], int LDim,
                  double E, bool ExcludeInnerCells, cdouble *GBarVD);
 
+/***************************************************************/
+/* precomputed lattice-sum data for repeated ewald evaluations */
+/* at fixed lattice, wavenumber, and Bloch vector. the tables  */
+/* cover evaluation points with |R| <= RMax; points outside    */
+/* that range are passed to the routine above.                 */
+/***************************************************************/
+struct EwaldTable;
+EwaldTable *CreateEwaldTable(double (*LBV)[3], int LDim,
+                             cdouble k, double *kBloch,
+                             bool ExcludeInnerCells,
+                             double RMax, double RelTol=1.0e-10);
+void DestroyEwaldTable(EwaldTable *ET);
+
+// single point; output as for the routine above
+void GBarVDEwald(EwaldTable *ET, double *R, cdouble *GBarVD);
+
+// many points: R[3*np + 0..2] --> GBarVD[8*np + 0..7]
+void GBarVDEwald(EwaldTable *ET, int NumPoints, double *R, cdouble *GBarVD);
+
 /***************************************************************/
 /* interpolation-based acceleration of periodic GF evaluation  */
 /***************************************************************/
@@ -46,7 +65,9 @@ typedef struct GBarAccelerator
  {
    cdouble k;
    double *kBloch;
+   double kBlochBuffer[2];
    bool ExcludeInnerCells;
+   double RelTol;
 
    int LDim;
    double LBV[3][3];
@@ -56,6 +77,11 @@ typedef struct GBarAccelerator
 
    Interp2D *I2D;
    Interp3D *I3D;
+   EwaldTable *ET;
+
+   // number of owners (callers plus the RWGGeometry's GBA pool,
+   // see below); DestroyGBarAccelerator() drops one reference
+   int RefCount;
 
  } GBarAccelerator;
 
@@ -70,6 +96,20 @@ GBarAccelerator *CreateGBarAccelerator(HMatrix *LBasis,
 
 void DestroyGBarAccelerator(GBarAccelerator *GBA);
 
+/***************************************************************/
+/* pool of GBarAccelerators owned by an RWGGeometry, which     */
+/* allows the interpolation table for a given region, lattice, */
+/* wavenumber, and Bloch vector to be shared by all BEM-matrix */
+/* blocks and all GetFields() calls that need it (see          */
+/* RWGGeometry::CreateRegionGBA).                              */
+/***************************************************************/
+GBarAccelerator *GetPooledGBA(void **Pool, int MaxEntries,
+                              HMatrix *LBasis, double RhoMin, double RhoMax,
+                              cdouble k, double *kBloch,
+                              double RelTol, bool ExcludeInnerCells,
+                              int LMDILogLevel=LMDI_LOGLEVEL_TERSE);
+void DestroyGBAPool(void *Pool);
+
 cdouble GetGBar(double R[3], GBarAccelerator *GBA,
                 cdouble *dGBar=0, cdouble *ddGBar=0,
                 bool ForceFullEwald=false);
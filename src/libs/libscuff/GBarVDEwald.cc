@@ -607,73 +607,61 @@ void AddGFull(double R[3], cdouble k, double kBloch[2],
 /* where g4 = (-4E/sqrt(pi)) * exp( -(E)^2R^2 + k^2/(4(E)^2).  */
 /*                                                             */
 /***************************************************************/
-void AddGShort(double *R, cdouble k, double *kBloch,
-               int n1, int n2, double (*LBV)[3], int LDim,
-               double E, cdouble *Sum)
-{ 
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  double L[2];
-  if (LDim==1)
-   { L[0] = n1*LBV[0][0];
-     L[1] = n1*LBV[0][1];
-   }
-  else // (LDim==2)
-   { L[0] = n1*LBV[0][0] + n2*LBV[1][0];
-     L[1] = n1*LBV[0][1] + n2*LBV[1][1];
-   };
-
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  if (E==0.0)
-   { AddGFull(R, k, kBloch, L[0], L[1], Sum);
-     return;
-   };
-
-  cdouble PhaseFactor=exp( II * (kBloch[0]*L[0] + kBloch[1]*L[1]) ) / (8.0*M_PI);
+typedef struct GShortData
+ { cdouble k, IkOver2E, ExpK2Over4E2;
+   double E, E2, E4;
+ } GShortData;
 
-  double RmL[3], rml2, rml, rml3, rml4, rml5, rml6, rml7;
-  cdouble g2p, g3p, g2m, g3m, g4, ggPgg, ggMgg, Term;
-
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  /*--------------------------------------------------------------*/
-  RmL[0] = (R[0]-L[0]);
-  RmL[1] = (R[1]-L[1]);
-  RmL[2] =  R[2];
+static void InitGShortData(cdouble k, double E, GShortData *GSD)
+{
+  GSD->k            = k;
+  GSD->E            = E;
+  GSD->E2           = E*E;
+  GSD->E4           = E*E*E*E;
+  GSD->IkOver2E     = II*k/(2.0*E);
+  GSD->ExpK2Over4E2 = exp(k*k/(4.0*E*E));
+}
 
-  rml2=RmL[0]*RmL[0] + RmL[1]*RmL[1] + RmL[2]*RmL[2];
-  rml=sqrt(rml2);
+/***************************************************************/
+/* contribution of a single direct-lattice vector L to the     */
+/* short-range sum, given RmL = R-L and the phase factor       */
+/* exp(i kBloch\dot L)/(8 pi)                                  */
+/***************************************************************/
+static void AddGShortTerm(double RmL[3], GShortData *GSD,
+                          cdouble PhaseFactor, cdouble *Sum)
+{
+  double rml2=RmL[0]*RmL[0] + RmL[1]*RmL[1] + RmL[2]*RmL[2];
+  double rml=sqrt(rml2);
   if ( rml < 1.0e-6 ) 
    return;
-  rml3=rml2*rml;
-  rml4=rml3*rml;
-  rml5=rml4*rml;
-  rml6=rml5*rml;
-  rml7=rml6*rml;
+  double rml3=rml2*rml;
+  double rml4=rml3*rml;
+  double rml5=rml4*rml;
+  double rml6=rml5*rml;
+  double rml7=rml6*rml;
 
-  double E2 = E*E;
-  double E4 = E2*E2;
+  cdouble k  = GSD->k;
+  double E   = GSD->E;
+  double E2  = GSD->E2;
+  double E4  = GSD->E4;
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   //g2p = exp( II*k*rml );
   //g3p = Faddeeva::erfc( E*rml + II*k/(2.0*E) );
-  cdouble g2pTg3p = erfc_s( II*k*rml, E*rml + II*k/(2.0*E) );
+  cdouble g2pTg3p = erfc_s( II*k*rml, E*rml + GSD->IkOver2E );
 
   //g2m = exp( -II*k*rml );
   //g3m = Faddeeva::erfc( E*rml - II*k/(2.0*E) );
-  cdouble g2mTg3m = erfc_s( -II*k*rml, E*rml - II*k/(2.0*E) );
+  cdouble g2mTg3m = erfc_s( -II*k*rml, E*rml - GSD->IkOver2E );
 
   //ggPgg = g2p*g3p + g2m*g3m;
   //ggMgg = g2p*g3p - g2m*g3m;
-  ggPgg = g2pTg3p + g2mTg3m;
-  ggMgg = g2pTg3p - g2mTg3m;
+  cdouble ggPgg = g2pTg3p + g2mTg3m;
+  cdouble ggMgg = g2pTg3p - g2mTg3m;
 
-  g4 = -2.0*M_2_SQRTPI*E*exp(-E2*rml2 + k*k/(4.0*E2));
+  cdouble g4 = -2.0*M_2_SQRTPI*E*exp(-E2*rml2)*GSD->ExpK2Over4E2;
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
@@ -683,7 +671,7 @@ void AddGShort(double *R, cdouble k, double *kBloch,
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
-  Term = -ggPgg/rml3 + (g4 + II*k*ggMgg)/rml2;
+  cdouble Term = -ggPgg/rml3 + (g4 + II*k*ggMgg)/rml2;
 
   Sum[1] += PhaseFactor * RmL[0] * Term;
   Sum[2] += PhaseFactor * RmL[1] * Term;
@@ -710,6 +698,44 @@ void AddGShort(double *R, cdouble k, double *kBloch,
 
 }
 
+void AddGShort(double *R, cdouble k, double *kBloch,
+               int n1, int n2, double (*LBV)[3], int LDim,
+               double E, cdouble *Sum)
+{ 
+  /*--------------------------------------------------------------*/
+  /*--------------------------------------------------------------*/
+  /*--------------------------------------------------------------*/
+  double L[2];
+  if (LDim==1)
+   { L[0] = n1*LBV[0][0];
+     L[1] = n1*LBV[0][1];
+   }
+  else // (LDim==2)
+   { L[0] = n1*LBV[0][0] + n2*LBV[1][0];
+     L[1] = n1*LBV[0][1] + n2*LBV[1][1];
+   };
+
+  /*--------------------------------------------------------------*/
+  /*--------------------------------------------------------------*/
+  /*--------------------------------------------------------------*/
+  if (E==0.0)
+   { AddGFull(R, k, kBloch, L[0], L[1], Sum);
+     return;
+   };
+
+  cdouble PhaseFactor=exp( II * (kBloch[0]*L[0] + kBloch[1]*L[1]) ) / (8.0*M_PI);
+
+  double RmL[3];
+  RmL[0] = (R[0]-L[0]);
+  RmL[1] = (R[1]-L[1]);
+  RmL[2] =  R[2];
+
+  GShortData GSD;
+  InitGShortData(k, E, &GSD);
+  AddGShortTerm(RmL, &GSD, PhaseFactor, Sum);
+
+}
+
 /***************************************************************/
 /***************************************************************/
 /***************************************************************/
@@ -958,4 +984,451 @@ void GBarVDEwald(double *R, cdouble k, double *kBloch,
 
 } 
 
+/***************************************************************/
+/* EwaldTable: precomputed data for repeated evaluations of    */
+/* GBar at a fixed lattice, wavenumber, and Bloch vector.      */
+/*                                                             */
+/* the direct- and reciprocal-lattice vectors needed for all   */
+/* points with |R| <= RMax are tabulated once, sorted by       */
+/* length, together with everything that does not depend on R */
+/* (Bloch phase factors, Q=sqrt(|P-G|^2-k^2), and, for 2D      */
+/* lattices, the exp*erfc factors at z=0). the ewald parameter */
+/* E is chosen at each point as in GBarVDEwald() above, and    */
+/* each sum is then truncated at the first lattice vector      */
+/* beyond which the gaussian bound on the summand (or, for the */
+/* reciprocal sum at points far from the lattice, the          */
+/* exponential bound) falls below the requested tolerance.     */
+/* points for which the tabulated vectors do not suffice are   */
+/* handed off to GBarVDEwald().                                */
+/***************************************************************/
+#define EWALD_MARGIN 4.0           // added to -log(RelTol) in truncation tests
+#define MAXEWALDVECTORS 100000
+
+typedef struct EwaldLVector
+ { double L[2], Mag;
+   bool Inner;       // true for the 9 (2D) or 3 (1D) innermost cells
+   cdouble Phase;    // exp(i*kBloch \dot L) / (8*pi)
+ } EwaldLVector;
+
+typedef struct EwaldGVector
+ { double PmG[2], Mag;
+   int n1, n2;
+   cdouble OneOverQ;
+   cdouble EEF0OverQ; // 2D lattices: EEF(z=0)/Q
+ } EwaldGVector;
+
+struct EwaldTable
+ { 
+   int LDim;
+   double LBV[3][3], Gamma[3][3];
+   cdouble k;
+   double kBloch[2];
+   bool ExcludeInnerCells;
+
+   double XCut2;      // -log(RelTol) + margin
+   double ReK2;       // max(0, Re k^2)
+   double E;          // ewald parameter (2D lattices only)
+   double GPreFactor;
+
+   int NumL, NumG, NMax;
+   double LCovered, GCovered;
+   EwaldLVector *LVectors;
+   EwaldGVector *GVectors;
+ };
+
+static int CompareLVectors(const void *a, const void *b)
+{ double Ma=((EwaldLVector *)a)->Mag, Mb=((EwaldLVector *)b)->Mag;
+  return (Ma<Mb) ? -1 : (Ma>Mb) ? 1 : 0;
+}
+
+static int CompareGVectors(const void *a, const void *b)
+{ double Ma=((EwaldGVector *)a)->Mag, Mb=((EwaldGVector *)b)->Mag;
+  return (Ma<Mb) ? -1 : (Ma>Mb) ? 1 : 0;
+}
+
+/***************************************************************/
+/* range of the integer coefficient n_i needed to reach all    */
+/* lattice vectors with |n1*B1 + n2*B2| <= Radius              */
+/***************************************************************/
+static int GetNRange(double B[3][3], int LDim, int i, double Radius)
+{ 
+  if (LDim==1)
+   return (int)ceil( Radius / sqrt(B[0][0]*B[0][0] + B[0][1]*B[0][1]) );
+  double Area = fabs(B[0][0]*B[1][1] - B[0][1]*B[1][0]);
+  int j = 1-i;
+  double BjMag = sqrt(B[j][0]*B[j][0] + B[j][1]*B[j][1]);
+  return (int)ceil( Radius*BjMag/Area );
+}
+
+// inverse of the above: radius out to which all lattice vectors
+// are reached with |n1|<=N1, |n2|<=N2
+static double GetNRadius(double B[3][3], int LDim, int N1, int N2)
+{ 
+  if (LDim==1)
+   return N1*sqrt(B[0][0]*B[0][0] + B[0][1]*B[0][1]);
+  double Area = fabs(B[0][0]*B[1][1] - B[0][1]*B[1][0]);
+  double B0Mag = sqrt(B[0][0]*B[0][0] + B[0][1]*B[0][1]);
+  double B1Mag = sqrt(B[1][0]*B[1][0] + B[1][1]*B[1][1]);
+  return fmin( N1*Area/B1Mag, N2*Area/B0Mag );
+}
+
+/***************************************************************/
+/* radius beyond which reciprocal-lattice vectors may be       */
+/* dropped at a point with out-of-lattice distance ZRho.       */
+/* the summand is bounded by exp(-f(Q)) with                   */
+/*  f(Q) = Q*ZRho                     for Q <= 2E^2*ZRho       */
+/*       = Q^2/(4E^2) + E^2*ZRho^2    otherwise,               */
+/* and |P-G|^2 = |Q|^2 + Re k^2.                               */
+/***************************************************************/
+static double GetGCutoff(EwaldTable *ET, double E, double ZRho)
+{ 
+  double X2=ET->XCut2, Q;
+  if ( X2 <= 2.0*E*E*ZRho*ZRho )
+   Q = X2 / ZRho;
+  else
+   Q = 2.0*E*sqrt(X2 - E*E*ZRho*ZRho);
+  return sqrt(Q*Q + ET->ReK2);
+}
+
+/***************************************************************/
+/* radius beyond which direct-lattice vectors may be dropped   */
+/* at a point with in-lattice distance RPar and out-of-lattice */
+/* distance ZRho; the summand is bounded by                    */
+/* exp(-E^2|R-L|^2 + Re k^2/(4E^2)).                           */
+/***************************************************************/
+static double GetLCutoff(EwaldTable *ET, double E, double RPar, double ZRho)
+{ 
+  double X2 = ( ET->XCut2 + ET->ReK2/(4.0*E*E) ) / (E*E) - ZRho*ZRho;
+  return RPar + ( X2>0.0 ? sqrt(X2) : 0.0 );
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+EwaldTable *CreateEwaldTable(double (*LBV)[3], int LDim,
+                             cdouble k, double *kBloch,
+                             bool ExcludeInnerCells,
+                             double RMax, double RelTol)
+{ 
+  EwaldTable *ET = (EwaldTable *)mallocEC(sizeof(EwaldTable));
+  memset(ET, 0, sizeof(EwaldTable));
+
+  ET->LDim = LDim;
+  for(int nd=0; nd<LDim; nd++)
+   for(int j=0; j<3; j++)
+    ET->LBV[nd][j] = LBV[nd][j];
+  ET->k = k;
+  ET->kBloch[0] = kBloch ? kBloch[0] : 0.0;
+  ET->kBloch[1] = (kBloch && LDim==2) ? kBloch[1] : 0.0;
+  ET->ExcludeInnerCells = ExcludeInnerCells;
+  ET->XCut2 = -log(RelTol) + EWALD_MARGIN;
+  ET->ReK2  = fmax(0.0, real(k*k));
+
+  if (k==0.0) 
+   return ET;
+
+  /*--------------------------------------------------------------*/
+  /*- range of ewald parameters over the region |R| <= RMax       */
+  /*--------------------------------------------------------------*/
+  double R0[3]={0.0, 0.0, 0.0}, R1[3]={0.0, RMax, 0.0}, EMax, EMin;
+  GetRLBasis(LDim, ET->LBV, ET->Gamma, k, &EMax, R0, 0);
+  GetRLBasis(LDim, ET->LBV, ET->Gamma, k, &EMin, R1, 0);
+  if (EMin>EMax) 
+   { double Temp=EMin; EMin=EMax; EMax=Temp; }
+  ET->E = EMax;
+
+  if (LDim==1)
+   { if (ET->LBV[0][1]!=0.0)
+      ErrExit("1D lattice vectors must point in the x direction");
+     ET->GPreFactor = fabs(ET->Gamma[0][0]);
+   }
+  else
+   ET->GPreFactor = fabs(ET->Gamma[0][0]*ET->Gamma[1][1] - ET->Gamma[0][1]*ET->Gamma[1][0])
+                     / (16.0*M_PI*M_PI);
+
+  /*--------------------------------------------------------------*/
+  /*- tabulate direct-lattice vectors ----------------------------*/
+  /*--------------------------------------------------------------*/
+  double LRadius = GetLCutoff(ET, EMin, RMax, 0.0);
+  int N1 = GetNRange(ET->LBV, LDim, 0, LRadius);
+  int N2 = (LDim==2) ? GetNRange(ET->LBV, LDim, 1, LRadius) : 0;
+  while ( (2*N1+1)*(2*N2+1) > MAXEWALDVECTORS )
+   { N1=(N1+1)/2; N2=(N2+1)/2; };
+  ET->LVectors = (EwaldLVector *)mallocEC( (2*N1+1)*(2*N2+1)*sizeof(EwaldLVector) );
+  int NumL=0;
+  for(int n1=-N1; n1<=N1; n1++)
+   for(int n2=-N2; n2<=N2; n2++)
+    { EwaldLVector *LV = ET->LVectors + NumL;
+      LV->L[0] = n1*ET->LBV[0][0] + (LDim==2 ? n2*ET->LBV[1][0] : 0.0);
+      LV->L[1] = n1*ET->LBV[0][1] + (LDim==2 ? n2*ET->LBV[1][1] : 0.0);
+      LV->Mag  = sqrt(LV->L[0]*LV->L[0] + LV->L[1]*LV->L[1]);
+      if (LV->Mag > LRadius) continue;
+      LV->Inner = ( abs(n1)<=1 && abs(n2)<=1 );
+      LV->Phase = exp( II*(ET->kBloch[0]*LV->L[0] + ET->kBloch[1]*LV->L[1]) ) / (8.0*M_PI);
+      NumL++;
+    };
+  qsort(ET->LVectors, NumL, sizeof(EwaldLVector), CompareLVectors);
+  ET->NumL = NumL;
+  ET->LCovered = fmin(LRadius, GetNRadius(ET->LBV, LDim, N1, N2));
+
+  /*--------------------------------------------------------------*/
+  /*- tabulate reciprocal-lattice vectors ------------------------*/
+  /*--------------------------------------------------------------*/
+  double GRadius = GetGCutoff(ET, EMax, 0.0);
+  double PMag    = sqrt(ET->kBloch[0]*ET->kBloch[0] + ET->kBloch[1]*ET->kBloch[1]);
+  N1 = GetNRange(ET->Gamma, LDim, 0, GRadius + PMag);
+  N2 = (LDim==2) ? GetNRange(ET->Gamma, LDim, 1, GRadius + PMag) : 0;
+  while ( (2*N1+1)*(2*N2+1) > MAXEWALDVECTORS )
+   { N1=(N1+1)/2; N2=(N2+1)/2; };
+  ET->GVectors = (EwaldGVector *)mallocEC( (2*N1+1)*(2*N2+1)*sizeof(EwaldGVector) );
+  int NumG=0;
+  for(int n1=-N1; n1<=N1; n1++)
+   for(int n2=-N2; n2<=N2; n2++)
+    { EwaldGVector *GV = ET->GVectors + NumG;
+      GV->PmG[0] = ET->kBloch[0] - n1*ET->Gamma[0][0] - (LDim==2 ? n2*ET->Gamma[1][0] : 0.0);
+      GV->PmG[1] = ET->kBloch[1] - n1*ET->Gamma[0][1] - (LDim==2 ? n2*ET->Gamma[1][1] : 0.0);
+      GV->Mag    = sqrt(GV->PmG[0]*GV->PmG[0] + GV->PmG[1]*GV->PmG[1]);
+      if (GV->Mag > GRadius) continue;
+      GV->n1 = n1;
+      GV->n2 = n2;
+      cdouble Q = sqrt( GV->Mag*GV->Mag - k*k );
+      GV->OneOverQ = 1.0/Q;
+      if (LDim==2)
+       { cdouble EEF, EEFPrime;
+         GetEEF(0.0, ET->E, Q, &EEF, &EEFPrime);
+         GV->EEF0OverQ = EEF/Q;
+       };
+      NumG++;
+    };
+  qsort(ET->GVectors, NumG, sizeof(EwaldGVector), CompareGVectors);
+  ET->NumG = NumG;
+  ET->NMax = N1>N2 ? N1 : N2;
+  ET->GCovered = fmin(GRadius, GetNRadius(ET->Gamma, LDim, N1, N2) - PMag);
+
+  return ET;
+}
+
+void DestroyEwaldTable(EwaldTable *ET)
+{ 
+  if (!ET) return;
+  if (ET->LVectors) free(ET->LVectors);
+  if (ET->GVectors) free(ET->GVectors);
+  free(ET);
+}
+
+/***************************************************************/
+/* R-independent factors in the reciprocal-lattice sum for all */
+/* reciprocal-lattice vectors out to radius GCutoff at a given */
+/* out-of-lattice distance (z for 2D lattices, Rho for 1D) and */
+/* ewald parameter. returns the number of vectors retained.    */
+/***************************************************************/
+static int GetGFactors(EwaldTable *ET, double ZRho, double E,
+                       double GCutoff, cdouble *F)
+{
+  int ng;
+  for(ng=0; ng<ET->NumG && ET->GVectors[ng].Mag<=GCutoff; ng++)
+   { 
+     EwaldGVector *GV = ET->GVectors + ng;
+     if (ET->LDim==2)
+      { if (ZRho==0.0 && E==ET->E)
+         { F[2*ng+0] = GV->EEF0OverQ;
+           F[2*ng+1] = 0.0;
+         }
+        else
+         { cdouble EEF, EEFPrime;
+           GetEEF(ZRho, E, 1.0/GV->OneOverQ, &EEF, &EEFPrime);
+           F[2*ng+0] = EEF*GV->OneOverQ;
+           F[2*ng+1] = EEFPrime*GV->OneOverQ;
+         };
+      }
+     else
+      { cdouble dGdRho[2];
+        double Rho=ZRho;
+        F[3*ng+0] = GetGLongTwiddle1D(GV->PmG[0], Rho, ET->k, E, dGdRho);
+        F[3*ng+1] = dGdRho[0];
+        F[3*ng+2] = Rho==0.0 ? 0.0 : (dGdRho[1] - dGdRho[0]/Rho);
+      };
+   };
+  return ng;
+}
+
+/***************************************************************/
+/* reciprocal-lattice sum at a single point, given the factors */
+/* computed by GetGFactors. W is workspace of length           */
+/* 2*(2*NMax+1).                                               */
+/***************************************************************/
+static void AddGLongSum(EwaldTable *ET, double *R, int NG, cdouble *F,
+                        cdouble *W, cdouble *Sum)
+{
+  int NMax=ET->NMax;
+  cdouble *W1 = W + NMax, *W2 = W + 3*NMax + 1;
+  for(int nd=0; nd<ET->LDim; nd++)
+   { cdouble *Wd = (nd==0) ? W1 : W2;
+     cdouble w = exp( -II*(ET->Gamma[nd][0]*R[0] + ET->Gamma[nd][1]*R[1]) );
+     Wd[0]=1.0;
+     for(int n=1; n<=NMax; n++)
+      { Wd[n]  = Wd[n-1]*w;
+        Wd[-n] = conj(Wd[n]);
+      };
+   };
+  cdouble PR = exp( II*(ET->kBloch[0]*R[0] + ET->kBloch[1]*R[1]) );
+
+  cdouble S[NSUM];
+  memset(S, 0, NSUM*sizeof(cdouble));
+  if (ET->LDim==2)
+   { 
+     for(int ng=0; ng<NG; ng++)
+      { EwaldGVector *GV = ET->GVectors + ng;
+        double px=GV->PmG[0], py=GV->PmG[1];
+        cdouble Phase = PR*W1[GV->n1]*W2[GV->n2];
+        cdouble A = Phase*F[2*ng+0], B = Phase*F[2*ng+1];
+        S[0] += A;
+        S[1] += II*px*A;
+        S[2] += II*py*A;
+        S[3] += B;
+        S[4] += -px*py*A;
+        S[5] += II*px*B;
+        S[6] += II*py*B;
+        S[7] += -px*py*B;
+      };
+   }
+  else
+   { double Rho = sqrt(R[1]*R[1] + R[2]*R[2]);
+     double YOverRho = (Rho==0.0) ? 0.0 : R[1]/Rho;
+     double ZOverRho = (Rho==0.0) ? 0.0 : R[2]/Rho;
+     for(int ng=0; ng<NG; ng++)
+      { EwaldGVector *GV = ET->GVectors + ng;
+        double px=GV->PmG[0];
+        cdouble Phase = PR*W1[GV->n1];
+        cdouble A = Phase*F[3*ng+0], B = Phase*F[3*ng+1], C = Phase*F[3*ng+2];
+        S[0] += A;
+        S[1] += II*px*A;
+        S[2] += YOverRho*B;
+        S[3] += ZOverRho*B;
+        S[4] += II*px*YOverRho*B;
+        S[5] += II*px*ZOverRho*B;
+        S[6] += YOverRho*ZOverRho*C;
+        S[7] += II*px*YOverRho*ZOverRho*C;
+      };
+   };
+
+  for(int ns=0; ns<NSUM; ns++)
+   Sum[ns] += ET->GPreFactor * S[ns];
+}
+
+/***************************************************************/
+/* direct-lattice sum at a single point out to radius LCutoff  */
+/***************************************************************/
+static void AddGShortSum(EwaldTable *ET, double *R, double E,
+                         double LCutoff, cdouble *Sum)
+{
+  GShortData GSD;
+  InitGShortData(ET->k, E, &GSD);
+  for(int nl=0; nl<ET->NumL && ET->LVectors[nl].Mag<=LCutoff; nl++)
+   { EwaldLVector *LV = ET->LVectors + nl;
+     if (ET->ExcludeInnerCells && LV->Inner) 
+      continue;
+     double RmL[3];
+     RmL[0] = R[0] - LV->L[0];
+     RmL[1] = R[1] - LV->L[1];
+     RmL[2] = R[2];
+     AddGShortTerm(RmL, &GSD, LV->Phase, Sum);
+   };
+}
+
+/***************************************************************/
+/* batch entry point: GBarVD[8*np + ns] is the ns-th component */
+/* of GBarVD (as in GBarVDEwald) at R[3*np+0..2].              */
+/* points are processed in order of their out-of-lattice       */
+/* distance so that the z- or Rho-dependent factors in the     */
+/* reciprocal-lattice sum are computed once for all points     */
+/* that share them.                                            */
+/***************************************************************/
+typedef struct EwaldPoint 
+ { double ZRho;
+   int np;
+ } EwaldPoint;
+
+static int CompareEwaldPoints(const void *a, const void *b)
+{ double Za=((EwaldPoint *)a)->ZRho, Zb=((EwaldPoint *)b)->ZRho;
+  return (Za<Zb) ? -1 : (Za>Zb) ? 1 : 0;
+}
+
+void GBarVDEwald(EwaldTable *ET, int NumPoints, double *R, cdouble *GBarVD)
+{
+  if (ET->k==0.0)
+   { memset(GBarVD, 0, NumPoints*NSUM*sizeof(cdouble));
+     return;
+   };
+
+  int LDim=ET->LDim;
+  EwaldPoint *Points = (EwaldPoint *)mallocEC(NumPoints*sizeof(EwaldPoint));
+  for(int np=0; np<NumPoints; np++)
+   { double *RR = R + 3*np;
+     Points[np].np   = np;
+     Points[np].ZRho = (LDim==2) ? RR[2] : sqrt(RR[1]*RR[1] + RR[2]*RR[2]);
+   };
+  if (NumPoints>1)
+   qsort(Points, NumPoints, sizeof(EwaldPoint), CompareEwaldPoints);
+
+  int FStride = (LDim==2) ? 2 : 3;
+  cdouble *F = (cdouble *)mallocEC( (FStride*ET->NumG + 2*(2*ET->NMax+1))*sizeof(cdouble) );
+  cdouble *W = F + FStride*ET->NumG;
+
+  double Gamma[3][3];
+  int NG=0;
+  bool HaveFactors=false;
+  double LastZRho=0.0, LastE=0.0;
+  for(int nnp=0; nnp<NumPoints; nnp++)
+   { 
+     int np        = Points[nnp].np;
+     double ZRho   = Points[nnp].ZRho;
+     double *RR    = R + 3*np;
+     cdouble *Sum  = GBarVD + NSUM*np;
+
+     double E;
+     if (LDim==2)
+      E = ET->E;
+     else
+      GetRLBasis(LDim, ET->LBV, Gamma, ET->k, &E, RR, 0);
+
+     double GCutoff = GetGCutoff(ET, E, fabs(ZRho));
+     double RPar    = (LDim==2) ? sqrt(RR[0]*RR[0] + RR[1]*RR[1]) : fabs(RR[0]);
+     double LCutoff = GetLCutoff(ET, E, RPar, fabs(ZRho));
+     if ( GCutoff>ET->GCovered || LCutoff>ET->LCovered )
+      { GBarVDEwald(RR, ET->k, ET->kBloch, ET->LBV, LDim, -1.0,
+                    ET->ExcludeInnerCells, Sum);
+        continue;
+      };
+
+     if ( !HaveFactors || ZRho!=LastZRho || E!=LastE )
+      { NG = GetGFactors(ET, ZRho, E, GCutoff, F);
+        HaveFactors=true;
+        LastZRho=ZRho;
+        LastE=E;
+      };
+
+     memset(Sum, 0, NSUM*sizeof(cdouble));
+     AddGLongSum(ET, RR, NG, F, W, Sum);
+     AddGShortSum(ET, RR, E, LCutoff, Sum);
+
+     if (ET->ExcludeInnerCells)
+      { cdouble GLongInner[NSUM];
+        memset(GLongInner,0,NSUM*sizeof(cdouble));
+        int n2Mult = (LDim==2) ? 1 : 0;
+        for(int n1=-1; n1<=1; n1++)
+         for(int n2=-1*n2Mult; n2<=1*n2Mult; n2++)
+          AddGLongRealSpace(RR, ET->k, ET->kBloch, n1, n2, ET->LBV, LDim, E, GLongInner);
+        for(int ns=0; ns<NSUM; ns++)
+         Sum[ns] -= GLongInner[ns];
+      };
+   };
+
+  free(F);
+  free(Points);
+}
+
+void GBarVDEwald(EwaldTable *ET, double *R, cdouble *GBarVD)
+{ GBarVDEwald(ET, 1, R, GBarVD); }
+
 } // namespace scuff
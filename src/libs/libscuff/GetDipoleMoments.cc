@@ -181,7 +181,6 @@ HMatrix *RWGGeometry::GetDipoleMoments(cdouble Omega, HVector *KN, HMatrix *PM,
 /*       reason, all rows of the PSD matrix corresponding to   */
 /*       straddler panels are returned as zeros.               */
 /***************************************************************/
-#define PSD_MATRIX_COLUMNS 13
 HMatrix *RWGGeometry::GetPanelSourceDensities(cdouble Omega,
                                               double *kBloch,
                                               HVector *KN,
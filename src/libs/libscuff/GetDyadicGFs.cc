@@ -58,27 +58,23 @@ namespace scuff {
 HMatrix *RWGGeometry::GetDyadicGFs(cdouble Omega, double *kBloch,
                                    HMatrix *XMatrix, HMatrix *M,
                                    HMatrix *GMatrix,
-                                   bool ScatteringOnly)
+                                   bool ScatteringOnly,
+                                   Workspace *WS)
 { 
   int NBF = TotalBFs;
   int NX  = XMatrix->NR;
   Log("Getting DGFs at %i eval points...",NX);
 
   /*--------------------------------------------------------------*/
-  /* allocate storage for RFSource, RFDest matrices. I keep these */
-  /* on hand as statically-allocated buffers on the assumption    */
-  /* that the routine will be called many times with the same     */
-  /* number of evaluation points, for example in Brillouin-zone   */
-  /* integrations                                                 */
+  /* storage for RFSource, RFDest matrices lives in a workspace,  */
+  /* which is only reallocated when the number of evaluation      */
+  /* points changes; this routine is typically called many times  */
+  /* with the same number of points, for example in Brillouin-    */
+  /* zone integrations                                            */
   /*--------------------------------------------------------------*/
-  static HMatrix *RFSource=0, *RFDest=0;
-  if ( RFSource==0 || RFSource->NR!=NBF || RFSource->NC!=(6*NX) )
-   { 
-     if (RFSource) delete RFSource;
-     if (RFDest)   delete RFDest;
-     RFSource=new HMatrix(NBF, 6*NX, LHM_COMPLEX);
-     RFDest=new HMatrix(NBF, 6*NX, LHM_COMPLEX);
-   };
+  Workspace *MyWS = WS ? WS : AcquireWorkspace();
+  HMatrix *RFSource = MyWS->GetHMatrix(WS_DGF_RFSOURCE, NBF, 6*NX);
+  HMatrix *RFDest   = MyWS->GetHMatrix(WS_DGF_RFDEST,   NBF, 6*NX);
 
   /*--------------------------------------------------------------*/
   /*- allocate an output matrix of the right size if necessary   -*/
@@ -187,6 +183,7 @@ HMatrix *RWGGeometry::GetDyadicGFs(cdouble Omega, double *kBloch,
        };
    };
 
+  if (WS==0) ReleaseWorkspace(MyWS);
   return GMatrix;
 
 }
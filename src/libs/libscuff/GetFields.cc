@@ -137,6 +137,277 @@ void GetDistanceToBF(double X0[3], RWGSurface *S, int ne)
 }
 #endif
 
+/***************************************************************/
+/* cubature parameters for reduced-field calculations, which   */
+/* may be overridden by environment variables.                 */
+/***************************************************************/
+void GetRFCubatureOptions(RFCubatureOptions *Options)
+{
+  Options->rRelOuterThreshold=4.0;
+  Options->rRelInnerThreshold=1.0;
+  Options->LowOrder=7;
+  Options->HighOrder=20;
+  char *s1=getenv("SCUFF_RREL_OUTER_THRESHOLD");
+  char *s2=getenv("SCUFF_RREL_INNER_THRESHOLD");
+  char *s3=getenv("SCUFF_LOWORDER");
+  char *s4=getenv("SCUFF_HIGHORDER");
+  if (s1) sscanf(s1,"%le",&(Options->rRelOuterThreshold));
+  if (s2) sscanf(s2,"%le",&(Options->rRelInnerThreshold));
+  if (s3) sscanf(s3,"%i",&(Options->LowOrder));
+  if (s4) sscanf(s4,"%i",&(Options->HighOrder));
+  if (s1||s2||s3||s4)
+   Log("({O,I}rRelThreshold | LowOrder | HighOrder)=(%e,%e,%i,%i)",
+       Options->rRelOuterThreshold,Options->rRelInnerThreshold,
+       Options->LowOrder,Options->HighOrder);
+
+  Options->NewMethod=RWGGeometry::UseNewRFMethod;
+}
+
+/***************************************************************/
+/* reduced fields GC = {G, C} of basis function #ne on surface */
+/* #ns at X, i.e. the integrals of the G and C dyadics against */
+/* the basis function, with the cubature scheme chosen by the  */
+/* distance from X to the basis function.                      */
+/***************************************************************/
+void GetEdgeReducedFields(RWGGeometry *G, int ns, int ne, double X[3],
+                          cdouble k, GBarAccelerator *GBA,
+                          RFCubatureOptions *Options, cdouble GC[6])
+{
+  RWGSurface *S = G->Surfaces[ns];
+  RWGEdge *E    = S->Edges[ne];
+
+  RFIData MyData, *Data=&MyData;
+  Data->X0  = X;
+  Data->k   = k;
+  Data->GBA = GBA;
+  Data->RLBasis = G->RLBasis;
+  Data->RLVolume= G->RLVolume;
+  Data->NewMethod = Options->NewMethod;
+
+  double rRel = VecDistance(X, E->Centroid) / E->Radius;
+  const int IDim=12;
+  if (rRel >= Options->rRelOuterThreshold)
+   { 
+     GetBFCubature2(G, ns, ne, RFIntegrand, (void *)Data,
+                    IDim, Options->LowOrder, (double *)GC);
+   }
+  else if (rRel>=Options->rRelInnerThreshold)
+   { 
+     GetBFCubature2(G, ns, ne, RFIntegrand, (void *)Data,
+                    IDim, Options->HighOrder, (double *)GC);
+   }
+  else
+   { 
+     GetReducedFields_Nearby(S, ne, X, k, GC+0, GC+3);
+     GC[3] /= (-II*k);
+     GC[4] /= (-II*k);
+     GC[5] /= (-II*k);
+
+     if (GBA)
+      { cdouble GC1[6], GC2[6];
+        int Order=4;
+        GetBFCubature2(G, ns, ne, RFIntegrand, (void *)Data,
+                       IDim, Order, (double *)GC1);
+        Data->GBA = 0;
+        GetBFCubature2(G, ns, ne, RFIntegrand, (void *)Data,
+                       IDim, Order, (double *)GC2);
+        for(int Mu=0; Mu<6; Mu++) 
+         GC[Mu] += (GC1[Mu] - GC2[Mu]);
+      };
+   };
+}
+
+/***************************************************************/
+/* spatial binning of evaluation points and basis functions.   */
+/* points (or edge centroids) are sorted along a Morton        */
+/* (Z-order) curve and split into consecutive runs of at most  */
+/* BinSize members, each with a bounding sphere.               */
+/***************************************************************/
+#define RF_POINTS_PER_BIN   32
+#define RF_EDGES_PER_CLUSTER 16
+
+typedef struct MortonKey
+ { unsigned long long Code;
+   int n;
+ } MortonKey;
+
+static int CompareMortonKeys(const void *p1, const void *p2)
+{ unsigned long long C1=((const MortonKey *)p1)->Code;
+  unsigned long long C2=((const MortonKey *)p2)->Code;
+  return (C1<C2) ? -1 : (C1>C2) ? 1 : 0;
+}
+
+// spread the low 21 bits of i into every third bit
+static unsigned long long SpreadBits(unsigned long long i)
+{ i &= 0x1fffff;
+  i = (i | i<<32) & 0x1f00000000ffffULL;
+  i = (i | i<<16) & 0x1f0000ff0000ffULL;
+  i = (i | i<< 8) & 0x100f00f00f00f00fULL;
+  i = (i | i<< 4) & 0x10c30c30c30c30c3ULL;
+  i = (i | i<< 2) & 0x1249249249249249ULL;
+  return i;
+}
+
+typedef struct SpatialBins
+ { int NumBins;
+   int *Order;       // Order[BinOffset[nb]...BinOffset[nb+1]-1] = members of bin #nb
+   int *BinOffset;
+   double *Spheres;  // center and radius of bounding sphere of each bin [4*NumBins]
+ } SpatialBins;
+
+static void CreateSpatialBins(int N, double *P, int BinSize, SpatialBins *SB)
+{
+  double XMin[3], XMax[3];
+  for(int Mu=0; Mu<3; Mu++)
+   { XMin[Mu]=XMax[Mu]=P[Mu];
+     for(int n=1; n<N; n++)
+      { XMin[Mu]=fmin(XMin[Mu], P[3*n+Mu]);
+        XMax[Mu]=fmax(XMax[Mu], P[3*n+Mu]);
+      };
+   };
+
+  MortonKey *Keys = (MortonKey *)mallocEC(N*sizeof(MortonKey));
+  for(int n=0; n<N; n++)
+   { Keys[n].n=n;
+     Keys[n].Code=0;
+     for(int Mu=0; Mu<3; Mu++)
+      { double Width = XMax[Mu] - XMin[Mu];
+        double t = (Width==0.0) ? 0.0 : (P[3*n+Mu] - XMin[Mu]) / Width;
+        unsigned long long i = (unsigned long long)(t*2097151.0);
+        Keys[n].Code |= SpreadBits(i) << Mu;
+      };
+   };
+  qsort(Keys, N, sizeof(MortonKey), CompareMortonKeys);
+
+  int NumBins = SB->NumBins = (N + BinSize - 1) / BinSize;
+  SB->Order     = (int *)mallocEC(N*sizeof(int));
+  SB->BinOffset = (int *)mallocEC((NumBins+1)*sizeof(int));
+  SB->Spheres   = (double *)mallocEC(4*NumBins*sizeof(double));
+  for(int n=0; n<N; n++)
+   SB->Order[n]=Keys[n].n;
+  free(Keys);
+
+  for(int nb=0; nb<NumBins; nb++)
+   { int nMin = SB->BinOffset[nb] = nb*BinSize;
+     int nMax = (nb+1)*BinSize; if (nMax>N) nMax=N;
+     double *Center = SB->Spheres + 4*nb;
+     Center[0]=Center[1]=Center[2]=0.0;
+     for(int n=nMin; n<nMax; n++)
+      VecPlusEquals(Center, 1.0/(nMax-nMin), P + 3*SB->Order[n]);
+     double Radius=0.0;
+     for(int n=nMin; n<nMax; n++)
+      Radius=fmax(Radius, VecDistance(Center, P + 3*SB->Order[n]));
+     Center[3]=Radius;
+   };
+  SB->BinOffset[NumBins]=N;
+}
+
+static void DestroySpatialBins(SpatialBins *SB)
+{ free(SB->Order);
+  free(SB->BinOffset);
+  free(SB->Spheres);
+}
+
+/***************************************************************/
+/* low-order cubature points of all basis functions, computed  */
+/* once for use at all evaluation points far from the basis    */
+/* function: for edge #neFull, points Y[3*n], weighted basis   */
+/* function Wb[3*n] and weighted divergence WDivb[n] for       */
+/* Offset[neFull] <= n < Offset[neFull+1].                     */
+/***************************************************************/
+typedef struct EdgeCubatureTable
+ { int *Offset;
+   double *Y, *Wb, *WDivb;
+ } EdgeCubatureTable;
+
+typedef struct ECTCollector
+ { EdgeCubatureTable *ECT;
+   int n;
+ } ECTCollector;
+
+static void ECTIntegrand(double X[3], double b[3], double Divb,
+                         void *UserData, double W, double *Integral)
+{
+  (void) Integral;
+  ECTCollector *Collector = (ECTCollector *)UserData;
+  EdgeCubatureTable *ECT  = Collector->ECT;
+  int n = Collector->n++;
+  memcpy(ECT->Y + 3*n, X, 3*sizeof(double));
+  ECT->Wb[3*n+0] = W*b[0];
+  ECT->Wb[3*n+1] = W*b[1];
+  ECT->Wb[3*n+2] = W*b[2];
+  ECT->WDivb[n]  = W*Divb;
+}
+
+static void CreateEdgeCubatureTable(RWGGeometry *G, int Order,
+                                    EdgeCubatureTable *ECT)
+{
+  int NumPts;
+  if ( GetTCR(Order, &NumPts)==0 )
+   ErrExit("invalid cubature order %i in GetRFMatrix",Order);
+
+  int NE=G->TotalEdges;
+  ECT->Offset = (int *)mallocEC((NE+1)*sizeof(int));
+  ECT->Offset[0]=0;
+  for(int neFull=0; neFull<NE; neFull++)
+   { int ns, ne;
+     RWGEdge *E = G->ResolveEdge(neFull, &ns, &ne, 0)->Edges[ne];
+     ECT->Offset[neFull+1] = ECT->Offset[neFull] + NumPts*( (E->iMPanel==-1) ? 1 : 2 );
+   };
+  int N=ECT->Offset[NE];
+  ECT->Y     = (double *)mallocEC(3*N*sizeof(double));
+  ECT->Wb    = (double *)mallocEC(3*N*sizeof(double));
+  ECT->WDivb = (double *)mallocEC(N*sizeof(double));
+
+  int NumThreads=GetNumThreads();
+#pragma omp parallel for schedule(dynamic,64), num_threads(NumThreads)
+  for(int neFull=0; neFull<NE; neFull++)
+   { int ns, ne;
+     G->ResolveEdge(neFull, &ns, &ne, 0);
+     ECTCollector Collector;
+     Collector.ECT = ECT;
+     Collector.n   = ECT->Offset[neFull];
+     double Dummy;
+     GetBFCubature2(G, ns, ne, ECTIntegrand, (void *)&Collector, 0, Order, &Dummy);
+   };
+}
+
+static void DestroyEdgeCubatureTable(EdgeCubatureTable *ECT)
+{ free(ECT->Offset);
+  free(ECT->Y);
+  free(ECT->Wb);
+  free(ECT->WDivb);
+}
+
+// low-order reduced fields of edge #neFull at X from the table;
+// this is the same sum that RFIntegrand accumulates
+static void GetTabulatedReducedFields(EdgeCubatureTable *ECT, int neFull,
+                                      double X[3], cdouble k,
+                                      GBarAccelerator *GBA, cdouble GC[6])
+{
+  memset(GC, 0, 6*sizeof(cdouble));
+  cdouble k2=k*k, ik=II*k;
+  for(int n=ECT->Offset[neFull]; n<ECT->Offset[neFull+1]; n++)
+   { double XmX0[3];
+     XmX0[0] = ECT->Y[3*n+0] - X[0];
+     XmX0[1] = ECT->Y[3*n+1] - X[1];
+     XmX0[2] = ECT->Y[3*n+2] - X[2];
+
+     cdouble G0, dG[3];
+     if (GBA)
+      G0=GetGBar(XmX0, GBA, dG);
+     else
+      G0=GetG(XmX0, k, dG);
+
+     double *Wb=ECT->Wb + 3*n, WDivb=ECT->WDivb[n];
+     for(int i=0; i<3; i++)
+      GC[i] += G0*Wb[i] - WDivb*dG[i]/k2;
+     GC[3+0] += (Wb[1]*dG[2] - Wb[2]*dG[1]) / (-1.0*ik);
+     GC[3+1] += (Wb[2]*dG[0] - Wb[0]*dG[2]) / (-1.0*ik);
+     GC[3+2] += (Wb[0]*dG[1] - Wb[1]*dG[0]) / (-1.0*ik);
+   };
+}
+
 /***************************************************************/
 /* RFMatrix is a matrix of "reduced fields", i.e. a matrix     */
 /* whose columns may be dot-producted with the KN vector (BEM  */
@@ -145,6 +416,14 @@ void GetDistanceToBF(double X0[3], RWGSurface *S, int ne)
 /* More specifically, for Mu=0...5, the (6*nx + Mu)th column   */
 /* of RFMatrix is dotted into KN to yield the Muth component   */
 /* of the field six-vector F=\{ E \choose H \}.                */
+/*                                                             */
+/* The calculation proceeds in two phases: first the points    */
+/* are assigned to regions and sorted into spatial bins, and   */
+/* the basis functions are grouped into spatial clusters; then */
+/* the matrix is filled one (bin, cluster) tile at a time. For */
+/* tiles in which every basis function is far from every point */
+/* the low-order cubature is evaluated from a precomputed      */
+/* table, without per-pair distance tests.                     */
 /***************************************************************/
 HMatrix *RWGGeometry::GetRFMatrix(cdouble Omega, double *kBloch0,
                                   HMatrix *XMatrix, HMatrix *RFMatrix,
@@ -180,21 +459,8 @@ HMatrix *RWGGeometry::GetRFMatrix(cdouble Omega, double *kBloch0,
   /***************************************************************/
   /***************************************************************/
   /***************************************************************/
-  double rRelOuterThreshold=4.0;
-  double rRelInnerThreshold=1.0;
-  int LowOrder=7;
-  int HighOrder=20;
-  char *s1=getenv("SCUFF_RREL_OUTER_THRESHOLD");
-  char *s2=getenv("SCUFF_RREL_INNER_THRESHOLD");
-  char *s3=getenv("SCUFF_LOWORDER");
-  char *s4=getenv("SCUFF_HIGHORDER");
-  if (s1) sscanf(s1,"%le",&rRelOuterThreshold);
-  if (s2) sscanf(s2,"%le",&rRelInnerThreshold);
-  if (s3) sscanf(s3,"%i",&LowOrder);
-  if (s4) sscanf(s4,"%i",&HighOrder);
-  if (s1||s2||s3||s4)
-   Log("({O,I}rRelThreshold | LowOrder | HighOrder)=(%e,%e,%i,%i)",
-       rRelOuterThreshold,rRelInnerThreshold,LowOrder,HighOrder);
+  RFCubatureOptions Options;
+  GetRFCubatureOptions(&Options);
 
   /***************************************************************/
   /***************************************************************/
@@ -224,138 +490,153 @@ HMatrix *RWGGeometry::GetRFMatrix(cdouble Omega, double *kBloch0,
    };
 
   /***************************************************************/
+  /* phase 1: classify evaluation points by region (once per     */
+  /* point), bin the points and cluster the basis functions.     */
   /***************************************************************/
-  /***************************************************************/
-/*!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!*/
-  static bool Initialized=false, UseNewMethod=false;
-  if (Initialized==false)
-   { Initialized=true;
-     char *s = getenv("SCUFF_NEW_RFMETHOD");
-     if(s && s[0]=='1')
-      { printf("Using new RF method.\n");
-        UseNewMethod=true;
-      };
+  int NumThreads=GetNumThreads();
+  double *XList = (double *)mallocEC(3*NX*sizeof(double));
+  int *XRegion  = (int *)mallocEC(NX*sizeof(int));
+#pragma omp parallel for schedule(dynamic,256), num_threads(NumThreads)
+  for(int nx=0; nx<NX; nx++)
+   { double *X = XList + 3*nx;
+     X[0]=XMatrix->GetEntryD(nx,ColumnOffset+0);
+     X[1]=XMatrix->GetEntryD(nx,ColumnOffset+1);
+     X[2]=XMatrix->GetEntryD(nx,ColumnOffset+2);
+     XRegion[nx] = GetRegionIndex(X); // -1 inside a closed PEC surface
    };
-/*!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!*/
+
+  double *EdgeCR = (double *)mallocEC(4*NE*sizeof(double));
+  for(int neFull=0; neFull<NE; neFull++)
+   { int ns, ne;
+     RWGEdge *E = ResolveEdge(neFull, &ns, &ne, 0)->Edges[ne];
+     memcpy(EdgeCR + 4*neFull, E->Centroid, 3*sizeof(double));
+     EdgeCR[4*neFull + 3] = E->Radius;
+   };
+  double *EdgeCentroids = (double *)mallocEC(3*NE*sizeof(double));
+  for(int neFull=0; neFull<NE; neFull++)
+   memcpy(EdgeCentroids + 3*neFull, EdgeCR + 4*neFull, 3*sizeof(double));
+
+  SpatialBins PointBins, EdgeClusters;
+  CreateSpatialBins(NX, XList, RF_POINTS_PER_BIN, &PointBins);
+  CreateSpatialBins(NE, EdgeCentroids, RF_EDGES_PER_CLUSTER, &EdgeClusters);
+  free(EdgeCentroids);
+
+  // for each cluster, the largest radius of its basis functions
+  double *ClusterMaxRadius = (double *)mallocEC(EdgeClusters.NumBins*sizeof(double));
+  for(int nc=0; nc<EdgeClusters.NumBins; nc++)
+   { ClusterMaxRadius[nc]=0.0;
+     for(int n=EdgeClusters.BinOffset[nc]; n<EdgeClusters.BinOffset[nc+1]; n++)
+      ClusterMaxRadius[nc]=fmax(ClusterMaxRadius[nc], EdgeCR[4*EdgeClusters.Order[n] + 3]);
+   };
+
+  // the experimental SCUFF_NEW_RFMETHOD integrand is only
+  // available through the per-pair path
+  EdgeCubatureTable ECT;
+  bool UseTable = !Options.NewMethod;
+  if (UseTable)
+   CreateEdgeCubatureTable(this, Options.LowOrder, &ECT);
 
   /***************************************************************/
+  /* phase 2: fill the matrix one (point bin, edge cluster) tile */
+  /* at a time. distinct tiles touch distinct matrix entries.    */
   /***************************************************************/
-  /***************************************************************/
-  int NENX=NE*NX;
-#ifndef USE_OPENMP
-  if (LogLevel>SCUFF_VERBOSELOGGING)
-   Log("Computing RFMatrix entries at %i points",NX);
-#else
-  int NumThreads=GetNumThreads();
+  int NumBins=PointBins.NumBins, NumClusters=EdgeClusters.NumBins;
+  int NumTiles=NumBins*NumClusters;
+  int NumFarTiles=0;
   if (LogLevel>SCUFF_VERBOSELOGGING)
-   Log("Computing RFMatrix entries (%i threads) at %i points",NumThreads,NX);
-#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
-#endif
-  for(int nenx=0; nenx<NENX; nenx++)
+   Log("Computing RFMatrix entries (%i threads) at %i points (%i tiles)",NumThreads,NX,NumTiles);
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads), reduction(+:NumFarTiles)
+  for(int nTile=0; nTile<NumTiles; nTile++)
    { 
-     int nx     = nenx / NE;
-     int neFull = nenx % NE;
-
-     int ns, ne, nbf;
-     RWGSurface *S = ResolveEdge(neFull, &ns, &ne, &nbf);
-     RWGEdge *E    = S->Edges[ne];
-
-     double X[3];
-     X[0]=XMatrix->GetEntryD(nx,ColumnOffset+0);
-     X[1]=XMatrix->GetEntryD(nx,ColumnOffset+1);
-     X[2]=XMatrix->GetEntryD(nx,ColumnOffset+2);
-     int RegionIndex = GetRegionIndex(X);
-     if (RegionIndex==-1) continue; // inside a closed PEC surface
-   
-     double Sign=0.0;
-     if      (Surfaces[ns]->RegionIndices[0]==RegionIndex) 
-      Sign=+1.0;
-     else if (Surfaces[ns]->RegionIndices[1]==RegionIndex)
-      Sign=-1.0;
-     else 
-      continue;
-   
-     cdouble k    = ks[RegionIndex];
-     cdouble ZRel = ZRels[RegionIndex];
-
-     /*--------------------------------------------------------------*/
-     /*--------------------------------------------------------------*/
-     /*--------------------------------------------------------------*/
-     cdouble GC[6];
-     RFIData MyData, *Data=&MyData;
-     Data->X0  = X;
-     Data->k   = ks[RegionIndex];
-     Data->GBA = RegionGBAs ? RegionGBAs[RegionIndex] : 0;
-     Data->RLBasis = RLBasis;
-     Data->RLVolume= RLVolume;
-     Data->NewMethod = UseNewMethod;
-
-     double rRel = VecDistance(X, E->Centroid) / E->Radius;
-     const int IDim=12;
-     if (rRel >= rRelOuterThreshold)
-      { 
-        GetBFCubature2(this, ns, ne, RFIntegrand, (void *)Data,
-                       IDim, LowOrder, (double *)GC);
-      }
-     else if (rRel>=rRelInnerThreshold)
+     int nb = nTile / NumClusters;
+     int nc = nTile % NumClusters;
+
+     // a tile is far if every point in the bin is at least
+     // rRelOuterThreshold radii from every basis function in the
+     // cluster
+     double *BS=PointBins.Spheres + 4*nb, *CS=EdgeClusters.Spheres + 4*nc;
+     double Gap = VecDistance(BS, CS) - BS[3] - CS[3];
+     bool FarTile = UseTable && ( Gap >= Options.rRelOuterThreshold*ClusterMaxRadius[nc] );
+     if (FarTile) NumFarTiles++;
+
+     for(int n=PointBins.BinOffset[nb]; n<PointBins.BinOffset[nb+1]; n++)
       { 
-        GetBFCubature2(this, ns, ne, RFIntegrand, (void *)Data,
-                       IDim, HighOrder, (double *)GC);
-      }
-     else
-      { 
-        GetReducedFields_Nearby(S, ne, X, k, GC+0, GC+3);
-        GC[3] /= (-II*k);
-        GC[4] /= (-II*k);
-        GC[5] /= (-II*k);
-
-        if (RegionGBAs)
-         { cdouble GC1[6], GC2[6];
-           int Order=4;
-           GetBFCubature2(this, ns, ne, RFIntegrand, (void *)Data,
-                          IDim, Order, (double *)GC1);
-           Data->GBA = 0;
-           GetBFCubature2(this, ns, ne, RFIntegrand, (void *)Data,
-                          IDim, Order, (double *)GC2);
-           for(int Mu=0; Mu<6; Mu++) 
-            GC[Mu] += (GC1[Mu] - GC2[Mu]);
-         };
-      };
-
-     /***************************************************/
-     /*                                                 */
-     /* E = ik*Z0 * Zr * k*g + ik*n*c                   */
-     /*   = ik*Z0 * Zr * k*g - ik*Z0*nScuff*c           */
-     /* H =        -ik * k*c + (ik/(Z0*Zr)) * n*c       */
-     /*   =        -ik * k*c - (ik/Zr) *nScuff*c        */
-     /***************************************************/
-     cdouble *GG=GC+0, *CC=GC+3;
-     cdouble EKFactor =      Sign*II*k*ZRel*ZVAC;
-     cdouble HKFactor = -1.0*Sign*II*k;
-     cdouble ENFactor = -1.0*Sign*II*k*ZVAC;
-     cdouble HNFactor = -1.0*Sign*II*k/ZRel;
-
-     RFMatrix->SetEntry(nbf, 6*nx + 0, EKFactor * GG[0] );
-     RFMatrix->SetEntry(nbf, 6*nx + 1, EKFactor * GG[1] );
-     RFMatrix->SetEntry(nbf, 6*nx + 2, EKFactor * GG[2] );
-     RFMatrix->SetEntry(nbf, 6*nx + 3, HKFactor * CC[0] );
-     RFMatrix->SetEntry(nbf, 6*nx + 4, HKFactor * CC[1] );
-     RFMatrix->SetEntry(nbf, 6*nx + 5, HKFactor * CC[2] );
-
-     if ( !(S->IsPEC) )
-      { RFMatrix->SetEntry(nbf+1, 6*nx + 0, ENFactor * CC[0] );
-        RFMatrix->SetEntry(nbf+1, 6*nx + 1, ENFactor * CC[1] );
-        RFMatrix->SetEntry(nbf+1, 6*nx + 2, ENFactor * CC[2] );
-        RFMatrix->SetEntry(nbf+1, 6*nx + 3, HNFactor * GG[0] );
-        RFMatrix->SetEntry(nbf+1, 6*nx + 4, HNFactor * GG[1] );
-        RFMatrix->SetEntry(nbf+1, 6*nx + 5, HNFactor * GG[2] );
-      };
-
-   }; // for(int nenx=0; nenx<NENX; nenx++)
+        int nx = PointBins.Order[n];
+        int RegionIndex = XRegion[nx];
+        if (RegionIndex==-1) continue;
+        double *X = XList + 3*nx;
+        cdouble k    = ks[RegionIndex];
+        cdouble ZRel = ZRels[RegionIndex];
+        GBarAccelerator *GBA = RegionGBAs ? RegionGBAs[RegionIndex] : 0;
+
+        for(int m=EdgeClusters.BinOffset[nc]; m<EdgeClusters.BinOffset[nc+1]; m++)
+         { 
+           int neFull = EdgeClusters.Order[m];
+           int ns, ne, nbf;
+           RWGSurface *S = ResolveEdge(neFull, &ns, &ne, &nbf);
+
+           double Sign=0.0;
+           if      (S->RegionIndices[0]==RegionIndex) 
+            Sign=+1.0;
+           else if (S->RegionIndices[1]==RegionIndex)
+            Sign=-1.0;
+           else 
+            continue;
+
+           cdouble GC[6];
+           double *CR = EdgeCR + 4*neFull;
+           if ( FarTile || (UseTable && VecDistance(X, CR) >= Options.rRelOuterThreshold*CR[3]) )
+            GetTabulatedReducedFields(&ECT, neFull, X, k, GBA, GC);
+           else
+            GetEdgeReducedFields(this, ns, ne, X, k, GBA, &Options, GC);
+
+           /***************************************************/
+           /*                                                 */
+           /* E = ik*Z0 * Zr * k*g + ik*n*c                   */
+           /*   = ik*Z0 * Zr * k*g - ik*Z0*nScuff*c           */
+           /* H =        -ik * k*c + (ik/(Z0*Zr)) * n*c       */
+           /*   =        -ik * k*c - (ik/Zr) *nScuff*c        */
+           /***************************************************/
+           cdouble *GG=GC+0, *CC=GC+3;
+           cdouble EKFactor =      Sign*II*k*ZRel*ZVAC;
+           cdouble HKFactor = -1.0*Sign*II*k;
+           cdouble ENFactor = -1.0*Sign*II*k*ZVAC;
+           cdouble HNFactor = -1.0*Sign*II*k/ZRel;
+
+           RFMatrix->SetEntry(nbf, 6*nx + 0, EKFactor * GG[0] );
+           RFMatrix->SetEntry(nbf, 6*nx + 1, EKFactor * GG[1] );
+           RFMatrix->SetEntry(nbf, 6*nx + 2, EKFactor * GG[2] );
+           RFMatrix->SetEntry(nbf, 6*nx + 3, HKFactor * CC[0] );
+           RFMatrix->SetEntry(nbf, 6*nx + 4, HKFactor * CC[1] );
+           RFMatrix->SetEntry(nbf, 6*nx + 5, HKFactor * CC[2] );
+
+           if ( !(S->IsPEC) )
+            { RFMatrix->SetEntry(nbf+1, 6*nx + 0, ENFactor * CC[0] );
+              RFMatrix->SetEntry(nbf+1, 6*nx + 1, ENFactor * CC[1] );
+              RFMatrix->SetEntry(nbf+1, 6*nx + 2, ENFactor * CC[2] );
+              RFMatrix->SetEntry(nbf+1, 6*nx + 3, HNFactor * GG[0] );
+              RFMatrix->SetEntry(nbf+1, 6*nx + 4, HNFactor * GG[1] );
+              RFMatrix->SetEntry(nbf+1, 6*nx + 5, HNFactor * GG[2] );
+            };
+         }; // for(int m=...)
+      }; // for(int n=...)
+   }; // for(int nTile=0; nTile<NumTiles; nTile++)
+
+  if (LogLevel>=SCUFF_VERBOSE2)
+   Log(" %i/%i RFMatrix tiles evaluated with far-field cubature",NumFarTiles,NumTiles);
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
+  if (UseTable)
+   DestroyEdgeCubatureTable(&ECT);
+  DestroySpatialBins(&PointBins);
+  DestroySpatialBins(&EdgeClusters);
+  free(ClusterMaxRadius);
+  free(EdgeCR);
+  free(XList);
+  free(XRegion);
+
   if (RegionGBAs)
    { for(int nr=0; nr<NumRegions; nr++)
       if (RegionGBAs[nr])
@@ -370,9 +651,38 @@ HMatrix *RWGGeometry::GetRFMatrix(cdouble Omega, double *kBloch0,
 }
 
 /***************************************************************/
+/* number of evaluation points for which the RFMatrix fits     */
+/* within RWGGeometry::FieldChunkMemory megabytes; callers     */
+/* that process large sets of evaluation points may use this   */
+/* to size their own chunks.                                   */
 /***************************************************************/
+int RWGGeometry::GetFieldChunkSize()
+{
+  double BytesPerPoint = 6.0*TotalBFs*sizeof(cdouble);
+  double ChunkSize = floor( FieldChunkMemory*1048576.0 / BytesPerPoint );
+  if (ChunkSize<1.0) return 1;
+  if (ChunkSize>1.0e8) return 100000000;
+  return (int)ChunkSize;
+}
+
 /***************************************************************/
-HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
+/* get the fields at the points in XMatrix for NumRHS sets of  */
+/* surface currents and/or incident fields at once: the        */
+/* surface currents are the first NumRHS columns of KN (as     */
+/* returned by AssembleRHSMatrix and LUSolve) and the incident */
+/* fields are the lists IFs[0..NumRHS-1]. either KN or IFs may */
+/* be NULL, as may individual entries of IFs.                  */
+/*                                                             */
+/* on return, FMatrix(nx, 6*nrhs + Mu) is the Muth component   */
+/* of the field six-vector at the nxth point for the nrhsth    */
+/* solution. the reduced-field matrix is computed once for all */
+/* solutions, which are then obtained with a single (level-3   */
+/* BLAS) matrix-matrix product.                                */
+/*                                                             */
+/* If FMatrix is NULL or has the wrong size on entry, a new    */
+/* NX x 6*NumRHS matrix is allocated and returned.             */
+/***************************************************************/
+HMatrix *RWGGeometry::GetFields(IncField **IFs, HMatrix *KN, int NumRHS,
                                 cdouble Omega, double *kBloch,
                                 HMatrix *XMatrix, HMatrix *FMatrix)
 { 
@@ -382,6 +692,8 @@ HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
   if ( XMatrix==0 || XMatrix->NC<3 || XMatrix->NR==0 )
    ErrExit("wrong-size XMatrix (%ix%i) passed to GetFields",
             XMatrix->NR,XMatrix->NC);
+  if ( KN && (KN->NR!=TotalBFs || KN->NC<NumRHS) )
+   ErrExit("wrong-size KN matrix (%ix%i) passed to GetFields",KN->NR,KN->NC);
 
   int NX=XMatrix->NR;
   if (LogLevel >= SCUFF_VERBOSELOGGING)
@@ -390,12 +702,13 @@ HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
   /***************************************************************/
   /* (re)allocate output matrix as necessary *********************/
   /***************************************************************/
-  if (FMatrix==0 || FMatrix->NR!=NX || FMatrix->NC!=NUMFIELDS)
+  int NCF=NUMFIELDS*NumRHS;
+  if (FMatrix==0 || FMatrix->NR!=NX || FMatrix->NC!=NCF)
    { if (FMatrix)
       { Warn(" ** warning: wrong-size FMatrix passed to GetFields(); reallocating");
         delete FMatrix;
       };
-     FMatrix=new HMatrix(NX, NUMFIELDS, LHM_COMPLEX);
+     FMatrix=new HMatrix(NX, NCF, LHM_COMPLEX);
    };
   FMatrix->Zero();
 
@@ -407,22 +720,78 @@ HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
   /* before setting up and solving the BEM problem, so we should */
   /* do this just to make sure.                                  */
   /***************************************************************/
-  if (IFList)
-   UpdateIncFields(IFList, Omega, kBloch);
+  if (IFs)
+   for(int nrhs=0; nrhs<NumRHS; nrhs++)
+    if (IFs[nrhs])
+     UpdateIncFields(IFs[nrhs], Omega, kBloch);
 
   /***************************************************************/
-  /* get contributions of surface currents if present ************/
+  /* get contributions of surface currents if present. if the    */
+  /* (approximate) multipole path has been requested by setting  */
+  /* FMMOrder>0, then for large numbers of basis functions and   */
+  /* evaluation points we use GetFieldsFMM.cc, which avoids      */
+  /* forming the full RFMatrix; otherwise the RFMatrix is formed */
+  /* for chunks of evaluation points at a time to bound its      */
+  /* memory. the multipole calculation is repeated for each      */
+  /* solution while the RFMatrix is shared among all of them,    */
+  /* which is taken into account in choosing between the two.    */
   /***************************************************************/
-  if (KN)
+  if (KN && LBasis==0 && FMMOrder>0 && ((double)TotalEdges)*NX >= FMMThreshold*NumRHS)
+   { 
+     HMatrix *FMatrix1 = (NumRHS==1) ? FMatrix : new HMatrix(NX, NUMFIELDS, LHM_COMPLEX);
+     for(int nrhs=0; nrhs<NumRHS; nrhs++)
+      { HVector KNColumn(TotalBFs, LHM_COMPLEX, (void *)(KN->ZM + nrhs*KN->NR));
+        if (FMatrix1!=FMatrix)
+         FMatrix1->Zero();
+        GetFieldsFMM(&KNColumn, Omega, XMatrix, FMatrix1);
+        if (FMatrix1!=FMatrix)
+         for(int nx=0; nx<NX; nx++)
+          for(int Mu=0; Mu<NUMFIELDS; Mu++)
+           FMatrix->SetEntry(nx, NUMFIELDS*nrhs + Mu, FMatrix1->GetEntry(nx,Mu));
+      };
+     if (FMatrix1!=FMatrix)
+      delete FMatrix1;
+   }
+  else if (KN)
    {
-     HMatrix *RFMatrix = GetRFMatrix(Omega, kBloch, XMatrix, 0, true);
-     HMatrix KNMatrix(1, TotalBFs, LHM_COMPLEX, LHM_NORMAL, (void *)KN->ZV);
-     HMatrix *FMatrixT = new HMatrix(1, 6*NX, LHM_COMPLEX);
-     KNMatrix.Multiply(RFMatrix, FMatrixT);
-     for(int nx=0; nx<NX; nx++)
-      for(int Mu=0; Mu<6; Mu++)
-       FMatrix->SetEntry(nx, Mu, FMatrixT->GetEntry(0, 6*nx + Mu));
+     int ChunkSize = GetFieldChunkSize();
+     if (ChunkSize>NX) ChunkSize=NX;
+     int NumChunks = (NX + ChunkSize - 1) / ChunkSize;
+     if (NumChunks>1 && LogLevel>=SCUFF_VERBOSELOGGING)
+      Log(" evaluating scattered fields in %i chunks of %i points",NumChunks,ChunkSize);
+
+     HMatrix *XChunk = (NumChunks==1) ? XMatrix : new HMatrix(ChunkSize, 3);
+     HMatrix *RFMatrix = new HMatrix(TotalBFs, 6*ChunkSize, LHM_COMPLEX);
+     HMatrix *FMatrixT = new HMatrix(NumRHS, 6*ChunkSize, LHM_COMPLEX);
+     HMatrix KNMatrix(TotalBFs, NumRHS, LHM_COMPLEX, LHM_NORMAL, (void *)KN->ZM);
+     for(int nc=0; nc<NumChunks; nc++)
+      { 
+        int nxMin = nc*ChunkSize;
+        int NXC   = (nxMin + ChunkSize <= NX) ? ChunkSize : NX - nxMin;
+        if (NumChunks>1)
+         { if (NXC!=XChunk->NR)
+            { delete XChunk;
+              delete RFMatrix;
+              delete FMatrixT;
+              XChunk   = new HMatrix(NXC, 3);
+              RFMatrix = new HMatrix(TotalBFs, 6*NXC, LHM_COMPLEX);
+              FMatrixT = new HMatrix(NumRHS, 6*NXC, LHM_COMPLEX);
+            };
+           for(int nx=0; nx<NXC; nx++)
+            for(int Mu=0; Mu<3; Mu++)
+             XChunk->SetEntry(nx, Mu, XMatrix->GetEntryD(nxMin+nx, Mu));
+         };
+
+        GetRFMatrix(Omega, kBloch, XChunk, RFMatrix, true);
+        KNMatrix.Multiply(RFMatrix, FMatrixT, "--transA T");
+        for(int nrhs=0; nrhs<NumRHS; nrhs++)
+         for(int nx=0; nx<NXC; nx++)
+          for(int Mu=0; Mu<6; Mu++)
+           FMatrix->SetEntry(nxMin+nx, NUMFIELDS*nrhs + Mu, 
+                             FMatrixT->GetEntry(nrhs, 6*nx + Mu));
+      };
 
+     if (XChunk!=XMatrix) delete XChunk;
      delete RFMatrix;
      delete FMatrixT;
    };
@@ -430,7 +799,7 @@ HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
   /***************************************************************/
   /* add contributions of incident fields if present *************/
   /***************************************************************/
-  if (IFList)
+  if (IFs)
    for(int nx=0; nx<NX; nx++)
     { 
       double X[3];
@@ -438,19 +807,34 @@ HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
       int RegionIndex = GetRegionIndex(X);
       if (RegionIndex==-1) continue; // inside a closed PEC surface
 
-      for(IncField *IF=IFList; IF; IF=IF->Next)
-       if ( IF->RegionIndex == RegionIndex )
-        { cdouble EH[6];
-          IF->GetFields(X, EH);
-          for(int Mu=0; Mu<6; Mu++)
-           FMatrix->AddEntry(nx, Mu, EH[Mu]);
-        };
+      for(int nrhs=0; nrhs<NumRHS; nrhs++)
+       for(IncField *IF=IFs[nrhs]; IF; IF=IF->Next)
+        if ( IF->RegionIndex == RegionIndex )
+         { cdouble EH[6];
+           IF->GetFields(X, EH);
+           for(int Mu=0; Mu<6; Mu++)
+            FMatrix->AddEntry(nx, NUMFIELDS*nrhs + Mu, EH[Mu]);
+         };
     };
 
   return FMatrix;
          
 }
 
+/***************************************************************/
+/* single-solution version                                     */
+/***************************************************************/
+HMatrix *RWGGeometry::GetFields(IncField *IFList, HVector *KN,
+                                cdouble Omega, double *kBloch,
+                                HMatrix *XMatrix, HMatrix *FMatrix)
+{ 
+  HMatrix *KNMatrix = KN ? new HMatrix(TotalBFs, 1, LHM_COMPLEX, LHM_NORMAL, (void *)KN->ZV) : 0;
+  IncField **IFs = IFList ? &IFList : 0;
+  FMatrix = GetFields(IFs, KNMatrix, 1, Omega, kBloch, XMatrix, FMatrix);
+  if (KNMatrix) delete KNMatrix;
+  return FMatrix;
+}
+
 /***************************************************************/
 /* alternative entry points to GetFields                       */
 /***************************************************************/
@@ -0,0 +1,1044 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * GetFieldsFMM.cc -- multilevel fast-multipole evaluation of the
+ *                 -- scattered fields at many points
+ *
+ * The scattered fields at each evaluation point X are sums over
+ * basis functions of the low-order cubature used by GetRFMatrix for
+ * well-separated basis functions, i.e. sums of free-space Green's
+ * function contributions from point sources at the cubature points.
+ * Here these sums are evaluated with a kernel-independent fast
+ * multipole method (Chebyshev interpolation of the source and field
+ * distributions within the boxes of an octree, as in Fong and Darve,
+ * J. Comp. Phys. 228 8712 (2009)), so that the NBF x 6NX matrix
+ * of reduced fields is never formed.
+ *
+ * For basis functions close to an evaluation point (rRel below the
+ * outer threshold used by GetRFMatrix) the low-order contribution
+ * included in the multipole sums is subtracted off again and
+ * replaced by the reduced fields computed exactly as in
+ * GetRFMatrix, i.e. by high-order cubature or
+ * GetReducedFields_Nearby.
+ *
+ * The order of the Chebyshev interpolation is set by
+ * RWGGeometry::FMMOrder (environment variable SCUFF_FMM_ORDER).
+ * Because the interpolation error (~1e-4 relative at order 5)
+ * is much larger than that of the direct calculation, this path
+ * is off by default (FMMOrder=0) and is only used when a nonzero
+ * order is requested explicitly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include <libTriInt.h>
+
+#include "libscuff.h"
+#include "libscuffInternals.h"
+#include "PanelCubature.h"
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#ifdef USE_OPENMP
+#  include <omp.h>
+#endif
+
+#define II cdouble(0,1)
+
+namespace scuff {
+
+#define NUMQ       8    // source densities per point (see below)
+#define NUMFIELDS  6    // Ex, Ey, Ez, Hx, Hy, Hz
+#define MAXLEVEL  20
+#define MAXORDER  10
+
+// boxes are considered well-separated if the gap between their
+// bounding spheres is at least FMM_SEPARATION times the larger radius
+#define FMM_SEPARATION 1.0
+
+/***************************************************************/
+/* data structures                                             */
+/*                                                             */
+/* each source point carries NUMQ complex densities: the       */
+/* cubature weight times KN coefficient times {b, div b} for   */
+/* the electric (K) and magnetic (N) currents:                 */
+/*  Q[0..2] = K*W*b,  Q[3] = K*W*Divb,                         */
+/*  Q[4..6] = N*W*b,  Q[7] = N*W*Divb,                         */
+/* with the sign of the surface relative to the region folded  */
+/* in.                                                         */
+/***************************************************************/
+typedef struct FMMBox
+ { double Center[3];
+   double HalfWidth;
+   int Level;
+   int Child[8];             // indices of nonempty child boxes, or -1
+   bool IsLeaf;
+   int SourceOffset, NumSources;
+   int TargetOffset, NumTargets;
+   double MaxEdgeRadius;     // largest basis function with points in the box
+   cdouble *M;               // source weights at Chebyshev nodes [NumNodes*NUMQ]
+   cdouble *L;               // fields at Chebyshev nodes [NumNodes*NUMFIELDS]
+ } FMMBox;
+
+typedef struct FMMData
+ {
+   // kernel
+   cdouble k, ik, OneOverK2, EKFactor, HNFactor;
+
+   // Chebyshev interpolation
+   int Order, NumNodes;
+   double ChebNodes[MAXORDER];
+
+   // sources and targets, sorted into tree order
+   int NS, NT;
+   double *Y;        // source points [3*NS]
+   cdouble *Q;       // source densities [NUMQ*NS]
+   int *SourceEdge;  // global index of the edge that owns each source
+   double *EdgeY;    // source points and densities in edge order,
+   cdouble *EdgeQ;   //  with those of edge #neFull starting at
+   int *EdgeOffset;  //  index EdgeOffset[neFull]
+   double *X;        // target points [3*NT]
+   int *TargetRow;   // row of XMatrix for each target
+   cdouble *EH;      // fields at targets [NUMFIELDS*NT]
+
+   // octree
+   int NumBoxes, MaxBoxes;
+   FMMBox *Boxes;
+   int LeafSize;
+
+   // interaction lists, grouped by target box
+   int *FarOffset, *FarList;
+   int *NearOffset, *NearList;
+
+   // for near-field corrections
+   RWGGeometry *G;
+   double *EdgeCR;   // centroid and radius of each edge [4*TotalEdges]
+   int RegionIndex;
+   cdouble ZRel;
+   double rRelOuterThreshold;
+   RFCubatureOptions *Options;
+   cdouble *KN;
+
+ } FMMData;
+
+/***************************************************************/
+/* kernel: add the fields at X due to NS point sources at Y    */
+/* with densities Q.                                           */
+/*                                                             */
+/* with R=Y-X, the contribution of each source is              */
+/*  E += EKFactor*(G*bK - divbK*grad G/k^2) + ZVAC*bN x grad G */
+/*  H += bK x grad G + HNFactor*(G*bN - divbN*grad G/k^2)      */
+/* which reproduces the combination of reduced fields formed   */
+/* in GetRFMatrix.                                             */
+/***************************************************************/
+static inline void AddFields(FMMData *Data, const double *Y,
+                             const cdouble *Q, const double *X,
+                             cdouble *EH)
+{
+  double R[3];
+  R[0]=Y[0]-X[0];
+  R[1]=Y[1]-X[1];
+  R[2]=Y[2]-X[2];
+  double r2=R[0]*R[0] + R[1]*R[1] + R[2]*R[2];
+  if (r2==0.0) return;
+  double r=sqrt(r2);
+
+  cdouble G = exp(Data->ik*r) / (4.0*M_PI*r);
+  cdouble f = G*(Data->ik - 1.0/r)/r;   // grad G = f*R
+  cdouble dG[3] = { f*R[0], f*R[1], f*R[2] };
+
+  cdouble GK  = Data->EKFactor*G;
+  cdouble DK  = Data->EKFactor*Data->OneOverK2*Q[3];
+  cdouble GN  = Data->HNFactor*G;
+  cdouble DN  = Data->HNFactor*Data->OneOverK2*Q[7];
+  const cdouble *bK=Q+0, *bN=Q+4;
+
+  EH[0] += GK*bK[0] - DK*dG[0] + ZVAC*(bN[1]*dG[2] - bN[2]*dG[1]);
+  EH[1] += GK*bK[1] - DK*dG[1] + ZVAC*(bN[2]*dG[0] - bN[0]*dG[2]);
+  EH[2] += GK*bK[2] - DK*dG[2] + ZVAC*(bN[0]*dG[1] - bN[1]*dG[0]);
+  EH[3] += (bK[1]*dG[2] - bK[2]*dG[1]) + GN*bN[0] - DN*dG[0];
+  EH[4] += (bK[2]*dG[0] - bK[0]*dG[2]) + GN*bN[1] - DN*dG[1];
+  EH[5] += (bK[0]*dG[1] - bK[1]*dG[0]) + GN*bN[2] - DN*dG[2];
+}
+
+/***************************************************************/
+/* Chebyshev nodes and Lagrange interpolation weights          */
+/***************************************************************/
+static void GetNodeCoordinates(FMMData *Data, FMMBox *B, int nn, double X[3])
+{
+  int p=Data->Order;
+  X[0] = B->Center[0] + B->HalfWidth*Data->ChebNodes[ nn%p ];
+  X[1] = B->Center[1] + B->HalfWidth*Data->ChebNodes[ (nn/p)%p ];
+  X[2] = B->Center[2] + B->HalfWidth*Data->ChebNodes[ nn/(p*p) ];
+}
+
+static void GetNodePoints(FMMData *Data, FMMBox *B, double *XNodes)
+{ for(int nn=0; nn<Data->NumNodes; nn++)
+   GetNodeCoordinates(Data, B, nn, XNodes + 3*nn);
+}
+
+// S[Mu*p + m] = m-th Lagrange polynomial in dimension Mu at X
+static void GetInterpWeights(FMMData *Data, FMMBox *B, const double X[3], double *S)
+{
+  int p=Data->Order;
+  double *c=Data->ChebNodes;
+  for(int Mu=0; Mu<3; Mu++)
+   { double t = (X[Mu] - B->Center[Mu]) / B->HalfWidth;
+     for(int m=0; m<p; m++)
+      { double Num=1.0, Den=1.0;
+        for(int j=0; j<p; j++)
+         if (j!=m)
+          { Num *= (t - c[j]);
+            Den *= (c[m] - c[j]);
+          };
+        S[Mu*p + m] = Num/Den;
+      };
+   };
+}
+
+/***************************************************************/
+/* octree construction. boxes are subdivided until they hold   */
+/* at most LeafSize sources+targets; children are always       */
+/* stored after their parents.                                 */
+/***************************************************************/
+static int AddBox(FMMData *Data, double Center[3], double HalfWidth, int Level)
+{
+  if (Data->NumBoxes==Data->MaxBoxes)
+   { Data->MaxBoxes *= 2;
+     Data->Boxes = (FMMBox *)reallocEC(Data->Boxes, Data->MaxBoxes*sizeof(FMMBox));
+   };
+  int nb = Data->NumBoxes++;
+  FMMBox *B=Data->Boxes + nb;
+  memcpy(B->Center, Center, 3*sizeof(double));
+  B->HalfWidth=HalfWidth;
+  B->Level=Level;
+  for(int nc=0; nc<8; nc++)
+   B->Child[nc]=-1;
+  B->IsLeaf=true;
+  B->MaxEdgeRadius=0.0;
+  B->M=B->L=0;
+  return nb;
+}
+
+static int GetOctant(const double *X, const double *Center)
+{ return   (X[0]>=Center[0] ? 1 : 0)
+         + (X[1]>=Center[1] ? 2 : 0)
+         + (X[2]>=Center[2] ? 4 : 0);
+}
+
+// sort the points in [Offset, Offset+N) by octant, permuting
+// the point coordinates and the index array Order in tandem
+static void SortByOctant(double *P, int *Order, int Offset, int N,
+                         const double *Center, int Counts[8])
+{
+  memset(Counts, 0, 8*sizeof(int));
+  for(int n=0; n<N; n++)
+   Counts[ GetOctant(P + 3*(Offset+n), Center) ]++;
+
+  int Start[8];
+  Start[0]=0;
+  for(int no=1; no<8; no++)
+   Start[no] = Start[no-1] + Counts[no-1];
+
+  double *PBuffer = (double *)mallocEC(3*N*sizeof(double));
+  int *OBuffer    = (int *)mallocEC(N*sizeof(int));
+  for(int n=0; n<N; n++)
+   { int no = GetOctant(P + 3*(Offset+n), Center);
+     int m  = Start[no]++;
+     memcpy(PBuffer + 3*m, P + 3*(Offset+n), 3*sizeof(double));
+     OBuffer[m] = Order[Offset+n];
+   };
+  memcpy(P + 3*Offset, PBuffer, 3*N*sizeof(double));
+  memcpy(Order + Offset, OBuffer, N*sizeof(int));
+  free(PBuffer);
+  free(OBuffer);
+}
+
+static void SubdivideBox(FMMData *Data, int nb, int *SourceOrder, int *TargetOrder)
+{
+  FMMBox *B=Data->Boxes + nb;
+  if ( B->NumSources + B->NumTargets <= Data->LeafSize || B->Level==MAXLEVEL )
+   return;
+
+  double Center[3], HalfWidth=B->HalfWidth;
+  memcpy(Center, B->Center, 3*sizeof(double));
+  int SourceOffset=B->SourceOffset, TargetOffset=B->TargetOffset;
+  int SourceCounts[8], TargetCounts[8];
+  SortByOctant(Data->Y, SourceOrder, SourceOffset, B->NumSources, Center, SourceCounts);
+  SortByOctant(Data->X, TargetOrder, TargetOffset, B->NumTargets, Center, TargetCounts);
+  B->IsLeaf=false;
+
+  for(int no=0; no<8; no++)
+   {
+     if ( SourceCounts[no]==0 && TargetCounts[no]==0 )
+      { SourceOffset += SourceCounts[no];
+        TargetOffset += TargetCounts[no];
+        continue;
+      };
+
+     double ChildCenter[3];
+     ChildCenter[0] = Center[0] + ( (no&1) ? 0.5 : -0.5)*HalfWidth;
+     ChildCenter[1] = Center[1] + ( (no&2) ? 0.5 : -0.5)*HalfWidth;
+     ChildCenter[2] = Center[2] + ( (no&4) ? 0.5 : -0.5)*HalfWidth;
+     int nc = AddBox(Data, ChildCenter, 0.5*HalfWidth, Data->Boxes[nb].Level+1);
+     FMMBox *C=Data->Boxes + nc;
+     C->SourceOffset = SourceOffset; C->NumSources = SourceCounts[no];
+     C->TargetOffset = TargetOffset; C->NumTargets = TargetCounts[no];
+     Data->Boxes[nb].Child[no]=nc;
+     SourceOffset += SourceCounts[no];
+     TargetOffset += TargetCounts[no];
+
+     SubdivideBox(Data, nc, SourceOrder, TargetOrder);
+   };
+}
+
+/***************************************************************/
+/* interaction lists by dual-tree traversal. a pair of boxes   */
+/* goes on the far list if the boxes are well separated and    */
+/* small enough in units of the wavelength for the Chebyshev   */
+/* interpolant to resolve the fields; otherwise a pair of      */
+/* leaves goes on the near list, and any other pair is         */
+/* subdivided.                                                 */
+/***************************************************************/
+typedef struct FMMPairList
+ { int N, NMax;
+   int *Pairs;
+ } FMMPairList;
+
+static void AddPair(FMMPairList *PL, int nt, int ns)
+{ if (PL->N==PL->NMax)
+   { PL->NMax = (PL->NMax==0) ? 1024 : 2*PL->NMax;
+     PL->Pairs = (int *)reallocEC(PL->Pairs, 2*PL->NMax*sizeof(int));
+   };
+  PL->Pairs[2*PL->N + 0]=nt;
+  PL->Pairs[2*PL->N + 1]=ns;
+  PL->N++;
+}
+
+// true if the interpolant on box B can be used
+static bool UsesExpansion(FMMData *Data, FMMBox *B, int NumPoints)
+{ return !(B->IsLeaf) || NumPoints > Data->NumNodes; }
+
+static bool Admissible(FMMData *Data, FMMBox *T, FMMBox *S)
+{
+  // the separation needed for an accurate interpolant on each
+  // side applies only if that side is actually interpolated;
+  // the interpolants must also resolve the wavelength
+  bool TExpansion = UsesExpansion(Data, T, T->NumTargets);
+  bool SExpansion = UsesExpansion(Data, S, S->NumSources);
+  double rT = sqrt(3.0)*T->HalfWidth, rS=sqrt(3.0)*S->HalfWidth;
+  double kWMax = 0.5*Data->Order, k = abs(Data->k);
+  double MinGap = 0.0;
+  if (TExpansion)
+   { if ( 2.0*k*T->HalfWidth > kWMax ) return false;
+     MinGap = fmax(MinGap, FMM_SEPARATION*rT);
+   };
+  if (SExpansion)
+   { if ( 2.0*k*S->HalfWidth > kWMax ) return false;
+     MinGap = fmax(MinGap, FMM_SEPARATION*rS);
+   };
+
+  double Gap = VecDistance(T->Center, S->Center) - rT - rS;
+  return Gap >= MinGap;
+}
+
+static void GetInteractions(FMMData *Data, int nt, int ns,
+                            FMMPairList *Far, FMMPairList *Near)
+{
+  FMMBox *T=Data->Boxes + nt, *S=Data->Boxes + ns;
+  if (T->NumTargets==0 || S->NumSources==0)
+   return;
+
+  if ( Admissible(Data, T, S) )
+   AddPair(Far, nt, ns);
+  else if ( T->IsLeaf && S->IsLeaf )
+   AddPair(Near, nt, ns);
+  else if ( S->IsLeaf || ( !(T->IsLeaf) && T->HalfWidth >= S->HalfWidth ) )
+   { for(int nc=0; nc<8; nc++)
+      if (T->Child[nc]!=-1)
+       GetInteractions(Data, T->Child[nc], ns, Far, Near);
+   }
+  else
+   { for(int nc=0; nc<8; nc++)
+      if (S->Child[nc]!=-1)
+       GetInteractions(Data, nt, S->Child[nc], Far, Near);
+   };
+}
+
+// group a list of (target,source) pairs by target box
+static void GroupPairs(FMMData *Data, FMMPairList *PL, int **pOffset, int **pList)
+{
+  int *Offset = (int *)mallocEC( (Data->NumBoxes+1)*sizeof(int) );
+  int *List   = (int *)mallocEC( (PL->N + 1)*sizeof(int) );
+  memset(Offset, 0, (Data->NumBoxes+1)*sizeof(int));
+  for(int n=0; n<PL->N; n++)
+   Offset[ PL->Pairs[2*n] + 1 ]++;
+  for(int nb=0; nb<Data->NumBoxes; nb++)
+   Offset[nb+1] += Offset[nb];
+  int *Fill = (int *)memdup(Offset, Data->NumBoxes*sizeof(int));
+  for(int n=0; n<PL->N; n++)
+   List[ Fill[ PL->Pairs[2*n] ]++ ] = PL->Pairs[2*n+1];
+  free(Fill);
+  free(PL->Pairs);
+  *pOffset=Offset;
+  *pList=List;
+}
+
+/***************************************************************/
+/* upward pass: source weights at the Chebyshev nodes of each  */
+/* box, from the source points (leaves) or from the nodes of   */
+/* the children.                                               */
+/***************************************************************/
+static void GetBoxSourceWeights(FMMData *Data, int nb)
+{
+  FMMBox *B=Data->Boxes + nb;
+  int p=Data->Order, NumNodes=Data->NumNodes;
+  B->M = (cdouble *)mallocEC(NumNodes*NUMQ*sizeof(cdouble));
+  memset(B->M, 0, NumNodes*NUMQ*sizeof(cdouble));
+
+  double S[3*MAXORDER];
+  if (B->IsLeaf)
+   { for(int ns=B->SourceOffset; ns<B->SourceOffset+B->NumSources; ns++)
+      { GetInterpWeights(Data, B, Data->Y + 3*ns, S);
+        cdouble *Q=Data->Q + NUMQ*ns;
+        for(int nn=0; nn<NumNodes; nn++)
+         { double W = S[nn%p] * S[p + (nn/p)%p] * S[2*p + nn/(p*p)];
+           for(int nq=0; nq<NUMQ; nq++)
+            B->M[NUMQ*nn + nq] += W*Q[nq];
+         };
+      };
+   }
+  else
+   { for(int nc=0; nc<8; nc++)
+      { if (B->Child[nc]==-1) continue;
+        FMMBox *C=Data->Boxes + B->Child[nc];
+        if (C->NumSources==0) continue;
+        for(int ncn=0; ncn<NumNodes; ncn++)
+         { double XC[3];
+           GetNodeCoordinates(Data, C, ncn, XC);
+           GetInterpWeights(Data, B, XC, S);
+           cdouble *Q=C->M + NUMQ*ncn;
+           for(int nn=0; nn<NumNodes; nn++)
+            { double W = S[nn%p] * S[p + (nn/p)%p] * S[2*p + nn/(p*p)];
+              for(int nq=0; nq<NUMQ; nq++)
+               B->M[NUMQ*nn + nq] += W*Q[nq];
+            };
+         };
+      };
+   };
+
+  for(int nc=0; nc<8; nc++)
+   if (B->Child[nc]!=-1 && Data->Boxes[B->Child[nc]].NumSources>0)
+    B->MaxEdgeRadius = fmax(B->MaxEdgeRadius, Data->Boxes[B->Child[nc]].MaxEdgeRadius);
+}
+
+/***************************************************************/
+/* far-field interactions for target box nt: each source box   */
+/* on its far list acts through its nodes (or its source       */
+/* points, if there are fewer of them), and the fields are     */
+/* accumulated at the nodes of the target box (or directly at  */
+/* its target points, if there are fewer of them).             */
+/***************************************************************/
+static void AddFarFields(FMMData *Data, int nt, double *Buffer)
+{
+  FMMBox *T=Data->Boxes + nt;
+  int NumNodes=Data->NumNodes;
+
+  bool TExpansion = UsesExpansion(Data, T, T->NumTargets);
+  double *XT;
+  cdouble *EHT;
+  int NXT;
+  if (TExpansion)
+   { XT=Buffer;
+     GetNodePoints(Data, T, XT);
+     NXT=NumNodes;
+     T->L = (cdouble *)mallocEC(NumNodes*NUMFIELDS*sizeof(cdouble));
+     memset(T->L, 0, NumNodes*NUMFIELDS*sizeof(cdouble));
+     EHT=T->L;
+   }
+  else
+   { XT  = Data->X + 3*T->TargetOffset;
+     EHT = Data->EH + NUMFIELDS*T->TargetOffset;
+     NXT = T->NumTargets;
+   };
+
+  double *YNodes = Buffer + 3*NumNodes;
+  for(int nf=Data->FarOffset[nt]; nf<Data->FarOffset[nt+1]; nf++)
+   { FMMBox *S=Data->Boxes + Data->FarList[nf];
+     double *YS;
+     cdouble *QS;
+     int NYS;
+     if ( UsesExpansion(Data, S, S->NumSources) )
+      { GetNodePoints(Data, S, YNodes);
+        YS=YNodes;
+        QS=S->M;
+        NYS=NumNodes;
+      }
+     else
+      { YS  = Data->Y + 3*S->SourceOffset;
+        QS  = Data->Q + NUMQ*S->SourceOffset;
+        NYS = S->NumSources;
+      };
+
+     for(int nx=0; nx<NXT; nx++)
+      for(int ny=0; ny<NYS; ny++)
+       AddFields(Data, YS + 3*ny, QS + NUMQ*ny, XT + 3*nx, EHT + NUMFIELDS*nx);
+   };
+}
+
+/***************************************************************/
+/* downward pass: interpolate the fields at the nodes of box   */
+/* nb to the nodes of its children (or, for leaves, to its     */
+/* target points).                                             */
+/***************************************************************/
+static void InterpolateFields(FMMData *Data, FMMBox *B, int NX, double *X, cdouble *EH)
+{
+  int p=Data->Order, NumNodes=Data->NumNodes;
+  double S[3*MAXORDER];
+  for(int nx=0; nx<NX; nx++)
+   { GetInterpWeights(Data, B, X + 3*nx, S);
+     for(int nn=0; nn<NumNodes; nn++)
+      { double W = S[nn%p] * S[p + (nn/p)%p] * S[2*p + nn/(p*p)];
+        for(int Mu=0; Mu<NUMFIELDS; Mu++)
+         EH[NUMFIELDS*nx + Mu] += W*B->L[NUMFIELDS*nn + Mu];
+      };
+   };
+}
+
+static void PassFieldsDown(FMMData *Data, int nb, double *Buffer)
+{
+  FMMBox *B=Data->Boxes + nb;
+  if (B->L==0)
+   return;
+
+  if (B->IsLeaf)
+   { InterpolateFields(Data, B, B->NumTargets, Data->X + 3*B->TargetOffset,
+                       Data->EH + NUMFIELDS*B->TargetOffset);
+     return;
+   };
+
+  int NumNodes=Data->NumNodes;
+  for(int nc=0; nc<8; nc++)
+   { if (B->Child[nc]==-1) continue;
+     FMMBox *C=Data->Boxes + B->Child[nc];
+     if (C->NumTargets==0) continue;
+     if ( UsesExpansion(Data, C, C->NumTargets) )
+      { if (C->L==0)
+         { C->L = (cdouble *)mallocEC(NumNodes*NUMFIELDS*sizeof(cdouble));
+           memset(C->L, 0, NumNodes*NUMFIELDS*sizeof(cdouble));
+         };
+        GetNodePoints(Data, C, Buffer);
+        InterpolateFields(Data, B, NumNodes, Buffer, C->L);
+      }
+     else
+      InterpolateFields(Data, B, C->NumTargets, Data->X + 3*C->TargetOffset,
+                        Data->EH + NUMFIELDS*C->TargetOffset);
+   };
+}
+
+/***************************************************************/
+/* near-field interactions for the targets in leaf box nt:     */
+/* direct summation over the source points in nearby leaves    */
+/***************************************************************/
+static void AddNearFields(FMMData *Data, int nt)
+{
+  FMMBox *T=Data->Boxes + nt;
+  for(int nx=T->TargetOffset; nx<T->TargetOffset+T->NumTargets; nx++)
+   for(int nn=Data->NearOffset[nt]; nn<Data->NearOffset[nt+1]; nn++)
+    { FMMBox *S=Data->Boxes + Data->NearList[nn];
+      for(int ny=S->SourceOffset; ny<S->SourceOffset+S->NumSources; ny++)
+       AddFields(Data, Data->Y + 3*ny, Data->Q + NUMQ*ny,
+                 Data->X + 3*nx, Data->EH + NUMFIELDS*nx);
+    };
+}
+
+/***************************************************************/
+/* find the basis functions with rRel below the outer          */
+/* threshold at point X by descending the tree from box nb,    */
+/* skipping boxes too far from X to contain points of any such */
+/* basis function.                                             */
+/***************************************************************/
+static void GetNearEdges(FMMData *Data, int nb, const double X[3],
+                         int **pNearEdges, int *pNumNearEdges, int *pMaxNearEdges)
+{
+  FMMBox *B=Data->Boxes + nb;
+  if (B->NumSources==0)
+   return;
+
+  double Threshold=Data->rRelOuterThreshold;
+  double D2=0.0;
+  for(int Mu=0; Mu<3; Mu++)
+   { double d = fabs(X[Mu] - B->Center[Mu]) - B->HalfWidth;
+     if (d>0.0) D2+=d*d;
+   };
+  double DMax = (Threshold + 1.0)*B->MaxEdgeRadius;
+  if ( D2 >= DMax*DMax )
+   return;
+
+  if (!B->IsLeaf)
+   { for(int nc=0; nc<8; nc++)
+      if (B->Child[nc]!=-1)
+       GetNearEdges(Data, B->Child[nc], X, pNearEdges, pNumNearEdges, pMaxNearEdges);
+     return;
+   };
+
+  for(int ny=B->SourceOffset; ny<B->SourceOffset+B->NumSources; ny++)
+   {
+     int neFull=Data->SourceEdge[ny];
+     double *CR=Data->EdgeCR + 4*neFull;
+     if ( VecDistance(X, CR) >= Threshold*CR[3] )
+      continue;
+
+     int nne;
+     for(nne=0; nne<*pNumNearEdges; nne++)
+      if ( (*pNearEdges)[nne]==neFull )
+       break;
+     if (nne<*pNumNearEdges)
+      continue;
+     if (*pNumNearEdges==*pMaxNearEdges)
+      { *pMaxNearEdges *= 2;
+        *pNearEdges = (int *)reallocEC(*pNearEdges, (*pMaxNearEdges)*sizeof(int));
+      };
+     (*pNearEdges)[(*pNumNearEdges)++]=neFull;
+   };
+}
+
+/***************************************************************/
+/* near-edge corrections at target nx: for each basis function */
+/* near the target, subtract the low-order contribution that   */
+/* was included in the far- and near-field sums and add the    */
+/* reduced fields computed as in GetRFMatrix.                  */
+/***************************************************************/
+static void AddNearEdgeCorrections(FMMData *Data, int nx,
+                                   int **pNearEdges, int *pMaxNearEdges)
+{
+  RWGGeometry *G=Data->G;
+  double *X   = Data->X + 3*nx;
+  cdouble *EH = Data->EH + NUMFIELDS*nx;
+
+  int NumNearEdges=0;
+  GetNearEdges(Data, 0, X, pNearEdges, &NumNearEdges, pMaxNearEdges);
+
+  cdouble k=Data->k, ZRel=Data->ZRel;
+  for(int nne=0; nne<NumNearEdges; nne++)
+   { int neFull=(*pNearEdges)[nne];
+
+     cdouble LowOrder[NUMFIELDS]={0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+     for(int ny=Data->EdgeOffset[neFull]; ny<Data->EdgeOffset[neFull+1]; ny++)
+      AddFields(Data, Data->EdgeY + 3*ny, Data->EdgeQ + NUMQ*ny, X, LowOrder);
+
+     int ns, ne, nbf;
+     RWGSurface *S = G->ResolveEdge(neFull, &ns, &ne, &nbf);
+     double Sign = (S->RegionIndices[0]==Data->RegionIndex) ? 1.0 : -1.0;
+
+     cdouble GC[6];
+     GetEdgeReducedFields(G, ns, ne, X, k, 0, Data->Options, GC);
+     cdouble *GG=GC+0, *CC=GC+3;
+
+     cdouble KAlpha = Data->KN[nbf];
+     cdouble NAlpha = S->IsPEC ? 0.0 : Data->KN[nbf+1];
+     cdouble EKFactor =      Sign*II*k*ZRel*ZVAC;
+     cdouble HKFactor = -1.0*Sign*II*k;
+     cdouble ENFactor = -1.0*Sign*II*k*ZVAC;
+     cdouble HNFactor = -1.0*Sign*II*k/ZRel;
+     for(int Mu=0; Mu<3; Mu++)
+      { EH[Mu]   += KAlpha*EKFactor*GG[Mu] + NAlpha*ENFactor*CC[Mu] - LowOrder[Mu];
+        EH[3+Mu] += KAlpha*HKFactor*CC[Mu] + NAlpha*HNFactor*GG[Mu] - LowOrder[3+Mu];
+      };
+   };
+}
+
+/***************************************************************/
+/* collect the low-order cubature points of all basis          */
+/* functions on surfaces bounding region #nr                   */
+/***************************************************************/
+typedef struct SourceCollector
+ { double *Y;
+   cdouble *Q;
+   cdouble KAlpha, NAlpha;
+   int Count;
+ } SourceCollector;
+
+static void CollectSource(double X[3], double b[3], double Divb,
+                          void *UserData, double W, double *Integral)
+{
+  (void) Integral;
+  SourceCollector *SC = (SourceCollector *)UserData;
+  int n=SC->Count++;
+  memcpy(SC->Y + 3*n, X, 3*sizeof(double));
+  cdouble *Q=SC->Q + NUMQ*n;
+  for(int Mu=0; Mu<3; Mu++)
+   { Q[Mu]   = SC->KAlpha*W*b[Mu];
+     Q[4+Mu] = SC->NAlpha*W*b[Mu];
+   };
+  Q[3] = SC->KAlpha*W*Divb;
+  Q[7] = SC->NAlpha*W*Divb;
+}
+
+static void GetSources(RWGGeometry *G, int nr, cdouble *KN, int Order, FMMData *Data)
+{
+  int NumPts;
+  if ( GetTCR(Order, &NumPts)==0 )
+   ErrExit("invalid cubature order %i in GetFieldsFMM",Order);
+
+  int NE=G->TotalEdges;
+  int *Offset = (int *)mallocEC( (NE+1)*sizeof(int) );
+  Offset[0]=0;
+  for(int neFull=0; neFull<NE; neFull++)
+   { int ns, ne;
+     RWGSurface *S=G->ResolveEdge(neFull, &ns, &ne, 0);
+     int Count=0;
+     if ( S->RegionIndices[0]==nr || S->RegionIndices[1]==nr )
+      Count = NumPts * ( (S->Edges[ne]->iQM==-1) ? 1 : 2 );
+     Offset[neFull+1] = Offset[neFull] + Count;
+   };
+
+  int NS = Data->NS = Offset[NE];
+  Data->Y          = (double *)mallocEC(3*NS*sizeof(double));
+  Data->Q          = (cdouble *)mallocEC(NUMQ*NS*sizeof(cdouble));
+  Data->SourceEdge = (int *)mallocEC(NS*sizeof(int));
+
+#ifdef USE_OPENMP
+  int NumThreads=GetNumThreads();
+#pragma omp parallel for schedule(dynamic,64), num_threads(NumThreads)
+#endif
+  for(int neFull=0; neFull<NE; neFull++)
+   { if (Offset[neFull+1]==Offset[neFull]) continue;
+     int ns, ne, nbf;
+     RWGSurface *S=G->ResolveEdge(neFull, &ns, &ne, &nbf);
+     double Sign = (S->RegionIndices[0]==nr) ? 1.0 : -1.0;
+
+     SourceCollector SC;
+     SC.Y      = Data->Y + 3*Offset[neFull];
+     SC.Q      = Data->Q + NUMQ*Offset[neFull];
+     SC.KAlpha = Sign*KN[nbf];
+     SC.NAlpha = S->IsPEC ? 0.0 : Sign*KN[nbf+1];
+     SC.Count  = 0;
+     double Dummy;
+     GetBFCubature2(G, ns, ne, CollectSource, (void *)&SC, 0, Order, &Dummy);
+     for(int n=Offset[neFull]; n<Offset[neFull+1]; n++)
+      Data->SourceEdge[n]=neFull;
+   };
+  Data->EdgeOffset=Offset;
+}
+
+/***************************************************************/
+/* add the scattered fields at the points in XMatrix due to    */
+/* the surface currents described by KN into FMatrix.          */
+/***************************************************************/
+void RWGGeometry::GetFieldsFMM(HVector *KN, cdouble Omega,
+                               HMatrix *XMatrix, HMatrix *FMatrix)
+{
+  if (LBasis)
+   ErrExit("%s:%i: FMM field evaluation not available for periodic geometries",__FILE__,__LINE__);
+
+  int NX=XMatrix->NR;
+  int Order=FMMOrder;
+  if (Order<2) Order=2;
+  if (Order>MAXORDER) Order=MAXORDER;
+
+  RFCubatureOptions Options;
+  GetRFCubatureOptions(&Options);
+
+  int NumThreads=1;
+#ifdef USE_OPENMP
+  NumThreads=GetNumThreads();
+#endif
+  if (LogLevel>=SCUFF_VERBOSELOGGING)
+   Log("Computing fields at %i points by FMM (order %i, %i threads)",NX,Order,NumThreads);
+
+  /***************************************************************/
+  /* assign evaluation points to regions                         */
+  /***************************************************************/
+  int *XRegion = (int *)mallocEC(NX*sizeof(int));
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,256), num_threads(NumThreads)
+#endif
+  for(int nx=0; nx<NX; nx++)
+   { double X[3];
+     X[0]=XMatrix->GetEntryD(nx,0);
+     X[1]=XMatrix->GetEntryD(nx,1);
+     X[2]=XMatrix->GetEntryD(nx,2);
+     XRegion[nx]=GetRegionIndex(X);
+   };
+
+  double *EdgeCR = (double *)mallocEC(4*TotalEdges*sizeof(double));
+  for(int neFull=0; neFull<TotalEdges; neFull++)
+   { int ns, ne;
+     RWGEdge *E = ResolveEdge(neFull, &ns, &ne, 0)->Edges[ne];
+     memcpy(EdgeCR + 4*neFull, E->Centroid, 3*sizeof(double));
+     EdgeCR[4*neFull + 3] = E->Radius;
+   };
+
+  /***************************************************************/
+  /* separate multipole calculation for each region              */
+  /***************************************************************/
+  for(int nr=0; nr<NumRegions; nr++)
+   {
+     if ( RegionMPs[nr]->IsPEC() )
+      continue;
+
+     FMMData MyData, *Data=&MyData;
+     memset(Data, 0, sizeof(FMMData));
+
+     Data->NT=0;
+     for(int nx=0; nx<NX; nx++)
+      if (XRegion[nx]==nr)
+       Data->NT++;
+     if (Data->NT==0)
+      continue;
+
+     GetSources(this, nr, KN->ZV, Options.LowOrder, Data);
+     if (Data->NS==0)
+      { free(Data->Y); free(Data->Q); free(Data->SourceEdge); free(Data->EdgeOffset);
+        continue;
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- kernel constants -------------------------------------------*/
+     /*--------------------------------------------------------------*/
+     cdouble EpsRel, MuRel;
+     RegionMPs[nr]->GetEpsMu(Omega, &EpsRel, &MuRel);
+     cdouble ZRel = sqrt(MuRel/EpsRel);
+     cdouble k    = sqrt(MuRel*EpsRel) * Omega;
+     Data->k         = k;
+     Data->ik        = II*k;
+     Data->OneOverK2 = 1.0/(k*k);
+     Data->EKFactor  = II*k*ZRel*ZVAC;
+     Data->HNFactor  = -1.0*II*k/ZRel;
+     Data->ZRel      = ZRel;
+
+     Data->Order    = Order;
+     Data->NumNodes = Order*Order*Order;
+     for(int m=0; m<Order; m++)
+      Data->ChebNodes[m] = cos( (2*m+1)*M_PI/(2.0*Order) );
+
+     Data->G                  = this;
+     Data->RegionIndex        = nr;
+     Data->Options            = &Options;
+     Data->rRelOuterThreshold = Options.rRelOuterThreshold;
+     Data->KN                 = KN->ZV;
+     Data->LeafSize           = 2*Data->NumNodes;
+
+     /*--------------------------------------------------------------*/
+     /*- targets ----------------------------------------------------*/
+     /*--------------------------------------------------------------*/
+     int NT=Data->NT, NS=Data->NS;
+     Data->X         = (double *)mallocEC(3*NT*sizeof(double));
+     Data->TargetRow = (int *)mallocEC(NT*sizeof(int));
+     for(int nx=0, nt=0; nx<NX; nx++)
+      if (XRegion[nx]==nr)
+       { XMatrix->GetEntriesD(nx, "0:2", Data->X + 3*nt);
+         Data->TargetRow[nt++]=nx;
+       };
+
+     /*--------------------------------------------------------------*/
+     /*- build the octree, permuting sources and targets into tree  -*/
+     /*- order                                                      -*/
+     /*--------------------------------------------------------------*/
+     double XMin[3], XMax[3];
+     for(int Mu=0; Mu<3; Mu++)
+      { XMin[Mu]=XMax[Mu]=Data->Y[Mu];
+        for(int n=0; n<NS; n++)
+         { XMin[Mu]=fmin(XMin[Mu], Data->Y[3*n+Mu]);
+           XMax[Mu]=fmax(XMax[Mu], Data->Y[3*n+Mu]);
+         };
+        for(int n=0; n<NT; n++)
+         { XMin[Mu]=fmin(XMin[Mu], Data->X[3*n+Mu]);
+           XMax[Mu]=fmax(XMax[Mu], Data->X[3*n+Mu]);
+         };
+      };
+     double Center[3], HalfWidth=0.0;
+     for(int Mu=0; Mu<3; Mu++)
+      { Center[Mu] = 0.5*(XMin[Mu] + XMax[Mu]);
+        HalfWidth  = fmax(HalfWidth, 0.5*(XMax[Mu]-XMin[Mu]));
+      };
+     HalfWidth *= 1.0 + 1.0e-8;
+     if (HalfWidth==0.0) HalfWidth=1.0;
+
+     Data->EdgeY = (double *)memdup(Data->Y, 3*NS*sizeof(double));
+     int *SourceOrder = (int *)mallocEC(NS*sizeof(int));
+     int *TargetOrder = (int *)mallocEC(NT*sizeof(int));
+     for(int n=0; n<NS; n++) SourceOrder[n]=n;
+     for(int n=0; n<NT; n++) TargetOrder[n]=n;
+
+     Data->MaxBoxes=1024;
+     Data->Boxes = (FMMBox *)mallocEC(Data->MaxBoxes*sizeof(FMMBox));
+     Data->NumBoxes=0;
+     AddBox(Data, Center, HalfWidth, 0);
+     Data->Boxes[0].SourceOffset=0; Data->Boxes[0].NumSources=NS;
+     Data->Boxes[0].TargetOffset=0; Data->Boxes[0].NumTargets=NT;
+     SubdivideBox(Data, 0, SourceOrder, TargetOrder);
+
+     // SubdivideBox permuted the point coordinates; permute the
+     // remaining per-point arrays to match, retaining the original
+     // (edge-ordered) arrays for the near-edge corrections
+     cdouble *Q = (cdouble *)mallocEC(NUMQ*NS*sizeof(cdouble));
+     int *SourceEdge = (int *)mallocEC(NS*sizeof(int));
+     for(int n=0; n<NS; n++)
+      { memcpy(Q + NUMQ*n, Data->Q + NUMQ*SourceOrder[n], NUMQ*sizeof(cdouble));
+        SourceEdge[n]=Data->SourceEdge[SourceOrder[n]];
+      };
+     Data->EdgeQ=Data->Q; Data->Q=Q;
+     free(Data->SourceEdge); Data->SourceEdge=SourceEdge;
+     int *TargetRow = (int *)mallocEC(NT*sizeof(int));
+     for(int n=0; n<NT; n++)
+      TargetRow[n]=Data->TargetRow[TargetOrder[n]];
+     free(Data->TargetRow); Data->TargetRow=TargetRow;
+     free(SourceOrder);
+     free(TargetOrder);
+
+     Data->EH = (cdouble *)mallocEC(NUMFIELDS*NT*sizeof(cdouble));
+     memset(Data->EH, 0, NUMFIELDS*NT*sizeof(cdouble));
+
+     // leaf-level edge radii
+     Data->EdgeCR=EdgeCR;
+     for(int nb=0; nb<Data->NumBoxes; nb++)
+      { FMMBox *B=Data->Boxes + nb;
+        if (!B->IsLeaf) continue;
+        for(int ns=B->SourceOffset; ns<B->SourceOffset+B->NumSources; ns++)
+         B->MaxEdgeRadius = fmax(B->MaxEdgeRadius, EdgeCR[4*Data->SourceEdge[ns] + 3]);
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- upward pass, one level at a time from the bottom           -*/
+     /*--------------------------------------------------------------*/
+     int MaxLevel=0;
+     for(int nb=0; nb<Data->NumBoxes; nb++)
+      MaxLevel = (Data->Boxes[nb].Level > MaxLevel) ? Data->Boxes[nb].Level : MaxLevel;
+     for(int Level=MaxLevel; Level>=0; Level--)
+      {
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+        for(int nb=0; nb<Data->NumBoxes; nb++)
+         if (Data->Boxes[nb].Level==Level && Data->Boxes[nb].NumSources>0)
+          GetBoxSourceWeights(Data, nb);
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- interaction lists                                          -*/
+     /*--------------------------------------------------------------*/
+     FMMPairList Far={0,0,0}, Near={0,0,0};
+     GetInteractions(Data, 0, 0, &Far, &Near);
+     int NumFar=Far.N, NumNear=Near.N;
+     GroupPairs(Data, &Far, &(Data->FarOffset), &(Data->FarList));
+     GroupPairs(Data, &Near, &(Data->NearOffset), &(Data->NearList));
+     if (LogLevel>=SCUFF_VERBOSE2)
+      Log(" region %i: %i sources, %i targets, %i boxes, %i far / %i near pairs",
+          nr,NS,NT,Data->NumBoxes,NumFar,NumNear);
+
+     /*--------------------------------------------------------------*/
+     /*- far interactions                                           -*/
+     /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+#pragma omp parallel num_threads(NumThreads)
+#endif
+      { double *Buffer = (double *)mallocEC(6*Data->NumNodes*sizeof(double));
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+        for(int nb=0; nb<Data->NumBoxes; nb++)
+         if (Data->FarOffset[nb+1] > Data->FarOffset[nb])
+          AddFarFields(Data, nb, Buffer);
+        free(Buffer);
+      }
+
+     /*--------------------------------------------------------------*/
+     /*- downward pass                                              -*/
+     /*--------------------------------------------------------------*/
+     for(int Level=0; Level<=MaxLevel; Level++)
+      {
+#ifdef USE_OPENMP
+#pragma omp parallel num_threads(NumThreads)
+#endif
+         { double *Buffer = (double *)mallocEC(3*Data->NumNodes*sizeof(double));
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+           for(int nb=0; nb<Data->NumBoxes; nb++)
+            if (Data->Boxes[nb].Level==Level)
+             PassFieldsDown(Data, nb, Buffer);
+           free(Buffer);
+         }
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- near interactions                                          -*/
+     /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
+#endif
+     for(int nb=0; nb<Data->NumBoxes; nb++)
+      if (Data->NearOffset[nb+1] > Data->NearOffset[nb])
+       AddNearFields(Data, nb);
+
+     /*--------------------------------------------------------------*/
+     /*- corrections for basis functions near the targets           -*/
+     /*--------------------------------------------------------------*/
+#ifdef USE_OPENMP
+#pragma omp parallel num_threads(NumThreads)
+#endif
+      { int MaxNearEdges=64;
+        int *NearEdges=(int *)mallocEC(MaxNearEdges*sizeof(int));
+#ifdef USE_OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for(int nt=0; nt<NT; nt++)
+         AddNearEdgeCorrections(Data, nt, &NearEdges, &MaxNearEdges);
+        free(NearEdges);
+      }
+
+     /*--------------------------------------------------------------*/
+     /*- accumulate into the output matrix and clean up             -*/
+     /*--------------------------------------------------------------*/
+     for(int nt=0; nt<NT; nt++)
+      for(int Mu=0; Mu<NUMFIELDS; Mu++)
+       FMatrix->AddEntry(Data->TargetRow[nt], Mu, Data->EH[NUMFIELDS*nt + Mu]);
+
+     for(int nb=0; nb<Data->NumBoxes; nb++)
+      { if (Data->Boxes[nb].M) free(Data->Boxes[nb].M);
+        if (Data->Boxes[nb].L) free(Data->Boxes[nb].L);
+      };
+     free(Data->Boxes);
+     free(Data->FarOffset);
+     free(Data->FarList);
+     free(Data->NearOffset);
+     free(Data->NearList);
+     free(Data->Y);
+     free(Data->Q);
+     free(Data->SourceEdge);
+     free(Data->EdgeY);
+     free(Data->EdgeQ);
+     free(Data->EdgeOffset);
+     free(Data->X);
+     free(Data->TargetRow);
+     free(Data->EH);
+   };
+
+  free(XRegion);
+  free(EdgeCR);
+}
+
+} // namespace scuff
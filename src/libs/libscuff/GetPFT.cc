@@ -50,7 +50,8 @@ void GetOPFT(RWGGeometry *G, int SurfaceIndex, cdouble Omega,
 HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega,
                             IncField *IF,
                             HVector *KNVector, HMatrix *DRMatrix=0,
-                            HMatrix *PFTMatrix=0, bool Itemize=false);
+                            HMatrix *PFTMatrix=0, bool Itemize=false,
+                            Workspace *WS=0);
 
 // PFT by displaced-surface-integral method
 void GetDSIPFT(RWGGeometry *G, cdouble Omega, double *kBloch,
@@ -64,13 +65,15 @@ void GetDSIPFTTrace(RWGGeometry *G, cdouble Omega, HMatrix *DRMatrix,
                     double PFT[NUMPFT], bool NeedQuantity[NUMPFT],
                     char *BSMesh, double R, int NumPoints,
                     bool FarField, char *PlotFileName,
-                    GTransformation *GT1, GTransformation *GT2);
+                    GTransformation *GT1, GTransformation *GT2,
+                    Workspace *WS=0);
 
 // PFT by energy/momentum transfer method
 HMatrix *GetEMTPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
                          HVector *KNVector, HMatrix *DRMatrix,
                          HMatrix *PFTMatrix, bool Interior,
-                         int EMTPFTIMethod, bool Itemize=false);
+                         int EMTPFTIMethod, bool Itemize=false,
+                         Workspace *WS=0);
 
 /***************************************************************/
 /***************************************************************/
@@ -191,12 +194,13 @@ void RWGGeometry::GetPFT(int SurfaceIndex, HVector *KN,
       GetDSIPFTTrace(this, Omega, DRMatrix,
                      PFT, NeedQuantity,
                      DSIMesh, DSIRadius, DSIPoints,
-                     DSIFarField, FluxFileName, GT1, GT2);
+                     DSIFarField, FluxFileName, GT1, GT2, Options->WS);
    }
   else if (PFTMethod==SCUFF_PFT_MOMENTS)
    { 
      HMatrix *PFTMatrix 
-      = GetMomentPFTMatrix(this, Omega, IF, KN, DRMatrix);
+      = GetMomentPFTMatrix(this, Omega, IF, KN, DRMatrix,
+                           0, false, Options->WS);
      PFTMatrix->GetEntriesD(SurfaceIndex, ":", PFT);
      delete PFTMatrix;
    }
@@ -205,7 +209,8 @@ void RWGGeometry::GetPFT(int SurfaceIndex, HVector *KN,
      bool Interior      = Options->Interior;
      int  Method        = Options->EMTPFTIMethod;  
      HMatrix *PFTMatrix 
-      = GetEMTPFTMatrix(this, Omega, IF, KN, DRMatrix, 0, Interior, Method);
+      = GetEMTPFTMatrix(this, Omega, IF, KN, DRMatrix, 0, Interior, Method,
+                        false, Options->WS);
      PFTMatrix->GetEntriesD(SurfaceIndex, ":", PFT);
      delete PFTMatrix;
    };
@@ -269,11 +274,13 @@ HMatrix *RWGGeometry::GetPFTMatrix(HVector *KN, cdouble Omega,
   if (Options->PFTMethod==SCUFF_PFT_EMT)
    { 
      GetEMTPFTMatrix(this, Omega, IF, KN, DRMatrix,
-                     PFTMatrix, Options->Interior, Options->EMTPFTIMethod);
+                     PFTMatrix, Options->Interior, Options->EMTPFTIMethod,
+                     false, Options->WS);
    }
   else if (Options->PFTMethod==SCUFF_PFT_MOMENTS)
    { 
-     GetMomentPFTMatrix(this, Omega, IF, KN, DRMatrix, PFTMatrix);
+     GetMomentPFTMatrix(this, Omega, IF, KN, DRMatrix, PFTMatrix,
+                        false, Options->WS);
    }
   else
    { 
@@ -324,6 +331,8 @@ PFTOptions *InitPFTOptions(PFTOptions *Options)
 
   Options->GetRegionPFTs=false;
 
+  Options->WS=0;
+
   return Options;
 }
 
@@ -0,0 +1,461 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * KrylovSolver.cc -- restarted GMRES and BiCGStab solvers for the BEM
+ *                 -- system, right-preconditioned by the inverses of
+ *                 -- the diagonal (single-surface) blocks of the matrix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include <libhmat.h>
+
+#include "libscuff.h"
+
+namespace scuff {
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int ParseSolverName(const char *Name)
+{
+  if ( !strcasecmp(Name,"LU") )
+   return SCUFF_SOLVER_LU;
+  else if ( !strcasecmp(Name,"GMRES") )
+   return SCUFF_SOLVER_GMRES;
+  else if ( !strcasecmp(Name,"BiCGStab") )
+   return SCUFF_SOLVER_BICGSTAB;
+  return -1;
+}
+
+/***************************************************************/
+/* vector helpers **********************************************/
+/***************************************************************/
+static double Norm(HVector *X)
+{ double Sum=0.0;
+  for(int n=0; n<X->N; n++)
+   Sum+=norm(X->ZV[n]);
+  return sqrt(Sum);
+}
+
+// returns X^\dagger * Y
+static cdouble Dot(HVector *X, HVector *Y)
+{ cdouble Sum=0.0;
+  for(int n=0; n<X->N; n++)
+   Sum+=conj(X->ZV[n])*Y->ZV[n];
+  return Sum;
+}
+
+// Y += Alpha*X
+static void AXPY(cdouble Alpha, HVector *X, HVector *Y)
+{ for(int n=0; n<X->N; n++)
+   Y->ZV[n]+=Alpha*X->ZV[n];
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+KrylovSolver::KrylovSolver(RWGGeometry *pG, int pMethod,
+                           double pTolerance, int pMaxIters, int pRestart)
+{
+  G         = pG;
+  Method    = pMethod;
+  Tolerance = pTolerance;
+  MaxIters  = pMaxIters;
+  Restart   = pRestart;
+
+  if (Method!=SCUFF_SOLVER_GMRES && Method!=SCUFF_SOLVER_BICGSTAB)
+   ErrExit("%s:%i: unknown iterative solver type %i",__FILE__,__LINE__,Method);
+
+  char *s;
+  if ( (s=getenv("SCUFF_SOLVER_TOLERANCE")) )
+   { sscanf(s,"%le",&Tolerance);
+     Log("Setting iterative solver tolerance to %e.",Tolerance);
+   };
+  if ( (s=getenv("SCUFF_SOLVER_MAXITERS")) )
+   { sscanf(s,"%i",&MaxIters);
+     Log("Setting iterative solver max iterations to %i.",MaxIters);
+   };
+  if ( (s=getenv("SCUFF_SOLVER_RESTART")) )
+   { sscanf(s,"%i",&Restart);
+     Log("Setting GMRES restart length to %i.",Restart);
+   };
+  if (Restart<1) Restart=1;
+
+  int N=G->TotalBFs;
+  for(int nw=0; nw<9; nw++)
+   Work[nw]=new HVector(N, LHM_COMPLEX);
+  Basis = (Method==SCUFF_SOLVER_GMRES) ? new HMatrix(N, Restart+1, LHM_COMPLEX) : 0;
+
+  // identical surfaces share preconditioner blocks
+  PBlocks=(HMatrix **)mallocEC(G->NumSurfaces*sizeof(HMatrix *));
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   { int NBF=G->Surfaces[ns]->NumBFs;
+     PBlocks[ns] = (G->Mate[ns]==-1) ? new HMatrix(NBF, NBF, LHM_COMPLEX) : 0;
+   };
+
+  M=0;
+  A=0;
+  NumIterations=0;
+  Residual=0.0;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+KrylovSolver::~KrylovSolver()
+{
+  for(int nw=0; nw<9; nw++)
+   delete Work[nw];
+  if (Basis) delete Basis;
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   if (PBlocks[ns]) delete PBlocks[ns];
+  free(PBlocks);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void KrylovSolver::FactorizePreconditioner()
+{
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   if (PBlocks[ns])
+    PBlocks[ns]->LUFactorize();
+}
+
+void KrylovSolver::SetMatrix(HMatrix *pM)
+{
+  if ( pM->NR!=G->TotalBFs || pM->NC!=G->TotalBFs )
+   ErrExit("%s:%i: matrix has wrong size for KrylovSolver",__FILE__,__LINE__);
+  if ( pM->RealComplex!=LHM_COMPLEX || pM->StorageType!=LHM_NORMAL )
+   ErrExit("%s:%i: iterative solvers require unpacked complex matrices",__FILE__,__LINE__);
+  M=pM;
+  A=0;
+
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   if (PBlocks[ns])
+    { int Offset=G->BFIndexOffset[ns];
+      M->ExtractBlock(Offset, Offset, PBlocks[ns]);
+    };
+  FactorizePreconditioner();
+}
+
+void KrylovSolver::SetMatrix(ACAMatrix *pA, cdouble Omega)
+{
+  M=0;
+  A=pA;
+
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   if (PBlocks[ns])
+    G->AssembleBEMMatrixBlock(ns, ns, Omega, 0, PBlocks[ns]);
+  FactorizePreconditioner();
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+void KrylovSolver::ApplyMatrix(HVector *X, HVector *Y)
+{
+  if (A)
+   A->Apply(X,Y);
+  else if (M)
+   M->Apply(X,Y);
+  else
+   ErrExit("%s:%i: KrylovSolver::Solve called before SetMatrix",__FILE__,__LINE__);
+}
+
+// X -> P^{-1} X, where P = block-diagonal part of the BEM matrix
+void KrylovSolver::ApplyPreconditioner(HVector *X)
+{
+  for(int ns=0; ns<G->NumSurfaces; ns++)
+   { int Mate=G->Mate[ns];
+     HMatrix *P = PBlocks[ Mate==-1 ? ns : Mate ];
+     HVector XBlock(P->NR, LHM_COMPLEX, X->ZV + G->BFIndexOffset[ns]);
+     P->LUSolve(&XBlock);
+   };
+}
+
+/***************************************************************/
+/* restarted GMRES with right preconditioning; on entry X is   */
+/* the RHS vector, on return the solution.                     */
+/***************************************************************/
+int KrylovSolver::GMRES(HVector *X)
+{
+  int N=X->N;
+  HVector *B=Work[0], *XX=Work[1], *R=Work[2];
+  B->Copy(X);
+  XX->Zero();
+
+  double BNorm=Norm(B);
+  NumIterations=0;
+  Residual=0.0;
+  if (BNorm==0.0)
+   { X->Zero();
+     return 0;
+   };
+
+  int m=Restart;
+  cdouble *H  = new cdouble[(m+1)*m];    // H[i + j*(m+1)]
+  cdouble *g  = new cdouble[m+1];
+  cdouble *sn = new cdouble[m];
+  double  *cs = new double[m];
+  cdouble *y  = new cdouble[m];
+
+  bool Converged=false;
+  while( !Converged && NumIterations<MaxIters )
+   {
+     /*--------------------------------------------------------------*/
+     /*- R = B - M*XX, first basis vector = R / |R|                 -*/
+     /*--------------------------------------------------------------*/
+     ApplyMatrix(XX, R);
+     for(int n=0; n<N; n++)
+      R->ZV[n] = B->ZV[n] - R->ZV[n];
+     double Beta=Norm(R);
+     Residual=Beta/BNorm;
+     if (Residual<=Tolerance)
+      { Converged=true;
+        break;
+      };
+
+     HVector V0(N, LHM_COMPLEX, Basis->ZM);
+     for(int n=0; n<N; n++)
+      V0.ZV[n] = R->ZV[n] / Beta;
+     g[0]=Beta;
+     for(int i=1; i<=m; i++) g[i]=0.0;
+
+     /*--------------------------------------------------------------*/
+     /*- Arnoldi iteration                                          -*/
+     /*--------------------------------------------------------------*/
+     int k=0;
+     for(int j=0; j<m && NumIterations<MaxIters; j++)
+      {
+        HVector Vj(N, LHM_COMPLEX, Basis->ZM + j*N);
+        HVector W(N, LHM_COMPLEX, Basis->ZM + (j+1)*N);
+        R->Copy(&Vj);
+        ApplyPreconditioner(R);
+        ApplyMatrix(R, &W);
+
+        // modified Gram-Schmidt
+        for(int i=0; i<=j; i++)
+         { HVector Vi(N, LHM_COMPLEX, Basis->ZM + i*N);
+           H[i + j*(m+1)] = Dot(&Vi, &W);
+           AXPY(-H[i + j*(m+1)], &Vi, &W);
+         };
+        double HNext=Norm(&W);
+        H[(j+1) + j*(m+1)]=HNext;
+        if (HNext!=0.0)
+         for(int n=0; n<N; n++)
+          W.ZV[n]/=HNext;
+
+        // apply previous Givens rotations to the new column
+        for(int i=0; i<j; i++)
+         { cdouble Hi=H[i + j*(m+1)], Hip1=H[(i+1) + j*(m+1)];
+           H[i + j*(m+1)]     =  cs[i]*Hi + sn[i]*Hip1;
+           H[(i+1) + j*(m+1)] = -conj(sn[i])*Hi + cs[i]*Hip1;
+         };
+
+        // compute a new rotation to annihilate H[j+1,j]
+        cdouble a=H[j + j*(m+1)], b=H[(j+1) + j*(m+1)];
+        double aAbs=abs(a), t=sqrt(norm(a) + norm(b));
+        if (aAbs==0.0)
+         { cs[j]=0.0; sn[j]=1.0; }
+        else
+         { cs[j]=aAbs/t; sn[j]=(a/aAbs)*conj(b)/t; };
+        H[j + j*(m+1)]     = cs[j]*a + sn[j]*b;
+        H[(j+1) + j*(m+1)] = 0.0;
+        g[j+1] = -conj(sn[j])*g[j];
+        g[j]   = cs[j]*g[j];
+
+        NumIterations++;
+        k=j+1;
+        Residual=abs(g[j+1])/BNorm;
+        if (G->LogLevel>=SCUFF_VERBOSE2)
+         Log(" GMRES iteration %i: residual %e",NumIterations,Residual);
+        if (Residual<=Tolerance || HNext==0.0)
+         break;
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- solve the upper-triangular system H*y=g and update XX      -*/
+     /*--------------------------------------------------------------*/
+     for(int i=k-1; i>=0; i--)
+      { y[i]=g[i];
+        for(int l=i+1; l<k; l++)
+         y[i]-=H[i + l*(m+1)]*y[l];
+        y[i]/=H[i + i*(m+1)];
+      };
+     R->Zero();
+     for(int i=0; i<k; i++)
+      { HVector Vi(N, LHM_COMPLEX, Basis->ZM + i*N);
+        AXPY(y[i], &Vi, R);
+      };
+     ApplyPreconditioner(R);
+     AXPY(1.0, R, XX);
+
+     if (G->LogLevel>=SCUFF_VERBOSELOGGING)
+      Log(" GMRES restart cycle: %i iterations, residual %e",NumIterations,Residual);
+     if (Residual<=Tolerance)
+      Converged=true;
+   };
+
+  delete[] H;
+  delete[] g;
+  delete[] sn;
+  delete[] cs;
+  delete[] y;
+
+  X->Copy(XX);
+  return Converged ? 0 : 1;
+}
+
+/***************************************************************/
+/* BiCGStab with right preconditioning                         */
+/***************************************************************/
+int KrylovSolver::BiCGStab(HVector *X)
+{
+  int N=X->N;
+  HVector *R=Work[0], *RHat=Work[1], *P=Work[2], *V=Work[3];
+  HVector *S=Work[4], *T=Work[5], *PHat=Work[6], *SHat=Work[7];
+  HVector *XX=Work[8];
+
+  double BNorm=Norm(X);
+  NumIterations=0;
+  Residual=0.0;
+  if (BNorm==0.0)
+   return 0;
+
+  // initial guess XX=0, so the initial residual is the RHS
+  XX->Zero();
+  R->Copy(X);
+  RHat->Copy(X);
+  P->Zero();
+  V->Zero();
+  cdouble Rho=1.0, Alpha=1.0, Omega=1.0;
+
+  bool Converged=false;
+  while( NumIterations<MaxIters )
+   {
+     NumIterations++;
+
+     cdouble RhoNew=Dot(RHat, R);
+     if (RhoNew==0.0)
+      { Warn("BiCGStab breakdown (rho=0) at iteration %i",NumIterations);
+        break;
+      };
+     cdouble Beta=(RhoNew/Rho)*(Alpha/Omega);
+     Rho=RhoNew;
+     for(int n=0; n<N; n++)
+      P->ZV[n] = R->ZV[n] + Beta*(P->ZV[n] - Omega*V->ZV[n]);
+
+     PHat->Copy(P);
+     ApplyPreconditioner(PHat);
+     ApplyMatrix(PHat, V);
+     Alpha=Rho/Dot(RHat, V);
+
+     S->Copy(R);
+     AXPY(-Alpha, V, S);
+     Residual=Norm(S)/BNorm;
+     if (Residual<=Tolerance)
+      { AXPY(Alpha, PHat, XX);
+        Converged=true;
+        break;
+      };
+
+     SHat->Copy(S);
+     ApplyPreconditioner(SHat);
+     ApplyMatrix(SHat, T);
+     double TNorm2=Dot(T,T).real();
+     Omega = (TNorm2==0.0) ? 0.0 : Dot(T,S)/TNorm2;
+
+     AXPY(Alpha, PHat, XX);
+     AXPY(Omega, SHat, XX);
+     R->Copy(S);
+     AXPY(-Omega, T, R);
+
+     Residual=Norm(R)/BNorm;
+     if (G->LogLevel>=SCUFF_VERBOSE2)
+      Log(" BiCGStab iteration %i: residual %e",NumIterations,Residual);
+     if (Residual<=Tolerance)
+      { Converged=true;
+        break;
+      };
+     if (Omega==0.0)
+      { Warn("BiCGStab breakdown (omega=0) at iteration %i",NumIterations);
+        break;
+      };
+   };
+
+  X->Copy(XX);
+  return Converged ? 0 : 1;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int KrylovSolver::Solve(HVector *X)
+{
+  if ( X->N!=G->TotalBFs || X->RealComplex!=LHM_COMPLEX )
+   ErrExit("%s:%i: invalid RHS vector in KrylovSolver::Solve",__FILE__,__LINE__);
+
+  const char *Name = (Method==SCUFF_SOLVER_GMRES) ? "GMRES" : "BiCGStab";
+  double Time=Secs();
+  int Status = (Method==SCUFF_SOLVER_GMRES) ? GMRES(X) : BiCGStab(X);
+  Time=Secs()-Time;
+
+  if (Status==0)
+   Log("%s converged in %i iterations (residual %.2e, %.2f s)",Name,NumIterations,Residual,Time);
+  else
+   Warn("%s did not converge in %i iterations (residual %.2e)",Name,NumIterations,Residual);
+  return Status;
+}
+
+int KrylovSolver::Solve(HMatrix *X)
+{
+  if ( X->NR!=G->TotalBFs || X->RealComplex!=LHM_COMPLEX || X->StorageType!=LHM_NORMAL )
+   ErrExit("%s:%i: invalid RHS matrix in KrylovSolver::Solve",__FILE__,__LINE__);
+
+  const char *Name = (Method==SCUFF_SOLVER_GMRES) ? "GMRES" : "BiCGStab";
+  double Time=Secs();
+  int NumFailed=0, TotalIterations=0;
+  double MaxResidual=0.0;
+  for(int nc=0; nc<X->NC; nc++)
+   { HVector XColumn(X->NR, LHM_COMPLEX, X->ZM + ((size_t)nc)*X->NR);
+     if ( (Method==SCUFF_SOLVER_GMRES) ? GMRES(&XColumn) : BiCGStab(&XColumn) )
+      NumFailed++;
+     TotalIterations+=NumIterations;
+     MaxResidual=fmax(MaxResidual, Residual);
+   };
+  NumIterations=TotalIterations;
+  Residual=MaxResidual;
+  Time=Secs()-Time;
+
+  Log("%s: %i right-hand sides, %i total iterations (max residual %.2e, %.2f s)",
+       Name,X->NC,NumIterations,Residual,Time);
+  if (NumFailed)
+   Warn("%s did not converge for %i of %i right-hand sides",Name,NumFailed,X->NC);
+  return NumFailed ? 1 : 0;
+}
+
+} // namespace scuff
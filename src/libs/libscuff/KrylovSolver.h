@@ -0,0 +1,98 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * KrylovSolver.h -- iterative (GMRES / BiCGStab) solution of the BEM
+ *                -- system with a block-diagonal preconditioner built
+ *                -- from the self-interaction (T) blocks of each surface
+ */
+
+#ifndef KRYLOVSOLVER_H
+#define KRYLOVSOLVER_H
+
+#include <libhmat.h>
+
+namespace scuff {
+
+class RWGGeometry;
+class ACAMatrix;
+
+#define SCUFF_SOLVER_LU       0
+#define SCUFF_SOLVER_GMRES    1
+#define SCUFF_SOLVER_BICGSTAB 2
+
+// convert a string like "LU", "GMRES", "BiCGStab" (case-insensitive)
+// to one of the constants above; returns -1 for unrecognized names
+int ParseSolverName(const char *Name);
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+class KrylovSolver
+ {
+  public:
+
+   // Tolerance = relative residual |b-Mx| / |b| at convergence
+   // Restart   = Krylov subspace dimension for restarted GMRES
+   // the defaults may be overridden by the environment variables
+   // SCUFF_SOLVER_TOLERANCE, SCUFF_SOLVER_MAXITERS, SCUFF_SOLVER_RESTART
+   KrylovSolver(RWGGeometry *G, int Method=SCUFF_SOLVER_GMRES,
+                double Tolerance=1.0e-6, int MaxIters=1000, int Restart=50);
+   ~KrylovSolver();
+
+   // set the system matrix; the diagonal surface blocks of M are
+   // extracted and LU-factorized to form the preconditioner
+   void SetMatrix(HMatrix *M);
+
+   // set a compressed system matrix; the preconditioner blocks
+   // are computed by AssembleBEMMatrixBlock at the given frequency
+   void SetMatrix(ACAMatrix *A, cdouble Omega);
+
+   // solve in place: on entry X is the RHS, on return the solution
+   // (same calling convention as HMatrix::LUSolve); returns 0 on
+   // convergence or 1 if MaxIters was reached
+   int Solve(HVector *X);
+   int Solve(HMatrix *X);
+
+   // statistics for the most recent call to Solve()
+   int NumIterations;
+   double Residual;
+
+  private:
+   RWGGeometry *G;
+   int Method;
+   double Tolerance;
+   int MaxIters, Restart;
+
+   HMatrix *M;
+   ACAMatrix *A;
+   HMatrix **PBlocks;          // LU-factorized diagonal blocks
+   HVector *Work[9];
+   HMatrix *Basis;             // Krylov basis vectors for GMRES
+
+   void FactorizePreconditioner();
+   void ApplyMatrix(HVector *X, HVector *Y);
+   void ApplyPreconditioner(HVector *X);
+   int GMRES(HVector *X);
+   int BiCGStab(HVector *X);
+ };
+
+} // namespace scuff
+
+#endif // KRYLOVSOLVER_H
@@ -193,7 +193,8 @@ void GetExtinctionMomentPFT(RWGGeometry *G, int ns,
 /***************************************************************/
 HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
                             HVector *KNVector, HMatrix *DRMatrix,
-                            HMatrix *PFTMatrix, bool Itemize)
+                            HMatrix *PFTMatrix, bool Itemize,
+                            Workspace *WS)
 { 
   (void) DRMatrix;
 
@@ -208,30 +209,17 @@ HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
    ErrExit("invalid PFTMatrix in MomentPFT");
 
   /***************************************************************/
-  /* ScatteredPFT[ns] = contributions of surface #ns to          */
-  /*                    scattered PFT                            */
+  /* ScatteredPFT[nsb*NS + nsa, nq] = contribution of surface    */
+  /*                                  #nsb to scattered PFT      */
+  /*                                  quantity #nq on #nsa       */
   /***************************************************************/
-  static int NSSave=0;
-  static HMatrix **ScatteredPFT=0, *ExtinctionPFT=0;
-  static HMatrix *PM;
-  if (NSSave!=NS)
-   { if (ScatteredPFT)
-      { for(int ns=0; ns<NSSave; ns++)
-         if (ScatteredPFT[ns]) 
-          delete ScatteredPFT[ns];
-        free(ScatteredPFT);
-       if (ExtinctionPFT)
-        delete ExtinctionPFT;
-       if (PM)
-        delete PM;
-      };
-     NSSave=NS;
-     ScatteredPFT=(HMatrix **)mallocEC(NS*sizeof(HMatrix));
-     for(int ns=0; ns<NS; ns++)
-      ScatteredPFT[ns]=new HMatrix(NS, NUMPFT);
-     ExtinctionPFT=new HMatrix(NS, NUMPFT);
-     PM=new HMatrix(NS, 6, LHM_COMPLEX);
-   };
+  Workspace *MyWS = WS ? WS : AcquireWorkspace();
+  HMatrix *ScatteredPFT
+   = MyWS->GetHMatrix(WS_MOMENTPFT_SCATTERED, NS*NS, NUMPFT, LHM_REAL);
+  HMatrix *ExtinctionPFT
+   = MyWS->GetHMatrix(WS_MOMENTPFT_EXTINCTION, NS, NUMPFT, LHM_REAL);
+  HMatrix *PM
+   = MyWS->GetHMatrix(WS_MOMENTPFT_PM, NS, 6, LHM_COMPLEX);
 
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
@@ -241,11 +229,7 @@ HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
   /*--------------------------------------------------------------*/
   /*- loop over all surfaces to moment PFT on that surface        */
   /*--------------------------------------------------------------*/
-  for(int ns=0; ns<NS; ns++)
-   ScatteredPFT[ns]->Zero();
-
-  for(int ns=0; ns<NS; ns++)
-   ScatteredPFT[ns]->Zero();
+  ScatteredPFT->Zero();
 
   for(int nsa=0; nsa<NS; nsa++)
    for(int nsb=0; nsb<NS; nsb++)
@@ -258,7 +242,7 @@ HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
        GetInterbodyMomentPFT(G, nsa, nsb, Omega, PM, PFT);
 
       for(int nq=0; nq<NUMPFT; nq++)
-       ScatteredPFT[nsb]->AddEntry(nsa, nq, PFT[nq]);
+       ScatteredPFT->AddEntry(nsb*NS+nsa, nq, PFT[nq]);
     };
 
   /***************************************************************/
@@ -291,11 +275,11 @@ HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
       for(int nsb=0; nsb<NS; nsb++)
        { 
          if (nq==PFT_PABS)
-          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFT[nsb]->GetEntry(nsa,PFT_PSCAT));
+          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFT->GetEntry(nsb*NS+nsa,PFT_PSCAT));
          else if (nq==PFT_PSCAT)
-          PFTMatrix->AddEntry(nsa,nq,+1.0*ScatteredPFT[nsb]->GetEntry(nsa,PFT_PSCAT));
+          PFTMatrix->AddEntry(nsa,nq,+1.0*ScatteredPFT->GetEntry(nsb*NS+nsa,PFT_PSCAT));
          else // force or torque 
-          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFT[nsb]->GetEntry(nsa,nq));
+          PFTMatrix->AddEntry(nsa,nq,-1.0*ScatteredPFT->GetEntry(nsb*NS+nsa,nq));
        };
     };
   
@@ -331,13 +315,14 @@ HMatrix *GetMomentPFTMatrix(RWGGeometry *G, cdouble Omega, IncField *IF,
          fprintf(f,"%e ",ExtinctionPFT->GetEntryD(nsa,nq));
         for(int nsb=0; nsb<NS; nsb++)
          for(int nq=0; nq<NUMPFT; nq++)
-          fprintf(f,"%e ",ScatteredPFT[nsb]->GetEntryD(nsa,nq));
+          fprintf(f,"%e ",ScatteredPFT->GetEntryD(nsb*NS+nsa,nq));
         fprintf(f,"\n");
         fclose(f);
       };
      WrotePreamble=true;
    };
 
+  if (WS==0) ReleaseWorkspace(MyWS);
   return PFTMatrix;
 }
   
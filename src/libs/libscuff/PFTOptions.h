@@ -29,6 +29,7 @@
 
 #include "libhmat.h"
 #include "libhrutil.h"
+#include "Workspace.h"
 
 namespace scuff {
 
@@ -120,6 +121,10 @@ typedef struct PFTOptions
 
    bool GetRegionPFTs;
 
+   // scratch storage for the PFT routines; if NULL, a pooled
+   // workspace is used for each call
+   Workspace *WS;
+
  } PFTOptions;
 
 /***************************************************************/
@@ -134,7 +139,8 @@ PFTOptions *InitPFTOptions(PFTOptions *Options=0);
 /***************************************************************/
 class RWGGeometry;
 HMatrix *GetSRFluxTrace(RWGGeometry *G, HMatrix *XMatrix, cdouble Omega,
-                   HMatrix *DRMatrix, HMatrix *FMatrix=0);
+                   HMatrix *DRMatrix, HMatrix *FMatrix=0,
+                   Workspace *WS=0);
 
 void GetKNBilinears(HVector *KNVector, HMatrix *DRMatrix,
                     bool IsPECA, int KNIndexA,
@@ -349,6 +349,295 @@ void GetPPIs_Cubature(GetPPIArgStruct *Args,
 
 }
 
+/*--------------------------------------------------------------*/
+/*--------------------------------------------------------------*/
+/*--------------------------------------------------------------*/
+/*- PART 1B: Fast path for low-order cubature between distant  -*/
+/*-          panels in the non-periodic case.                  -*/
+/*--------------------------------------------------------------*/
+/*--------------------------------------------------------------*/
+/*--------------------------------------------------------------*/
+
+/***************************************************************/
+/* For distant panels we only need the H integrals, and these  */
+/* depend on the RWG source vertices Qa, Qb only through       */
+/* low-degree polynomials. Taking each panel centroid as the   */
+/* origin (x=X-Ca, x'=X'-Cb, q=Qa-Ca, q'=Qb-Cb) we have        */
+/*                                                             */
+/*  HPlus  = M_xx' - q'.M_x - q.M_x' + (q.q' + 4/(ik)^2)*M_1   */
+/*  HTimes = N_0 - q'.N_1 - q.N_2 + (q x q').N_3               */
+/*                                                             */
+/* where the 18 'panel-pair moments'                           */
+/*                                                             */
+/*  M_1 = <1|Phi>,  M_x = <x|Phi>,  M_x' = <x'|Phi>,           */
+/*  M_xx' = <x.x'|Phi>,  N_0 = <x.(x' x R)|Psi>,               */
+/*  N_1 = <R x x|Psi>,  N_2 = <x' x R|Psi>,  N_3 = <R|Psi>     */
+/*                                                             */
+/* (Phi=e^{ikr}/(4 pi r), Psi=Phi*(ik-1/r)/r) do not depend on */
+/* Qa, Qb; they are shared by all RWG half-functions on the    */
+/* panel pair and may be cached across all edge pairs that     */
+/* touch it. The cubature points of each panel are stored in   */
+/* separate real arrays so that the inner loop is a sequence   */
+/* of real-valued operations the compiler can vectorize.       */
+/***************************************************************/
+#define NUMPPMOMENTS 18
+#define PPM_MAXPTS   16
+
+// indices into the array of panel-pair moments
+#define PPM_M1    0
+#define PPM_MX    1
+#define PPM_MXP   4
+#define PPM_MXXP  7
+#define PPM_N0    8
+#define PPM_N1    9
+#define PPM_N2   12
+#define PPM_N3   15
+
+/***************************************************************/
+/* compute the panel-pair moments for the triangles with       */
+/* vertices Va, Vb (which must already include the displacement*/
+/* if any), taking Ca and Cb as the origins for the two panels.*/
+/***************************************************************/
+static void GetPanelPairMoments(double **Va, double *Ca,
+                                double **Vb, double *Cb,
+                                cdouble k, cdouble *PPM)
+{
+  int NumPts;
+  double *TCR=GetTCR(4, &NumPts);
+  if (NumPts>PPM_MAXPTS)
+   ErrExit("%s:%i: internal error",__FILE__,__LINE__);
+
+  /***************************************************************/
+  /* tabulate cubature points on both panels in local coordinates*/
+  /***************************************************************/
+  double xa[PPM_MAXPTS], ya[PPM_MAXPTS], za[PPM_MAXPTS], wa[PPM_MAXPTS];
+  double xb[PPM_MAXPTS], yb[PPM_MAXPTS], zb[PPM_MAXPTS], wb[PPM_MAXPTS];
+  double *La[3]={xa,ya,za}, *Lb[3]={xb,yb,zb};
+  for(int np=0; np<NumPts; np++)
+   { double u=TCR[3*np+0], v=TCR[3*np+1];
+     for(int Mu=0; Mu<3; Mu++)
+      { La[Mu][np] = Va[0][Mu] + u*(Va[1][Mu]-Va[0][Mu]) + v*(Va[2][Mu]-Va[0][Mu]) - Ca[Mu];
+        Lb[Mu][np] = Vb[0][Mu] + u*(Vb[1][Mu]-Vb[0][Mu]) + v*(Vb[2][Mu]-Vb[0][Mu]) - Cb[Mu];
+      };
+     wa[np]=wb[np]=TCR[3*np+2];
+   };
+
+  double Dx=Ca[0]-Cb[0], Dy=Ca[1]-Cb[1], Dz=Ca[2]-Cb[2];
+  double kr=real(k), ki=imag(k);
+  double OOFP=1.0/(4.0*M_PI);
+
+  /***************************************************************/
+  /* accumulators for the moments, split into real and imaginary */
+  /* parts                                                       */
+  /***************************************************************/
+  double MR[NUMPPMOMENTS], MI[NUMPPMOMENTS];
+  memset(MR, 0, NUMPPMOMENTS*sizeof(double));
+  memset(MI, 0, NUMPPMOMENTS*sizeof(double));
+
+  for(int na=0; na<NumPts; na++)
+   { 
+     double X=xa[na], Y=ya[na], Z=za[na];
+
+     // inner sums: S0=sum Phi, S1=sum x'*Phi, T=sum R*Psi, U=sum (x' x R)*Psi
+     double S0R=0.0, S0I=0.0;
+     double S1xR=0.0, S1xI=0.0, S1yR=0.0, S1yI=0.0, S1zR=0.0, S1zI=0.0;
+     double TxR=0.0, TxI=0.0, TyR=0.0, TyI=0.0, TzR=0.0, TzI=0.0;
+     double UxR=0.0, UxI=0.0, UyR=0.0, UyI=0.0, UzR=0.0, UzI=0.0;
+     for(int nb=0; nb<NumPts; nb++)
+      { 
+        double Rx = Dx + X - xb[nb];
+        double Ry = Dy + Y - yb[nb];
+        double Rz = Dz + Z - zb[nb];
+        double r  = sqrt(Rx*Rx + Ry*Ry + Rz*Rz);
+        double OOR = 1.0/r;
+
+        // Phi = wb * e^{ikr} / (4 pi r)
+        double Mag = wb[nb]*OOFP*OOR*exp(-ki*r);
+        double PhiR = Mag*cos(kr*r), PhiI = Mag*sin(kr*r);
+
+        // Psi = Phi*(ik - 1/r)/r
+        double FR = (-ki - OOR)*OOR, FI = kr*OOR;
+        double PsiR = PhiR*FR - PhiI*FI, PsiI = PhiR*FI + PhiI*FR;
+
+        double XPx=xb[nb], XPy=yb[nb], XPz=zb[nb];
+        double Cx = XPy*Rz - XPz*Ry;
+        double Cy = XPz*Rx - XPx*Rz;
+        double Cz = XPx*Ry - XPy*Rx;
+
+        S0R  += PhiR;       S0I  += PhiI;
+        S1xR += XPx*PhiR;   S1xI += XPx*PhiI;
+        S1yR += XPy*PhiR;   S1yI += XPy*PhiI;
+        S1zR += XPz*PhiR;   S1zI += XPz*PhiI;
+        TxR  += Rx*PsiR;    TxI  += Rx*PsiI;
+        TyR  += Ry*PsiR;    TyI  += Ry*PsiI;
+        TzR  += Rz*PsiR;    TzI  += Rz*PsiI;
+        UxR  += Cx*PsiR;    UxI  += Cx*PsiI;
+        UyR  += Cy*PsiR;    UyI  += Cy*PsiI;
+        UzR  += Cz*PsiR;    UzI  += Cz*PsiI;
+      };
+
+     double w=wa[na];
+     MR[PPM_M1]   += w*S0R;                       MI[PPM_M1]   += w*S0I;
+     MR[PPM_MX+0] += w*X*S0R;                     MI[PPM_MX+0] += w*X*S0I;
+     MR[PPM_MX+1] += w*Y*S0R;                     MI[PPM_MX+1] += w*Y*S0I;
+     MR[PPM_MX+2] += w*Z*S0R;                     MI[PPM_MX+2] += w*Z*S0I;
+     MR[PPM_MXP+0]+= w*S1xR;                      MI[PPM_MXP+0]+= w*S1xI;
+     MR[PPM_MXP+1]+= w*S1yR;                      MI[PPM_MXP+1]+= w*S1yI;
+     MR[PPM_MXP+2]+= w*S1zR;                      MI[PPM_MXP+2]+= w*S1zI;
+     MR[PPM_MXXP] += w*(X*S1xR + Y*S1yR + Z*S1zR);
+     MI[PPM_MXXP] += w*(X*S1xI + Y*S1yI + Z*S1zI);
+     MR[PPM_N0]   += w*(X*UxR + Y*UyR + Z*UzR);
+     MI[PPM_N0]   += w*(X*UxI + Y*UyI + Z*UzI);
+     MR[PPM_N1+0] += w*(TyR*Z - TzR*Y);           MI[PPM_N1+0] += w*(TyI*Z - TzI*Y);
+     MR[PPM_N1+1] += w*(TzR*X - TxR*Z);           MI[PPM_N1+1] += w*(TzI*X - TxI*Z);
+     MR[PPM_N1+2] += w*(TxR*Y - TyR*X);           MI[PPM_N1+2] += w*(TxI*Y - TyI*X);
+     MR[PPM_N2+0] += w*UxR;                       MI[PPM_N2+0] += w*UxI;
+     MR[PPM_N2+1] += w*UyR;                       MI[PPM_N2+1] += w*UyI;
+     MR[PPM_N2+2] += w*UzR;                       MI[PPM_N2+2] += w*UzI;
+     MR[PPM_N3+0] += w*TxR;                       MI[PPM_N3+0] += w*TxI;
+     MR[PPM_N3+1] += w*TyR;                       MI[PPM_N3+1] += w*TyI;
+     MR[PPM_N3+2] += w*TzR;                       MI[PPM_N3+2] += w*TzI;
+   };
+
+  for(int n=0; n<NUMPPMOMENTS; n++)
+   PPM[n]=cdouble(MR[n], MI[n]);
+}
+
+/***************************************************************/
+/* assemble the H integrals for a given choice of RWG source    */
+/* vertices from the panel-pair moments                        */
+/***************************************************************/
+static void GetPPIsFromMoments(cdouble *PPM, double *q, double *qp,
+                               cdouble k, cdouble *H)
+{ 
+  cdouble ik=II*k;
+  double qxqp[3];
+  VecCross(q, qp, qxqp);
+
+  H[0] =  PPM[PPM_MXXP]
+         -qp[0]*PPM[PPM_MX+0]  - qp[1]*PPM[PPM_MX+1]  - qp[2]*PPM[PPM_MX+2]
+         -q[0]*PPM[PPM_MXP+0]  - q[1]*PPM[PPM_MXP+1]  - q[2]*PPM[PPM_MXP+2]
+         +(VecDot(q,qp) + 4.0/(ik*ik))*PPM[PPM_M1];
+
+  H[1] =  PPM[PPM_N0]
+         -qp[0]*PPM[PPM_N1+0]  - qp[1]*PPM[PPM_N1+1]  - qp[2]*PPM[PPM_N1+2]
+         -q[0]*PPM[PPM_N2+0]   - q[1]*PPM[PPM_N2+1]   - q[2]*PPM[PPM_N2+2]
+         +qxqp[0]*PPM[PPM_N3+0] + qxqp[1]*PPM[PPM_N3+1] + qxqp[2]*PPM[PPM_N3+2];
+}
+
+/***************************************************************/
+/* a simple open-addressing hash table storing the panel-pair  */
+/* moments for (npa,npb) pairs. a cache is only valid for a    */
+/* single choice of (Sa, Sb, k, Displacement), so callers      */
+/* create one per medium for each block of edge pairs they     */
+/* process; it is not thread-safe.                             */
+/***************************************************************/
+typedef struct PanelPairCache
+ { size_t Capacity, Count;
+   unsigned long long *Keys;  // 0 means 'empty slot'
+   cdouble *Moments;
+ } PanelPairCache;
+
+#define PPC_INITIAL_CAPACITY 1024
+
+static inline unsigned long long PPCKey(int npa, int npb)
+{ return ( ((unsigned long long)(npa+1)) << 32 ) | ((unsigned long long)(unsigned)npb); }
+
+static inline size_t PPCHash(unsigned long long Key, size_t Capacity)
+{ Key ^= Key >> 33;
+  Key *= 0xff51afd7ed558ccdULL;
+  Key ^= Key >> 33;
+  return (size_t)(Key & (Capacity-1));
+}
+
+static void InitPPCTable(PanelPairCache *PPC, size_t Capacity)
+{ PPC->Capacity = Capacity;
+  PPC->Count    = 0;
+  PPC->Keys     = (unsigned long long *)mallocEC(Capacity*sizeof(unsigned long long));
+  PPC->Moments  = (cdouble *)mallocEC(Capacity*NUMPPMOMENTS*sizeof(cdouble));
+  memset(PPC->Keys, 0, Capacity*sizeof(unsigned long long));
+}
+
+void *CreatePanelPairCache()
+{ PanelPairCache *PPC = (PanelPairCache *)mallocEC(sizeof(PanelPairCache));
+  InitPPCTable(PPC, PPC_INITIAL_CAPACITY);
+  return (void *)PPC;
+}
+
+void DestroyPanelPairCache(void *opPPC)
+{ if (!opPPC) return;
+  PanelPairCache *PPC = (PanelPairCache *)opPPC;
+  free(PPC->Keys);
+  free(PPC->Moments);
+  free(PPC);
+}
+
+// returns a pointer to the moment slot for (npa,npb); on return
+// *Found is true if the slot was already populated
+static cdouble *GetPPCSlot(PanelPairCache *PPC, int npa, int npb, bool *Found)
+{
+  // grow the table when it is half full
+  if ( 2*(PPC->Count+1) > PPC->Capacity )
+   { PanelPairCache Old = *PPC;
+     InitPPCTable(PPC, 2*Old.Capacity);
+     for(size_t n=0; n<Old.Capacity; n++)
+      { if (Old.Keys[n]==0) continue;
+        size_t Slot=PPCHash(Old.Keys[n], PPC->Capacity);
+        while( PPC->Keys[Slot]!=0 )
+         Slot = (Slot+1) & (PPC->Capacity-1);
+        PPC->Keys[Slot]=Old.Keys[n];
+        memcpy(PPC->Moments + NUMPPMOMENTS*Slot, Old.Moments + NUMPPMOMENTS*n,
+               NUMPPMOMENTS*sizeof(cdouble));
+        PPC->Count++;
+      };
+     free(Old.Keys);
+     free(Old.Moments);
+   };
+
+  unsigned long long Key=PPCKey(npa, npb);
+  size_t Slot=PPCHash(Key, PPC->Capacity);
+  while( PPC->Keys[Slot]!=0 )
+   { if (PPC->Keys[Slot]==Key)
+      { *Found=true;
+        return PPC->Moments + NUMPPMOMENTS*Slot;
+      };
+     Slot = (Slot+1) & (PPC->Capacity-1);
+   };
+
+  PPC->Keys[Slot]=Key;
+  PPC->Count++;
+  *Found=false;
+  return PPC->Moments + NUMPPMOMENTS*Slot;
+}
+
+/***************************************************************/
+/* low-order cubature for distant panels via the panel-pair    */
+/* moments, optionally retrieved from / stored in a cache.     */
+/***************************************************************/
+static void GetPPIs_LowOrderMoments(GetPPIArgStruct *Args,
+                                    double **Va, double *Qa,
+                                    double **Vb, double *Qb)
+{ 
+  RWGPanel *Pa = Args->Sa->Panels[Args->npa];
+  RWGPanel *Pb = Args->Sb->Panels[Args->npb];
+  double *Ca = Pa->Centroid, Cb[3];
+  VecCopy(Pb->Centroid, Cb);
+  if (Args->Displacement)
+   VecPlusEquals(Cb, 1.0, Args->Displacement);
+
+  cdouble PPMBuffer[NUMPPMOMENTS], *PPM=PPMBuffer;
+  bool Found=false;
+  if (Args->opPPC)
+   PPM=GetPPCSlot((PanelPairCache *)Args->opPPC, Args->npa, Args->npb, &Found);
+  if (!Found)
+   GetPanelPairMoments(Va, Ca, Vb, Cb, Args->k, PPM);
+
+  double q[3], qp[3];
+  VecSub(Qa, Ca, q);
+  VecSub(Qb, Cb, qp);
+  GetPPIsFromMoments(PPM, q, qp, Args->k, Args->H);
+}
+
 /***************************************************************/
 /* calculate integrals over a single pair of triangles using   */
 /* one of several different methods based on how near the two  */
@@ -419,7 +708,10 @@ void GetPanelPanelInteractions(GetPPIArgStruct *Args)
   /***************************************************************/
   if ( Args->GBA || (rRel > DESINGULARIZATION_RADIUS) )
    { Args->WhichAlgorithm=PPIALG_LOCUBATURE;
-     GetPPIs_Cubature(Args, 0, 0, Va, Qa, Vb, Qb);
+     if ( Args->GBA==0 && NumGradientComponents==0 && NumTorqueAxes==0 )
+      GetPPIs_LowOrderMoments(Args, Va, Qa, Vb, Qb);
+     else
+      GetPPIs_Cubature(Args, 0, 0, Va, Qa, Vb, Qb);
      return;
    };
 
@@ -589,6 +881,7 @@ void InitGetPPIArgs(GetPPIArgStruct *Args)
   Args->ForceTaylorDuffy = RWGGeometry::DisableCache;
   Args->GammaMatrix=0;
   Args->opFC=0;
+  Args->opPPC=0;
   Args->Displacement=0;
   Args->GBA=0;
   Args->ForceFullEwald=false;
@@ -48,7 +48,14 @@ bool RWGGeometry::AssignBasisFunctionsToExteriorEdges=false;
 bool RWGGeometry::UseHighKTaylorDuffy=true;
 bool RWGGeometry::UseTaylorDuffyV2P0=true;
 bool RWGGeometry::UseGetFieldsV2P0=false;
+bool RWGGeometry::UseNewRFMethod=false;
 bool RWGGeometry::DisableCache=false;
+bool RWGGeometry::UseSymmetricFactorization=false;
+double RWGGeometry::EdgeMomentThreshold=0.0;
+int RWGGeometry::GBAPoolSize=32;
+int RWGGeometry::FMMOrder=0;
+double RWGGeometry::FMMThreshold=1.0e8;
+double RWGGeometry::FieldChunkMemory=256.0;
 int RWGGeometry::NumMeshDirs=0;
 char **RWGGeometry::MeshDirs=0;
 
@@ -303,6 +310,7 @@ RWGGeometry::RWGGeometry(const char *pGeoFileName, int pLogLevel)
    };
   tolVecClose=0.0; // to be updated once mesh is read in
   TBlockCacheNameAddendum=0;
+  GBAPool=0;
 
   // we always start with a single Region, for the exterior,
   // taken to be vacuum by default
@@ -341,6 +349,36 @@ RWGGeometry::RWGGeometry(const char *pGeoFileName, int pLogLevel)
      RWGGeometry::DisableCache=true;
    };
 
+  if ( (s=getenv("SCUFF_SYMMETRIC_FACTORIZATION")) && (s[0]=='1') )
+   { Log("Using symmetric (LDL^T) factorization of BEM matrices.");
+     RWGGeometry::UseSymmetricFactorization=true;
+   };
+
+  if ( (s=getenv("SCUFF_EDGE_MOMENT_THRESHOLD")) )
+   { sscanf(s,"%le",&RWGGeometry::EdgeMomentThreshold);
+     Log("Setting edge-moment threshold to %g.",RWGGeometry::EdgeMomentThreshold);
+   };
+
+  if ( (s=getenv("SCUFF_GBA_POOL_SIZE")) )
+   { sscanf(s,"%i",&RWGGeometry::GBAPoolSize);
+     Log("Setting size of periodic-GF interpolation table pool to %i.",RWGGeometry::GBAPoolSize);
+   };
+
+  if ( (s=getenv("SCUFF_FMM_ORDER")) )
+   { sscanf(s,"%i",&RWGGeometry::FMMOrder);
+     Log("Setting FMM interpolation order for field calculations to %i.",RWGGeometry::FMMOrder);
+   };
+
+  if ( (s=getenv("SCUFF_FMM_THRESHOLD")) )
+   { sscanf(s,"%le",&RWGGeometry::FMMThreshold);
+     Log("Using FMM for field calculations with more than %g BF-point pairs.",RWGGeometry::FMMThreshold);
+   };
+
+  if ( (s=getenv("SCUFF_FIELD_CHUNK_MB")) )
+   { sscanf(s,"%le",&RWGGeometry::FieldChunkMemory);
+     Log("Limiting RFMatrix storage for field calculations to %g MB.",RWGGeometry::FieldChunkMemory);
+   };
+
   if ( (s= getenv("SCUFF_HALF_RWG")) && (s[0]=='1') )
    { Log("Assigning half-RWG basis functions to exterior edges.");
      RWGGeometry::AssignBasisFunctionsToExteriorEdges=true;
@@ -361,6 +399,11 @@ RWGGeometry::RWGGeometry(const char *pGeoFileName, int pLogLevel)
      UseGetFieldsV2P0=true;
    };
 
+  if ( (s=getenv("SCUFF_NEW_RFMETHOD")) && (s[0]=='1') )
+   { Log("Using new RF method.");
+     UseNewRFMethod=true;
+   };
+
   /***************************************************************/
   /* try to open input file **************************************/
   /***************************************************************/
@@ -770,6 +813,8 @@ RWGGeometry::~RWGGeometry()
    DestroyFIBBICache(FIBBICaches[ns]);
   free(FIBBICaches);
 
+  DestroyGBAPool(GBAPool);
+
 }
 
 /***************************************************************/
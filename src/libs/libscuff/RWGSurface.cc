@@ -34,6 +34,7 @@
 #include <libhrutil.h>
 
 #include "libscuff.h"
+#include "libscuffInternals.h"
 #include "cmatheval.h"
 
 namespace scuff {
@@ -299,6 +300,7 @@ void RWGSurface::InitRWGSurface()
 { 
   ErrMsg=0;
   kdPanels = NULL;
+  EdgeMoments = NULL;
 
   /*------------------------------------------------------------*/
   /*- try to open the mesh file. we look in several places:     */
@@ -459,6 +461,7 @@ RWGSurface::RWGSurface(double *pVertices, int pNumVertices,
 { 
   ErrMsg=0;
   kdPanels = NULL;
+  EdgeMoments = NULL;
 
   MeshFileName=strdupEC("ByHand.msh");
   Label=strdupEC("ByHand");
@@ -577,6 +580,7 @@ RWGSurface::~RWGSurface()
   if (ErrMsg) free(ErrMsg);
   if (GT) delete GT;
   if (OTGT) delete OTGT;
+  DestroyEdgeMoments(this);
 
   if (MaterialName) free(MaterialName);
   if (RegionLabels[0]) free(RegionLabels[0]);
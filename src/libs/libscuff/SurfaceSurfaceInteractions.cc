@@ -97,6 +97,8 @@ typedef struct ThreadData
    GetSSIArgStruct *Args;
    unsigned PPIAlgorithmCount[NUMPPIALGORITHMS];
    int nt, NumTasks;
+   int neaMin, neaMax;   // range of edge pairs (a 'tile') handled by
+   int nebMin, nebMax;   // this call to GSSIThread
 
  } ThreadData;
 
@@ -110,7 +112,6 @@ void *GSSIThread(void *data)
   /***************************************************************/
   ThreadData *TD=(ThreadData *)data;
   GetSSIArgStruct *Args= TD->Args;
-  RWGGeometry *G       = Args->G;
   RWGSurface *Sa       = Args->Sa;
   RWGSurface *Sb       = Args->Sb;
   cdouble Omega        = Args->Omega;
@@ -131,6 +132,12 @@ void *GSSIThread(void *data)
   double SignB         = Args->SignB;
   bool SaIsPEC         = Args->SaIsPEC;
   bool SbIsPEC         = Args->SbIsPEC;
+  cdouble *GCBuffer    = Args->GCBuffer;
+  int NEa              = Sa->NumEdges;
+  int NEb              = Sb->NumEdges;
+  EdgeMomentData *MomentsA = Args->MomentsA;
+  EdgeMomentData *MomentsB = Args->MomentsB;
+  double MomentThreshold = RWGGeometry::EdgeMomentThreshold;
 
 #ifdef USE_PTHREAD
   SetCPUAffinity(TD->nt);
@@ -150,6 +157,19 @@ void *GSSIThread(void *data)
   GetEEIArgs->GammaMatrix=GammaMatrix;
   GetEEIArgs->Displacement=Displacement;
 
+  /***************************************************************/
+  /* panel-pair moments for distant panels are shared by all the */
+  /* edge pairs in our tile that touch a given panel pair; we    */
+  /* keep one cache per medium since the moments depend on k.    */
+  /* (the moments are only used in the non-periodic case without */
+  /* derivatives, so there is no point in creating caches else.) */
+  /***************************************************************/
+  void *PPCA=0, *PPCB=0;
+  if ( GradB==0 && NumTorqueAxes==0 )
+   { if (Args->GBA1==0) PPCA=CreatePanelPairCache();
+     if (Args->GBA2==0 && EpsB!=0.0) PPCB=CreatePanelPairCache();
+   };
+
   /* pointers to arrays inside the structure */
   cdouble *GC=GetEEIArgs->GC;
   cdouble *GradGC=GetEEIArgs->GradGC;
@@ -176,22 +196,28 @@ void *GSSIThread(void *data)
    };
 
   /***************************************************************/
-  /* loop over all internal edges on both objects.               */
+  /* loop over all pairs of internal edges in our tile.          */
   /***************************************************************/
-  int nea, NEa=Sa->NumEdges;
-  int neb, NEb=Sb->NumEdges;
-  int X, Y, Mu, nt=0;
+  int nea, neb, X, Y, Mu;
   int NumGradientComponents = GradB ? 3 : 0;
-  int nebStart = Symmetric ? 1 : 0;
-  for(nea=0; nea<NEa; nea++)
-   for(neb=nebStart*nea; neb<NEb; neb++)
+  for(nea=TD->neaMin; nea<TD->neaMax; nea++)
+   for(neb=(Symmetric ? (nea>TD->nebMin ? nea : TD->nebMin) : TD->nebMin); neb<TD->nebMax; neb++)
     { 
-      nt++;
-      if (nt==TD->NumTasks) nt=0;
-      if (nt!=TD->nt) continue;
-
-      if (G->LogLevel>=SCUFF_VERBOSE2 && (neb==nebStart*nea) )
-       LogPercent(nea, NEa);
+      /*--------------------------------------------------------------*/
+      /*- for well-separated basis functions on different surfaces,  -*/
+      /*- get the edge-edge interactions from the multipole moments  -*/
+      /*- (separately for each medium, since admissibility depends   -*/
+      /*- on the wavenumber)                                         -*/
+      /*--------------------------------------------------------------*/
+      bool UseMomentsA=false, UseMomentsB=false;
+      double R[3];
+      if (MomentsA)
+       { RWGEdge *Ea=Sa->Edges[nea], *Eb=Sb->Edges[neb];
+         VecSub(Ea->Centroid, Eb->Centroid, R);
+         if (Displacement) VecPlusEquals(R, -1.0, Displacement);
+         UseMomentsA = EdgeMomentsAdmissible(Ea, Eb, R, kA, MomentThreshold);
+         UseMomentsB = EpsB!=0.0 && EdgeMomentsAdmissible(Ea, Eb, R, kB, MomentThreshold);
+       };
 
       /*--------------------------------------------------------------*/
       /*- contributions of first medium (EpsA, MuA)  -----------------*/
@@ -200,7 +226,36 @@ void *GSSIThread(void *data)
       GetEEIArgs->neb  = neb;
       GetEEIArgs->k    = kA;
       GetEEIArgs->GBA  = Args->GBA1;
-      GetEdgeEdgeInteractions(GetEEIArgs);
+      GetEEIArgs->opPPC= PPCA;
+      if (UseMomentsA)
+       GetEEIsFromMoments(GetEdgeMomentPointer(MomentsA, nea),
+                          GetEdgeMomentPointer(MomentsB, neb), R, kA, GC);
+      else
+       GetEdgeEdgeInteractions(GetEEIArgs);
+
+      /*--------------------------------------------------------------*/
+      /*- if the caller asked for the raw integrals, store them and   */
+      /*- skip the matrix stamping                                    */
+      /*--------------------------------------------------------------*/
+      if (GCBuffer)
+       { size_t Offset = 2*( ((size_t)nea)*NEb + neb );
+         GCBuffer[Offset + 0] = GC[0];
+         GCBuffer[Offset + 1] = GC[1];
+         if (EpsB!=0.0)
+          { GetEEIArgs->k     = kB;
+            GetEEIArgs->GBA   = Args->GBA2;
+            GetEEIArgs->opPPC = PPCB;
+            if (UseMomentsB)
+             GetEEIsFromMoments(GetEdgeMomentPointer(MomentsA, nea),
+                                GetEdgeMomentPointer(MomentsB, neb), R, kB, GC);
+            else
+             GetEdgeEdgeInteractions(GetEEIArgs);
+            Offset += 2*((size_t)NEa)*NEb;
+            GCBuffer[Offset + 0] = GC[0];
+            GCBuffer[Offset + 1] = GC[1];
+          };
+         continue;
+       };
 
       if ( SaIsPEC && SbIsPEC )
        { 
@@ -293,9 +348,14 @@ void *GSSIThread(void *data)
       /*--------------------------------------------------------------*/
       if (EpsB!=0.0)
        { 
-         GetEEIArgs->k   = kB;
-         GetEEIArgs->GBA = Args->GBA2;
-         GetEdgeEdgeInteractions(GetEEIArgs);
+         GetEEIArgs->k     = kB;
+         GetEEIArgs->GBA   = Args->GBA2;
+         GetEEIArgs->opPPC = PPCB;
+         if (UseMomentsB)
+          GetEEIsFromMoments(GetEdgeMomentPointer(MomentsA, nea),
+                             GetEdgeMomentPointer(MomentsB, neb), R, kB, GC);
+         else
+          GetEdgeEdgeInteractions(GetEEIArgs);
 
          X=RowOffset + 2*nea;
          Y=ColOffset + 2*neb;
@@ -326,7 +386,10 @@ void *GSSIThread(void *data)
           };
        }; // if (EpsB!=0.0)
 
-    }; // for(nea=0; nea<NEa; nea++), for(neb=nebStart*nea; neb<NEb; neb++) ... 
+    }; // for(nea=neaMin; nea<neaMax; nea++), for(neb=...; neb<nebMax; neb++) ... 
+
+  DestroyPanelPairCache(PPCA);
+  DestroyPanelPairCache(PPCB);
 
   memcpy(TD->PPIAlgorithmCount, GetEEIArgs->PPIAlgorithmCount, NUMPPIALGORITHMS*sizeof(unsigned));
   return 0;
@@ -420,6 +483,218 @@ void AddSurfaceZetaContributionToBEMMatrix(GetSSIArgStruct *Args)
 
 }
 
+/***************************************************************/
+/* The space of (nea, neb) edge pairs is partitioned into      */
+/* rectangular tiles that are handed out dynamically to        */
+/* threads. Tiles are sorted by a cost estimate so that the    */
+/* most expensive tiles (those containing pairs of touching or */
+/* nearby edges, which require Taylor-Duffy or desingularized  */
+/* cubature) are started first and the cheap far-field tiles   */
+/* fill in the gaps at the end.                                */
+/*                                                             */
+/* The cost estimate must itself be cheap: a tile whose two    */
+/* edge ranges have well-separated bounding spheres is costed  */
+/* as all far-field pairs, and any other tile is costed by     */
+/* classifying a small grid of sampled pairs, so that the work */
+/* done here is O(#tiles) rather than O(NEa*NEb).              */
+/***************************************************************/
+#define GSSI_TILES_PER_THREAD 32
+#define GSSI_MAX_TILESIZE     256
+
+// relative cost of far, nearby, and touching edge pairs
+#define GSSI_FARCOST    1.0
+#define GSSI_NEARCOST   4.0
+#define GSSI_TOUCHCOST 16.0
+#define GSSI_NEARRADIUS 4.0
+
+// sampled pairs per tile dimension for the cost estimate
+#define GSSI_COSTSAMPLES 4
+
+typedef struct GSSITile
+ { int neaMin, neaMax, nebMin, nebMax;
+   double Cost;
+ } GSSITile;
+
+// bounding sphere of a range of edges
+typedef struct GSSIEdgeRange
+ { double Center[3], Radius, MaxEdgeRadius;
+ } GSSIEdgeRange;
+
+static void GetEdgeRange(RWGSurface *S, int neMin, int neMax, GSSIEdgeRange *R)
+{
+  R->Center[0]=R->Center[1]=R->Center[2]=0.0;
+  for(int ne=neMin; ne<neMax; ne++)
+   VecPlusEquals(R->Center, 1.0/(neMax-neMin), S->Edges[ne]->Centroid);
+
+  R->Radius=R->MaxEdgeRadius=0.0;
+  for(int ne=neMin; ne<neMax; ne++)
+   { RWGEdge *E=S->Edges[ne];
+     R->Radius=fmax(R->Radius, VecDistance(R->Center, E->Centroid) + E->Radius);
+     R->MaxEdgeRadius=fmax(R->MaxEdgeRadius, E->Radius);
+   };
+}
+
+static double GetPairCost(RWGSurface *Sa, int nea, RWGSurface *Sb, int neb)
+{
+  double rRel;
+  int ncv=AssessBFPair(Sa, nea, Sb, neb, &rRel);
+  if (ncv>0)
+   return GSSI_TOUCHCOST;
+  else if (rRel<GSSI_NEARRADIUS)
+   return GSSI_NEARCOST;
+  return GSSI_FARCOST;
+}
+
+static int CompareTileCosts(const void *p1, const void *p2)
+{ double C1=((const GSSITile *)p1)->Cost;
+  double C2=((const GSSITile *)p2)->Cost;
+  return (C1>C2) ? -1 : (C1<C2) ? 1 : 0;
+}
+
+static GSSITile *CreateGSSITiles(GetSSIArgStruct *Args, int NumThreads,
+                                 int *pNumTiles, int *pTileSize)
+{
+  RWGSurface *Sa = Args->Sa, *Sb = Args->Sb;
+  int NEa        = Sa->NumEdges;
+  int NEb        = Sb->NumEdges;
+  bool Symmetric = Args->Symmetric;
+
+  /*--------------------------------------------------------------*/
+  /*- choose the tile size to give enough tiles per thread for    */
+  /*- dynamic load balancing                                      */
+  /*--------------------------------------------------------------*/
+  double NumPairs = Symmetric ? 0.5*NEa*(NEa+1.0) : ((double)NEa)*NEb;
+  int TileSize = (int)ceil(sqrt( NumPairs / (NumThreads*GSSI_TILES_PER_THREAD) ));
+  char *s=getenv("SCUFF_GSSI_TILESIZE");
+  if (s) sscanf(s,"%i",&TileSize);
+  if (TileSize<1) TileSize=1;
+  if (TileSize>GSSI_MAX_TILESIZE) TileSize=GSSI_MAX_TILESIZE;
+
+  int NTa = (NEa + TileSize - 1) / TileSize;
+  int NTb = (NEb + TileSize - 1) / TileSize;
+  GSSITile *Tiles = new GSSITile[NTa*NTb];
+
+  // pairs in displaced or periodic-image blocks are all handled
+  // the same way, so there is no point estimating their cost
+  bool UniformCost = (Args->Displacement || Args->GBA1 || Args->GBA2);
+
+  GSSIEdgeRange *RangesA=0, *RangesB=0;
+  if (!UniformCost)
+   { RangesA = new GSSIEdgeRange[NTa];
+     for(int nta=0; nta<NTa; nta++)
+      GetEdgeRange(Sa, nta*TileSize, ((nta+1)*TileSize < NEa ? (nta+1)*TileSize : NEa), RangesA+nta);
+     if (Sb==Sa)
+      RangesB = RangesA;
+     else
+      { RangesB = new GSSIEdgeRange[NTb];
+        for(int ntb=0; ntb<NTb; ntb++)
+         GetEdgeRange(Sb, ntb*TileSize, ((ntb+1)*TileSize < NEb ? (ntb+1)*TileSize : NEb), RangesB+ntb);
+      };
+   };
+
+  int NumTiles=0;
+  for(int nta=0; nta<NTa; nta++)
+   for(int ntb=(Symmetric ? nta : 0); ntb<NTb; ntb++)
+    { GSSITile *T = Tiles + (NumTiles++);
+      T->neaMin = nta*TileSize;
+      T->neaMax = (nta+1)*TileSize; if (T->neaMax>NEa) T->neaMax=NEa;
+      T->nebMin = ntb*TileSize;
+      T->nebMax = (ntb+1)*TileSize; if (T->nebMax>NEb) T->nebMax=NEb;
+
+      int NA = T->neaMax - T->neaMin, NB = T->nebMax - T->nebMin;
+      bool DiagonalTile = (Symmetric && nta==ntb);
+      double NumTilePairs = DiagonalTile ? 0.5*NA*(NA+1.0) : ((double)NA)*NB;
+
+      if (UniformCost)
+       { T->Cost = GSSI_FARCOST*NumTilePairs;
+         continue;
+       };
+
+      // if the bounding spheres of the two edge ranges are far
+      // enough apart, every pair in the tile is a far pair
+      GSSIEdgeRange *RA=RangesA+nta, *RB=RangesB+ntb;
+      double Gap = VecDistance(RA->Center, RB->Center) - RA->Radius - RB->Radius;
+      if ( Gap >= GSSI_NEARRADIUS*fmax(RA->MaxEdgeRadius, RB->MaxEdgeRadius) )
+       { T->Cost = GSSI_FARCOST*NumTilePairs;
+         continue;
+       };
+
+      // otherwise, extrapolate from a grid of sampled pairs
+      int NSA = (NA < GSSI_COSTSAMPLES) ? NA : GSSI_COSTSAMPLES;
+      int NSB = (NB < GSSI_COSTSAMPLES) ? NB : GSSI_COSTSAMPLES;
+      double SampleCost=0.0;
+      int NumSamples=0;
+      for(int nsa=0; nsa<NSA; nsa++)
+       for(int nsb=0; nsb<NSB; nsb++)
+        { int nea = T->neaMin + (nsa*NA)/NSA;
+          int neb = T->nebMin + (nsb*NB)/NSB;
+          if (DiagonalTile && neb<nea) continue;
+          SampleCost += GetPairCost(Sa, nea, Sb, neb);
+          NumSamples++;
+        };
+      T->Cost = NumTilePairs * SampleCost / NumSamples;
+    };
+
+  if (RangesB && RangesB!=RangesA) delete[] RangesB;
+  if (RangesA) delete[] RangesA;
+
+  qsort(Tiles, NumTiles, sizeof(GSSITile), CompareTileCosts);
+
+  *pNumTiles=NumTiles;
+  *pTileSize=TileSize;
+  return Tiles;
+}
+
+#ifdef USE_PTHREAD
+/***************************************************************/
+/* with pthreads, each thread repeatedly grabs the next        */
+/* unclaimed tile from the (cost-sorted) list                  */
+/***************************************************************/
+typedef struct GSSIPThreadData
+ { GetSSIArgStruct *Args;
+   GSSITile *Tiles;
+   int NumTiles, NextTile;
+   pthread_mutex_t Mutex;
+   unsigned *PPIAlgorithmCounts;
+   double *BusyTime;
+ } GSSIPThreadData;
+
+typedef struct GSSIPThreadArgs
+ { GSSIPThreadData *PTD;
+   int nt;
+ } GSSIPThreadArgs;
+
+void *GSSIPThread(void *data)
+{
+  GSSIPThreadArgs *PTArgs = (GSSIPThreadArgs *)data;
+  GSSIPThreadData *PTD    = PTArgs->PTD;
+  int nt                  = PTArgs->nt;
+
+  for(;;)
+   { pthread_mutex_lock(&(PTD->Mutex));
+     int nTile = PTD->NextTile++;
+     pthread_mutex_unlock(&(PTD->Mutex));
+     if (nTile>=PTD->NumTiles)
+      break;
+
+     ThreadData TD1;
+     TD1.nt=nt;
+     TD1.NumTasks=PTD->NumTiles;
+     TD1.Args=PTD->Args;
+     TD1.neaMin=PTD->Tiles[nTile].neaMin;
+     TD1.neaMax=PTD->Tiles[nTile].neaMax;
+     TD1.nebMin=PTD->Tiles[nTile].nebMin;
+     TD1.nebMax=PTD->Tiles[nTile].nebMax;
+     double TileTime=Secs();
+     GSSIThread((void *)&TD1);
+     PTD->BusyTime[nt] += Secs() - TileTime;
+     for(int n=0; n<NUMPPIALGORITHMS; n++)
+      PTD->PPIAlgorithmCounts[nt*NUMPPIALGORITHMS + n] += TD1.PPIAlgorithmCount[n];
+   };
+  return 0;
+}
+#endif
+
 /***************************************************************/  
 /***************************************************************/  
 /***************************************************************/
@@ -439,7 +714,7 @@ void GetSurfaceSurfaceInteractions(GetSSIArgStruct *Args)
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
   /*--------------------------------------------------------------*/
-  if ( Args->Accumulate==false )
+  if ( Args->Accumulate==false && Args->GCBuffer==0 )
    { Args->B->ZeroBlock(Args->RowOffset, Sa->NumBFs, Args->ColOffset, Sb->NumBFs);
      if (Args->GradB && Args->GradB[0])
       Args->GradB[0]->ZeroBlock(Args->RowOffset, Sa->NumBFs, Args->ColOffset, Sb->NumBFs);
@@ -492,60 +767,116 @@ void GetSurfaceSurfaceInteractions(GetSSIArgStruct *Args)
    return;
 
   /***************************************************************/
-  /* fire off threads ********************************************/
+  /* interactions between well-separated basis functions on      */
+  /* different surfaces may be computed from multipole moments,  */
+  /* which are reused across frequencies and displacements       */
+  /***************************************************************/
+  Args->MomentsA = Args->MomentsB = 0;
+  if (    RWGGeometry::EdgeMomentThreshold > 0.0
+       && Sa!=Sb && !G->LBasis && !Args->GBA1 && !Args->GBA2
+       && !Args->GradB && !Args->dBdTheta && Args->NumTorqueAxes==0 )
+   { Args->MomentsA = GetEdgeMoments(Sa);
+     Args->MomentsB = GetEdgeMoments(Sb);
+   };
+
+  /***************************************************************/
+  /* partition the edge-pair space into tiles, sorted in order   */
+  /* of decreasing estimated cost                                */
   /***************************************************************/
   GlobalFIPPICache.Hits=GlobalFIPPICache.Misses=0;
 
-  int nt, NumTasks, NumThreads = GetNumThreads();
-  unsigned PPIAlgorithmCount[NUMPPIALGORITHMS];  
-  memset(PPIAlgorithmCount, 0, NUMPPIALGORITHMS*sizeof(unsigned));
+  int NumThreads = GetNumThreads();
+  int NumTiles, TileSize;
+  GSSITile *Tiles=CreateGSSITiles(Args, NumThreads, &NumTiles, &TileSize);
+
+  unsigned *PPIAlgorithmCounts = new unsigned[NumThreads*NUMPPIALGORITHMS];
+  memset(PPIAlgorithmCounts, 0, NumThreads*NUMPPIALGORITHMS*sizeof(unsigned));
+  double *BusyTime = new double[NumThreads];
+  for(int nt=0; nt<NumThreads; nt++)
+   BusyTime[nt]=0.0;
 
+  /***************************************************************/
+  /* fire off threads ********************************************/
+  /***************************************************************/
+  double WallTime=Secs();
 #ifdef USE_PTHREAD
-  ThreadData *TDs = new ThreadData[NumThreads], *TD;
+  GSSIPThreadData PTD;
+  PTD.Args=Args;
+  PTD.Tiles=Tiles;
+  PTD.NumTiles=NumTiles;
+  PTD.NextTile=0;
+  PTD.PPIAlgorithmCounts=PPIAlgorithmCounts;
+  PTD.BusyTime=BusyTime;
+  pthread_mutex_init(&(PTD.Mutex), 0);
+  GSSIPThreadArgs *PTArgs = new GSSIPThreadArgs[NumThreads];
   pthread_t *Threads = new pthread_t[NumThreads];
-  for(nt=0; nt<NumThreads; nt++)
-   { 
-     TD=&(TDs[nt]);
-     TD->nt=nt;
-     TD->NumTasks=NumThreads;
-     TD->Args=Args;
+  for(int nt=0; nt<NumThreads; nt++)
+   { PTArgs[nt].PTD=&PTD;
+     PTArgs[nt].nt=nt;
      if (nt+1 == NumThreads)
-       GSSIThread((void *)TD);
+      GSSIPThread((void *)&(PTArgs[nt]));
      else
-       pthread_create( &(Threads[nt]), 0, GSSIThread, (void *)TD);
-   }
-  for(nt=0; nt<NumThreads-1; nt++)
-   { pthread_join(Threads[nt],0);
-     for(int n=0; n<NUMPPIALGORITHMS; n++)
-      PPIAlgorithmCount[n] += TD->PPIAlgorithmCount[n];
+      pthread_create( &(Threads[nt]), 0, GSSIPThread, (void *)&(PTArgs[nt]));
    };
+  for(int nt=0; nt<NumThreads-1; nt++)
+   pthread_join(Threads[nt],0);
+  pthread_mutex_destroy(&(PTD.Mutex));
   delete[] Threads;
-  delete[] TDs;
-
-#else 
+  delete[] PTArgs;
+#else
 #ifndef USE_OPENMP
-  NumTasks=NumThreads=1;
   if (G->LogLevel>=SCUFF_VERBOSE2)
    Log(" no multithreading...");
 #else
-  NumTasks=NumThreads*100;
-  if (NumTasks>Sa->NumEdges) 
-   NumTasks=Sa->NumEdges;
   if (G->LogLevel>=SCUFF_VERBOSE2)
-   Log(" OpenMP multithreading (%i threads,%i tasks)...",NumThreads,NumTasks);
+   Log(" OpenMP multithreading (%i threads,%i tiles of size %i)...",NumThreads,NumTiles,TileSize);
 #pragma omp parallel for schedule(dynamic,1), num_threads(NumThreads)
 #endif
-  for(nt=0; nt<NumTasks; nt++)
+  for(int nTile=0; nTile<NumTiles; nTile++)
    { 
+     int nt=0;
+#ifdef USE_OPENMP
+     nt=omp_get_thread_num();
+#endif
      ThreadData TD1;
      TD1.nt=nt;
-     TD1.NumTasks=NumTasks;
+     TD1.NumTasks=NumTiles;
      TD1.Args=Args;
+     TD1.neaMin=Tiles[nTile].neaMin;
+     TD1.neaMax=Tiles[nTile].neaMax;
+     TD1.nebMin=Tiles[nTile].nebMin;
+     TD1.nebMax=Tiles[nTile].nebMax;
+     double TileTime=Secs();
      GSSIThread((void *)&TD1);
+     BusyTime[nt] += Secs() - TileTime;
      for(int n=0; n<NUMPPIALGORITHMS; n++)
-      PPIAlgorithmCount[n] += TD1.PPIAlgorithmCount[n];
+      PPIAlgorithmCounts[nt*NUMPPIALGORITHMS + n] += TD1.PPIAlgorithmCount[n];
    };
 #endif
+  WallTime=Secs()-WallTime;
+
+  unsigned PPIAlgorithmCount[NUMPPIALGORITHMS];  
+  memset(PPIAlgorithmCount, 0, NUMPPIALGORITHMS*sizeof(unsigned));
+  for(int nt=0; nt<NumThreads; nt++)
+   for(int n=0; n<NUMPPIALGORITHMS; n++)
+    PPIAlgorithmCount[n] += PPIAlgorithmCounts[nt*NUMPPIALGORITHMS + n];
+
+  /***************************************************************/
+  /* report load balance *****************************************/
+  /***************************************************************/
+  if (G->LogLevel>=SCUFF_VERBOSELOGGING && NumThreads>1 && WallTime>0.0)
+   { double TotalBusy=0.0;
+     for(int nt=0; nt<NumThreads; nt++)
+      TotalBusy+=BusyTime[nt];
+     Log(" %i tiles on %i threads: %.2f s wall, %.1f %% thread utilization",
+          NumTiles,NumThreads,WallTime,100.0*TotalBusy/(NumThreads*WallTime));
+     if (G->LogLevel>=SCUFF_VERBOSE2)
+      for(int nt=0; nt<NumThreads; nt++)
+       Log("  thread %2i: busy %.3f s, idle %.3f s",nt,BusyTime[nt],WallTime-BusyTime[nt]);
+   };
+  delete[] BusyTime;
+  delete[] PPIAlgorithmCounts;
+  delete[] Tiles;
 
   if (G->LogLevel>=SCUFF_VERBOSE2)
    { Log("  %i/%i cache hits/misses",GlobalFIPPICache.Hits,GlobalFIPPICache.Misses);
@@ -557,6 +888,9 @@ void GetSurfaceSurfaceInteractions(GetSSIArgStruct *Args)
             PPIAlgorithmCount[PPIALG_DESING]);
    };
 
+  if (Args->GCBuffer)
+   return;
+
   /***************************************************************/
   /* 20120526 handle objects with finite surface conductivity    */
   /***************************************************************/
@@ -624,6 +958,8 @@ void InitGetSSIArgs(GetSSIArgStruct *Args)
 
   Args->Accumulate=false;
 
+  Args->GCBuffer=0;
+
 }
 
 } // namespace scuff
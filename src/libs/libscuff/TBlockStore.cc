@@ -0,0 +1,716 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * TBlockStore.cc -- content-addressed on-disk store of the diagonal
+ *                -- ("T") blocks of the BEM matrix, which may be
+ *                -- shared by many jobs using the same object meshes
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBZ
+#  include <zlib.h>
+#endif
+
+#include <libhrutil.h>
+
+#include "libscuff.h"
+#include "libscuffInternals.h"
+#include "cmatheval.h"
+
+#define MAXSTR 1000
+
+namespace scuff {
+
+/***************************************************************/
+/* The store is a directory (SCUFF_TBLOCK_PATH) containing one */
+/* file per T-block, named by the 64-bit hash of a key that    */
+/* identifies the block by content:                            */
+/*                                                             */
+/*  -- a hash of the mesh (connectivity and vertex coordinates */
+/*     relative to the first vertex, in the untransformed      */
+/*     frame, so that displaced copies of the same mesh share  */
+/*     their blocks)                                           */
+/*  -- the material properties of the two regions bounded by   */
+/*     the surface at the given frequency, together with the   */
+/*     interior/exterior ('Zeroed') flags, PEC flag, and the   */
+/*     surface-impedance expression if any                     */
+/*  -- Omega, kBloch, and the lattice basis (if any)           */
+/*  -- the numerical options that affect the matrix elements   */
+/*     and the optional G->TBlockCacheNameAddendum string      */
+/*                                                             */
+/* The full key is stored in the file and checked on reading,  */
+/* as is a checksum of the data.                               */
+/*                                                             */
+/* Block files are written under a temporary name and renamed  */
+/* into place, so concurrent jobs on a shared filesystem never */
+/* see partially-written blocks. Symmetric blocks are stored   */
+/* as their upper triangle and, if libz is available, the data */
+/* are byte-shuffled and deflated.                             */
+/*                                                             */
+/* After each write, the writer locks the store and rewrites   */
+/* the text index file 'TBlockIndex', which lists the blocks   */
+/* in the store together with their sizes and descriptions.    */
+/* If SCUFF_TBLOCK_BUDGET is set (in bytes, with optional      */
+/* K/M/G suffix), least-recently-used blocks are deleted until */
+/* the store fits within the budget. (Reading a block updates  */
+/* the modification time of its file, which serves as the      */
+/* access time for this purpose.)                              */
+/*                                                             */
+/* SCUFF_TBLOCK_READPATH may be used instead of                */
+/* SCUFF_TBLOCK_PATH to use an existing store read-only.       */
+/***************************************************************/
+#define TBS_VERSION     1
+#define TBS_KEYWORDS    24
+#define TBS_HEADERSIZE  64
+#define TBS_FILEHEADER  (TBS_HEADERSIZE + 8*TBS_KEYWORDS)
+
+#define TBS_SYMMETRIC   1
+#define TBS_SHUFFLED    2
+#define TBS_DEFLATED    4
+
+static const char TBS_Signature[8]={'S','C','U','F','F','T','B','K'};
+static const char *TBS_IndexName="TBlockIndex";
+
+/*--------------------------------------------------------------*/
+/*- little-endian packing and hashing --------------------------*/
+/*--------------------------------------------------------------*/
+static void Put64(unsigned char *p, uint64_t u)
+{ for(int n=0; n<8; n++) p[n] = (unsigned char)(u>>(8*n)); }
+
+static uint64_t Get64(const unsigned char *p)
+{ uint64_t u=0;
+  for(int n=7; n>=0; n--) u = (u<<8) | p[n];
+  return u;
+}
+
+static uint64_t DoubleBits(double x)
+{ uint64_t u;
+  memcpy(&u, &x, 8);
+  return u;
+}
+
+static double BitsDouble(uint64_t u)
+{ double x;
+  memcpy(&x, &u, 8);
+  return x;
+}
+
+static uint64_t FNVHash(const void *Data, size_t Size, uint64_t h=14695981039346656037ULL)
+{ const unsigned char *p=(const unsigned char *)Data;
+  for(size_t n=0; n<Size; n++)
+   { h ^= p[n];
+     h *= 1099511628211ULL;
+   };
+  return h;
+}
+
+static uint64_t StringHash(const char *s)
+{ return s ? FNVHash(s, strlen(s)) : 0; }
+
+/***************************************************************/
+/* hash of the mesh of surface S. vertex coordinates are taken */
+/* relative to the first vertex, in the untransformed frame,   */
+/* and rounded to a small fraction of the size of the mesh, so */
+/* that the hash is unaffected by displacements and by the     */
+/* roundoff incurred in transforming and untransforming it.    */
+/***************************************************************/
+static uint64_t GetMeshHash(RWGSurface *S)
+{
+  int NV=S->NumVertices;
+  double *V=(double *)memdup((void *)S->Vertices, 3*NV*sizeof(double));
+  if (S->GT) S->GT->UnApply(V, NV);
+
+  double Min[3], Max[3];
+  VecCopy(V, Min);
+  VecCopy(V, Max);
+  for(int nv=1; nv<NV; nv++)
+   for(int i=0; i<3; i++)
+    { if (V[3*nv+i] < Min[i]) Min[i]=V[3*nv+i];
+      if (V[3*nv+i] > Max[i]) Max[i]=V[3*nv+i];
+    };
+  double Quantum = 1.0e-8 * VecDistance(Min, Max);
+  if (Quantum==0.0) Quantum=1.0;
+
+  unsigned char Word[8];
+  Put64(Word, (uint64_t)NV);
+  uint64_t h=FNVHash(Word, 8);
+  for(int nv=0; nv<NV; nv++)
+   for(int i=0; i<3; i++)
+    { Put64(Word, (uint64_t)llround( (V[3*nv+i]-V[i]) / Quantum ));
+      h=FNVHash(Word, 8, h);
+    };
+  free(V);
+
+  Put64(Word, (uint64_t)S->NumPanels);
+  h=FNVHash(Word, 8, h);
+  for(int np=0; np<S->NumPanels; np++)
+   for(int i=0; i<3; i++)
+    { Put64(Word, (uint64_t)S->Panels[np]->VI[i]);
+      h=FNVHash(Word, 8, h);
+    };
+
+  Put64(Word, (uint64_t)S->NumEdges);
+  return FNVHash(Word, 8, h);
+}
+
+/***************************************************************/
+/* assemble the key for the T-block of surface ns, as          */
+/* TBS_KEYWORDS little-endian 64-bit words                     */
+/***************************************************************/
+static void GetTBlockKey(RWGGeometry *G, int ns, cdouble Omega, double *kBloch,
+                         int RealComplex, unsigned char *Key)
+{
+  RWGSurface *S=G->Surfaces[ns];
+  uint64_t W[TBS_KEYWORDS];
+  memset(W, 0, TBS_KEYWORDS*sizeof(uint64_t));
+
+  int nr1=S->RegionIndices[0], nr2=S->RegionIndices[1];
+  uint64_t Flags=0;
+  if (S->IsPEC)                                  Flags|=1;
+  if (RealComplex==LHM_COMPLEX)                  Flags|=2;
+  if (G->RegionMPs[nr1]->Zeroed)                 Flags|=4;
+  if (nr2!=-1 && G->RegionMPs[nr2]->Zeroed)      Flags|=8;
+  if (RWGGeometry::UseHighKTaylorDuffy)          Flags|=16;
+  if (RWGGeometry::UseTaylorDuffyV2P0)           Flags|=32;
+  if (RWGGeometry::DisableCache)                 Flags|=64;
+
+  W[0] = TBS_VERSION;
+  W[1] = GetMeshHash(S);
+  W[2] = (uint64_t)S->NumBFs;
+  W[3] = Flags;
+  W[4] = StringHash(S->SurfaceZeta ? cevaluator_get_string(S->SurfaceZeta) : 0)
+        ^ (StringHash(G->TBlockCacheNameAddendum)<<1);
+  W[5] = DoubleBits(real(Omega));
+  W[6] = DoubleBits(imag(Omega));
+
+  int nw=7;
+  for(int nd=0; nd<G->LDim; nd++)
+   { W[nw++] = DoubleBits(kBloch[nd]);
+     for(int i=0; i<3; i++)
+      W[nw++] = DoubleBits(G->LBasis->GetEntryD(i,nd));
+   };
+
+  nw=15;
+  for(int nr=0; nr<2; nr++)
+   { int Region = S->RegionIndices[nr];
+     if (Region==-1) continue;
+     cdouble Eps, Mu;
+     G->RegionMPs[Region]->GetEpsMu(Omega, &Eps, &Mu);
+     W[nw+4*nr+0] = DoubleBits(real(Eps));
+     W[nw+4*nr+1] = DoubleBits(imag(Eps));
+     W[nw+4*nr+2] = DoubleBits(real(Mu));
+     W[nw+4*nr+3] = DoubleBits(imag(Mu));
+   };
+
+  for(int n=0; n<TBS_KEYWORDS; n++)
+   Put64(Key + 8*n, W[n]);
+}
+
+static void GetTBlockFileName(const char *Dir, uint64_t Hash, char *FileName, size_t Size)
+{ snprintf(FileName, Size, "%s/%016llx.tblk", Dir, (unsigned long long)Hash); }
+
+/*--------------------------------------------------------------*/
+/*- byte shuffling: word n, byte b <--> byte b*NumWords + n;    */
+/*- this groups the sign/exponent bytes of the doubles together */
+/*- and makes them much more compressible                       */
+/*--------------------------------------------------------------*/
+static void Shuffle(const unsigned char *In, unsigned char *Out, size_t NumWords, bool Inverse)
+{ for(size_t n=0; n<NumWords; n++)
+   for(int b=0; b<8; b++)
+    { if (Inverse)
+       Out[8*n+b] = In[b*NumWords+n];
+      else
+       Out[b*NumWords+n] = In[8*n+b];
+    };
+}
+
+/***************************************************************/
+/* copy the block of M to (or from) a buffer of little-endian   */
+/* words, storing only the upper triangle if Symmetric          */
+/***************************************************************/
+static bool BlockIsSymmetric(HMatrix *M, int NBF, int RowOffset, int ColOffset)
+{
+  for(int nc=0; nc<NBF; nc++)
+   for(int nr=0; nr<nc; nr++)
+    if ( M->GetEntry(RowOffset+nr, ColOffset+nc) != M->GetEntry(RowOffset+nc, ColOffset+nr) )
+     return false;
+  return true;
+}
+
+static size_t NumBlockWords(int NBF, bool IsComplex, bool Symmetric)
+{ size_t NE = Symmetric ? ((size_t)NBF)*(NBF+1)/2 : ((size_t)NBF)*NBF;
+  return IsComplex ? 2*NE : NE;
+}
+
+static void PackBlock(HMatrix *M, int NBF, int RowOffset, int ColOffset,
+                      bool Symmetric, unsigned char *Buffer)
+{
+  bool IsComplex = (M->RealComplex==LHM_COMPLEX);
+  size_t nw=0;
+  for(int nc=0; nc<NBF; nc++)
+   for(int nr=0; nr<=(Symmetric ? nc : NBF-1); nr++)
+    { if (IsComplex)
+       { cdouble z=M->GetEntry(RowOffset+nr, ColOffset+nc);
+         Put64(Buffer + 8*(nw++), DoubleBits(real(z)));
+         Put64(Buffer + 8*(nw++), DoubleBits(imag(z)));
+       }
+      else
+       Put64(Buffer + 8*(nw++), DoubleBits(M->GetEntryD(RowOffset+nr, ColOffset+nc)));
+    };
+}
+
+static void UnpackBlock(const unsigned char *Buffer, bool Symmetric,
+                        HMatrix *M, int NBF, int RowOffset, int ColOffset)
+{
+  bool IsComplex = (M->RealComplex==LHM_COMPLEX);
+  size_t nw=0;
+  for(int nc=0; nc<NBF; nc++)
+   for(int nr=0; nr<=(Symmetric ? nc : NBF-1); nr++)
+    { if (IsComplex)
+       { double re=BitsDouble(Get64(Buffer + 8*(nw++)));
+         double im=BitsDouble(Get64(Buffer + 8*(nw++)));
+         M->SetEntry(RowOffset+nr, ColOffset+nc, cdouble(re,im));
+         if (Symmetric && nr!=nc)
+          M->SetEntry(RowOffset+nc, ColOffset+nr, cdouble(re,im));
+       }
+      else
+       { double x=BitsDouble(Get64(Buffer + 8*(nw++)));
+         M->SetEntry(RowOffset+nr, ColOffset+nc, x);
+         if (Symmetric && nr!=nc)
+          M->SetEntry(RowOffset+nc, ColOffset+nr, x);
+       };
+    };
+}
+
+/*--------------------------------------------------------------*/
+/*- robust read/write of full buffers --------------------------*/
+/*--------------------------------------------------------------*/
+static bool ReadFully(int fd, void *Buffer, size_t Size)
+{ char *p=(char *)Buffer;
+  while(Size>0)
+   { ssize_t n=read(fd, p, Size);
+     if (n<0 && errno==EINTR) continue;
+     if (n<=0) return false;
+     p+=n; Size-=n;
+   };
+  return true;
+}
+
+static bool WriteFully(int fd, const void *Buffer, size_t Size)
+{ const char *p=(const char *)Buffer;
+  while(Size>0)
+   { ssize_t n=write(fd, p, Size);
+     if (n<0 && errno==EINTR) continue;
+     if (n<=0) return false;
+     p+=n; Size-=n;
+   };
+  return true;
+}
+
+/***************************************************************/
+/* parse SCUFF_TBLOCK_BUDGET                                   */
+/***************************************************************/
+static double GetTBlockBudget()
+{
+  char *s=getenv("SCUFF_TBLOCK_BUDGET");
+  if (!s) return 0.0;
+  double Budget=0.0;
+  char Suffix=0;
+  if (sscanf(s,"%le%c",&Budget,&Suffix)<1 || Budget<0.0)
+   { Warn("invalid value %s for SCUFF_TBLOCK_BUDGET (ignoring)",s);
+     return 0.0;
+   };
+  switch(Suffix)
+   { case 'k': case 'K': Budget*=1.0e3; break;
+     case 'm': case 'M': Budget*=1.0e6; break;
+     case 'g': case 'G': Budget*=1.0e9; break;
+     case 't': case 'T': Budget*=1.0e12; break;
+   };
+  return Budget;
+}
+
+/***************************************************************/
+/* update the index of the store and enforce the disk budget.  */
+/* the caller has just written the block with hash NewHash and */
+/* description NewLabel. we hold an exclusive lock on the      */
+/* index file while doing this, so concurrent writers update   */
+/* the index one at a time.                                    */
+/***************************************************************/
+typedef struct TBSEntry
+ { uint64_t Hash;
+   off_t Size;
+   time_t LastAccess;
+   char *Label;
+ } TBSEntry;
+
+static int CompareEntries(const void *p1, const void *p2)
+{ const TBSEntry *E1=(const TBSEntry *)p1, *E2=(const TBSEntry *)p2;
+  if (E1->LastAccess != E2->LastAccess)
+   return E1->LastAccess < E2->LastAccess ? -1 : 1;
+  return E1->Hash < E2->Hash ? -1 : (E1->Hash > E2->Hash ? 1 : 0);
+}
+
+static void UpdateTBlockIndex(const char *Dir, uint64_t NewHash, const char *NewLabel)
+{
+  char LockName[MAXSTR], IndexName[MAXSTR], TmpName[MAXSTR], FileName[MAXSTR];
+  snprintf(LockName,  MAXSTR, "%s/%s.lock", Dir, TBS_IndexName);
+  snprintf(IndexName, MAXSTR, "%s/%s", Dir, TBS_IndexName);
+  snprintf(TmpName,   MAXSTR, "%s/%s.%i.tmp", Dir, TBS_IndexName, (int)getpid());
+
+  int LockFD=open(LockName, O_RDWR | O_CREAT, 0666);
+  if (LockFD<0)
+   { Log("...could not open lock file %s (%s)",LockName,strerror(errno));
+     return;
+   };
+  struct flock FL;
+  memset(&FL, 0, sizeof(FL));
+  FL.l_type=F_WRLCK;
+  FL.l_whence=SEEK_SET;
+  while( fcntl(LockFD, F_SETLKW, &FL)==-1 )
+   if (errno!=EINTR)
+    { Log("...could not lock %s (%s)",LockName,strerror(errno));
+      close(LockFD);
+      return;
+    };
+
+  /*--------------------------------------------------------------*/
+  /*- the entries of the index are the block files actually       */
+  /*- present in the directory; we take their descriptions from   */
+  /*- the old index where available                               */
+  /*--------------------------------------------------------------*/
+  int NumEntries=0, MaxEntries=0;
+  TBSEntry *Entries=0;
+  DIR *D=opendir(Dir);
+  struct dirent *DE;
+  while( D && (DE=readdir(D)) )
+   { unsigned long long Hash;
+     char Tail[8];
+     if ( sscanf(DE->d_name, "%16llx.%7s", &Hash, Tail)!=2 || strcmp(Tail,"tblk") )
+      continue;
+     struct stat st;
+     snprintf(FileName, MAXSTR, "%s/%s", Dir, DE->d_name);
+     if ( stat(FileName, &st) )
+      continue;
+     if (NumEntries==MaxEntries)
+      { MaxEntries = MaxEntries ? 2*MaxEntries : 64;
+        Entries = (TBSEntry *)reallocEC(Entries, MaxEntries*sizeof(TBSEntry));
+      };
+     Entries[NumEntries].Hash=(uint64_t)Hash;
+     Entries[NumEntries].Size=st.st_size;
+     Entries[NumEntries].LastAccess=st.st_mtime;
+     Entries[NumEntries].Label=0;
+     NumEntries++;
+   };
+  if (D) closedir(D);
+  qsort(Entries, NumEntries, sizeof(TBSEntry), CompareEntries);
+
+  FILE *f=fopen(IndexName,"r");
+  char Line[MAXSTR];
+  while( f && fgets(Line, MAXSTR, f) )
+   { unsigned long long Hash;
+     long Size;
+     int n;
+     if ( Line[0]=='#' || sscanf(Line, "%llx %li %n", &Hash, &Size, &n)<2 )
+      continue;
+     char *Label=Line+n;
+     Label[strcspn(Label,"\n")]=0;
+     for(int ne=0; ne<NumEntries; ne++)
+      if (Entries[ne].Hash==(uint64_t)Hash && Entries[ne].Label==0)
+       Entries[ne].Label=strdup(Label);
+   };
+  if (f) fclose(f);
+  for(int ne=0; ne<NumEntries; ne++)
+   if (Entries[ne].Hash==NewHash)
+    { free(Entries[ne].Label);
+      Entries[ne].Label=strdup(NewLabel);
+    };
+
+  /*--------------------------------------------------------------*/
+  /*- evict least-recently-used blocks until we fit in the budget */
+  /*--------------------------------------------------------------*/
+  double Budget=GetTBlockBudget(), TotalSize=0.0;
+  for(int ne=0; ne<NumEntries; ne++)
+   TotalSize+=(double)Entries[ne].Size;
+  int NumEvicted=0;
+  for(int ne=0; Budget>0.0 && TotalSize>Budget && ne<NumEntries; ne++)
+   { if (Entries[ne].Hash==NewHash)
+      continue;
+     GetTBlockFileName(Dir, Entries[ne].Hash, FileName, MAXSTR);
+     if ( unlink(FileName) && errno!=ENOENT )
+      continue;
+     TotalSize-=(double)Entries[ne].Size;
+     Entries[ne].Size=-1;
+     NumEvicted++;
+   };
+  if (NumEvicted>0)
+   Log("...evicted %i T-blocks from %s to stay within budget of %g bytes",NumEvicted,Dir,Budget);
+
+  /*--------------------------------------------------------------*/
+  /*- write the new index and rename it into place                -*/
+  /*--------------------------------------------------------------*/
+  f=fopen(TmpName,"w");
+  if (f)
+   { fprintf(f,"# SCUFF-EM T-block store, version %i\n",TBS_VERSION);
+     fprintf(f,"# hash             size(bytes)  description (least recently used first)\n");
+     for(int ne=0; ne<NumEntries; ne++)
+      if (Entries[ne].Size>=0)
+       fprintf(f,"%016llx %li %s\n",(unsigned long long)Entries[ne].Hash,
+                  (long)Entries[ne].Size, Entries[ne].Label ? Entries[ne].Label : "?");
+     if ( fclose(f) || rename(TmpName, IndexName) )
+      { Log("...could not update index %s (%s)",IndexName,strerror(errno));
+        unlink(TmpName);
+      };
+   };
+
+  for(int ne=0; ne<NumEntries; ne++)
+   free(Entries[ne].Label);
+  free(Entries);
+
+  FL.l_type=F_UNLCK;
+  fcntl(LockFD, F_SETLK, &FL);
+  close(LockFD);
+}
+
+/***************************************************************/
+/* try to read the T-block of surface ns at (Omega, kBloch)     */
+/* from the store into the block of M at (RowOffset, ColOffset).*/
+/* returns true on success, false (leaving M untouched) if the  */
+/* block is not in the store or the store is not in use.        */
+/***************************************************************/
+bool ReadTBlockStore(RWGGeometry *G, int ns, cdouble Omega, double *kBloch,
+                     HMatrix *M, int RowOffset, int ColOffset)
+{
+  bool ReadOnly=false;
+  char *Dir = getenv("SCUFF_TBLOCK_PATH");
+  if (!Dir)
+   { Dir = getenv("SCUFF_TBLOCK_READPATH");
+     ReadOnly=true;
+   };
+  if (!Dir) return false;
+
+  RWGSurface *S = G->Surfaces[ns];
+  int NBF = S->NumBFs;
+  bool IsComplex = (M->RealComplex==LHM_COMPLEX);
+
+  unsigned char Key[8*TBS_KEYWORDS];
+  GetTBlockKey(G, ns, Omega, kBloch, M->RealComplex, Key);
+  uint64_t Hash=FNVHash(Key, 8*TBS_KEYWORDS);
+  char FileName[MAXSTR];
+  GetTBlockFileName(Dir, Hash, FileName, MAXSTR);
+
+  int fd=open(FileName, O_RDONLY);
+  if (fd<0)
+   { Log("T-block (%s,%s) not found in store %s",S->Label,z2s(Omega),Dir);
+     return false;
+   };
+
+  /*--------------------------------------------------------------*/
+  /*- check the header and the key -------------------------------*/
+  /*--------------------------------------------------------------*/
+  unsigned char Header[TBS_FILEHEADER];
+  const char *ErrMsg=0;
+  if ( !ReadFully(fd, Header, TBS_FILEHEADER) )
+   ErrMsg="file too short";
+  else if ( memcmp(Header, TBS_Signature, 8) || Get64(Header+8)!=TBS_VERSION )
+   ErrMsg="not a T-block file of the current version";
+  else if ( memcmp(Header+TBS_HEADERSIZE, Key, 8*TBS_KEYWORDS) )
+   ErrMsg="key mismatch";
+
+  uint64_t Flags       = Get64(Header+16);
+  uint64_t NumWords    = Get64(Header+24);
+  uint64_t StoredSize  = Get64(Header+32);
+  uint64_t Checksum    = Get64(Header+40);
+  bool Symmetric       = (Flags & TBS_SYMMETRIC);
+  if ( !ErrMsg && NumWords!=NumBlockWords(NBF, IsComplex, Symmetric) )
+   ErrMsg="incorrect block size";
+#ifndef HAVE_LIBZ
+  if ( !ErrMsg && (Flags & TBS_DEFLATED) )
+   ErrMsg="block is compressed, but libscuff was built without libz";
+#endif
+
+  unsigned char *Stored=0, *Buffer=0;
+  if (!ErrMsg)
+   { Stored=(unsigned char *)mallocEC(StoredSize);
+     if ( !ReadFully(fd, Stored, StoredSize) )
+      ErrMsg="file too short";
+     else if ( FNVHash(Stored, StoredSize)!=Checksum )
+      ErrMsg="checksum mismatch";
+   };
+  close(fd);
+
+  /*--------------------------------------------------------------*/
+  /*- decompress and unshuffle ------------------------------------*/
+  /*--------------------------------------------------------------*/
+  if (!ErrMsg)
+   { size_t RawSize=8*NumWords;
+     unsigned char *Raw=Stored;
+#ifdef HAVE_LIBZ
+     if (Flags & TBS_DEFLATED)
+      { Raw=(unsigned char *)mallocEC(RawSize);
+        uLongf DestLen=RawSize;
+        if (    uncompress(Raw, &DestLen, Stored, StoredSize)!=Z_OK
+             || DestLen!=RawSize )
+         ErrMsg="could not decompress data";
+      }
+     else
+#endif
+     if (StoredSize!=RawSize)
+      ErrMsg="incorrect data size";
+
+     if (!ErrMsg && (Flags & TBS_SHUFFLED))
+      { Buffer=(unsigned char *)mallocEC(RawSize);
+        Shuffle(Raw, Buffer, NumWords, true);
+        if (Raw!=Stored) free(Raw);
+      }
+     else if (Raw!=Stored)
+      Buffer=Raw;
+   };
+
+  if (ErrMsg)
+   { Log("Could not read T-block (%s,%s) from %s: %s",S->Label,z2s(Omega),FileName,ErrMsg);
+     free(Stored);
+     free(Buffer);
+     return false;
+   };
+
+  UnpackBlock(Buffer ? Buffer : Stored, Symmetric, M, NBF, RowOffset, ColOffset);
+  free(Stored);
+  free(Buffer);
+
+  // mark the block as recently used
+  if (!ReadOnly)
+   utime(FileName, 0);
+
+  Log("Read T-block (%s,%s) from %s",S->Label,z2s(Omega),FileName);
+  return true;
+}
+
+/***************************************************************/
+/* write the T-block of surface ns at (Omega, kBloch), which is */
+/* the block of M at (RowOffset, ColOffset), to the store.      */
+/***************************************************************/
+bool WriteTBlockStore(RWGGeometry *G, int ns, cdouble Omega, double *kBloch,
+                      HMatrix *M, int RowOffset, int ColOffset)
+{
+  char *Dir = getenv("SCUFF_TBLOCK_PATH");
+  if (!Dir) return false;
+
+  RWGSurface *S = G->Surfaces[ns];
+  int NBF = S->NumBFs;
+  bool IsComplex = (M->RealComplex==LHM_COMPLEX);
+
+  unsigned char Header[TBS_FILEHEADER];
+  memset(Header, 0, TBS_FILEHEADER);
+  GetTBlockKey(G, ns, Omega, kBloch, M->RealComplex, Header+TBS_HEADERSIZE);
+  uint64_t Hash=FNVHash(Header+TBS_HEADERSIZE, 8*TBS_KEYWORDS);
+  char FileName[MAXSTR], TmpName[MAXSTR+80]; // room for ".host.pid.tmp"
+  GetTBlockFileName(Dir, Hash, FileName, MAXSTR);
+
+  /*--------------------------------------------------------------*/
+  /*- pack, shuffle, and compress the data ------------------------*/
+  /*--------------------------------------------------------------*/
+  bool Symmetric = BlockIsSymmetric(M, NBF, RowOffset, ColOffset);
+  uint64_t Flags = Symmetric ? TBS_SYMMETRIC : 0;
+  size_t NumWords = NumBlockWords(NBF, IsComplex, Symmetric);
+  size_t RawSize = 8*NumWords;
+  unsigned char *Raw=(unsigned char *)mallocEC(RawSize);
+  PackBlock(M, NBF, RowOffset, ColOffset, Symmetric, Raw);
+  unsigned char *Stored=Raw;
+  size_t StoredSize=RawSize;
+#ifdef HAVE_LIBZ
+  unsigned char *Shuffled=(unsigned char *)mallocEC(RawSize);
+  Shuffle(Raw, Shuffled, NumWords, false);
+  uLongf DestLen=compressBound(RawSize);
+  unsigned char *Deflated=(unsigned char *)mallocEC(DestLen);
+  if ( compress2(Deflated, &DestLen, Shuffled, RawSize, 1)==Z_OK && DestLen<RawSize )
+   { Flags |= TBS_SHUFFLED | TBS_DEFLATED;
+     Stored=Deflated;
+     StoredSize=DestLen;
+     free(Raw);
+   }
+  else
+   free(Deflated);
+  free(Shuffled);
+#endif
+
+  memcpy(Header, TBS_Signature, 8);
+  Put64(Header+8,  TBS_VERSION);
+  Put64(Header+16, Flags);
+  Put64(Header+24, NumWords);
+  Put64(Header+32, StoredSize);
+  Put64(Header+40, FNVHash(Stored, StoredSize));
+
+  /*--------------------------------------------------------------*/
+  /*- write to a temporary file, then rename into place ----------*/
+  /*--------------------------------------------------------------*/
+  char HostName[64]="";
+  gethostname(HostName, 63);
+  snprintf(TmpName, MAXSTR+80, "%s.%s.%i.tmp", FileName, HostName, (int)getpid());
+  bool Success=false;
+  int fd=open(TmpName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd<0)
+   Log("Could not write T-block to %s (%s)",TmpName,strerror(errno));
+  else
+   { Success =    WriteFully(fd, Header, TBS_FILEHEADER)
+               && WriteFully(fd, Stored, StoredSize)
+               && fsync(fd)==0;
+     Success = (close(fd)==0) && Success;
+     if ( Success && rename(TmpName, FileName) )
+      Success=false;
+     if (!Success)
+      { Log("Could not write T-block to %s (%s)",FileName,strerror(errno));
+        unlink(TmpName);
+      };
+   };
+  free(Stored);
+
+  if (Success)
+   { Log("Wrote T-block (%s,%s) to %s (%lu bytes%s)",S->Label,z2s(Omega),FileName,
+          (unsigned long)(TBS_FILEHEADER+StoredSize), (Flags & TBS_DEFLATED) ? ", compressed" : "");
+     int nr1=S->RegionIndices[0], nr2=S->RegionIndices[1];
+     const char *Which="";
+     if (G->RegionMPs[nr1]->Zeroed)
+      Which=" (interior only)";
+     else if (nr2!=-1 && G->RegionMPs[nr2]->Zeroed)
+      Which=" (exterior only)";
+     char Label[MAXSTR];
+     snprintf(Label, MAXSTR, "%s Omega=%s%s%s", S->MeshFileName, z2s(Omega),
+              Which, G->LDim ? " (periodic)" : "");
+     UpdateTBlockIndex(Dir, Hash, Label);
+   };
+
+  return Success;
+}
+
+} // namespace scuff
@@ -776,11 +776,9 @@ void RWGGeometry::PlotSurfaceCurrents(const char *SurfaceLabel,
   /***************************************************************/
   /***************************************************************/
   /***************************************************************/
-  static HMatrix *PSD=0;
-  if (PSD==0)
-   PSD=GetPanelSourceDensities(Omega, kBloch, KN, 0);
-  else
-   PSD=GetPanelSourceDensities(Omega, kBloch, KN, PSD);
+  Workspace *WS = AcquireWorkspace();
+  HMatrix *PSD = WS->GetHMatrix(WS_PSD, TotalPanels, PSD_MATRIX_COLUMNS);
+  GetPanelSourceDensities(Omega, kBloch, KN, PSD);
 
   /***************************************************************/
   /***************************************************************/
@@ -858,6 +856,7 @@ void RWGGeometry::PlotSurfaceCurrents(const char *SurfaceLabel,
 
   if (!NeedMagnetic)
    { fclose(f); 
+     ReleaseWorkspace(WS);
      return;
    };
 
@@ -944,6 +943,7 @@ void RWGGeometry::PlotSurfaceCurrents(const char *SurfaceLabel,
 
 
   fclose(f);
+  ReleaseWorkspace(WS);
 
 }
 
@@ -0,0 +1,113 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Workspace.cc -- scratch storage for post-processing routines
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "libscuff.h"
+
+namespace scuff {
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+Workspace::Workspace()
+{
+  for(int ns=0; ns<WS_NUMSLOTS; ns++)
+   { Matrices[ns]=0;
+     Buffers[ns]=0;
+     BufferSizes[ns]=0;
+   };
+}
+
+Workspace::~Workspace()
+{
+  for(int ns=0; ns<WS_NUMSLOTS; ns++)
+   { if (Matrices[ns]) delete Matrices[ns];
+     if (Buffers[ns]) free(Buffers[ns]);
+   };
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+HMatrix *Workspace::GetHMatrix(int Slot, int NR, int NC, int RealComplex)
+{
+  if (Slot<0 || Slot>=WS_NUMSLOTS)
+   ErrExit("%s:%i: invalid workspace slot %i",__FILE__,__LINE__,Slot);
+
+  HMatrix *M=Matrices[Slot];
+  if ( M==0 || M->NR!=NR || M->NC!=NC || M->RealComplex!=RealComplex )
+   { if (M) delete M;
+     M=Matrices[Slot]=new HMatrix(NR, NC, RealComplex);
+   };
+  return M;
+}
+
+void *Workspace::GetBuffer(int Slot, size_t Size)
+{
+  if (Slot<0 || Slot>=WS_NUMSLOTS)
+   ErrExit("%s:%i: invalid workspace slot %i",__FILE__,__LINE__,Slot);
+
+  if (BufferSizes[Slot] < Size)
+   { if (Buffers[Slot]) free(Buffers[Slot]);
+     Buffers[Slot]=mallocEC(Size);
+     BufferSizes[Slot]=Size;
+   };
+  return Buffers[Slot];
+}
+
+/***************************************************************/
+/* the pool is a stack of idle Workspaces; it only ever grows  */
+/* to the largest number of simultaneous users.                */
+/***************************************************************/
+static pthread_mutex_t WSPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static Workspace **WSPool=0;
+static int WSPoolSize=0, WSPoolCapacity=0;
+
+Workspace *AcquireWorkspace()
+{
+  Workspace *WS=0;
+  pthread_mutex_lock(&WSPoolMutex);
+  if (WSPoolSize>0)
+   WS=WSPool[--WSPoolSize];
+  pthread_mutex_unlock(&WSPoolMutex);
+
+  return WS ? WS : new Workspace();
+}
+
+void ReleaseWorkspace(Workspace *WS)
+{
+  if (WS==0) return;
+  pthread_mutex_lock(&WSPoolMutex);
+  if (WSPoolSize==WSPoolCapacity)
+   { WSPoolCapacity = (WSPoolCapacity==0) ? 4 : 2*WSPoolCapacity;
+     WSPool=(Workspace **)reallocEC(WSPool, WSPoolCapacity*sizeof(Workspace *));
+   };
+  WSPool[WSPoolSize++]=WS;
+  pthread_mutex_unlock(&WSPoolMutex);
+}
+
+} // namespace scuff
@@ -0,0 +1,98 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Workspace.h -- scratch storage for post-processing routines
+ *             -- (GetDyadicGFs, GetSRFluxTrace, EMT/moment PFTs, ...)
+ *             -- that are called many times with the same sizes
+ */
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h>
+#include <libhmat.h>
+
+namespace scuff {
+
+/***************************************************************/
+/* one slot per scratch buffer. a routine only ever touches    */
+/* its own slots, so a single Workspace may be shared by all   */
+/* routines called from one thread.                            */
+/***************************************************************/
+enum WorkspaceSlot
+ { WS_DGF_RFSOURCE=0,      // GetDyadicGFs
+   WS_DGF_RFDEST,
+   WS_SRFLUX_RFMATRIX,     // GetSRFluxTrace
+   WS_SRFLUX_DELTA,
+   WS_EXTPFTT_DELTA,       // GetExtinctionPFTT
+   WS_EMTPFT_DELTA,        // GetEMTPFTMatrix
+   WS_EMTPFT_SCATTERED,
+   WS_EMTPFT_EXTINCTION,
+   WS_MOMENTPFT_SCATTERED, // GetMomentPFTMatrix
+   WS_MOMENTPFT_EXTINCTION,
+   WS_MOMENTPFT_PM,
+   WS_PSD,                 // PlotSurfaceCurrents
+   WS_NUMSLOTS
+ };
+
+/***************************************************************/
+/* a Workspace owns the scratch matrices and buffers of the    */
+/* routines above. storage is (re)allocated only when a slot   */
+/* is requested with a new size, so repeated calls with the    */
+/* same sizes do no allocation at all.                         */
+/*                                                             */
+/* routines that accept a Workspace use a pooled one if none   */
+/* is passed, so concurrent calls from different threads are   */
+/* always safe; callers that make many calls from the same     */
+/* thread may keep their own Workspace to skip the pool.       */
+/***************************************************************/
+class Workspace
+ {
+public:
+   Workspace();
+   ~Workspace();
+
+   // return the matrix in slot #Slot, reallocating it only if
+   // it does not already have the requested shape and type.
+   // contents are undefined on return.
+   HMatrix *GetHMatrix(int Slot, int NR, int NC,
+                       int RealComplex=LHM_COMPLEX);
+
+   // return a buffer of at least Size bytes in slot #Slot;
+   // buffers only grow. contents are undefined on return.
+   void *GetBuffer(int Slot, size_t Size);
+
+private:
+   HMatrix *Matrices[WS_NUMSLOTS];
+   void *Buffers[WS_NUMSLOTS];
+   size_t BufferSizes[WS_NUMSLOTS];
+ };
+
+/***************************************************************/
+/* thread-safe pool of Workspaces: AcquireWorkspace returns an */
+/* idle pooled Workspace (creating one if all are in use) and  */
+/* ReleaseWorkspace hands it back for reuse.                   */
+/***************************************************************/
+Workspace *AcquireWorkspace();
+void ReleaseWorkspace(Workspace *WS);
+
+} // namespace scuff
+
+#endif // #ifndef WORKSPACE_H
@@ -48,7 +48,11 @@
 #include "GTransformation.h"
 #include "FieldGrid.h"
 #include "GBarAccelerator.h"
+#include "Workspace.h"
 #include "PFTOptions.h"
+#include "ACAMatrix.h"
+#include "KrylovSolver.h"
+#include "BEMMatrixInterpolator.h"
 
 namespace scuff {
 
@@ -266,6 +270,10 @@ class RWGSurface
    GTransformation *GT;
    double Origin[3];
 
+   /* EdgeMoments, if non-NULL, points to an EdgeMomentData      */
+   /* structure (see libscuffInternals.h)                         */
+   void *EdgeMoments;
+
    /* SurfaceZeta, if non-NULL, points to a cevaluator for a      */
    /* user-specified function of frequency and position (w,x,y,z) */
    /* describing surface impedance in units of ZVAC               */
@@ -328,10 +336,16 @@ class RWGGeometry
    HMatrix *AssembleBEMMatrix(cdouble Omega, double *kBloch, HMatrix *M = NULL);
    HMatrix *AssembleBEMMatrix(cdouble Omega, HMatrix *M = NULL);
 
+   // compressed (hierarchical low-rank) storage of the BEM matrix
+   // for large compact geometries; see ACAMatrix.h
+   ACAMatrix *AssembleACAMatrix(cdouble Omega, ACAMatrix *M = NULL);
+
    HVector *AllocateRHSVector(bool PureImagFreq = false );
    HVector *AssembleRHSVector(cdouble Omega, double *kBloch,
                               IncField *IF, HVector *RHS = NULL);
    HVector *AssembleRHSVector(cdouble Omega, IncField *IF, HVector *RHS = NULL);
+   HMatrix *AssembleRHSMatrix(cdouble Omega, double *kBloch,
+                              IncField **IFs, int NumIFs, HMatrix *RHS = NULL);
 
    /*--------------------------------------------------------------*/
    /*- post-processing routines for computing fields               */
@@ -348,13 +362,19 @@ class RWGGeometry
    void GetFields(IncField *IF, HVector *KN, cdouble Omega,
                   double *X, cdouble *EH);
 
+   // fields for NumRHS solutions (the columns of KN) at once
+   HMatrix *GetFields(IncField **IFs, HMatrix *KN, int NumRHS,
+                      cdouble Omega, double *kBloch,
+                      HMatrix *XMatrix, HMatrix *FMatrix=NULL);
+
    /*--------------------------------------------------------------*/
    /*- post-processing routine for dyadic green's functions -------*/
    /*--------------------------------------------------------------*/
    HMatrix *GetDyadicGFs(cdouble Omega, double *kBloch,
                          HMatrix *XMatrix, HMatrix *M,
                          HMatrix *GMatrix=0, 
-                         bool ScatteringOnly=false);
+                         bool ScatteringOnly=false,
+                         Workspace *WS=0);
 
    // these next two are legacy interfaces which will be
    // removed in future versions
@@ -380,6 +400,7 @@ class RWGGeometry
    /*- post-processing routines for various other quantities      -*/
    /*--------------------------------------------------------------*/
    /* charge and current densities at panel centroids */
+#define PSD_MATRIX_COLUMNS 13
    HMatrix *GetPanelSourceDensities(cdouble Omega, double *kBloch, HVector *KN, HMatrix *PSD=0);
    HMatrix *GetPanelSourceDensities(cdouble Omega, HVector *KN, HMatrix *PSD=0);
 
@@ -459,6 +480,13 @@ class RWGGeometry
                         HMatrix *RFMatrix=0, bool MinuskBloch=false,
                         int ColumnOffset=0);
 
+   // multipole-accelerated alternative to GetRFMatrix for GetFields
+   void GetFieldsFMM(HVector *KN, cdouble Omega,
+                     HMatrix *XMatrix, HMatrix *FMatrix);
+
+   // max number of evaluation points per GetRFMatrix call in GetFields
+   int GetFieldChunkSize();
+
    // helper function for accelerating periodic GF calculations
    GBarAccelerator *CreateRegionGBA(int nr, cdouble Omega, double *kBloch, int ns1, int ns2);
    GBarAccelerator *CreateRegionGBA(int nr, cdouble Omega, double *kBloch, HMatrix *XMatrix);
@@ -510,6 +538,10 @@ class RWGGeometry
 
    void **FIBBICaches;
 
+   /* pool of periodic-GF interpolation tables shared by all     */
+   /* matrix blocks and field computations (see CreateRegionGBA) */
+   void *GBAPool;
+
    /**************************************************************/
    /* LDim=0 for compact geometries.                             */
    /* For geometries with D-dimensional Bloch-periodicity,       */
@@ -567,8 +599,15 @@ class RWGGeometry
    static bool AssignBasisFunctionsToExteriorEdges;
    static bool UseHighKTaylorDuffy;
    static bool UseGetFieldsV2P0;
+   static bool UseNewRFMethod;
    static bool UseTaylorDuffyV2P0;
    static bool DisableCache;
+   static bool UseSymmetricFactorization;
+   static double EdgeMomentThreshold;
+   static int GBAPoolSize;
+   static int FMMOrder;
+   static double FMMThreshold;
+   static double FieldChunkMemory;
  };
 
 /***************************************************************/
@@ -603,6 +642,21 @@ void PreloadCache(const char *FileName);
 void StoreCache(const char *FileName);
 void CheckLattice(HMatrix *LBasis);
 
+/*--------------------------------------------------------------*/
+/*- checkpoint files: append-only stores of integrand samples  -*/
+/*- keyed by (Tag, Omega, kBloch), which the applications use  -*/
+/*- to resume interrupted frequency and Brillouin-zone sweeps. -*/
+/*- kBloch is either null or a 2-vector.                       -*/
+/*--------------------------------------------------------------*/
+typedef struct CheckpointFile CheckpointFile;
+CheckpointFile *OpenCheckpointFile(const char *FileName, const char *Context,
+                                   int NumValues, bool ReadExisting=true);
+void CloseCheckpointFile(CheckpointFile *CPF);
+bool ReadCheckpoint(CheckpointFile *CPF, const char *Tag, cdouble Omega,
+                    const double *kBloch, double *Values);
+void WriteCheckpoint(CheckpointFile *CPF, const char *Tag, cdouble Omega,
+                     const double *kBloch, const double *Values);
+
 } // namespace scuff
 
 #endif // #ifndef LIBSCUFF_H
@@ -77,6 +77,7 @@ typedef struct GetPPIArgStruct
    int ForceTaylorDuffy;
    double *GammaMatrix;
    void *opFC; // 'opaque pointer to FIPPI cache'
+   void *opPPC; // 'opaque pointer to panel-pair cache' (optional)
 
    // this is an optional 3-vector displacement applied to object b
    double *Displacement;
@@ -105,6 +106,8 @@ typedef struct GetPPIArgStruct
  } GetPPIArgStruct;
 
 void InitGetPPIArgs(GetPPIArgStruct *Args);
+void *CreatePanelPairCache();
+void DestroyPanelPairCache(void *opPPC);
 void GetPanelPanelInteractions(GetPPIArgStruct *Args);
 void GetPanelPanelInteractions(GetPPIArgStruct *Args,
                                cdouble *H,
@@ -138,6 +141,10 @@ typedef struct GetEEIArgStruct
 
    void *opFC; // 'opaque pointer to FIPPI cache'
 
+   // optional cache of panel-pair moments for distant panels;
+   // valid only for fixed (Sa, Sb, k, Displacement)
+   void *opPPC;
+
    // this is used to force the code to use a specific
    // panel-integration algorithm; for diagnostic purposes only
    int Force;
@@ -242,6 +249,13 @@ typedef struct GetSSIArgStruct
    // augments (does not overwrite) the matrix entries
    bool Accumulate;
 
+   // if this is nonzero, the matrix is not touched; instead, the
+   // raw edge-edge integrals G and C for edge pair (nea,neb) in the
+   // first common region are stored in GCBuffer[2*(nea*NEb+neb)+{0,1}],
+   // and those for the second common region (if any) follow at
+   // offset 2*NEa*NEb. (used by BEMMatrixInterpolator)
+   cdouble *GCBuffer;
+
    // output fields filled in by routine
    HMatrix *B;
    HMatrix **GradB;
@@ -253,6 +267,7 @@ typedef struct GetSSIArgStruct
    cdouble EpsA, EpsB;
    cdouble MuA, MuB;
    bool SaIsPEC, SbIsPEC;
+   struct EdgeMomentData *MomentsA, *MomentsB; // nonzero if far pairs use moments
 
  } GetSSIArgStruct;
 
@@ -328,6 +343,7 @@ class FIPPICache
     // look up an entry 
     QIFIPPIData *GetQIFIPPIData(double **OVa, double **OVb, int ncv);
 
+    // updated atomically by GetQIFIPPIData
     int Hits, Misses;
 
   private:
@@ -336,13 +352,18 @@ class FIPPICache
     // storage table, but to allow maximal flexibility in implementation
     // i am just going to store an opaque pointer to this table
     // in the class body, with all the details left up to the 
-    // implementation 
+    // implementation (currently an array of independently-locked
+    // shards; see FIPPICache.cc)
     void *opTable;
 
-    rwlock FCLock;
+    // preloaded cache files, mapped read-only (CacheFile **)
+    void *Files;
+    int NumFiles;
 
-    char *PreloadFileName;
-    unsigned int RecordsPreloaded;
+    // if non-null, a cache file known to contain all records in the
+    // mapped files and all in-memory records marked as stored, to
+    // which Store() can append instead of rewriting
+    char *StoreFileName;
 
  };
 
@@ -384,6 +405,57 @@ int NumCommonVertices(RWGSurface *Sa, int npa, RWGSurface *Sb, int npb);
 int CanonicallyOrderVertices(double **Va, double **Vb, int ncv,
                              double **OVa, double **OVb);
 
+/****************************************************************/
+/*- 4. multipole moments of RWG basis functions, used to get    */
+/*-    interactions between well-separated basis functions on   */
+/*-    different surfaces without panel-panel cubature. the     */
+/*-    moments are frequency-independent and unchanged by       */
+/*-    displacements, so they are computed once per surface and */
+/*-    reused across frequencies and translation sweeps; they   */
+/*-    are recomputed only if the surface is rotated.           */
+/*-    (see EdgeMoments.cc and RWGGeometry::EdgeMomentThreshold)*/
+/****************************************************************/
+typedef struct EdgeMomentData
+ { double Rotation[3][3];  // rotation of the surface when the moments were computed
+   int NumEdges;
+   double *Moments;
+ } EdgeMomentData;
+
+EdgeMomentData *GetEdgeMoments(RWGSurface *S);
+void DestroyEdgeMoments(RWGSurface *S);
+const double *GetEdgeMomentPointer(EdgeMomentData *EMD, int ne);
+void GetEEIsFromMoments(const double *MA, const double *MB,
+                        const double R[3], cdouble k, cdouble GC[2]);
+bool EdgeMomentsAdmissible(RWGEdge *Ea, RWGEdge *Eb, const double R[3],
+                           cdouble k, double Threshold);
+
+/****************************************************************/
+/*- 5. content-addressed on-disk store of T-blocks (diagonal    */
+/*-    blocks of the BEM matrix), enabled by SCUFF_TBLOCK_PATH  */
+/*-    (see TBlockStore.cc)                                     */
+/****************************************************************/
+bool ReadTBlockStore(RWGGeometry *G, int ns, cdouble Omega, double *kBloch,
+                     HMatrix *M, int RowOffset, int ColOffset);
+bool WriteTBlockStore(RWGGeometry *G, int ns, cdouble Omega, double *kBloch,
+                      HMatrix *M, int RowOffset, int ColOffset);
+
+/****************************************************************/
+/*- 6. reduced fields of individual basis functions, and the    */
+/*-    multipole-accelerated evaluation of scattered fields at  */
+/*-    many points (see GetFields.cc, GetFieldsFMM.cc)          */
+/****************************************************************/
+typedef struct RFCubatureOptions
+ { double rRelOuterThreshold;  // low-order cubature beyond this rRel
+   double rRelInnerThreshold;  // high-order cubature beyond this rRel
+   int LowOrder, HighOrder;
+   bool NewMethod;
+ } RFCubatureOptions;
+
+void GetRFCubatureOptions(RFCubatureOptions *Options);
+void GetEdgeReducedFields(RWGGeometry *G, int ns, int ne, double X[3],
+                          cdouble k, GBarAccelerator *GBA,
+                          RFCubatureOptions *Options, cdouble GC[6]);
+
 } // namespace scuff
 
 #endif //LIBSCUFFINTERNALS_H
@@ -0,0 +1,184 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-ACAMatrix.cc -- SCUFF-EM unit test for the ACA-compressed
+ *                        -- BEM matrix, checked against the dense
+ *                        -- matrix from AssembleBEMMatrix
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+#include "KrylovSolver.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "PEC sphere, medium real frequency"
+#define TESTNAME2  "Two PEC spheres, imaginary frequency"
+#define TESTNAME3  "Two dielectric spheres, low real frequency"
+#define NUMTESTS   3
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* the ACA matrix is computed with relative tolerance ACATOL.  */
+/* a test passes if the compressed matrix and its matrix-vector*/
+/* product agree with their dense counterparts to within       */
+/* RELTOL in the relative 2-norm, and if the GMRES solution of */
+/* the compressed system has a relative residual below RELTOL  */
+/* in the dense system. (the solutions themselves are not      */
+/* compared, since at low frequencies the condition number of  */
+/* the BEM matrix amplifies the compression error.)            */
+/***************************************************************/
+#define ACATOL 1.0e-4
+#define RELTOL 1.0e-3
+
+/***************************************************************/
+/* |X-XRef| / |XRef| for vectors or matrices *******************/
+/***************************************************************/
+double RelDiff(cdouble *X, cdouble *XRef, size_t N)
+{
+  double Num=0.0, Denom=0.0;
+  for(size_t n=0; n<N; n++)
+   { Num   += norm(X[n]-XRef[n]);
+     Denom += norm(XRef[n]);
+   };
+  return Denom==0.0 ? sqrt(Num) : sqrt(Num/Denom);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-ACAMatrix.log");
+  Log("SCUFF-EM ACA matrix unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble Omega[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSphere_501.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.1*II;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.1;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  srand48(1);
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     /*--------------------------------------------------------------*/
+     /*- dense reference matrix and compressed matrix                -*/
+     /*--------------------------------------------------------------*/
+     HMatrix *M = G->AssembleBEMMatrix(Omega[nt]);
+     ACAMatrix *A = new ACAMatrix(G, ACATOL);
+     A->Assemble(Omega[nt]);
+     HMatrix *MACA = A->GetDenseMatrix();
+     double MatrixError = RelDiff(MACA->ZM, M->ZM, ((size_t)M->NR)*M->NC);
+     double Compression = A->GetStorage() / (((double)M->NR)*M->NC*sizeof(cdouble));
+
+     /*--------------------------------------------------------------*/
+     /*- matrix-vector product for a random vector                  -*/
+     /*--------------------------------------------------------------*/
+     int N=M->NR;
+     HVector *X=new HVector(N, LHM_COMPLEX);
+     HVector *Y=new HVector(N, LHM_COMPLEX);
+     HVector *YRef=new HVector(N, LHM_COMPLEX);
+     for(int n=0; n<N; n++)
+      X->SetEntry(n, cdouble(drand48()-0.5, drand48()-0.5));
+     A->Apply(X, Y);
+     M->Apply(X, YRef);
+     double ApplyError = RelDiff(Y->ZV, YRef->ZV, N);
+
+     /*--------------------------------------------------------------*/
+     /*- residual of the GMRES solution of the compressed system in  */
+     /*- the dense system                                            */
+     /*--------------------------------------------------------------*/
+     KrylovSolver *KS = new KrylovSolver(G, SCUFF_SOLVER_GMRES, 1.0e-8);
+     KS->SetMatrix(A, Omega[nt]);
+     Y->Copy(X);
+     KS->Solve(Y);
+     M->Apply(Y, YRef);
+     double SolveError = RelDiff(YRef->ZV, X->ZV, N);
+
+     if ( MatrixError>RELTOL || ApplyError>RELTOL || SolveError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (RelErr matrix = %.1e, apply = %.1e, residual = %.1e; storage = %.0f %% of dense)\n",
+              MatrixError, ApplyError, SolveError, 100.0*Compression);
+
+     delete KS;
+     delete X;
+     delete Y;
+     delete YRef;
+     delete MACA;
+     delete A;
+     delete M;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
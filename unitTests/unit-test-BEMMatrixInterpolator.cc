@@ -0,0 +1,242 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-BEMMatrixInterpolator.cc -- SCUFF-EM unit test for the
+ *                                    -- frequency-interpolated BEM
+ *                                    -- matrix, checked against direct
+ *                                    -- assembly
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Two PEC spheres, real frequencies"
+#define TESTNAME2  "Two dielectric spheres, imaginary frequencies"
+#define TESTNAME3  "Memory budget exceeded, direct assembly"
+#define TESTNAME4  "Diagonal block of a mate, regions zeroed"
+#define NUMTESTS   4
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* the interpolator is set up for a sweep of NUMFREQS equally  */
+/* spaced frequencies in [OmegaMin, OmegaMax] and the matrix   */
+/* is assembled at NUMCHECKS points in that range, chosen to   */
+/* fall in different interpolation intervals and away from the */
+/* Chebyshev nodes. a test passes if the interpolated matrix   */
+/* agrees with the directly-assembled matrix to within RELTOL  */
+/* in the relative Frobenius norm at every point. (with the    */
+/* default interpolation tolerance of 1e-6, the observed       */
+/* errors are below 1e-9.)                                     */
+/*                                                             */
+/* in the last test the memory budget is set to zero, so no    */
+/* block may be interpolated: AssembleBlock() must decline and */
+/* Assemble() must fall back to direct assembly of every block */
+/* (agreement to within DIRECTTOL).                            */
+/*                                                             */
+/* the last test checks the block of the second of two         */
+/* identical spheres, which is interpolated from the data of   */
+/* the first, with each region zeroed in turn, as scuff-neq    */
+/* and scuff-heat do to split it into interior and exterior    */
+/* contributions.                                              */
+/***************************************************************/
+#define RELTOL    1.0e-6
+#define DIRECTTOL 1.0e-12
+#define NUMFREQS  11
+#define NUMCHECKS 3
+
+/***************************************************************/
+/* |M-MRef| / |MRef| over all entries **************************/
+/***************************************************************/
+double RelDiff(HMatrix *M, HMatrix *MRef)
+{
+  double Num=0.0, Denom=0.0;
+  for(int nr=0; nr<MRef->NR; nr++)
+   for(int nc=0; nc<MRef->NC; nc++)
+    { Num   += norm(M->GetEntry(nr,nc) - MRef->GetEntry(nr,nc));
+      Denom += norm(MRef->GetEntry(nr,nc));
+    };
+  return sqrt(Num/Denom);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-BEMMatrixInterpolator.log");
+  Log("SCUFF-EM BEM matrix interpolator unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false, Test4=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {"Test4",     PA_BOOL, 0, 1, (void *)&Test4,     0, TESTNAME4},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble OmegaMin[NUMTESTS], OmegaMax[NUMTESTS];
+  bool OverBudget[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     OmegaMin[NumTests]     = 0.5;
+     OmegaMax[NumTests]     = 1.5;
+     OverBudget[NumTests]   = false;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     OmegaMin[NumTests]     = 0.1*II;
+     OmegaMax[NumTests]     = 1.0*II;
+     OverBudget[NumTests]   = false;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     OmegaMin[NumTests]     = 0.5;
+     OmegaMax[NumTests]     = 1.5;
+     OverBudget[NumTests]   = true;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     HVector *OmegaList = new HVector(NUMFREQS, LHM_COMPLEX);
+     for(int nf=0; nf<NUMFREQS; nf++)
+      OmegaList->SetEntry(nf, OmegaMin[nt] + (OmegaMax[nt]-OmegaMin[nt])*(nf/(NUMFREQS-1.0)));
+
+     if (OverBudget[nt])
+      setenv("SCUFF_INTERP_MAX_MB","0",1);
+     BEMMatrixInterpolator *BMI = CreateBEMMatrixInterpolator(G, OmegaList);
+     unsetenv("SCUFF_INTERP_MAX_MB");
+
+     HMatrix *M    = G->AllocateBEMMatrix();
+     HMatrix *MRef = G->AllocateBEMMatrix();
+     double MaxError=0.0;
+     bool Interpolated=false, Assembled=(BMI!=0);
+     for(int nc=0; BMI && nc<NUMCHECKS; nc++)
+      { double t = (nc + 0.37) / NUMCHECKS;
+        cdouble Omega = OmegaMin[nt] + t*(OmegaMax[nt]-OmegaMin[nt]);
+
+        if ( BMI->AssembleBlock(0, 0, Omega, M) )
+         Interpolated=true;
+        if ( !BMI->Assemble(Omega, M) )
+         Assembled=false;
+        G->AssembleBEMMatrix(Omega, MRef);
+
+        double Error=RelDiff(M, MRef);
+        if (Error>MaxError) MaxError=Error;
+      };
+
+     double Tol = OverBudget[nt] ? DIRECTTOL : RELTOL;
+     if ( !Assembled || Interpolated==OverBudget[nt] || MaxError>Tol )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (max RelErr = %.1e at %i frequencies; blocks %s)\n",
+              MaxError, NUMCHECKS, Interpolated ? "interpolated" : "assembled directly");
+
+     delete BMI;
+     delete OmegaList;
+     delete M;
+     delete MRef;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  if ( Test4 || AllTests )
+   {
+     RWGGeometry *G = new RWGGeometry("SiSpheres_255.scuffgeo");
+     printf("Test %i (%s): \n",NumTests,TESTNAME4);
+
+     HVector *OmegaList = new HVector(2, LHM_COMPLEX);
+     OmegaList->SetEntry(0, 0.5);
+     OmegaList->SetEntry(1, 1.5);
+     BEMMatrixInterpolator *BMI = CreateBEMMatrixInterpolator(G, OmegaList);
+
+     int NBF=G->Surfaces[1]->NumBFs;
+     HMatrix *M    = new HMatrix(NBF, NBF, LHM_COMPLEX);
+     HMatrix *MRef = new HMatrix(NBF, NBF, LHM_COMPLEX);
+     double MaxError=0.0;
+     bool Interpolated = (G->Mate[1]==0 && BMI!=0);
+     for(int nr=0; Interpolated && nr<G->NumRegions; nr++)
+      { G->RegionMPs[nr]->Zero();
+        if ( !BMI->AssembleBlock(1, 1, 0.77, M) )
+         Interpolated=false;
+        G->AssembleBEMMatrixBlock(1, 1, 0.77, 0, MRef);
+        G->RegionMPs[nr]->UnZero();
+
+        double Error=RelDiff(M, MRef);
+        if (Error>MaxError) MaxError=Error;
+      };
+
+     if ( !Interpolated || MaxError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (max RelErr = %.1e over %i zeroed regions)\n",
+              MaxError, G->NumRegions);
+
+     delete BMI;
+     delete OmegaList;
+     delete M;
+     delete MRef;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
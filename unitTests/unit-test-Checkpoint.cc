@@ -0,0 +1,174 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-Checkpoint.cc -- SCUFF-EM unit test for checkpoint files
+ *                         -- of integrand samples: samples read back
+ *                         -- after reopening the file must reproduce
+ *                         -- the values that were written
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Frequency samples, resumed run"
+#define TESTNAME2  "(Omega, kBloch) samples, resumed run"
+#define TESTNAME3  "Changed context or fresh start"
+#define NUMTESTS   3
+
+#define II cdouble(0.0,1.0)
+
+#define CPFILENAME "scuff-test-Checkpoint.checkpoint"
+#define CONTEXT    "unit-test-Checkpoint"
+#define NUMVALUES  5
+#define NUMSAMPLES 200
+
+static const char *Tags[]={"DEFAULT", "DISP_1.0", "DISP_2.0"};
+#define NUMTAGS 3
+
+/***************************************************************/
+/* the value stored for sample #ns                             */
+/***************************************************************/
+static void GetSample(int ns, bool UseKBloch,
+                      const char **Tag, cdouble *Omega, double kBloch[2],
+                      double *Values)
+{
+  *Tag      = Tags[ns%NUMTAGS];
+  *Omega    = (ns%2) ? cdouble(0.01*ns, 0.0) : cdouble(0.0, 0.01*ns);
+  kBloch[0] = UseKBloch ? 0.1*(ns%7) : 0.0;
+  kBloch[1] = UseKBloch ? -0.05*(ns%5) : 0.0;
+  for(int nv=0; nv<NUMVALUES; nv++)
+   Values[nv] = sin(1.0 + ns + 0.37*nv) * exp(0.1*nv);
+}
+
+/***************************************************************/
+/* write NumSamples samples to a checkpoint file opened with   */
+/* Context, reopen it with (NewContext, ReadExisting), and     */
+/* count the samples that are found again (NumFound) and those */
+/* whose values differ from the ones that were written          */
+/* (NumWrong).                                                 */
+/***************************************************************/
+static void WriteAndReread(bool UseKBloch, const char *NewContext,
+                           bool ReadExisting, int *NumFound, int *NumWrong)
+{
+  unlink(CPFILENAME);
+
+  CheckpointFile *CPF=OpenCheckpointFile(CPFILENAME, CONTEXT, NUMVALUES, false);
+  for(int ns=0; ns<NUMSAMPLES; ns++)
+   { const char *Tag;
+     cdouble Omega;
+     double kBloch[2], Values[NUMVALUES];
+     GetSample(ns, UseKBloch, &Tag, &Omega, kBloch, Values);
+     WriteCheckpoint(CPF, Tag, Omega, UseKBloch ? kBloch : 0, Values);
+   };
+  CloseCheckpointFile(CPF);
+
+  CPF=OpenCheckpointFile(CPFILENAME, NewContext, NUMVALUES, ReadExisting);
+  *NumFound=*NumWrong=0;
+  for(int ns=0; ns<NUMSAMPLES; ns++)
+   { const char *Tag;
+     cdouble Omega;
+     double kBloch[2], Values[NUMVALUES], ValuesRead[NUMVALUES];
+     GetSample(ns, UseKBloch, &Tag, &Omega, kBloch, Values);
+     if ( !ReadCheckpoint(CPF, Tag, Omega, UseKBloch ? kBloch : 0, ValuesRead) )
+      continue;
+     (*NumFound)++;
+     if ( memcmp(Values, ValuesRead, NUMVALUES*sizeof(double)) )
+      (*NumWrong)++;
+   };
+
+  // a sample that was never written must not be found
+  double ValuesRead[NUMVALUES];
+  if ( ReadCheckpoint(CPF, Tags[0], cdouble(-1.0,0.0), 0, ValuesRead) )
+   (*NumWrong)++;
+
+  CloseCheckpointFile(CPF);
+  unlink(CPFILENAME);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-Checkpoint.log");
+  Log("SCUFF-EM checkpoint unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  bool AllTests = (argc==1);
+  bool Success=true;
+  int NumFound, NumWrong;
+
+  /***************************************************************/
+  /* a resumed run must find every sample, with bitwise-identical*/
+  /* values                                                      */
+  /***************************************************************/
+  if ( Test1 || AllTests )
+   { WriteAndReread(false, CONTEXT, true, &NumFound, &NumWrong);
+     bool Passed = (NumFound==NUMSAMPLES && NumWrong==0);
+     printf("Test 1 (%s): \n %s  (%i/%i samples found, %i wrong)\n",
+             TESTNAME1, Passed ? "PASSED" : "FAILED", NumFound, NUMSAMPLES, NumWrong);
+     if (!Passed) Success=false;
+   };
+
+  if ( Test2 || AllTests )
+   { WriteAndReread(true, CONTEXT, true, &NumFound, &NumWrong);
+     bool Passed = (NumFound==NUMSAMPLES && NumWrong==0);
+     printf("Test 2 (%s): \n %s  (%i/%i samples found, %i wrong)\n",
+             TESTNAME2, Passed ? "PASSED" : "FAILED", NumFound, NUMSAMPLES, NumWrong);
+     if (!Passed) Success=false;
+   };
+
+  /***************************************************************/
+  /* samples written under a different context, or by a run that */
+  /* is not being resumed, must never be matched                 */
+  /***************************************************************/
+  if ( Test3 || AllTests )
+   { int NumFound1, NumWrong1, NumFound2, NumWrong2;
+     WriteAndReread(false, CONTEXT " changed", true, &NumFound1, &NumWrong1);
+     WriteAndReread(false, CONTEXT, false, &NumFound2, &NumWrong2);
+     bool Passed = (NumFound1==0 && NumWrong1==0 && NumFound2==0 && NumWrong2==0);
+     printf("Test 3 (%s): \n %s  (%i + %i samples found)\n",
+             TESTNAME3, Passed ? "PASSED" : "FAILED", NumFound1, NumFound2);
+     if (!Passed) Success=false;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,155 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-EdgeMoments.cc -- SCUFF-EM unit test for off-diagonal BEM
+ *                          -- matrix blocks computed from edge moments
+ *                          -- (RWGGeometry::EdgeMomentThreshold),
+ *                          -- checked against panel-panel cubature
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Two PEC spheres, low real frequency"
+#define TESTNAME2  "Two PEC spheres, imaginary frequency"
+#define TESTNAME3  "Two dielectric spheres, low real frequency"
+#define TESTNAME4  "Two PEC spheres, high real frequency"
+#define NUMTESTS   4
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* the (0,1) block of the BEM matrix is assembled with moments */
+/* at edge-moment threshold THRESHOLD and by cubature alone; a */
+/* test passes if the two agree to within RELTOL in the        */
+/* relative 2-norm. (at the high frequency of test 4 the       */
+/* moments are inadmissible for every edge pair, and the two   */
+/* blocks should agree exactly.)                               */
+/***************************************************************/
+#define THRESHOLD 8.0
+#define RELTOL    1.0e-4
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-EdgeMoments.log");
+  Log("SCUFF-EM edge-moment unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false, Test4=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {"Test4",     PA_BOOL, 0, 1, (void *)&Test4,     0, TESTNAME4},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble Omega[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 1.0*II;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+  if ( Test4 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 10.0;
+     TestNames[NumTests]    = TESTNAME4;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     int NBF0=G->Surfaces[0]->NumBFs, NBF1=G->Surfaces[1]->NumBFs;
+     HMatrix *BRef = new HMatrix(NBF0, NBF1, LHM_COMPLEX);
+     HMatrix *B    = new HMatrix(NBF0, NBF1, LHM_COMPLEX);
+
+     RWGGeometry::EdgeMomentThreshold=0.0;
+     G->AssembleBEMMatrixBlock(0, 1, Omega[nt], 0, BRef);
+
+     RWGGeometry::EdgeMomentThreshold=THRESHOLD;
+     G->AssembleBEMMatrixBlock(0, 1, Omega[nt], 0, B);
+     RWGGeometry::EdgeMomentThreshold=0.0;
+
+     double Num=0.0, Denom=0.0;
+     for(int nr=0; nr<NBF0; nr++)
+      for(int nc=0; nc<NBF1; nc++)
+       { Num   += norm(B->GetEntry(nr,nc) - BRef->GetEntry(nr,nc));
+         Denom += norm(BRef->GetEntry(nr,nc));
+       };
+     double RelError = sqrt(Num/Denom);
+
+     if ( RelError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (RelErr = %.1e)\n",RelError);
+
+     delete B;
+     delete BRef;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,183 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-FIPPICache.cc -- SCUFF-EM unit test for concurrent lookups
+ *                         -- and insertions in the global FIPPI cache,
+ *                         -- checked against uncached FIPPI data
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <libhrutil.h>
+#include "libscuff.h"
+#include "libscuffInternals.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Concurrent lookups, cold cache"
+#define TESTNAME2  "Concurrent lookups, warm cache"
+#define NUMTESTS   2
+
+/***************************************************************/
+/* NUMTHREADS threads look up the FIPPI data for every ordered */
+/* pair of panels on a 334-panel sphere. threads 2n and 2n+1   */
+/* walk the list from the same starting point, so they race to */
+/* insert the same keys, and every thread eventually visits    */
+/* every key. (the ~10^5 distinct keys are enough to make the  */
+/* table of each shard grow while lookups are in flight.)      */
+/* a test passes if every record returned by the cache is      */
+/* bitwise identical to the uncached data for its pair, and if */
+/* each distinct key was computed exactly once (cold cache) or */
+/* not at all (warm cache).                                    */
+/***************************************************************/
+#define NUMTHREADS 8
+
+typedef struct PanelPair
+ { double *OVa[3], *OVb[3];
+   int ncv;
+   int VIndices[6];
+ } PanelPair;
+
+static int CompareVIndices(const void *p1, const void *p2)
+{ return memcmp( ((PanelPair *)p1)->VIndices, ((PanelPair *)p2)->VIndices,
+                 6*sizeof(int) );
+}
+
+/***************************************************************/
+/* look up every pair from each of NUMTHREADS threads; returns */
+/* the number of records that differ from the reference data   */
+/***************************************************************/
+static int HammerCache(PanelPair *Pairs, QIFIPPIData *RefData, int NumPairs)
+{
+  int NumWrong=0;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static,1) num_threads(NUMTHREADS) reduction(+:NumWrong)
+#endif
+  for(int nt=0; nt<NUMTHREADS; nt++)
+   { int Start = (nt/2) * (NumPairs/(NUMTHREADS/2));
+     for(int n=0; n<NumPairs; n++)
+      { int np = (Start + n) % NumPairs;
+        QIFIPPIData *QIFD
+         = GlobalFIPPICache.GetQIFIPPIData(Pairs[np].OVa, Pairs[np].OVb, Pairs[np].ncv);
+        if ( memcmp(QIFD, RefData + np, sizeof(QIFIPPIData)) )
+         NumWrong++;
+      };
+   };
+  return NumWrong;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-FIPPICache.log");
+  Log("SCUFF-EM FIPPI cache unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  bool AllTests = (argc==1);
+
+  /***************************************************************/
+  /* canonically-ordered vertices and uncached FIPPI data for    */
+  /* all panel pairs                                             */
+  /***************************************************************/
+  RWGGeometry *G = new RWGGeometry("PECSphere_501.scuffgeo");
+  RWGSurface *S  = G->Surfaces[0];
+  int NP         = S->NumPanels;
+  int NumPairs   = NP*NP;
+
+  PanelPair *Pairs     = (PanelPair *)mallocEC(NumPairs*sizeof(PanelPair));
+  QIFIPPIData *RefData = (QIFIPPIData *)mallocEC(NumPairs*sizeof(QIFIPPIData));
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+  for(int npa=0; npa<NP; npa++)
+   for(int npb=0; npb<NP; npb++)
+    { PanelPair *PP = Pairs + npa*NP + npb;
+      double rRel, *Va[3], *Vb[3];
+      PP->ncv=AssessPanelPair(S, npa, S, npb, &rRel, Va, Vb);
+      CanonicallyOrderVertices(Va, Vb, PP->ncv, PP->OVa, PP->OVb);
+      for(int i=0; i<3; i++)
+       { PP->VIndices[i]   = (PP->OVa[i] - S->Vertices)/3;
+         PP->VIndices[3+i] = (PP->OVb[i] - S->Vertices)/3;
+       };
+      ComputeQIFIPPIData(PP->OVa, PP->OVb, PP->ncv, RefData + npa*NP + npb);
+    };
+
+  // number of distinct keys
+  PanelPair *Sorted = (PanelPair *)memdup(Pairs, NumPairs*sizeof(PanelPair));
+  qsort(Sorted, NumPairs, sizeof(PanelPair), CompareVIndices);
+  int NumKeys=1;
+  for(int np=1; np<NumPairs; np++)
+   if ( CompareVIndices(Sorted+np-1, Sorted+np) )
+    NumKeys++;
+  free(Sorted);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  for(int nt=0; nt<NUMTESTS; nt++)
+   {
+     int Hits0=GlobalFIPPICache.Hits, Misses0=GlobalFIPPICache.Misses;
+     int NumWrong=HammerCache(Pairs, RefData, NumPairs);
+     int Hits=GlobalFIPPICache.Hits-Hits0, Misses=GlobalFIPPICache.Misses-Misses0;
+
+     // the warm-cache test needs the cold-cache pass to have run first
+     if ( nt==0 && !Test1 && !AllTests ) continue;
+     if ( nt==1 && !Test2 && !AllTests ) continue;
+     printf("Test %i (%s): \n",nt,nt==0 ? TESTNAME1 : TESTNAME2);
+
+     int ExpectedMisses = (nt==0) ? NumKeys : 0;
+     bool Passed = (    NumWrong==0
+                     && Misses==ExpectedMisses
+                     && Hits+Misses==NUMTHREADS*NumPairs
+                   );
+     if (!Passed)
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (%i wrong records; %i/%i keys computed; %i hits)\n",
+              NumWrong, Misses, NumKeys, Hits);
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,182 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-FMM.cc -- SCUFF-EM unit test for the multipole-accelerated
+ *                  -- scattered-field evaluation (RWGGeometry::FMMOrder),
+ *                  -- checked against the reduced-field-matrix path
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+#include "libIncField.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "PEC sphere, medium real frequency"
+#define TESTNAME2  "Two PEC spheres, medium real frequency"
+#define TESTNAME3  "Two dielectric spheres, imaginary frequency"
+#define NUMTESTS   3
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* scattered fields at NUMPOINTS random points outside the     */
+/* spheres are computed with multipole order FMMORDER and with */
+/* the exact reduced-field matrix. a test passes if the largest*/
+/* pointwise error in the six-vector of E and ZVAC*H is below  */
+/* RELTOL times the largest field magnitude.                   */
+/***************************************************************/
+#define FMMORDER  8
+#define NUMPOINTS 400
+#define RELTOL    1.0e-3
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-FMM.log");
+  Log("SCUFF-EM FMM unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble Omega[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSphere_501.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5*II;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  srand48(1);
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     /*--------------------------------------------------------------*/
+     /*- solve the scattering problem for a plane wave               -*/
+     /*--------------------------------------------------------------*/
+     cdouble E0[3]={1.0, 0.0, 0.0};
+     double nHat[3]={0.0, 0.0, 1.0};
+     PlaneWave PW(E0, nHat);
+     HMatrix *M  = G->AssembleBEMMatrix(Omega[nt]);
+     HVector *KN = G->AssembleRHSVector(Omega[nt], &PW);
+     M->LUFactorize();
+     M->LUSolve(KN);
+
+     /*--------------------------------------------------------------*/
+     /*- random evaluation points outside all surfaces               -*/
+     /*--------------------------------------------------------------*/
+     HMatrix *XMatrix = new HMatrix(NUMPOINTS, 3);
+     for(int nx=0; nx<NUMPOINTS; )
+      { double X[3];
+        X[0] = -3.0 + 6.0*drand48();
+        X[1] = -3.0 + 6.0*drand48();
+        X[2] = -3.0 + 9.0*drand48();
+        if ( G->GetRegionIndex(X)!=0 ) continue;
+        XMatrix->SetEntriesD(nx++, ":", X);
+      };
+
+     /*--------------------------------------------------------------*/
+     /*- scattered fields by both methods                            -*/
+     /*--------------------------------------------------------------*/
+     RWGGeometry::FMMOrder=0;
+     HMatrix *FRef = G->GetFields(0, KN, Omega[nt], XMatrix);
+
+     RWGGeometry::FMMOrder=FMMORDER;
+     double FMMThresholdSave=RWGGeometry::FMMThreshold;
+     RWGGeometry::FMMThreshold=0.0;
+     HMatrix *F = G->GetFields(0, KN, Omega[nt], XMatrix);
+     RWGGeometry::FMMOrder=0;
+     RWGGeometry::FMMThreshold=FMMThresholdSave;
+
+     double MaxError=0.0, MaxField=0.0;
+     for(int nx=0; nx<NUMPOINTS; nx++)
+      { double Error=0.0, Field=0.0;
+        for(int Mu=0; Mu<6; Mu++)
+         { double Scale = (Mu<3) ? 1.0 : ZVAC;
+           Error += norm( Scale*(F->GetEntry(nx,Mu) - FRef->GetEntry(nx,Mu)) );
+           Field += norm( Scale*FRef->GetEntry(nx,Mu) );
+         };
+        MaxError = fmax(MaxError, sqrt(Error));
+        MaxField = fmax(MaxField, sqrt(Field));
+      };
+     double RelError = MaxError / MaxField;
+
+     if ( RelError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (max error / max field = %.1e)\n",RelError);
+
+     delete F;
+     delete FRef;
+     delete XMatrix;
+     delete KN;
+     delete M;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,200 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-KrylovSolver.cc -- SCUFF-EM unit test for the preconditioned
+ *                           -- GMRES and BiCGStab solvers, checked
+ *                           -- against the dense LU solution
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+#include "libIncField.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Two PEC spheres, GMRES"
+#define TESTNAME2  "Two PEC spheres, BiCGStab"
+#define TESTNAME3  "Two dielectric spheres, GMRES"
+#define TESTNAME4  "Two dielectric spheres, BiCGStab"
+#define NUMTESTS   4
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* the BEM system is solved by the iterative solver, run to    */
+/* relative residual SOLVERTOL, and by LU factorization, for a */
+/* plane-wave RHS vector (Solve(HVector *)) and for a matrix   */
+/* of NUMRHS random RHS columns (Solve(HMatrix *), the path    */
+/* used for batches of incident fields in scuff-scatter). a    */
+/* test passes if the solver converges and both solutions      */
+/* agree with LU to within RELTOL in the relative 2-norm.      */
+/***************************************************************/
+#define SOLVERTOL 1.0e-10
+#define RELTOL    1.0e-6
+#define NUMRHS    4
+
+/***************************************************************/
+/* |X-XRef| / |XRef| over all entries **************************/
+/***************************************************************/
+double RelDiff(cdouble *X, cdouble *XRef, int N)
+{
+  double Num=0.0, Denom=0.0;
+  for(int n=0; n<N; n++)
+   { Num   += norm(X[n] - XRef[n]);
+     Denom += norm(XRef[n]);
+   };
+  return sqrt(Num/Denom);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-KrylovSolver.log");
+  Log("SCUFF-EM Krylov solver unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false, Test4=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {"Test4",     PA_BOOL, 0, 1, (void *)&Test4,     0, TESTNAME4},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble Omega[NUMTESTS];
+  int Method[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     Method[NumTests]       = SCUFF_SOLVER_GMRES;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     Method[NumTests]       = SCUFF_SOLVER_BICGSTAB;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5;
+     Method[NumTests]       = SCUFF_SOLVER_GMRES;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+  if ( Test4 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5;
+     Method[NumTests]       = SCUFF_SOLVER_BICGSTAB;
+     TestNames[NumTests]    = TESTNAME4;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  srand48(1);
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     /*--------------------------------------------------------------*/
+     /*- BEM matrix, its LU factorization, and the right-hand sides  -*/
+     /*--------------------------------------------------------------*/
+     HMatrix *M    = G->AssembleBEMMatrix(Omega[nt]);
+     HMatrix *MRef = new HMatrix(M);
+     MRef->LUFactorize();
+
+     cdouble E0[3]={1.0, 0.0, 0.0};
+     double nHat[3]={0.0, 0.0, 1.0};
+     PlaneWave PW(E0, nHat);
+     HVector *KN    = G->AssembleRHSVector(Omega[nt], &PW);
+     HVector *KNRef = new HVector(KN);
+
+     int N=G->TotalBFs;
+     HMatrix *KNBatch    = new HMatrix(N, NUMRHS, LHM_COMPLEX);
+     for(int nr=0; nr<N; nr++)
+      for(int nc=0; nc<NUMRHS; nc++)
+       KNBatch->SetEntry(nr, nc, cdouble(drand48()-0.5, drand48()-0.5));
+     HMatrix *KNBatchRef = new HMatrix(KNBatch);
+
+     /*--------------------------------------------------------------*/
+     /*- solve by both methods                                       -*/
+     /*--------------------------------------------------------------*/
+     MRef->LUSolve(KNRef);
+     MRef->LUSolve(KNBatchRef);
+
+     KrylovSolver *KS = new KrylovSolver(G, Method[nt], SOLVERTOL);
+     KS->SetMatrix(M);
+     int Status = KS->Solve(KN);
+     int Iters  = KS->NumIterations;
+     Status    += KS->Solve(KNBatch);
+     int BatchIters = KS->NumIterations;
+
+     double VectorError = RelDiff(KN->ZV, KNRef->ZV, N);
+     double BatchError  = RelDiff(KNBatch->ZM, KNBatchRef->ZM, N*NUMRHS);
+
+     if ( Status!=0 || VectorError>RELTOL || BatchError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (RelErr vector = %.1e, %i iterations; batch = %.1e, %i iterations%s)\n",
+              VectorError, Iters, BatchError, BatchIters,
+              Status ? "; not converged" : "");
+
+     delete KS;
+     delete KNBatch;
+     delete KNBatchRef;
+     delete KN;
+     delete KNRef;
+     delete M;
+     delete MRef;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,192 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-LDLT.cc -- SCUFF-EM unit test for the symmetric (LDL^T)
+ *                   -- factorization of BEM matrices
+ *                   -- (RWGGeometry::UseSymmetricFactorization),
+ *                   -- checked against the dense LU factorization
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "PEC sphere, medium real frequency"
+#define TESTNAME2  "Two dielectric spheres, imaginary frequency"
+#define TESTNAME3  "Two PEC spheres, matrix re-assembled at a new frequency"
+#define NUMTESTS   3
+
+#define II cdouble(0.0,1.0)
+
+/***************************************************************/
+/* a test passes if the matrix-vector product and the solution */
+/* of the BEM system for a random right-hand side computed     */
+/* with the LDL^T-factorized matrix agree with those computed  */
+/* with the full matrix and its LU factorization to within     */
+/* RELTOL in the relative 2-norm. in the re-assembly test, the */
+/* LDL^T matrix is first assembled and factorized at a         */
+/* different frequency.                                        */
+/***************************************************************/
+#define RELTOL 1.0e-8
+
+/***************************************************************/
+/* |X-XRef| / |XRef| *******************************************/
+/***************************************************************/
+double RelDiff(HVector *X, HVector *XRef)
+{
+  double Num=0.0, Denom=0.0;
+  for(int n=0; n<X->N; n++)
+   { Num   += norm(X->GetEntry(n) - XRef->GetEntry(n));
+     Denom += norm(XRef->GetEntry(n));
+   };
+  return Denom==0.0 ? sqrt(Num) : sqrt(Num/Denom);
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-LDLT.log");
+  Log("SCUFF-EM LDL^T unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool AllTests = (argc==1);
+
+  const char *GeoFileNames[NUMTESTS];
+  cdouble Omega[NUMTESTS], OmegaFirst[NUMTESTS];
+  const char *TestNames[NUMTESTS];
+  int NumTests=0;
+
+  if ( Test1 || AllTests )
+   { GeoFileNames[NumTests] = "PECSphere_501.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     OmegaFirst[NumTests]   = 0.0;
+     TestNames[NumTests]    = TESTNAME1;
+     NumTests++;
+   };
+  if ( Test2 || AllTests )
+   { GeoFileNames[NumTests] = "SiSpheres_255.scuffgeo";
+     Omega[NumTests]        = 0.5*II;
+     OmegaFirst[NumTests]   = 0.0;
+     TestNames[NumTests]    = TESTNAME2;
+     NumTests++;
+   };
+  if ( Test3 || AllTests )
+   { GeoFileNames[NumTests] = "PECSpheres_255.scuffgeo";
+     Omega[NumTests]        = 1.0;
+     OmegaFirst[NumTests]   = 0.1;
+     TestNames[NumTests]    = TESTNAME3;
+     NumTests++;
+   };
+
+  /***************************************************************/
+  /***************************************************************/
+  /***************************************************************/
+  bool Success=true;
+  srand48(1);
+  for(int nt=0; nt<NumTests; nt++)
+   {
+     RWGGeometry *G = new RWGGeometry(GeoFileNames[nt]);
+     printf("Test %i (%s): \n",nt,TestNames[nt]);
+
+     /*--------------------------------------------------------------*/
+     /*- reference: full matrix, LU factorization                    -*/
+     /*--------------------------------------------------------------*/
+     RWGGeometry::UseSymmetricFactorization=false;
+     HMatrix *MRef = G->AssembleBEMMatrix(Omega[nt]);
+
+     /*--------------------------------------------------------------*/
+     /*- LDL^T matrix, possibly factorized at another frequency      -*/
+     /*- first                                                       -*/
+     /*--------------------------------------------------------------*/
+     RWGGeometry::UseSymmetricFactorization=true;
+     HMatrix *M = G->AllocateBEMMatrix();
+     if ( OmegaFirst[nt]!=0.0 )
+      { G->AssembleBEMMatrix(OmegaFirst[nt], M);
+        M->LUFactorize();
+      };
+     G->AssembleBEMMatrix(Omega[nt], M);
+     RWGGeometry::UseSymmetricFactorization=false;
+     bool UsedLDLT = M->UseLDLT && !M->LDLFactored;
+
+     /*--------------------------------------------------------------*/
+     /*- matrix-vector products for a random vector                  -*/
+     /*--------------------------------------------------------------*/
+     HVector *X    = G->AllocateRHSVector();
+     HVector *Y    = G->AllocateRHSVector();
+     HVector *YRef = G->AllocateRHSVector();
+     for(int n=0; n<X->N; n++)
+      X->SetEntry(n, cdouble(drand48()-0.5, drand48()-0.5));
+     M->Apply(X, Y);
+     MRef->Apply(X, YRef);
+     double ApplyError = RelDiff(Y, YRef);
+
+     /*--------------------------------------------------------------*/
+     /*- solutions of the BEM system                                  */
+     /*--------------------------------------------------------------*/
+     M->LUFactorize();
+     MRef->LUFactorize();
+     Y->Copy(X);
+     YRef->Copy(X);
+     M->LUSolve(Y);
+     MRef->LUSolve(YRef);
+     double SolveError = RelDiff(Y, YRef);
+
+     if ( !UsedLDLT || ApplyError>RELTOL || SolveError>RELTOL )
+      { Success=false;
+        printf(" FAILED ");
+      }
+     else
+      printf(" PASSED ");
+     printf(" (RelErr apply = %.1e, solve = %.1e%s)\n",
+              ApplyError, SolveError, UsedLDLT ? "" : "; LDL^T not used");
+
+     delete X;
+     delete Y;
+     delete YRef;
+     delete M;
+     delete MRef;
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}
@@ -0,0 +1,316 @@
+/* Copyright (C) 2005-2011 M. T. Homer Reid
+ *
+ * This file is part of SCUFF-EM.
+ *
+ * SCUFF-EM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SCUFF-EM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * unit-test-TBlockStore.cc -- SCUFF-EM unit test for the on-disk store
+ *                          -- of T-blocks (SCUFF_TBLOCK_PATH)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <utime.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libhrutil.h>
+#include "libscuff.h"
+#include "libscuffInternals.h"
+
+using namespace scuff;
+
+#define TESTNAME1  "Round trip, symmetric block"
+#define TESTNAME2  "Round trip, non-symmetric block"
+#define TESTNAME3  "Key mismatch and corrupted data"
+#define TESTNAME4  "Eviction under SCUFF_TBLOCK_BUDGET"
+#define NUMTESTS   4
+
+/***************************************************************/
+/* blocks read back from the store must be bitwise identical   */
+/* to the blocks that were written (symmetric blocks are       */
+/* stored as their upper triangle, others in full; the flags   */
+/* word at byte 16 of the file header says which). a block     */
+/* file whose key does not match the request, or whose data    */
+/* have been corrupted, must be rejected without touching the  */
+/* matrix. with a budget of 2.5 blocks, writing a third block  */
+/* must evict the least-recently-used one (reading a block     */
+/* counts as using it).                                        */
+/***************************************************************/
+#define STOREBASE     "scuff-test-TBlockStore"
+#define TBS_SYMMETRIC 1
+#define SENTINEL      -1.0
+#define MAXSTR        1000
+
+/***************************************************************/
+/* store directories ********************************************/
+/***************************************************************/
+static void RemoveStore(const char *Dir)
+{
+  DIR *D=opendir(Dir);
+  struct dirent *DE;
+  char FileName[MAXSTR];
+  while( D && (DE=readdir(D)) )
+   { if (DE->d_name[0]=='.') continue;
+     snprintf(FileName, MAXSTR, "%s/%s", Dir, DE->d_name);
+     unlink(FileName);
+   };
+  if (D) closedir(D);
+  rmdir(Dir);
+}
+
+static void UseNewStore(const char *Dir)
+{
+  RemoveStore(Dir);
+  mkdir(Dir, 0755);
+  setenv("SCUFF_TBLOCK_PATH", Dir, 1);
+  unsetenv("SCUFF_TBLOCK_BUDGET");
+}
+
+// find a block file in Dir other than Exclude1, Exclude2
+static bool FindBlock(const char *Dir, char *FileName,
+                      const char *Exclude1="", const char *Exclude2="")
+{
+  DIR *D=opendir(Dir);
+  struct dirent *DE;
+  bool Found=false;
+  while( !Found && D && (DE=readdir(D)) )
+   { if ( !strstr(DE->d_name, ".tblk") || strstr(DE->d_name, ".tmp") )
+      continue;
+     snprintf(FileName, MAXSTR, "%s/%s", Dir, DE->d_name);
+     Found = strcmp(FileName, Exclude1) && strcmp(FileName, Exclude2);
+   };
+  if (D) closedir(D);
+  return Found;
+}
+
+static bool FileExists(const char *FileName)
+{ struct stat st;
+  return stat(FileName, &st)==0;
+}
+
+static long FileSize(const char *FileName)
+{ struct stat st;
+  return stat(FileName, &st) ? 0 : (long)st.st_size;
+}
+
+static void SetFileTime(const char *FileName, time_t Time)
+{ struct utimbuf UT;
+  UT.actime=UT.modtime=Time;
+  utime(FileName, &UT);
+}
+
+static int GetBlockFlags(const char *FileName)
+{ FILE *f=fopen(FileName,"r");
+  if (!f) return -1;
+  fseek(f, 16, SEEK_SET);
+  int Flags=fgetc(f);
+  fclose(f);
+  return Flags;
+}
+
+static void CopyFile(const char *From, const char *To)
+{ FILE *fi=fopen(From,"r"), *fo=fopen(To,"w");
+  int c;
+  while( fi && fo && (c=fgetc(fi))!=EOF )
+   fputc(c, fo);
+  if (fi) fclose(fi);
+  if (fo) fclose(fo);
+}
+
+static void CorruptLastByte(const char *FileName)
+{ FILE *f=fopen(FileName,"r+");
+  if (!f) return;
+  fseek(f, -1, SEEK_END);
+  int c=fgetc(f);
+  fseek(f, -1, SEEK_END);
+  fputc(c ^ 0xFF, f);
+  fclose(f);
+}
+
+/***************************************************************/
+/* matrix comparisons ******************************************/
+/***************************************************************/
+static bool SameBits(HMatrix *A, HMatrix *B)
+{ return !memcmp(A->ZM, B->ZM, ((size_t)A->NR)*A->NC*sizeof(cdouble)); }
+
+static void FillSentinel(HMatrix *M)
+{ for(int nr=0; nr<M->NR; nr++)
+   for(int nc=0; nc<M->NC; nc++)
+    M->SetEntry(nr, nc, SENTINEL);
+}
+
+static bool IsSentinel(HMatrix *M)
+{ for(int nr=0; nr<M->NR; nr++)
+   for(int nc=0; nc<M->NC; nc++)
+    if ( M->GetEntry(nr,nc)!=SENTINEL )
+     return false;
+  return true;
+}
+
+/***************************************************************/
+/***************************************************************/
+/***************************************************************/
+static void Report(int nt, const char *TestName, bool Passed, const char *Details,
+                   bool *Success)
+{
+  printf("Test %i (%s): \n",nt,TestName);
+  printf(Passed ? " PASSED " : " FAILED ");
+  printf(" (%s)\n",Details);
+  if (!Passed) *Success=false;
+}
+
+int main(int argc, char *argv[])
+{
+  SetLogFileName("scuff-test-TBlockStore.log");
+  Log("SCUFF-EM T-block store unit test running on %s",GetHostName());
+
+  bool Test1=false, Test2=false, Test3=false, Test4=false;
+  /* name        type    #args  max_instances  storage    count  description*/
+  OptStruct OSArray[]=
+   {
+     {"Test1",     PA_BOOL, 0, 1, (void *)&Test1,     0, TESTNAME1},
+     {"Test2",     PA_BOOL, 0, 1, (void *)&Test2,     0, TESTNAME2},
+     {"Test3",     PA_BOOL, 0, 1, (void *)&Test3,     0, TESTNAME3},
+     {"Test4",     PA_BOOL, 0, 1, (void *)&Test4,     0, TESTNAME4},
+     {0,0,0,0,0,0,0}
+   };
+  ProcessOptions(argc, argv, OSArray);
+
+  bool AllTests = (argc==1);
+  bool Success=true;
+
+  RWGGeometry *G = new RWGGeometry("PECSphere_255.scuffgeo");
+  int NBF=G->Surfaces[0]->NumBFs;
+  HMatrix *T    = new HMatrix(NBF, NBF, LHM_COMPLEX);
+  HMatrix *TRef = new HMatrix(NBF, NBF, LHM_COMPLEX);
+  char Dir[MAXSTR], Dir2[MAXSTR], FileA[MAXSTR], FileB[MAXSTR], FileC[MAXSTR];
+  char Details[MAXSTR];
+
+  /***************************************************************/
+  /* test 1: a T-block assembled with the store enabled is       */
+  /* written to it and is read back bitwise identical            */
+  /***************************************************************/
+  if ( Test1 || AllTests )
+   { snprintf(Dir, MAXSTR, "%s.1", STOREBASE);
+     UseNewStore(Dir);
+     G->AssembleBEMMatrixBlock(0, 0, 1.0, 0, TRef);
+     bool Written = FindBlock(Dir, FileA);
+     bool Symmetric = Written && (GetBlockFlags(FileA) & TBS_SYMMETRIC);
+     FillSentinel(T);
+     bool Read = ReadTBlockStore(G, 0, 1.0, 0, T, 0, 0);
+     bool Same = Read && SameBits(T, TRef);
+     snprintf(Details, MAXSTR, "written=%i symmetric=%i read=%i identical=%i",
+              Written, Symmetric, Read, Same);
+     Report(0, TESTNAME1, Written && Symmetric && Same, Details, &Success);
+     RemoveStore(Dir);
+   };
+
+  /***************************************************************/
+  /* test 2: a block that is not symmetric is stored in full     */
+  /***************************************************************/
+  if ( Test2 || AllTests )
+   { snprintf(Dir, MAXSTR, "%s.2", STOREBASE);
+     unsetenv("SCUFF_TBLOCK_PATH");
+     G->AssembleBEMMatrixBlock(0, 0, 2.0, 0, TRef);
+     TRef->SetEntry(0, NBF-1, TRef->GetEntry(0,NBF-1) + 1.0);
+     UseNewStore(Dir);
+     bool Written = WriteTBlockStore(G, 0, 2.0, 0, TRef, 0, 0) && FindBlock(Dir, FileA);
+     bool Symmetric = Written && (GetBlockFlags(FileA) & TBS_SYMMETRIC);
+     FillSentinel(T);
+     bool Read = ReadTBlockStore(G, 0, 2.0, 0, T, 0, 0);
+     bool Same = Read && SameBits(T, TRef);
+     snprintf(Details, MAXSTR, "written=%i symmetric=%i read=%i identical=%i",
+              Written, Symmetric, Read, Same);
+     Report(1, TESTNAME2, Written && !Symmetric && Same, Details, &Success);
+     RemoveStore(Dir);
+   };
+
+  /***************************************************************/
+  /* test 3: the file for the block at Omega=1 is copied to the  */
+  /* name of the block at Omega=0.5, and the data of another     */
+  /* copy are corrupted; both must be rejected                   */
+  /***************************************************************/
+  if ( Test3 || AllTests )
+   { snprintf(Dir,  MAXSTR, "%s.3a", STOREBASE);
+     snprintf(Dir2, MAXSTR, "%s.3b", STOREBASE);
+     UseNewStore(Dir2);
+     G->AssembleBEMMatrixBlock(0, 0, 0.5, 0, TRef);
+     FindBlock(Dir2, FileB);
+     UseNewStore(Dir);
+     G->AssembleBEMMatrixBlock(0, 0, 1.0, 0, TRef);
+     FindBlock(Dir, FileA);
+     CopyFile(FileA, FileB);
+
+     setenv("SCUFF_TBLOCK_PATH", Dir2, 1);
+     FillSentinel(T);
+     bool KeyRejected = !ReadTBlockStore(G, 0, 0.5, 0, T, 0, 0) && IsSentinel(T);
+
+     setenv("SCUFF_TBLOCK_PATH", Dir, 1);
+     CorruptLastByte(FileA);
+     bool CorruptRejected = !ReadTBlockStore(G, 0, 1.0, 0, T, 0, 0) && IsSentinel(T);
+
+     snprintf(Details, MAXSTR, "key mismatch rejected=%i, corrupted data rejected=%i",
+              KeyRejected, CorruptRejected);
+     Report(2, TESTNAME3, KeyRejected && CorruptRejected, Details, &Success);
+     RemoveStore(Dir);
+     RemoveStore(Dir2);
+   };
+
+  /***************************************************************/
+  /* test 4: blocks A, B are written, with B more recently used  */
+  /* than A; then A is read, and C is written with a budget of   */
+  /* 2.5 blocks, which must evict B                              */
+  /***************************************************************/
+  if ( Test4 || AllTests )
+   { snprintf(Dir, MAXSTR, "%s.4", STOREBASE);
+     UseNewStore(Dir);
+     time_t Now=time(0);
+     G->AssembleBEMMatrixBlock(0, 0, 0.25, 0, T);
+     FindBlock(Dir, FileA);
+     SetFileTime(FileA, Now-200);
+
+     char Budget[100];
+     snprintf(Budget, 100, "%li", (long)(2.5*FileSize(FileA)));
+     setenv("SCUFF_TBLOCK_BUDGET", Budget, 1);
+
+     G->AssembleBEMMatrixBlock(0, 0, 0.75, 0, T);
+     FindBlock(Dir, FileB, FileA);
+     SetFileTime(FileB, Now-100);
+
+     ReadTBlockStore(G, 0, 0.25, 0, T, 0, 0);
+     G->AssembleBEMMatrixBlock(0, 0, 1.25, 0, TRef);
+     FindBlock(Dir, FileC, FileA, FileB);
+
+     bool Evicted = FileExists(FileA) && !FileExists(FileB) && FileExists(FileC);
+     FillSentinel(T);
+     bool Read = ReadTBlockStore(G, 0, 1.25, 0, T, 0, 0) && SameBits(T, TRef);
+     snprintf(Details, MAXSTR, "A kept=%i, B evicted=%i, C kept=%i, C read=%i",
+              FileExists(FileA), !FileExists(FileB), FileExists(FileC), Read);
+     Report(3, TESTNAME4, Evicted && Read, Details, &Success);
+     RemoveStore(Dir);
+   };
+
+  if (Success)
+   exit(0);
+  else
+   exit(1);
+
+}